@@ -110,6 +110,8 @@ struct boot_times {
         usec_t initrd_generators_finish_time;
         usec_t initrd_unitsload_start_time;
         usec_t initrd_unitsload_finish_time;
+        usec_t reload_start_time;
+        usec_t reload_finish_time;
 
         /*
          * If we're analyzing the user instance, all timestamps will be offset
@@ -250,6 +252,8 @@ static int acquire_boot_times(sd_bus *bus, struct boot_times **bt) {
                 { "InitRDGeneratorsFinishTimestampMonotonic", "t", NULL, offsetof(struct boot_times, initrd_generators_finish_time) },
                 { "InitRDUnitsLoadStartTimestampMonotonic",   "t", NULL, offsetof(struct boot_times, initrd_unitsload_start_time)   },
                 { "InitRDUnitsLoadFinishTimestampMonotonic",  "t", NULL, offsetof(struct boot_times, initrd_unitsload_finish_time)  },
+                { "ReloadStartTimestampMonotonic",            "t", NULL, offsetof(struct boot_times, reload_start_time)             },
+                { "ReloadFinishTimestampMonotonic",           "t", NULL, offsetof(struct boot_times, reload_finish_time)            },
                 {},
         };
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
@@ -548,6 +552,11 @@ static int pretty_boot_time(sd_bus *bus, char **_buf) {
         else if (!unit_id)
                 size = strpcpyf(&ptr, size, "\ncould not find default.target");
 
+        /* Both are monotonic timestamps of the running manager, no need to correct them by reverse_offset */
+        if (t->reload_start_time > 0 && t->reload_finish_time >= t->reload_start_time)
+                size = strpcpyf(&ptr, size, "\nLast daemon reload took %s",
+                                format_timespan(ts, sizeof(ts), t->reload_finish_time - t->reload_start_time, USEC_PER_MSEC));
+
         ptr = strdup(buf);
         if (!ptr)
                 return log_oom();
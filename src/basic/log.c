@@ -58,6 +58,7 @@ static bool upgrade_syslog_to_journal = false;
 static bool always_reopen_console = false;
 static bool open_when_needed = false;
 static bool prohibit_ipc = false;
+static thread_local bool thread_quiet = false;
 
 /* Akin to glibc's __abort_msg; which is private and we hence cannot
  * use here. */
@@ -621,7 +622,7 @@ int log_dispatch_internal(
 
         assert_raw(buffer);
 
-        if (log_target == LOG_TARGET_NULL)
+        if (log_target == LOG_TARGET_NULL || thread_quiet)
                 return -ERRNO_VALUE(error);
 
         /* Patch in LOG_DAEMON facility if necessary */
@@ -931,7 +932,8 @@ int log_struct_internal(
         va_list ap;
 
         if (_likely_(LOG_PRI(level) > log_max_level[realm]) ||
-            log_target == LOG_TARGET_NULL)
+            log_target == LOG_TARGET_NULL ||
+            thread_quiet)
                 return -ERRNO_VALUE(error);
 
         if ((level & LOG_FACMASK) == 0)
@@ -1030,7 +1032,8 @@ int log_struct_iovec_internal(
         char *m;
 
         if (_likely_(LOG_PRI(level) > log_max_level[realm]) ||
-            log_target == LOG_TARGET_NULL)
+            log_target == LOG_TARGET_NULL ||
+            thread_quiet)
                 return -ERRNO_VALUE(error);
 
         if ((level & LOG_FACMASK) == 0)
@@ -1401,6 +1404,10 @@ void log_set_prohibit_ipc(bool b) {
         prohibit_ipc = b;
 }
 
+void log_set_thread_quiet(bool b) {
+        thread_quiet = b;
+}
+
 int log_emergency_level(void) {
         /* Returns the log level to use for log_emergency() logging. We use LOG_EMERG only when we are PID 1, as only
          * then the system of the whole system is obviously affected. */
@@ -302,6 +302,10 @@ void log_set_open_when_needed(bool b);
  * stderr, the console or kmsg */
 void log_set_prohibit_ipc(bool b);
 
+/* If turned on, nothing is logged from the calling thread. For worker threads running code that logs, as the log
+ * streams are shared by all threads and (re)opened and closed without any locking. */
+void log_set_thread_quiet(bool b);
+
 int log_dup_console(void);
 
 int log_syntax_internal(
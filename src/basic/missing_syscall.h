@@ -579,6 +579,56 @@ static inline int missing_pidfd_open(pid_t pid, unsigned flags) {
 #  define pidfd_open missing_pidfd_open
 #endif
 
+#if !HAVE_IO_URING_SETUP
+/* may be (invalid) negative number due to libseccomp, see PR 13319 */
+#  if ! (defined __NR_io_uring_setup && __NR_io_uring_setup >= 0)
+#    if defined __NR_io_uring_setup
+#      undef __NR_io_uring_setup
+#    endif
+/* should be always defined, added in 5.1 */
+#    if defined(__alpha__)
+#      define __NR_io_uring_setup 535
+#    else
+#      define __NR_io_uring_setup 425
+#    endif
+#  endif
+struct io_uring_params;
+static inline int missing_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+#  ifdef __NR_io_uring_setup
+        return syscall(__NR_io_uring_setup, entries, p);
+#  else
+        errno = ENOSYS;
+        return -1;
+#  endif
+}
+
+#  define io_uring_setup missing_io_uring_setup
+#endif
+
+#if !HAVE_IO_URING_ENTER
+/* may be (invalid) negative number due to libseccomp, see PR 13319 */
+#  if ! (defined __NR_io_uring_enter && __NR_io_uring_enter >= 0)
+#    if defined __NR_io_uring_enter
+#      undef __NR_io_uring_enter
+#    endif
+#    if defined(__alpha__)
+#      define __NR_io_uring_enter 536
+#    else
+#      define __NR_io_uring_enter 426
+#    endif
+#  endif
+static inline int missing_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, const void *arg, size_t argsz) {
+#  ifdef __NR_io_uring_enter
+        return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+#  else
+        errno = ENOSYS;
+        return -1;
+#  endif
+}
+
+#  define io_uring_enter missing_io_uring_enter
+#endif
+
 #if !HAVE_RT_SIGQUEUEINFO
 static inline int missing_rt_sigqueueinfo(pid_t tgid, int sig, siginfo_t *info) {
         return syscall(__NR_rt_sigqueueinfo, tgid, sig, info);
@@ -0,0 +1,320 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+/*
+ * Timer Wheel
+ * The timer wheel object keeps track of objects that elapse at a certain time. Entries are hashed into
+ * slots by their time, in a hierarchy of levels whose slots are 64 times as coarse as the ones of the level
+ * below. Each entry is kept on the lowest level on which its slot doesn't coincide with the current time, and
+ * is redistributed into the finer levels as time passes. This way, all entries of a level elapse before all
+ * entries of the levels above it, and the slots of each level are ordered by time, too. Insertion and
+ * removal are O(1), and so is finding the slot elapsing first, but not the entry elapsing first within it,
+ * which requires a walk of the slot.
+ *
+ * Each entry carries a time it elapses at, and a time by which it has to be dispatched at the latest, which
+ * is at least the minimum accuracy of the wheel later. The latter isn't ordered by, and
+ * timer_wheel_peek() only returns a lower bound for it, which however is never earlier than the end of the
+ * first slot plus the minimum accuracy, and hence leaves enough room for coalescing wakeups.
+ */
+
+#include <stdlib.h>
+
+#include "alloc-util.h"
+#include "timer-wheel.h"
+
+/* The finest slots are 2^16µs, i.e. about 65ms wide */
+#define TICK_BITS 16U
+#define SLOT_BITS 6U
+#define N_SLOTS (1U << SLOT_BITS)
+#define N_LEVELS ((64U - TICK_BITS + SLOT_BITS - 1) / SLOT_BITS)
+
+struct TimerWheel {
+        /* The tick everything up to which has been popped from the wheel */
+        uint64_t base;
+        usec_t min_accuracy;
+        unsigned n_entries;
+
+        uint64_t occupied[N_LEVELS];
+        LIST_HEAD(TimerWheelEntry, slots[N_LEVELS][N_SLOTS]);
+
+        /* Cached result of timer_wheel_peek(), for the first occupied slot */
+        bool peek_valid;
+        unsigned peek_level, peek_slot;
+        usec_t peek_earliest, peek_latest;
+};
+
+TimerWheel *timer_wheel_new(usec_t min_accuracy) {
+        TimerWheel *w;
+
+        w = new0(TimerWheel, 1);
+        if (!w)
+                return NULL;
+
+        w->min_accuracy = min_accuracy;
+        return w;
+}
+
+TimerWheel *timer_wheel_free(TimerWheel *w) {
+        unsigned level, slot;
+
+        if (!w)
+                return NULL;
+
+        /* The entries are owned by the caller, just mark them unlinked */
+        for (level = 0; level < N_LEVELS; level++)
+                for (slot = 0; slot < N_SLOTS; slot++) {
+                        TimerWheelEntry *e;
+
+                        while ((e = w->slots[level][slot])) {
+                                LIST_REMOVE(entries, w->slots[level][slot], e);
+                                e->linked = false;
+                        }
+                }
+
+        return mfree(w);
+}
+
+static uint64_t tick_from_usec(usec_t u) {
+        return u >> TICK_BITS;
+}
+
+static usec_t tick_to_usec(uint64_t tick) {
+        if (tick >= UINT64_C(1) << (64U - TICK_BITS))
+                return USEC_INFINITY;
+
+        return tick << TICK_BITS;
+}
+
+static uint64_t slot_first_tick(TimerWheel *w, unsigned level, unsigned slot) {
+        unsigned shift = level * SLOT_BITS;
+
+        /* All entries on a level have the bits above that level in common with the base */
+        if (shift + SLOT_BITS < 64U)
+                return ((w->base >> (shift + SLOT_BITS)) << (shift + SLOT_BITS)) | ((uint64_t) slot << shift);
+
+        return (uint64_t) slot << shift;
+}
+
+static bool position_before(unsigned level_a, unsigned slot_a, unsigned level_b, unsigned slot_b) {
+        return level_a < level_b || (level_a == level_b && slot_a < slot_b);
+}
+
+static void wheel_link(TimerWheel *w, TimerWheelEntry *e) {
+        uint64_t tick, x;
+        unsigned level;
+
+        assert(w);
+        assert(e);
+        assert(!e->linked);
+
+        /* Entries that already elapsed go into the current slot */
+        tick = MAX(tick_from_usec(e->time), w->base);
+
+        /* Pick the level of the highest bits that differ from the base */
+        x = tick ^ w->base;
+        level = x == 0 ? 0 : (unsigned) (63 - __builtin_clzll(x)) / SLOT_BITS;
+        assert(level < N_LEVELS);
+
+        e->level = level;
+        e->slot = (tick >> (level * SLOT_BITS)) & (N_SLOTS - 1);
+        e->linked = true;
+
+        LIST_PREPEND(entries, w->slots[level][e->slot], e);
+        w->occupied[level] |= UINT64_C(1) << e->slot;
+}
+
+static void wheel_unlink(TimerWheel *w, TimerWheelEntry *e) {
+        assert(w);
+        assert(e);
+        assert(e->linked);
+
+        LIST_REMOVE(entries, w->slots[e->level][e->slot], e);
+        if (!w->slots[e->level][e->slot])
+                w->occupied[e->level] &= ~(UINT64_C(1) << e->slot);
+
+        e->linked = false;
+}
+
+void timer_wheel_add(TimerWheel *w, TimerWheelEntry *e, usec_t time, usec_t latest) {
+        assert(w);
+        assert(e);
+        assert(time != USEC_INFINITY);
+        assert(latest >= usec_add(time, w->min_accuracy));
+
+        e->time = time;
+        e->latest = latest;
+        wheel_link(w, e);
+        w->n_entries++;
+
+        if (!w->peek_valid)
+                return;
+
+        if (e->level == w->peek_level && e->slot == w->peek_slot) {
+                w->peek_earliest = MIN(w->peek_earliest, time);
+                w->peek_latest = MIN(w->peek_latest, latest);
+        } else if (position_before(e->level, e->slot, w->peek_level, w->peek_slot))
+                w->peek_valid = false;
+}
+
+void timer_wheel_remove(TimerWheel *w, TimerWheelEntry *e) {
+        assert(w);
+        assert(e);
+
+        if (!e->linked)
+                return;
+
+        /* The cached values are minimums over the first slot, which only change if they were this entry's,
+         * including when it was the last one in the slot */
+        if (w->peek_valid && e->level == w->peek_level && e->slot == w->peek_slot &&
+            (e->time == w->peek_earliest || e->latest == w->peek_latest))
+                w->peek_valid = false;
+
+        wheel_unlink(w, e);
+
+        assert(w->n_entries > 0);
+        w->n_entries--;
+}
+
+static bool wheel_first_slot(TimerWheel *w, unsigned *ret_level, unsigned *ret_slot) {
+        unsigned level;
+
+        assert(w);
+
+        for (level = 0; level < N_LEVELS; level++) {
+                if (w->occupied[level] == 0)
+                        continue;
+
+                *ret_level = level;
+                *ret_slot = __builtin_ctzll(w->occupied[level]);
+                return true;
+        }
+
+        return false;
+}
+
+bool timer_wheel_peek(TimerWheel *w, usec_t *ret_earliest, usec_t *ret_latest) {
+        unsigned level, slot;
+        TimerWheelEntry *e;
+        usec_t end;
+
+        assert(w);
+
+        if (!w->peek_valid) {
+                if (!wheel_first_slot(w, &level, &slot))
+                        return false;
+
+                /* Everything in later slots elapses at the end of this slot at the earliest, and has at
+                 * least the minimum accuracy, so that's the latest we might have to wake up for those */
+                end = tick_to_usec(slot_first_tick(w, level, slot) + (UINT64_C(1) << (level * SLOT_BITS)));
+
+                w->peek_level = level;
+                w->peek_slot = slot;
+                w->peek_earliest = USEC_INFINITY;
+                w->peek_latest = usec_add(end, w->min_accuracy);
+
+                LIST_FOREACH(entries, e, w->slots[level][slot]) {
+                        w->peek_earliest = MIN(w->peek_earliest, e->time);
+                        w->peek_latest = MIN(w->peek_latest, e->latest);
+                }
+
+                w->peek_valid = true;
+        }
+
+        if (ret_earliest)
+                *ret_earliest = w->peek_earliest;
+        if (ret_latest)
+                *ret_latest = w->peek_latest;
+
+        return true;
+}
+
+static void wheel_advance(TimerWheel *w, uint64_t tick) {
+        unsigned level, slot;
+
+        assert(w);
+        assert(tick >= w->base);
+
+        if (tick == w->base)
+                return;
+
+        w->base = tick;
+
+        /* The slots the new base falls into on the upper levels now coincide with the current time,
+         * redistribute their entries into the levels below, starting from the top. The first slot is
+         * still the same if nothing moved. */
+        for (level = N_LEVELS - 1; level > 0; level--) {
+                TimerWheelEntry *e;
+
+                slot = (tick >> (level * SLOT_BITS)) & (N_SLOTS - 1);
+
+                while ((e = w->slots[level][slot])) {
+                        wheel_unlink(w, e);
+                        wheel_link(w, e);
+                        assert(e->level < level);
+
+                        w->peek_valid = false;
+                }
+        }
+}
+
+TimerWheelEntry *timer_wheel_pop(TimerWheel *w, usec_t n) {
+        unsigned level, slot;
+        TimerWheelEntry *e;
+        uint64_t first, now_tick;
+
+        assert(w);
+
+        now_tick = tick_from_usec(n);
+
+        for (;;) {
+                if (!wheel_first_slot(w, &level, &slot)) {
+                        wheel_advance(w, MAX(w->base, now_tick));
+                        return NULL;
+                }
+
+                first = slot_first_tick(w, level, slot);
+
+                if (first > now_tick) {
+                        /* The current slot may contain entries that elapsed before the base was reached,
+                         * if the clock jumped backwards */
+                        if (first != w->base)
+                                break;
+
+                        assert(level == 0);
+                } else
+                        wheel_advance(w, first);
+
+                if (level > 0)
+                        continue;
+
+                if (first < now_tick) {
+                        /* The whole slot elapsed */
+                        e = w->slots[0][slot];
+                        timer_wheel_remove(w, e);
+                        return e;
+                }
+
+                LIST_FOREACH(entries, e, w->slots[0][slot])
+                        if (e->time <= n) {
+                                timer_wheel_remove(w, e);
+                                return e;
+                        }
+
+                /* Nothing in the first slot elapsed, hence nothing at all */
+                return NULL;
+        }
+
+        /* Nothing elapsed, but move on to the current time, so that new entries end up on the lower levels */
+        wheel_advance(w, now_tick);
+        return NULL;
+}
+
+unsigned timer_wheel_size(TimerWheel *w) {
+        if (!w)
+                return 0;
+
+        return w->n_entries;
+}
+
+bool timer_wheel_isempty(TimerWheel *w) {
+        return timer_wheel_size(w) == 0;
+}
@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stdbool.h>
+
+#include "list.h"
+#include "macro.h"
+#include "time-util.h"
+
+typedef struct TimerWheel TimerWheel;
+typedef struct TimerWheelEntry TimerWheelEntry;
+
+/* Embedded in the objects placed in the wheel, and owned by the wheel while linked */
+struct TimerWheelEntry {
+        usec_t time;
+        usec_t latest;
+        unsigned level;
+        unsigned slot;
+        bool linked;
+        LIST_FIELDS(TimerWheelEntry, entries);
+};
+
+TimerWheel *timer_wheel_new(usec_t min_accuracy);
+TimerWheel *timer_wheel_free(TimerWheel *w);
+DEFINE_TRIVIAL_CLEANUP_FUNC(TimerWheel*, timer_wheel_free);
+
+void timer_wheel_add(TimerWheel *w, TimerWheelEntry *e, usec_t time, usec_t latest);
+void timer_wheel_remove(TimerWheel *w, TimerWheelEntry *e);
+
+bool timer_wheel_peek(TimerWheel *w, usec_t *ret_earliest, usec_t *ret_latest);
+TimerWheelEntry *timer_wheel_pop(TimerWheel *w, usec_t n);
+
+unsigned timer_wheel_size(TimerWheel *w) _pure_;
+bool timer_wheel_isempty(TimerWheel *w) _pure_;
@@ -1329,12 +1329,12 @@ int verify_run_space_and_log(const char *message) {
         return 0;
 }
 
-static int method_reload(sd_bus_message *message, void *userdata, sd_bus_error *error) {
-        Manager *m = userdata;
+static int method_reload_generic(sd_bus_message *message, Manager *m, ManagerObjective objective, sd_bus_error *error) {
         int r;
 
         assert(message);
         assert(m);
+        assert(IN_SET(objective, MANAGER_RELOAD, MANAGER_RELOAD_INCREMENTAL));
 
         r = verify_run_space("Refusing to reload", error);
         if (r < 0)
@@ -1360,11 +1360,19 @@ static int method_reload(sd_bus_message *message, void *userdata, sd_bus_error *
         if (r < 0)
                 return r;
 
-        m->objective = MANAGER_RELOAD;
+        m->objective = objective;
 
         return 1;
 }
 
+static int method_reload(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        return method_reload_generic(message, userdata, MANAGER_RELOAD, error);
+}
+
+static int method_reload_incremental(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        return method_reload_generic(message, userdata, MANAGER_RELOAD_INCREMENTAL, error);
+}
+
 static int method_reexecute(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         Manager *m = userdata;
         int r;
@@ -2500,6 +2508,8 @@ const sd_bus_vtable bus_manager_vtable[] = {
         BUS_PROPERTY_DUAL_TIMESTAMP("InitRDGeneratorsFinishTimestamp", offsetof(Manager, timestamps[MANAGER_TIMESTAMP_INITRD_GENERATORS_FINISH]), SD_BUS_VTABLE_PROPERTY_CONST),
         BUS_PROPERTY_DUAL_TIMESTAMP("InitRDUnitsLoadStartTimestamp", offsetof(Manager, timestamps[MANAGER_TIMESTAMP_INITRD_UNITS_LOAD_START]), SD_BUS_VTABLE_PROPERTY_CONST),
         BUS_PROPERTY_DUAL_TIMESTAMP("InitRDUnitsLoadFinishTimestamp", offsetof(Manager, timestamps[MANAGER_TIMESTAMP_INITRD_UNITS_LOAD_FINISH]), SD_BUS_VTABLE_PROPERTY_CONST),
+        BUS_PROPERTY_DUAL_TIMESTAMP("ReloadStartTimestamp", offsetof(Manager, timestamps[MANAGER_TIMESTAMP_RELOAD_START]), 0),
+        BUS_PROPERTY_DUAL_TIMESTAMP("ReloadFinishTimestamp", offsetof(Manager, timestamps[MANAGER_TIMESTAMP_RELOAD_FINISH]), 0),
         SD_BUS_WRITABLE_PROPERTY("LogLevel", "s", bus_property_get_log_level, property_set_log_level, 0, 0),
         SD_BUS_WRITABLE_PROPERTY("LogTarget", "s", bus_property_get_log_target, property_set_log_target, 0, 0),
         SD_BUS_PROPERTY("NNames", "u", property_get_hashmap_size, offsetof(Manager, units), 0),
@@ -2889,6 +2899,11 @@ const sd_bus_vtable bus_manager_vtable[] = {
                       NULL,
                       method_reload,
                       SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("ReloadIncremental",
+                      NULL,
+                      NULL,
+                      method_reload_incremental,
+                      SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Reexecute",
                       NULL,
                       NULL,
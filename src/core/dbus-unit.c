@@ -156,21 +156,20 @@ static int property_get_dependencies(
                 void *userdata,
                 sd_bus_error *error) {
 
-        Hashmap **h = userdata;
-        Iterator j;
+        UnitDependencyArray **a = userdata;
+        unsigned j = 0;
         Unit *u;
-        void *v;
         int r;
 
         assert(bus);
         assert(reply);
-        assert(h);
+        assert(a);
 
         r = sd_bus_message_open_container(reply, 'a', "s");
         if (r < 0)
                 return r;
 
-        HASHMAP_FOREACH_KEY(v, u, *h, j) {
+        while (unit_dependency_array_next(*a, &j, &u, NULL)) {
                 r = sd_bus_message_append(reply, "s", u->id);
                 if (r < 0)
                         return r;
@@ -842,7 +841,7 @@ static int property_get_refs(
 }
 
 const sd_bus_vtable bus_unit_vtable[] = {
-        SD_BUS_VTABLE_START(0),
+        SD_BUS_VTABLE_START(SD_BUS_VTABLE_PROPERTY_CACHE),
 
         SD_BUS_PROPERTY("Id", "s", NULL, offsetof(Unit, id), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("Names", "as", property_get_names, 0, SD_BUS_VTABLE_PROPERTY_CONST),
@@ -898,7 +897,7 @@ const sd_bus_vtable bus_unit_vtable[] = {
         SD_BUS_PROPERTY("DefaultDependencies", "b", bus_property_get_bool, offsetof(Unit, default_dependencies), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("OnFailureJobMode", "s", property_get_job_mode, offsetof(Unit, on_failure_job_mode), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("IgnoreOnIsolate", "b", bus_property_get_bool, offsetof(Unit, ignore_on_isolate), SD_BUS_VTABLE_PROPERTY_CONST),
-        SD_BUS_PROPERTY("NeedDaemonReload", "b", property_get_need_daemon_reload, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("NeedDaemonReload", "b", property_get_need_daemon_reload, 0, 0),
         SD_BUS_PROPERTY("JobTimeoutUSec", "t", bus_property_get_usec, offsetof(Unit, job_timeout), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("JobRunningTimeoutUSec", "t", bus_property_get_usec, offsetof(Unit, job_running_timeout), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("JobTimeoutAction", "s", property_get_emergency_action, offsetof(Unit, job_timeout_action), SD_BUS_VTABLE_PROPERTY_CONST),
@@ -1718,6 +1717,36 @@ void bus_unit_send_removed_signal(Unit *u) {
                 log_unit_debug_errno(u, r, "Failed to send unit remove signal for %s: %m", u->id);
 }
 
+void bus_unit_invalidate_properties(Unit *u) {
+        _cleanup_free_ char *p = NULL;
+        Iterator i;
+        sd_bus *b;
+
+        assert(u);
+
+        /* The bus connections cache the constant properties of unit objects, i.e. names, dependencies and
+         * configuration. Drop them whenever one of those changes. Unlike change signals this needs to happen
+         * right-away, and regardless whether anyone is subscribed. */
+
+        if (!u->id || u->load_state == UNIT_STUB) /* Not loaded yet, hence nothing cached either */
+                return;
+
+        if (!u->manager->api_bus && set_isempty(u->manager->private_buses))
+                return;
+
+        p = unit_dbus_path(u);
+        if (!p) {
+                log_oom();
+                return;
+        }
+
+        if (u->manager->api_bus)
+                (void) sd_bus_invalidate_properties(u->manager->api_bus, p, NULL);
+
+        SET_FOREACH(b, u->manager->private_buses, i)
+                (void) sd_bus_invalidate_properties(b, p, NULL);
+}
+
 int bus_unit_queue_job(
                 sd_bus_message *message,
                 Unit *u,
@@ -2334,6 +2363,9 @@ int bus_unit_set_properties(
                                 return r;
 
                         for_real = true;
+
+                        /* We are about to change the unit, drop what's cached of its properties */
+                        bus_unit_invalidate_properties(u);
                         continue;
                 }
 
@@ -303,10 +303,20 @@ static int find_unit(Manager *m, sd_bus *bus, const char *path, Unit **unit, sd_
                 if (!u)
                         return 0;
         } else {
-                r = manager_load_unit_from_dbus_path(m, path, error, &u);
-                if (r < 0)
-                        return 0;
-                assert(u);
+                _cleanup_free_ char *n = NULL;
+
+                /* This is called for each vtable on every property access or invalidation, hence take a
+                 * shortcut for units that are loaded already, which don't need the load queue dispatched. */
+                if (unit_name_from_dbus_path(path, &n) >= 0)
+                        u = manager_get_unit(m, n);
+                if (u && u->load_state != UNIT_STUB)
+                        u = unit_follow_merge(u);
+                else {
+                        r = manager_load_unit_from_dbus_path(m, path, error, &u);
+                        if (r < 0)
+                                return 0;
+                        assert(u);
+                }
         }
 
         *unit = u;
@@ -743,6 +753,10 @@ static int bus_on_connection(sd_event_source *s, int fd, uint32_t revents, void
                 return 0;
         }
 
+        /* We tend to send out lots of signals at once, for example for each job finishing, let's write
+         * them out in one go */
+        (void) sd_bus_set_batch_send(bus, true);
+
         r = bus_setup_disconnected_match(m, bus);
         if (r < 0)
                 return 0;
@@ -838,6 +852,8 @@ int bus_init_api(Manager *m) {
                 if (r < 0)
                         return log_error_errno(r, "Failed to attach API bus to event loop: %m");
 
+                (void) sd_bus_set_batch_send(bus, true);
+
                 r = bus_setup_disconnected_match(m, bus);
                 if (r < 0)
                         return r;
@@ -895,6 +911,8 @@ int bus_init_system(Manager *m) {
                 if (r < 0)
                         return log_error_errno(r, "Failed to attach system bus to event loop: %m");
 
+                (void) sd_bus_set_batch_send(bus, true);
+
                 r = bus_setup_disconnected_match(m, bus);
                 if (r < 0)
                         return r;
@@ -1015,6 +1033,9 @@ static void destroy_bus(Manager *m, sd_bus **bus) {
         if (m->pending_reload_message && sd_bus_message_get_bus(m->pending_reload_message) == *bus)
                 m->pending_reload_message = sd_bus_message_unref(m->pending_reload_message);
 
+        /* Write out what we queued up so far, as far as possible without blocking */
+        (void) sd_bus_set_batch_send(*bus, false);
+
         /* Possibly flush unwritten data, but only if we are
          * unprivileged, since we don't want to sync here */
         if (!MANAGER_IS_SYSTEM(m))
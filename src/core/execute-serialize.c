@@ -0,0 +1,1301 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "alloc-util.h"
+#include "cpu-set-util.h"
+#include "escape.h"
+#include "execute-serialize.h"
+#include "extract-word.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "hexdecoct.h"
+#include "io-util.h"
+#include "parse-util.h"
+#include "rlimit-util.h"
+#include "serialize.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "strv.h"
+
+/* The serialization is only ever read by the systemd-executor binary of the same build, hence enums and flags
+ * are stored as plain numbers. Unknown keys are refused rather than skipped, as anything we don't apply might
+ * loosen the sandbox of the process. */
+
+#define DESERIALIZE_BOOL(value, field)                          \
+        ({                                                      \
+                int _b = parse_boolean(value);                  \
+                if (_b >= 0)                                    \
+                        field = _b;                             \
+                _b;                                             \
+        })
+
+static int put_fd_pair(FDSet *fds, const int fd[static 2], int copy[static 2]) {
+        size_t j;
+
+        for (j = 0; j < 2; j++) {
+                if (fd[j] < 0) {
+                        copy[j] = -1;
+                        continue;
+                }
+
+                copy[j] = fdset_put_dup(fds, fd[j]);
+                if (copy[j] < 0)
+                        return log_error_errno(copy[j], "Failed to add file descriptor to serialization set: %m");
+        }
+
+        return 0;
+}
+
+static int serialize_fd_pair(FILE *f, FDSet *fds, const char *key, const int fd[static 2]) {
+        int copy[2], r;
+
+        r = put_fd_pair(fds, fd, copy);
+        if (r < 0)
+                return r;
+
+        return serialize_item_format(f, key, "%i %i", copy[0], copy[1]);
+}
+
+static int serialize_word_escaped(FILE *f, const char *key, const char *prefix, const char *value) {
+        _cleanup_free_ char *e = NULL;
+
+        /* Like serialize_item_escaped(), but escapes whitespace, too, so that the value can be split off
+         * again with extract_first_word() */
+
+        e = xescape(value, WHITESPACE);
+        if (!e)
+                return log_oom();
+
+        return serialize_item_format(f, key, "%s %s", prefix, e);
+}
+
+static int exec_command_serialize(const ExecCommand *c, FILE *f) {
+        assert(c);
+        assert(f);
+
+        (void) serialize_item_escaped(f, "exec-command-path", c->path);
+        (void) serialize_strv(f, "exec-command-argv", c->argv);
+        (void) serialize_item_format(f, "exec-command-flags", "%i", (int) c->flags);
+
+        return 0;
+}
+
+static int exec_context_serialize(const ExecContext *c, FILE *f) {
+        ExecDirectoryType dt;
+        Iterator i;
+        void *key, *val;
+        size_t j;
+        int r;
+
+        assert(c);
+        assert(f);
+
+        (void) serialize_strv(f, "exec-context-environment", c->environment);
+        (void) serialize_strv(f, "exec-context-environment-files", c->environment_files);
+        (void) serialize_strv(f, "exec-context-pass-environment", c->pass_environment);
+        (void) serialize_strv(f, "exec-context-unset-environment", c->unset_environment);
+
+        for (j = 0; j < _RLIMIT_MAX; j++)
+                if (c->rlimit[j])
+                        (void) serialize_item_format(f, "exec-context-limit", "%s %" PRIu64 " %" PRIu64,
+                                                     rlimit_to_string(j),
+                                                     (uint64_t) c->rlimit[j]->rlim_cur,
+                                                     (uint64_t) c->rlimit[j]->rlim_max);
+
+        (void) serialize_item_escaped(f, "exec-context-working-directory", c->working_directory);
+        (void) serialize_item_escaped(f, "exec-context-root-directory", c->root_directory);
+        (void) serialize_item_escaped(f, "exec-context-root-image", c->root_image);
+        (void) serialize_item_escaped(f, "exec-context-root-verity", c->root_verity);
+        (void) serialize_item_escaped(f, "exec-context-root-hash-path", c->root_hash_path);
+        (void) serialize_item_escaped(f, "exec-context-root-hash-sig-path", c->root_hash_sig_path);
+
+        if (c->root_hash_size > 0) {
+                _cleanup_free_ char *h = NULL;
+
+                h = hexmem(c->root_hash, c->root_hash_size);
+                if (!h)
+                        return log_oom();
+
+                (void) serialize_item(f, "exec-context-root-hash", h);
+        }
+
+        if (c->root_hash_sig_size > 0) {
+                _cleanup_free_ char *s = NULL;
+
+                if (base64mem(c->root_hash_sig, c->root_hash_sig_size, &s) < 0)
+                        return log_oom();
+
+                (void) serialize_item(f, "exec-context-root-hash-sig", s);
+        }
+
+        (void) serialize_bool(f, "exec-context-working-directory-missing-ok", c->working_directory_missing_ok);
+        (void) serialize_bool(f, "exec-context-working-directory-home", c->working_directory_home);
+        (void) serialize_bool(f, "exec-context-oom-score-adjust-set", c->oom_score_adjust_set);
+        (void) serialize_bool(f, "exec-context-coredump-filter-set", c->coredump_filter_set);
+        (void) serialize_bool(f, "exec-context-nice-set", c->nice_set);
+        (void) serialize_bool(f, "exec-context-ioprio-set", c->ioprio_set);
+        (void) serialize_bool(f, "exec-context-cpu-sched-set", c->cpu_sched_set);
+        (void) serialize_bool(f, "exec-context-same-pgrp", c->same_pgrp);
+        (void) serialize_bool(f, "exec-context-cpu-sched-reset-on-fork", c->cpu_sched_reset_on_fork);
+        (void) serialize_bool(f, "exec-context-non-blocking", c->non_blocking);
+
+        (void) serialize_item_format(f, "exec-context-umask", "%04o", c->umask);
+        (void) serialize_item_format(f, "exec-context-oom-score-adjust", "%i", c->oom_score_adjust);
+        (void) serialize_item_format(f, "exec-context-nice", "%i", c->nice);
+        (void) serialize_item_format(f, "exec-context-ioprio", "%i", c->ioprio);
+        (void) serialize_item_format(f, "exec-context-cpu-sched-policy", "%i", c->cpu_sched_policy);
+        (void) serialize_item_format(f, "exec-context-cpu-sched-priority", "%i", c->cpu_sched_priority);
+        (void) serialize_item_format(f, "exec-context-coredump-filter", "%" PRIu64, c->coredump_filter);
+
+        if (c->cpu_set.set) {
+                _cleanup_free_ char *s = NULL;
+
+                s = cpu_set_to_range_string(&c->cpu_set);
+                if (!s)
+                        return log_oom();
+
+                (void) serialize_item(f, "exec-context-cpu-affinity", s);
+        }
+
+        (void) serialize_item_format(f, "exec-context-numa-policy", "%i", c->numa_policy.type);
+        if (c->numa_policy.nodes.set) {
+                _cleanup_free_ char *s = NULL;
+
+                s = cpu_set_to_range_string(&c->numa_policy.nodes);
+                if (!s)
+                        return log_oom();
+
+                (void) serialize_item(f, "exec-context-numa-mask", s);
+        }
+        (void) serialize_bool(f, "exec-context-cpu-affinity-from-numa", c->cpu_affinity_from_numa);
+
+        (void) serialize_item_format(f, "exec-context-std-input", "%i", c->std_input);
+        (void) serialize_item_format(f, "exec-context-std-output", "%i", c->std_output);
+        (void) serialize_item_format(f, "exec-context-std-error", "%i", c->std_error);
+        (void) serialize_bool(f, "exec-context-stdio-as-fds", c->stdio_as_fds);
+
+        for (j = 0; j < 3; j++) {
+                char prefix[DECIMAL_STR_MAX(size_t)];
+
+                xsprintf(prefix, "%zu", j);
+
+                if (c->stdio_fdname[j])
+                        (void) serialize_word_escaped(f, "exec-context-stdio-fdname", prefix, c->stdio_fdname[j]);
+                if (c->stdio_file[j])
+                        (void) serialize_word_escaped(f, "exec-context-stdio-file", prefix, c->stdio_file[j]);
+        }
+
+        /* The input data may be up to EXEC_STDIN_DATA_MAX in size, hence split it up, to stay below the line
+         * length limit */
+        for (j = 0; j < c->stdin_data_size; j += 64U*1024U) {
+                _cleanup_free_ char *s = NULL;
+
+                if (base64mem((uint8_t*) c->stdin_data + j, MIN(c->stdin_data_size - j, 64U*1024U), &s) < 0)
+                        return log_oom();
+
+                (void) serialize_item(f, "exec-context-stdin-data", s);
+        }
+
+        (void) serialize_item_format(f, "exec-context-timer-slack-nsec", NSEC_FMT, c->timer_slack_nsec);
+
+        (void) serialize_item_escaped(f, "exec-context-tty-path", c->tty_path);
+        (void) serialize_bool(f, "exec-context-tty-reset", c->tty_reset);
+        (void) serialize_bool(f, "exec-context-tty-vhangup", c->tty_vhangup);
+        (void) serialize_bool(f, "exec-context-tty-vt-disallocate", c->tty_vt_disallocate);
+        (void) serialize_bool(f, "exec-context-ignore-sigpipe", c->ignore_sigpipe);
+        (void) serialize_item_format(f, "exec-context-keyring-mode", "%i", c->keyring_mode);
+
+        (void) serialize_item_escaped(f, "exec-context-user", c->user);
+        (void) serialize_item_escaped(f, "exec-context-group", c->group);
+        (void) serialize_strv(f, "exec-context-supplementary-groups", c->supplementary_groups);
+        (void) serialize_item_escaped(f, "exec-context-pam-name", c->pam_name);
+        (void) serialize_item_escaped(f, "exec-context-utmp-id", c->utmp_id);
+        (void) serialize_item_format(f, "exec-context-utmp-mode", "%i", c->utmp_mode);
+
+        (void) serialize_bool(f, "exec-context-no-new-privileges", c->no_new_privileges);
+        (void) serialize_bool(f, "exec-context-selinux-context-ignore", c->selinux_context_ignore);
+        (void) serialize_bool(f, "exec-context-apparmor-profile-ignore", c->apparmor_profile_ignore);
+        (void) serialize_bool(f, "exec-context-smack-process-label-ignore", c->smack_process_label_ignore);
+        (void) serialize_item_escaped(f, "exec-context-selinux-context", c->selinux_context);
+        (void) serialize_item_escaped(f, "exec-context-apparmor-profile", c->apparmor_profile);
+        (void) serialize_item_escaped(f, "exec-context-smack-process-label", c->smack_process_label);
+
+        (void) serialize_strv(f, "exec-context-read-write-paths", c->read_write_paths);
+        (void) serialize_strv(f, "exec-context-read-only-paths", c->read_only_paths);
+        (void) serialize_strv(f, "exec-context-inaccessible-paths", c->inaccessible_paths);
+        (void) serialize_item_format(f, "exec-context-mount-flags", "%lu", c->mount_flags);
+
+        for (j = 0; j < c->n_bind_mounts; j++) {
+                _cleanup_free_ char *s = NULL, *d = NULL;
+                const BindMount *b = c->bind_mounts + j;
+
+                s = xescape(b->source, WHITESPACE);
+                d = xescape(b->destination, WHITESPACE);
+                if (!s || !d)
+                        return log_oom();
+
+                (void) serialize_item_format(f, "exec-context-bind-mount", "%i %i %i %i %s %s",
+                                             b->read_only, b->nosuid, b->recursive, b->ignore_enoent, s, d);
+        }
+
+        for (j = 0; j < c->n_temporary_filesystems; j++) {
+                _cleanup_free_ char *p = NULL, *o = NULL;
+                const TemporaryFileSystem *t = c->temporary_filesystems + j;
+
+                p = xescape(t->path, WHITESPACE);
+                o = xescape(strempty(t->options), WHITESPACE);
+                if (!p || !o)
+                        return log_oom();
+
+                (void) serialize_item_format(f, "exec-context-temporary-filesystem", "%s %s", p, o);
+        }
+
+        (void) serialize_item_format(f, "exec-context-capability-bounding-set", "%" PRIu64, c->capability_bounding_set);
+        (void) serialize_item_format(f, "exec-context-capability-ambient-set", "%" PRIu64, c->capability_ambient_set);
+        (void) serialize_item_format(f, "exec-context-secure-bits", "%i", c->secure_bits);
+
+        (void) serialize_item_format(f, "exec-context-syslog-priority", "%i", c->syslog_priority);
+        (void) serialize_bool(f, "exec-context-syslog-level-prefix", c->syslog_level_prefix);
+        (void) serialize_item_escaped(f, "exec-context-syslog-identifier", c->syslog_identifier);
+
+        for (j = 0; j < c->n_log_extra_fields; j++) {
+                _cleanup_free_ char *s = NULL;
+
+                if (base64mem(c->log_extra_fields[j].iov_base, c->log_extra_fields[j].iov_len, &s) < 0)
+                        return log_oom();
+
+                (void) serialize_item(f, "exec-context-log-extra-field", s);
+        }
+
+        (void) serialize_item_format(f, "exec-context-log-ratelimit-interval-usec", USEC_FMT, c->log_ratelimit_interval_usec);
+        (void) serialize_item_format(f, "exec-context-log-ratelimit-burst", "%u", c->log_ratelimit_burst);
+        (void) serialize_item_format(f, "exec-context-log-level-max", "%i", c->log_level_max);
+        (void) serialize_item_escaped(f, "exec-context-log-namespace", c->log_namespace);
+
+        (void) serialize_bool(f, "exec-context-private-tmp", c->private_tmp);
+        (void) serialize_bool(f, "exec-context-private-network", c->private_network);
+        (void) serialize_bool(f, "exec-context-private-devices", c->private_devices);
+        (void) serialize_bool(f, "exec-context-private-users", c->private_users);
+        (void) serialize_bool(f, "exec-context-private-mounts", c->private_mounts);
+        (void) serialize_bool(f, "exec-context-protect-kernel-tunables", c->protect_kernel_tunables);
+        (void) serialize_bool(f, "exec-context-protect-kernel-modules", c->protect_kernel_modules);
+        (void) serialize_bool(f, "exec-context-protect-kernel-logs", c->protect_kernel_logs);
+        (void) serialize_bool(f, "exec-context-protect-clock", c->protect_clock);
+        (void) serialize_bool(f, "exec-context-protect-control-groups", c->protect_control_groups);
+        (void) serialize_item_format(f, "exec-context-protect-system", "%i", c->protect_system);
+        (void) serialize_item_format(f, "exec-context-protect-home", "%i", c->protect_home);
+        (void) serialize_bool(f, "exec-context-protect-hostname", c->protect_hostname);
+        (void) serialize_bool(f, "exec-context-mount-apivfs", c->mount_apivfs);
+
+        (void) serialize_bool(f, "exec-context-dynamic-user", c->dynamic_user);
+        (void) serialize_bool(f, "exec-context-remove-ipc", c->remove_ipc);
+
+        (void) serialize_bool(f, "exec-context-memory-deny-write-execute", c->memory_deny_write_execute);
+        (void) serialize_bool(f, "exec-context-restrict-realtime", c->restrict_realtime);
+        (void) serialize_bool(f, "exec-context-restrict-suid-sgid", c->restrict_suid_sgid);
+
+        (void) serialize_bool(f, "exec-context-lock-personality", c->lock_personality);
+        (void) serialize_item_format(f, "exec-context-personality", "%lu", c->personality);
+
+        (void) serialize_item_format(f, "exec-context-restrict-namespaces", "%lu", c->restrict_namespaces);
+
+        HASHMAP_FOREACH_KEY(val, key, c->syscall_filter, i)
+                (void) serialize_item_format(f, "exec-context-syscall-filter", "%i %i", PTR_TO_INT(key) - 1, PTR_TO_INT(val));
+        SET_FOREACH(key, c->syscall_archs, i)
+                (void) serialize_item_format(f, "exec-context-syscall-archs", "%" PRIu32, PTR_TO_UINT32(key) - 1);
+        (void) serialize_item_format(f, "exec-context-syscall-errno", "%i", c->syscall_errno);
+        (void) serialize_bool(f, "exec-context-syscall-allow-list", c->syscall_allow_list);
+
+        (void) serialize_bool(f, "exec-context-address-families-allow-list", c->address_families_allow_list);
+        SET_FOREACH(key, c->address_families, i)
+                (void) serialize_item_format(f, "exec-context-address-families", "%i", PTR_TO_INT(key));
+
+        (void) serialize_item_escaped(f, "exec-context-network-namespace-path", c->network_namespace_path);
+
+        for (dt = 0; dt < _EXEC_DIRECTORY_TYPE_MAX; dt++) {
+                char **d, prefix[DECIMAL_STR_MAX(int)];
+
+                xsprintf(prefix, "%i", dt);
+
+                (void) serialize_item_format(f, "exec-context-directory-mode", "%s %04o", prefix, c->directories[dt].mode);
+                STRV_FOREACH(d, c->directories[dt].paths) {
+                        r = serialize_word_escaped(f, "exec-context-directory", prefix, *d);
+                        if (r < 0)
+                                return r;
+                }
+        }
+
+        (void) serialize_item_format(f, "exec-context-runtime-directory-preserve-mode", "%i", c->runtime_directory_preserve_mode);
+        (void) serialize_item_format(f, "exec-context-timeout-clean-usec", USEC_FMT, c->timeout_clean_usec);
+
+        return 0;
+}
+
+static int exec_parameters_serialize(const ExecParameters *p, FILE *f, FDSet *fds) {
+        ExecDirectoryType dt;
+        size_t j;
+        int r;
+
+        assert(p);
+        assert(f);
+        assert(fds);
+
+        (void) serialize_strv(f, "exec-parameters-environment", p->environment);
+
+        for (j = 0; j < p->n_socket_fds + p->n_storage_fds; j++) {
+                r = serialize_fd(f, fds, "exec-parameters-fd", p->fds[j]);
+                if (r < 0)
+                        return r;
+        }
+        (void) serialize_strv(f, "exec-parameters-fd-names", p->fd_names);
+        (void) serialize_item_format(f, "exec-parameters-n-socket-fds", "%zu", p->n_socket_fds);
+        (void) serialize_item_format(f, "exec-parameters-n-storage-fds", "%zu", p->n_storage_fds);
+
+        (void) serialize_item_format(f, "exec-parameters-flags", "%i", (int) p->flags);
+        (void) serialize_bool(f, "exec-parameters-selinux-context-net", p->selinux_context_net);
+
+        (void) serialize_item_format(f, "exec-parameters-cgroup-supported", "%" PRIu32, (uint32_t) p->cgroup_supported);
+        (void) serialize_item_escaped(f, "exec-parameters-cgroup-path", p->cgroup_path);
+
+        for (dt = 0; dt < _EXEC_DIRECTORY_TYPE_MAX; dt++) {
+                char prefix[DECIMAL_STR_MAX(int)];
+
+                if (!p->prefix || !p->prefix[dt])
+                        continue;
+
+                xsprintf(prefix, "%i", dt);
+                r = serialize_word_escaped(f, "exec-parameters-prefix", prefix, p->prefix[dt]);
+                if (r < 0)
+                        return r;
+        }
+
+        (void) serialize_item_format(f, "exec-parameters-watchdog-usec", USEC_FMT, p->watchdog_usec);
+
+        if (p->idle_pipe) {
+                r = serialize_fd_pair(f, fds, "exec-parameters-idle-pipe", p->idle_pipe);
+                if (r < 0)
+                        return r;
+                r = serialize_fd_pair(f, fds, "exec-parameters-idle-pipe-reply", p->idle_pipe + 2);
+                if (r < 0)
+                        return r;
+        }
+
+        r = serialize_fd(f, fds, "exec-parameters-stdin-fd", p->stdin_fd);
+        if (r < 0)
+                return r;
+        r = serialize_fd(f, fds, "exec-parameters-stdout-fd", p->stdout_fd);
+        if (r < 0)
+                return r;
+        r = serialize_fd(f, fds, "exec-parameters-stderr-fd", p->stderr_fd);
+        if (r < 0)
+                return r;
+
+        return serialize_fd(f, fds, "exec-parameters-exec-fd", p->exec_fd);
+}
+
+static int dynamic_user_serialize_one(const DynamicUser *d, FILE *f, FDSet *fds, const char *key) {
+        int copy[2], r;
+
+        assert(d);
+        assert(f);
+        assert(fds);
+
+        r = put_fd_pair(fds, d->storage_socket, copy);
+        if (r < 0)
+                return r;
+
+        return serialize_item_format(f, key, "%i %i %s", copy[0], copy[1], d->name);
+}
+
+int exec_invocation_serialize(
+                FILE *f,
+                FDSet *fds,
+                const Unit *unit,
+                const ExecCommand *command,
+                const ExecContext *context,
+                const ExecParameters *params,
+                const ExecRuntime *runtime,
+                const DynamicCreds *dcreds,
+                char **files_env,
+                int user_lookup_fd) {
+
+        int r;
+
+        assert(f);
+        assert(fds);
+        assert(unit);
+        assert(command);
+        assert(context);
+        assert(params);
+
+        (void) serialize_item_format(f, "log-level", "%i", log_get_max_level());
+        (void) serialize_item(f, "log-target", log_target_to_string(log_get_target()));
+        (void) serialize_bool(f, "log-color", log_get_show_color());
+        (void) serialize_bool(f, "log-location", log_get_show_location());
+        (void) serialize_bool(f, "log-time", log_get_show_time());
+
+        (void) serialize_item(f, "manager-scope", MANAGER_IS_SYSTEM(unit->manager) ? "system" : "user");
+        (void) serialize_item(f, "unit-id", unit->id);
+        if (!sd_id128_is_null(unit->invocation_id))
+                (void) serialize_item(f, "unit-invocation-id", unit->invocation_id_string);
+
+        r = exec_command_serialize(command, f);
+        if (r < 0)
+                return r;
+
+        r = exec_context_serialize(context, f);
+        if (r < 0)
+                return r;
+
+        r = exec_parameters_serialize(params, f, fds);
+        if (r < 0)
+                return r;
+
+        if (runtime) {
+                (void) serialize_item(f, "exec-runtime-id", runtime->id);
+                (void) serialize_item_escaped(f, "exec-runtime-tmp-dir", runtime->tmp_dir);
+                (void) serialize_item_escaped(f, "exec-runtime-var-tmp-dir", runtime->var_tmp_dir);
+
+                r = serialize_fd_pair(f, fds, "exec-runtime-netns-storage-socket", runtime->netns_storage_socket);
+                if (r < 0)
+                        return r;
+        }
+
+        if (dcreds && dcreds->user) {
+                r = dynamic_user_serialize_one(dcreds->user, f, fds, "dynamic-creds-user");
+                if (r < 0)
+                        return r;
+        }
+        if (dcreds && dcreds->group) {
+                if (dcreds->group == dcreds->user)
+                        (void) serialize_bool(f, "dynamic-creds-group-is-user", true);
+                else {
+                        r = dynamic_user_serialize_one(dcreds->group, f, fds, "dynamic-creds-group");
+                        if (r < 0)
+                                return r;
+                }
+        }
+
+        (void) serialize_strv(f, "exec-files-environment", files_env);
+
+        r = serialize_fd(f, fds, "user-lookup-fd", user_lookup_fd);
+        if (r < 0)
+                return r;
+
+        return fflush_and_check(f);
+}
+
+void exec_invocation_init(ExecInvocation *i) {
+        assert(i);
+
+        *i = (ExecInvocation) {
+                .unit.manager = &i->manager,
+                .params = {
+                        .stdin_fd = -1,
+                        .stdout_fd = -1,
+                        .stderr_fd = -1,
+                        .exec_fd = -1,
+                },
+                .idle_pipe = { -1, -1, -1, -1 },
+                .runtime.netns_storage_socket = { -1, -1 },
+                .user_lookup_fd = -1,
+        };
+
+        exec_context_init(&i->context);
+}
+
+static int deserialize_string(const char *value, char **s) {
+        char *u;
+        int r;
+
+        r = cunescape(value, 0, &u);
+        if (r < 0)
+                return r;
+
+        return free_and_replace(*s, u), 0;
+}
+
+static int deserialize_strv(const char *value, char ***l) {
+        char *u;
+        int r;
+
+        r = cunescape(value, 0, &u);
+        if (r < 0)
+                return r;
+
+        return strv_consume(l, u);
+}
+
+static int deserialize_fd(const char *value, FDSet *fds, int *ret) {
+        int fd, r;
+
+        r = safe_atoi(value, &fd);
+        if (r < 0)
+                return r;
+        if (fd < 0) {
+                *ret = -1;
+                return 0;
+        }
+        if (!fdset_contains(fds, fd))
+                return -EBADF;
+
+        *ret = fdset_remove(fds, fd);
+        return 0;
+}
+
+static int deserialize_fd_pair(const char *value, FDSet *fds, int ret[static 2], const char **remaining) {
+        size_t j;
+        int r;
+
+        /* The fds are removed from the set and stored in ret one by one, so that they are owned by the caller
+         * even if we fail half-way. */
+
+        for (j = 0; j < 2; j++) {
+                _cleanup_free_ char *w = NULL;
+
+                r = extract_first_word(&value, &w, NULL, 0);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        return -EINVAL;
+
+                r = deserialize_fd(w, fds, ret + j);
+                if (r < 0)
+                        return r;
+        }
+
+        if (remaining)
+                *remaining = value;
+        else if (!isempty(value))
+                return -EINVAL;
+
+        return 0;
+}
+
+static int deserialize_word(const char **value, char **ret) {
+        _cleanup_free_ char *w = NULL;
+        int r;
+
+        r = extract_first_word(value, &w, NULL, EXTRACT_CUNESCAPE);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return -EINVAL;
+
+        *ret = TAKE_PTR(w);
+        return 0;
+}
+
+static int deserialize_directory_type(const char **value, ExecDirectoryType *ret) {
+        _cleanup_free_ char *w = NULL;
+        int dt, r;
+
+        r = extract_first_word(value, &w, NULL, 0);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return -EINVAL;
+
+        r = safe_atoi(w, &dt);
+        if (r < 0)
+                return r;
+        if (dt < 0 || dt >= _EXEC_DIRECTORY_TYPE_MAX)
+                return -ERANGE;
+
+        *ret = dt;
+        return 0;
+}
+
+static int deserialize_rlimit(const char *value, ExecContext *c) {
+        _cleanup_free_ char *name = NULL, *cur = NULL, *max = NULL;
+        uint64_t rlim_cur, rlim_max;
+        int resource, r;
+
+        r = extract_many_words(&value, NULL, 0, &name, &cur, &max, NULL);
+        if (r < 0)
+                return r;
+        if (r != 3 || !isempty(value))
+                return -EINVAL;
+
+        resource = rlimit_from_string(name);
+        if (resource < 0)
+                return -EINVAL;
+
+        r = safe_atou64(cur, &rlim_cur);
+        if (r < 0)
+                return r;
+        r = safe_atou64(max, &rlim_max);
+        if (r < 0)
+                return r;
+
+        if (!c->rlimit[resource]) {
+                c->rlimit[resource] = new0(struct rlimit, 1);
+                if (!c->rlimit[resource])
+                        return -ENOMEM;
+        }
+
+        *c->rlimit[resource] = (struct rlimit) {
+                .rlim_cur = rlim_cur,
+                .rlim_max = rlim_max,
+        };
+
+        return 0;
+}
+
+static int deserialize_bind_mount(const char *value, ExecContext *c) {
+        _cleanup_free_ char *source = NULL, *destination = NULL;
+        int flags[4], r;
+        size_t j;
+
+        for (j = 0; j < ELEMENTSOF(flags); j++) {
+                _cleanup_free_ char *w = NULL;
+
+                r = extract_first_word(&value, &w, NULL, 0);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        return -EINVAL;
+
+                flags[j] = parse_boolean(w);
+                if (flags[j] < 0)
+                        return flags[j];
+        }
+
+        r = deserialize_word(&value, &source);
+        if (r < 0)
+                return r;
+        r = deserialize_word(&value, &destination);
+        if (r < 0)
+                return r;
+        if (!isempty(value))
+                return -EINVAL;
+
+        return bind_mount_add(&c->bind_mounts, &c->n_bind_mounts,
+                              &(BindMount) {
+                                      .source = source,
+                                      .destination = destination,
+                                      .read_only = flags[0],
+                                      .nosuid = flags[1],
+                                      .recursive = flags[2],
+                                      .ignore_enoent = flags[3],
+                              });
+}
+
+static int deserialize_temporary_filesystem(const char *value, ExecContext *c) {
+        _cleanup_free_ char *path = NULL, *options = NULL;
+        int r;
+
+        r = deserialize_word(&value, &path);
+        if (r < 0)
+                return r;
+        if (!isempty(value)) {
+                r = deserialize_word(&value, &options);
+                if (r < 0)
+                        return r;
+                if (!isempty(value))
+                        return -EINVAL;
+        }
+
+        return temporary_filesystem_add(&c->temporary_filesystems, &c->n_temporary_filesystems, path, options);
+}
+
+static int deserialize_stdio(const char *value, char *(*names)[3]) {
+        _cleanup_free_ char *w = NULL;
+        unsigned idx;
+        int r;
+
+        r = extract_first_word(&value, &w, NULL, 0);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return -EINVAL;
+
+        r = safe_atou(w, &idx);
+        if (r < 0)
+                return r;
+        if (idx >= 3)
+                return -ERANGE;
+
+        w = mfree(w);
+        r = deserialize_word(&value, &w);
+        if (r < 0)
+                return r;
+        if (!isempty(value))
+                return -EINVAL;
+
+        return free_and_replace((*names)[idx], w), 0;
+}
+
+static int deserialize_append_data(const char *value, void **data, size_t *size) {
+        _cleanup_free_ void *p = NULL;
+        size_t l;
+        void *n;
+        int r;
+
+        r = unbase64mem(value, (size_t) -1, &p, &l);
+        if (r < 0)
+                return r;
+
+        n = realloc(*data, *size + l);
+        if (!n)
+                return -ENOMEM;
+
+        memcpy((uint8_t*) n + *size, p, l);
+        *data = n;
+        *size += l;
+
+        return 0;
+}
+
+static int deserialize_log_extra_field(const char *value, ExecContext *c) {
+        _cleanup_free_ void *p = NULL;
+        struct iovec *t;
+        size_t l;
+        int r;
+
+        r = unbase64mem(value, (size_t) -1, &p, &l);
+        if (r < 0)
+                return r;
+
+        t = reallocarray(c->log_extra_fields, c->n_log_extra_fields + 1, sizeof(struct iovec));
+        if (!t)
+                return -ENOMEM;
+
+        c->log_extra_fields = t;
+        c->log_extra_fields[c->n_log_extra_fields++] = IOVEC_MAKE(TAKE_PTR(p), l);
+
+        return 0;
+}
+
+static int deserialize_syscall_filter(const char *value, ExecContext *c) {
+        int id, e, r;
+
+        if (sscanf(value, "%i %i", &id, &e) != 2 || id < 0)
+                return -EINVAL;
+
+        r = hashmap_ensure_allocated(&c->syscall_filter, NULL);
+        if (r < 0)
+                return r;
+
+        return hashmap_put(c->syscall_filter, INT_TO_PTR(id + 1), INT_TO_PTR(e));
+}
+
+static int deserialize_directory(const char *value, ExecContext *c) {
+        _cleanup_free_ char *path = NULL;
+        ExecDirectoryType dt;
+        int r;
+
+        r = deserialize_directory_type(&value, &dt);
+        if (r < 0)
+                return r;
+        r = deserialize_word(&value, &path);
+        if (r < 0)
+                return r;
+        if (!isempty(value))
+                return -EINVAL;
+
+        return strv_consume(&c->directories[dt].paths, TAKE_PTR(path));
+}
+
+static int deserialize_directory_mode(const char *value, ExecContext *c) {
+        ExecDirectoryType dt;
+        int r;
+
+        r = deserialize_directory_type(&value, &dt);
+        if (r < 0)
+                return r;
+
+        return parse_mode(value, &c->directories[dt].mode);
+}
+
+static int deserialize_prefix(const char *value, ExecInvocation *i) {
+        ExecDirectoryType dt;
+        int r;
+
+        r = deserialize_directory_type(&value, &dt);
+        if (r < 0)
+                return r;
+
+        i->prefix[dt] = mfree(i->prefix[dt]);
+        r = deserialize_word(&value, &i->prefix[dt]);
+        if (r < 0)
+                return r;
+
+        return isempty(value) ? 0 : -EINVAL;
+}
+
+static int deserialize_dynamic_user(const char *value, FDSet *fds, DynamicUser **ret) {
+        int storage_socket[2] = { -1, -1 };
+        DynamicUser *d;
+        int r;
+
+        if (*ret)
+                return -EEXIST;
+
+        r = deserialize_fd_pair(value, fds, storage_socket, &value);
+        if (r < 0) {
+                safe_close_pair(storage_socket);
+                return r;
+        }
+
+        value += strspn(value, WHITESPACE);
+        if (isempty(value)) {
+                safe_close_pair(storage_socket);
+                return -EINVAL;
+        }
+
+        d = malloc0(offsetof(DynamicUser, name) + strlen(value) + 1);
+        if (!d) {
+                safe_close_pair(storage_socket);
+                return -ENOMEM;
+        }
+
+        d->n_ref = 1;
+        d->storage_socket[0] = storage_socket[0];
+        d->storage_socket[1] = storage_socket[1];
+        strcpy(d->name, value);
+
+        *ret = d;
+        return 0;
+}
+
+static int deserialize_int_enum(const char *value, int max, void *ret) {
+        int v, r;
+
+        r = safe_atoi(value, &v);
+        if (r < 0)
+                return r;
+        if (v < 0 || v >= max)
+                return -ERANGE;
+
+        *(int*) ret = v;
+        return 0;
+}
+
+int exec_invocation_deserialize(ExecInvocation *i, FILE *f, FDSet *fds) {
+        ExecContext *c = &i->context;
+        ExecParameters *p = &i->params;
+        size_t n_fds_allocated = 0;
+        int r;
+
+        assert(i);
+        assert(f);
+        assert(fds);
+
+        for (;;) {
+                _cleanup_free_ char *line = NULL;
+                const char *val, *l;
+
+                r = read_line(f, LONG_LINE_MAX, &line);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to read serialization line: %m");
+                if (r == 0)
+                        break;
+
+                /* Don't strip the line, escaped strings may end in whitespace */
+                l = line;
+                if (isempty(l))
+                        continue;
+
+                if ((val = startswith(l, "log-level="))) {
+                        int level;
+
+                        r = safe_atoi(val, &level);
+                        if (r >= 0)
+                                log_set_max_level(level);
+                } else if ((val = startswith(l, "log-target="))) {
+                        r = log_set_target_from_string(val);
+                } else if ((val = startswith(l, "log-color="))) {
+                        r = log_show_color_from_string(val);
+                } else if ((val = startswith(l, "log-location="))) {
+                        r = log_show_location_from_string(val);
+                } else if ((val = startswith(l, "log-time="))) {
+                        r = log_show_time_from_string(val);
+
+                } else if ((val = startswith(l, "manager-scope="))) {
+                        if (streq(val, "system"))
+                                i->manager.unit_file_scope = UNIT_FILE_SYSTEM;
+                        else if (streq(val, "user"))
+                                i->manager.unit_file_scope = UNIT_FILE_USER;
+                        else
+                                r = -EINVAL;
+                } else if ((val = startswith(l, "unit-id=")))
+                        r = free_and_strdup(&i->unit.id, val);
+                else if ((val = startswith(l, "unit-invocation-id="))) {
+                        r = sd_id128_from_string(val, &i->unit.invocation_id);
+                        if (r >= 0)
+                                sd_id128_to_string(i->unit.invocation_id, i->unit.invocation_id_string);
+
+                } else if ((val = startswith(l, "exec-command-path=")))
+                        r = deserialize_string(val, &i->command.path);
+                else if ((val = startswith(l, "exec-command-argv=")))
+                        r = deserialize_strv(val, &i->command.argv);
+                else if ((val = startswith(l, "exec-command-flags=")))
+                        r = safe_atoi(val, (int*) &i->command.flags);
+
+                else if ((val = startswith(l, "exec-context-environment=")))
+                        r = deserialize_strv(val, &c->environment);
+                else if ((val = startswith(l, "exec-context-environment-files=")))
+                        r = deserialize_strv(val, &c->environment_files);
+                else if ((val = startswith(l, "exec-context-pass-environment=")))
+                        r = deserialize_strv(val, &c->pass_environment);
+                else if ((val = startswith(l, "exec-context-unset-environment=")))
+                        r = deserialize_strv(val, &c->unset_environment);
+                else if ((val = startswith(l, "exec-context-limit=")))
+                        r = deserialize_rlimit(val, c);
+                else if ((val = startswith(l, "exec-context-working-directory=")))
+                        r = deserialize_string(val, &c->working_directory);
+                else if ((val = startswith(l, "exec-context-root-directory=")))
+                        r = deserialize_string(val, &c->root_directory);
+                else if ((val = startswith(l, "exec-context-root-image=")))
+                        r = deserialize_string(val, &c->root_image);
+                else if ((val = startswith(l, "exec-context-root-verity=")))
+                        r = deserialize_string(val, &c->root_verity);
+                else if ((val = startswith(l, "exec-context-root-hash-path=")))
+                        r = deserialize_string(val, &c->root_hash_path);
+                else if ((val = startswith(l, "exec-context-root-hash-sig-path=")))
+                        r = deserialize_string(val, &c->root_hash_sig_path);
+                else if ((val = startswith(l, "exec-context-root-hash=")))
+                        r = unhexmem(val, (size_t) -1, &c->root_hash, &c->root_hash_size);
+                else if ((val = startswith(l, "exec-context-root-hash-sig=")))
+                        r = unbase64mem(val, (size_t) -1, &c->root_hash_sig, &c->root_hash_sig_size);
+                else if ((val = startswith(l, "exec-context-working-directory-missing-ok=")))
+                        r = DESERIALIZE_BOOL(val, c->working_directory_missing_ok);
+                else if ((val = startswith(l, "exec-context-working-directory-home=")))
+                        r = DESERIALIZE_BOOL(val, c->working_directory_home);
+                else if ((val = startswith(l, "exec-context-oom-score-adjust-set=")))
+                        r = DESERIALIZE_BOOL(val, c->oom_score_adjust_set);
+                else if ((val = startswith(l, "exec-context-coredump-filter-set=")))
+                        r = DESERIALIZE_BOOL(val, c->coredump_filter_set);
+                else if ((val = startswith(l, "exec-context-nice-set=")))
+                        r = DESERIALIZE_BOOL(val, c->nice_set);
+                else if ((val = startswith(l, "exec-context-ioprio-set=")))
+                        r = DESERIALIZE_BOOL(val, c->ioprio_set);
+                else if ((val = startswith(l, "exec-context-cpu-sched-set=")))
+                        r = DESERIALIZE_BOOL(val, c->cpu_sched_set);
+                else if ((val = startswith(l, "exec-context-same-pgrp=")))
+                        r = DESERIALIZE_BOOL(val, c->same_pgrp);
+                else if ((val = startswith(l, "exec-context-cpu-sched-reset-on-fork=")))
+                        r = DESERIALIZE_BOOL(val, c->cpu_sched_reset_on_fork);
+                else if ((val = startswith(l, "exec-context-non-blocking=")))
+                        r = DESERIALIZE_BOOL(val, c->non_blocking);
+                else if ((val = startswith(l, "exec-context-umask=")))
+                        r = parse_mode(val, &c->umask);
+                else if ((val = startswith(l, "exec-context-oom-score-adjust=")))
+                        r = safe_atoi(val, &c->oom_score_adjust);
+                else if ((val = startswith(l, "exec-context-nice=")))
+                        r = safe_atoi(val, &c->nice);
+                else if ((val = startswith(l, "exec-context-ioprio=")))
+                        r = safe_atoi(val, &c->ioprio);
+                else if ((val = startswith(l, "exec-context-cpu-sched-policy=")))
+                        r = safe_atoi(val, &c->cpu_sched_policy);
+                else if ((val = startswith(l, "exec-context-cpu-sched-priority=")))
+                        r = safe_atoi(val, &c->cpu_sched_priority);
+                else if ((val = startswith(l, "exec-context-coredump-filter=")))
+                        r = safe_atou64(val, &c->coredump_filter);
+                else if ((val = startswith(l, "exec-context-cpu-affinity=")))
+                        r = parse_cpu_set(val, &c->cpu_set);
+                else if ((val = startswith(l, "exec-context-numa-policy=")))
+                        r = safe_atoi(val, &c->numa_policy.type);
+                else if ((val = startswith(l, "exec-context-numa-mask=")))
+                        r = parse_cpu_set(val, &c->numa_policy.nodes);
+                else if ((val = startswith(l, "exec-context-cpu-affinity-from-numa=")))
+                        r = DESERIALIZE_BOOL(val, c->cpu_affinity_from_numa);
+                else if ((val = startswith(l, "exec-context-std-input=")))
+                        r = deserialize_int_enum(val, _EXEC_INPUT_MAX, &c->std_input);
+                else if ((val = startswith(l, "exec-context-std-output=")))
+                        r = deserialize_int_enum(val, _EXEC_OUTPUT_MAX, &c->std_output);
+                else if ((val = startswith(l, "exec-context-std-error=")))
+                        r = deserialize_int_enum(val, _EXEC_OUTPUT_MAX, &c->std_error);
+                else if ((val = startswith(l, "exec-context-stdio-as-fds=")))
+                        r = DESERIALIZE_BOOL(val, c->stdio_as_fds);
+                else if ((val = startswith(l, "exec-context-stdio-fdname=")))
+                        r = deserialize_stdio(val, &c->stdio_fdname);
+                else if ((val = startswith(l, "exec-context-stdio-file=")))
+                        r = deserialize_stdio(val, &c->stdio_file);
+                else if ((val = startswith(l, "exec-context-stdin-data=")))
+                        r = deserialize_append_data(val, &c->stdin_data, &c->stdin_data_size);
+                else if ((val = startswith(l, "exec-context-timer-slack-nsec=")))
+                        r = safe_atou64(val, &c->timer_slack_nsec);
+                else if ((val = startswith(l, "exec-context-tty-path=")))
+                        r = deserialize_string(val, &c->tty_path);
+                else if ((val = startswith(l, "exec-context-tty-reset=")))
+                        r = DESERIALIZE_BOOL(val, c->tty_reset);
+                else if ((val = startswith(l, "exec-context-tty-vhangup=")))
+                        r = DESERIALIZE_BOOL(val, c->tty_vhangup);
+                else if ((val = startswith(l, "exec-context-tty-vt-disallocate=")))
+                        r = DESERIALIZE_BOOL(val, c->tty_vt_disallocate);
+                else if ((val = startswith(l, "exec-context-ignore-sigpipe=")))
+                        r = DESERIALIZE_BOOL(val, c->ignore_sigpipe);
+                else if ((val = startswith(l, "exec-context-keyring-mode=")))
+                        r = deserialize_int_enum(val, _EXEC_KEYRING_MODE_MAX, &c->keyring_mode);
+                else if ((val = startswith(l, "exec-context-user=")))
+                        r = deserialize_string(val, &c->user);
+                else if ((val = startswith(l, "exec-context-group=")))
+                        r = deserialize_string(val, &c->group);
+                else if ((val = startswith(l, "exec-context-supplementary-groups=")))
+                        r = deserialize_strv(val, &c->supplementary_groups);
+                else if ((val = startswith(l, "exec-context-pam-name=")))
+                        r = deserialize_string(val, &c->pam_name);
+                else if ((val = startswith(l, "exec-context-utmp-id=")))
+                        r = deserialize_string(val, &c->utmp_id);
+                else if ((val = startswith(l, "exec-context-utmp-mode=")))
+                        r = deserialize_int_enum(val, _EXEC_UTMP_MODE_MAX, &c->utmp_mode);
+                else if ((val = startswith(l, "exec-context-no-new-privileges=")))
+                        r = DESERIALIZE_BOOL(val, c->no_new_privileges);
+                else if ((val = startswith(l, "exec-context-selinux-context-ignore=")))
+                        r = DESERIALIZE_BOOL(val, c->selinux_context_ignore);
+                else if ((val = startswith(l, "exec-context-apparmor-profile-ignore=")))
+                        r = DESERIALIZE_BOOL(val, c->apparmor_profile_ignore);
+                else if ((val = startswith(l, "exec-context-smack-process-label-ignore=")))
+                        r = DESERIALIZE_BOOL(val, c->smack_process_label_ignore);
+                else if ((val = startswith(l, "exec-context-selinux-context=")))
+                        r = deserialize_string(val, &c->selinux_context);
+                else if ((val = startswith(l, "exec-context-apparmor-profile=")))
+                        r = deserialize_string(val, &c->apparmor_profile);
+                else if ((val = startswith(l, "exec-context-smack-process-label=")))
+                        r = deserialize_string(val, &c->smack_process_label);
+                else if ((val = startswith(l, "exec-context-read-write-paths=")))
+                        r = deserialize_strv(val, &c->read_write_paths);
+                else if ((val = startswith(l, "exec-context-read-only-paths=")))
+                        r = deserialize_strv(val, &c->read_only_paths);
+                else if ((val = startswith(l, "exec-context-inaccessible-paths=")))
+                        r = deserialize_strv(val, &c->inaccessible_paths);
+                else if ((val = startswith(l, "exec-context-mount-flags=")))
+                        r = safe_atolu(val, &c->mount_flags);
+                else if ((val = startswith(l, "exec-context-bind-mount=")))
+                        r = deserialize_bind_mount(val, c);
+                else if ((val = startswith(l, "exec-context-temporary-filesystem=")))
+                        r = deserialize_temporary_filesystem(val, c);
+                else if ((val = startswith(l, "exec-context-capability-bounding-set=")))
+                        r = safe_atou64(val, &c->capability_bounding_set);
+                else if ((val = startswith(l, "exec-context-capability-ambient-set=")))
+                        r = safe_atou64(val, &c->capability_ambient_set);
+                else if ((val = startswith(l, "exec-context-secure-bits=")))
+                        r = safe_atoi(val, &c->secure_bits);
+                else if ((val = startswith(l, "exec-context-syslog-priority=")))
+                        r = safe_atoi(val, &c->syslog_priority);
+                else if ((val = startswith(l, "exec-context-syslog-level-prefix=")))
+                        r = DESERIALIZE_BOOL(val, c->syslog_level_prefix);
+                else if ((val = startswith(l, "exec-context-syslog-identifier=")))
+                        r = deserialize_string(val, &c->syslog_identifier);
+                else if ((val = startswith(l, "exec-context-log-extra-field=")))
+                        r = deserialize_log_extra_field(val, c);
+                else if ((val = startswith(l, "exec-context-log-ratelimit-interval-usec=")))
+                        r = safe_atou64(val, &c->log_ratelimit_interval_usec);
+                else if ((val = startswith(l, "exec-context-log-ratelimit-burst=")))
+                        r = safe_atou(val, &c->log_ratelimit_burst);
+                else if ((val = startswith(l, "exec-context-log-level-max=")))
+                        r = safe_atoi(val, &c->log_level_max);
+                else if ((val = startswith(l, "exec-context-log-namespace=")))
+                        r = deserialize_string(val, &c->log_namespace);
+                else if ((val = startswith(l, "exec-context-private-tmp=")))
+                        r = DESERIALIZE_BOOL(val, c->private_tmp);
+                else if ((val = startswith(l, "exec-context-private-network=")))
+                        r = DESERIALIZE_BOOL(val, c->private_network);
+                else if ((val = startswith(l, "exec-context-private-devices=")))
+                        r = DESERIALIZE_BOOL(val, c->private_devices);
+                else if ((val = startswith(l, "exec-context-private-users=")))
+                        r = DESERIALIZE_BOOL(val, c->private_users);
+                else if ((val = startswith(l, "exec-context-private-mounts=")))
+                        r = DESERIALIZE_BOOL(val, c->private_mounts);
+                else if ((val = startswith(l, "exec-context-protect-kernel-tunables=")))
+                        r = DESERIALIZE_BOOL(val, c->protect_kernel_tunables);
+                else if ((val = startswith(l, "exec-context-protect-kernel-modules=")))
+                        r = DESERIALIZE_BOOL(val, c->protect_kernel_modules);
+                else if ((val = startswith(l, "exec-context-protect-kernel-logs=")))
+                        r = DESERIALIZE_BOOL(val, c->protect_kernel_logs);
+                else if ((val = startswith(l, "exec-context-protect-clock=")))
+                        r = DESERIALIZE_BOOL(val, c->protect_clock);
+                else if ((val = startswith(l, "exec-context-protect-control-groups=")))
+                        r = DESERIALIZE_BOOL(val, c->protect_control_groups);
+                else if ((val = startswith(l, "exec-context-protect-system=")))
+                        r = deserialize_int_enum(val, _PROTECT_SYSTEM_MAX, &c->protect_system);
+                else if ((val = startswith(l, "exec-context-protect-home=")))
+                        r = deserialize_int_enum(val, _PROTECT_HOME_MAX, &c->protect_home);
+                else if ((val = startswith(l, "exec-context-protect-hostname=")))
+                        r = DESERIALIZE_BOOL(val, c->protect_hostname);
+                else if ((val = startswith(l, "exec-context-mount-apivfs=")))
+                        r = DESERIALIZE_BOOL(val, c->mount_apivfs);
+                else if ((val = startswith(l, "exec-context-dynamic-user=")))
+                        r = DESERIALIZE_BOOL(val, c->dynamic_user);
+                else if ((val = startswith(l, "exec-context-remove-ipc=")))
+                        r = DESERIALIZE_BOOL(val, c->remove_ipc);
+                else if ((val = startswith(l, "exec-context-memory-deny-write-execute=")))
+                        r = DESERIALIZE_BOOL(val, c->memory_deny_write_execute);
+                else if ((val = startswith(l, "exec-context-restrict-realtime=")))
+                        r = DESERIALIZE_BOOL(val, c->restrict_realtime);
+                else if ((val = startswith(l, "exec-context-restrict-suid-sgid=")))
+                        r = DESERIALIZE_BOOL(val, c->restrict_suid_sgid);
+                else if ((val = startswith(l, "exec-context-lock-personality=")))
+                        r = DESERIALIZE_BOOL(val, c->lock_personality);
+                else if ((val = startswith(l, "exec-context-personality=")))
+                        r = safe_atolu(val, &c->personality);
+                else if ((val = startswith(l, "exec-context-restrict-namespaces=")))
+                        r = safe_atolu(val, &c->restrict_namespaces);
+                else if ((val = startswith(l, "exec-context-syscall-filter=")))
+                        r = deserialize_syscall_filter(val, c);
+                else if ((val = startswith(l, "exec-context-syscall-archs="))) {
+                        uint32_t a;
+
+                        r = safe_atou32(val, &a);
+                        if (r >= 0)
+                                r = set_ensure_put(&c->syscall_archs, NULL, UINT32_TO_PTR(a + 1));
+                } else if ((val = startswith(l, "exec-context-syscall-errno=")))
+                        r = safe_atoi(val, &c->syscall_errno);
+                else if ((val = startswith(l, "exec-context-syscall-allow-list=")))
+                        r = DESERIALIZE_BOOL(val, c->syscall_allow_list);
+                else if ((val = startswith(l, "exec-context-address-families-allow-list=")))
+                        r = DESERIALIZE_BOOL(val, c->address_families_allow_list);
+                else if ((val = startswith(l, "exec-context-address-families="))) {
+                        int af;
+
+                        r = safe_atoi(val, &af);
+                        if (r >= 0)
+                                r = set_ensure_put(&c->address_families, NULL, INT_TO_PTR(af));
+                } else if ((val = startswith(l, "exec-context-network-namespace-path=")))
+                        r = deserialize_string(val, &c->network_namespace_path);
+                else if ((val = startswith(l, "exec-context-directory=")))
+                        r = deserialize_directory(val, c);
+                else if ((val = startswith(l, "exec-context-directory-mode=")))
+                        r = deserialize_directory_mode(val, c);
+                else if ((val = startswith(l, "exec-context-runtime-directory-preserve-mode=")))
+                        r = deserialize_int_enum(val, _EXEC_PRESERVE_MODE_MAX, &c->runtime_directory_preserve_mode);
+                else if ((val = startswith(l, "exec-context-timeout-clean-usec=")))
+                        r = safe_atou64(val, &c->timeout_clean_usec);
+
+                else if ((val = startswith(l, "exec-parameters-environment=")))
+                        r = deserialize_strv(val, &p->environment);
+                else if ((val = startswith(l, "exec-parameters-fd="))) {
+                        if (!GREEDY_REALLOC(p->fds, n_fds_allocated, p->n_socket_fds + p->n_storage_fds + 1))
+                                r = -ENOMEM;
+                        else {
+                                /* Counted as storage fds until we learn the real numbers */
+                                r = deserialize_fd(val, fds, p->fds + p->n_socket_fds + p->n_storage_fds);
+                                if (r >= 0)
+                                        p->n_storage_fds++;
+                        }
+                } else if ((val = startswith(l, "exec-parameters-fd-names=")))
+                        r = deserialize_strv(val, &p->fd_names);
+                else if ((val = startswith(l, "exec-parameters-n-socket-fds=")))
+                        r = safe_atozu(val, &i->n_socket_fds);
+                else if ((val = startswith(l, "exec-parameters-n-storage-fds=")))
+                        r = safe_atozu(val, &i->n_storage_fds);
+                else if ((val = startswith(l, "exec-parameters-flags=")))
+                        r = safe_atoi(val, (int*) &p->flags);
+                else if ((val = startswith(l, "exec-parameters-selinux-context-net=")))
+                        r = DESERIALIZE_BOOL(val, p->selinux_context_net);
+                else if ((val = startswith(l, "exec-parameters-cgroup-supported=")))
+                        r = safe_atou32(val, (uint32_t*) &p->cgroup_supported);
+                else if ((val = startswith(l, "exec-parameters-cgroup-path=")))
+                        r = deserialize_string(val, &i->cgroup_path);
+                else if ((val = startswith(l, "exec-parameters-prefix=")))
+                        r = deserialize_prefix(val, i);
+                else if ((val = startswith(l, "exec-parameters-watchdog-usec=")))
+                        r = safe_atou64(val, &p->watchdog_usec);
+                else if ((val = startswith(l, "exec-parameters-idle-pipe=")))
+                        r = deserialize_fd_pair(val, fds, i->idle_pipe, NULL);
+                else if ((val = startswith(l, "exec-parameters-idle-pipe-reply=")))
+                        r = deserialize_fd_pair(val, fds, i->idle_pipe + 2, NULL);
+                else if ((val = startswith(l, "exec-parameters-stdin-fd=")))
+                        r = deserialize_fd(val, fds, &p->stdin_fd);
+                else if ((val = startswith(l, "exec-parameters-stdout-fd=")))
+                        r = deserialize_fd(val, fds, &p->stdout_fd);
+                else if ((val = startswith(l, "exec-parameters-stderr-fd=")))
+                        r = deserialize_fd(val, fds, &p->stderr_fd);
+                else if ((val = startswith(l, "exec-parameters-exec-fd=")))
+                        r = deserialize_fd(val, fds, &p->exec_fd);
+
+                else if ((val = startswith(l, "exec-runtime-id="))) {
+                        r = free_and_strdup(&i->runtime.id, val);
+                        i->has_runtime = true;
+                } else if ((val = startswith(l, "exec-runtime-tmp-dir=")))
+                        r = deserialize_string(val, &i->runtime.tmp_dir);
+                else if ((val = startswith(l, "exec-runtime-var-tmp-dir=")))
+                        r = deserialize_string(val, &i->runtime.var_tmp_dir);
+                else if ((val = startswith(l, "exec-runtime-netns-storage-socket=")))
+                        r = deserialize_fd_pair(val, fds, i->runtime.netns_storage_socket, NULL);
+
+                else if ((val = startswith(l, "dynamic-creds-user=")))
+                        r = deserialize_dynamic_user(val, fds, &i->dynamic_creds.user);
+                else if ((val = startswith(l, "dynamic-creds-group=")))
+                        r = deserialize_dynamic_user(val, fds, &i->dynamic_creds.group);
+                else if ((val = startswith(l, "dynamic-creds-group-is-user=")))
+                        r = DESERIALIZE_BOOL(val, i->dynamic_creds_group_is_user);
+
+                else if ((val = startswith(l, "exec-files-environment=")))
+                        r = deserialize_strv(val, &i->files_env);
+                else if ((val = startswith(l, "user-lookup-fd=")))
+                        r = deserialize_fd(val, fds, &i->user_lookup_fd);
+                else
+                        r = -EBADMSG;
+
+                if (r < 0)
+                        return log_error_errno(r, "Failed to deserialize item '%.*s': %m", (int) strcspn(l, "="), l);
+        }
+
+        if (i->n_socket_fds + i->n_storage_fds != p->n_storage_fds ||
+            strv_length(p->fd_names) < p->n_storage_fds)
+                return log_error_errno(SYNTHETIC_ERRNO(EBADMSG), "Serialized file descriptors do not match their counts.");
+        p->n_socket_fds = i->n_socket_fds;
+        p->n_storage_fds = i->n_storage_fds;
+
+        if (!i->unit.id || !i->command.path)
+                return log_error_errno(SYNTHETIC_ERRNO(EBADMSG), "Serialization lacks the unit or command.");
+
+        if (i->dynamic_creds_group_is_user)
+                i->dynamic_creds.group = i->dynamic_creds.user;
+
+        p->cgroup_path = i->cgroup_path;
+        p->prefix = i->prefix;
+        if (i->idle_pipe[0] >= 0)
+                p->idle_pipe = i->idle_pipe;
+
+        manager_setup_log_fields(&i->manager);
+
+        return 0;
+}
+
+static DynamicUser *dynamic_user_free_stub(DynamicUser *d) {
+        if (!d)
+                return NULL;
+
+        safe_close_pair(d->storage_socket);
+        return mfree(d);
+}
+
+void exec_invocation_done(ExecInvocation *i) {
+        ExecDirectoryType dt;
+
+        assert(i);
+
+        i->unit.id = mfree(i->unit.id);
+
+        i->command.path = mfree(i->command.path);
+        i->command.argv = strv_free(i->command.argv);
+
+        exec_context_done(&i->context);
+
+        close_many(i->params.fds, i->params.n_socket_fds + i->params.n_storage_fds);
+        exec_params_clear(&i->params);
+        i->params.stdin_fd = safe_close(i->params.stdin_fd);
+        i->params.stdout_fd = safe_close(i->params.stdout_fd);
+        i->params.stderr_fd = safe_close(i->params.stderr_fd);
+        i->cgroup_path = mfree(i->cgroup_path);
+        for (dt = 0; dt < _EXEC_DIRECTORY_TYPE_MAX; dt++)
+                i->prefix[dt] = mfree(i->prefix[dt]);
+        safe_close_pair(i->idle_pipe);
+        safe_close_pair(i->idle_pipe + 2);
+
+        i->runtime.id = mfree(i->runtime.id);
+        i->runtime.tmp_dir = mfree(i->runtime.tmp_dir);
+        i->runtime.var_tmp_dir = mfree(i->runtime.var_tmp_dir);
+        safe_close_pair(i->runtime.netns_storage_socket);
+
+        if (i->dynamic_creds.group != i->dynamic_creds.user)
+                dynamic_user_free_stub(i->dynamic_creds.group);
+        i->dynamic_creds.group = NULL;
+        i->dynamic_creds.user = dynamic_user_free_stub(i->dynamic_creds.user);
+
+        i->files_env = strv_free(i->files_env);
+        i->user_lookup_fd = safe_close(i->user_lookup_fd);
+}
@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stdio.h>
+
+#include "dynamic-user.h"
+#include "execute.h"
+#include "fdset.h"
+#include "manager.h"
+#include "unit.h"
+
+/* Everything exec_invoke() needs to set up the execution environment of a command, as serialized by PID 1 and
+ * deserialized again in systemd-executor. The unit and manager objects are only stubs, carrying the few
+ * fields used for logging and the environment of NSS and PAM modules. */
+typedef struct ExecInvocation {
+        Manager manager;
+        Unit unit;
+
+        ExecCommand command;
+        ExecContext context;
+
+        ExecParameters params;
+        char *cgroup_path;
+        char *prefix[_EXEC_DIRECTORY_TYPE_MAX];
+        int idle_pipe[4];
+        size_t n_socket_fds, n_storage_fds;
+
+        ExecRuntime runtime;
+        bool has_runtime;
+
+        DynamicCreds dynamic_creds;
+        bool dynamic_creds_group_is_user;
+
+        char **files_env;
+        int user_lookup_fd;
+} ExecInvocation;
+
+int exec_invocation_serialize(
+                FILE *f,
+                FDSet *fds,
+                const Unit *unit,
+                const ExecCommand *command,
+                const ExecContext *context,
+                const ExecParameters *params,
+                const ExecRuntime *runtime,
+                const DynamicCreds *dcreds,
+                char **files_env,
+                int user_lookup_fd);
+
+void exec_invocation_init(ExecInvocation *i);
+int exec_invocation_deserialize(ExecInvocation *i, FILE *f, FDSet *fds);
+void exec_invocation_done(ExecInvocation *i);
@@ -3,6 +3,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <spawn.h>
 #include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
@@ -48,6 +49,7 @@
 #include "env-file.h"
 #include "env-util.h"
 #include "errno-list.h"
+#include "execute-serialize.h"
 #include "execute.h"
 #include "exit-status.h"
 #include "fd-util.h"
@@ -74,11 +76,13 @@
 #include "seccomp-util.h"
 #endif
 #include "securebits-util.h"
+#include "serialize.h"
 #include "selinux-util.h"
 #include "signal-util.h"
 #include "smack-util.h"
 #include "socket-util.h"
 #include "special.h"
+#include "stdio-util.h"
 #include "stat-util.h"
 #include "string-table.h"
 #include "string-util.h"
@@ -4067,25 +4071,19 @@ static int exec_child(
 static int exec_context_load_environment(const Unit *unit, const ExecContext *c, char ***l);
 static int exec_context_named_iofds(const ExecContext *c, const ExecParameters *p, int named_iofds[static 3]);
 
-int exec_spawn(Unit *unit,
-               ExecCommand *command,
-               const ExecContext *context,
-               const ExecParameters *params,
-               ExecRuntime *runtime,
-               DynamicCreds *dcreds,
-               pid_t *ret) {
+static int exec_prepare_fds(
+                const Unit *unit,
+                const ExecContext *context,
+                const ExecParameters *params,
+                int *ret_socket_fd,
+                int **ret_fds,
+                size_t *ret_n_socket_fds,
+                size_t *ret_n_storage_fds,
+                int ret_named_iofds[static 3]) {
 
-        int socket_fd, r, named_iofds[3] = { -1, -1, -1 }, *fds = NULL;
-        _cleanup_free_ char *subcgroup_path = NULL;
-        _cleanup_strv_free_ char **files_env = NULL;
-        size_t n_storage_fds = 0, n_socket_fds = 0;
-        _cleanup_free_ char *line = NULL;
-        pid_t pid;
+        int r;
 
-        assert(unit);
-        assert(command);
         assert(context);
-        assert(ret);
         assert(params);
         assert(params->fds || (params->n_socket_fds + params->n_storage_fds <= 0));
 
@@ -4103,18 +4101,189 @@ int exec_spawn(Unit *unit,
                         return -EINVAL;
                 }
 
-                socket_fd = params->fds[0];
+                *ret_socket_fd = params->fds[0];
+                *ret_fds = NULL;
+                *ret_n_socket_fds = *ret_n_storage_fds = 0;
         } else {
-                socket_fd = -1;
-                fds = params->fds;
-                n_socket_fds = params->n_socket_fds;
-                n_storage_fds = params->n_storage_fds;
+                *ret_socket_fd = -1;
+                *ret_fds = params->fds;
+                *ret_n_socket_fds = params->n_socket_fds;
+                *ret_n_storage_fds = params->n_storage_fds;
         }
 
-        r = exec_context_named_iofds(context, params, named_iofds);
+        r = exec_context_named_iofds(context, params, ret_named_iofds);
         if (r < 0)
                 return log_unit_error_errno(unit, r, "Failed to load a named file descriptor: %m");
 
+        return 0;
+}
+
+int exec_invoke(
+                Unit *unit,
+                const ExecCommand *command,
+                const ExecContext *context,
+                const ExecParameters *params,
+                ExecRuntime *runtime,
+                DynamicCreds *dcreds,
+                char **files_env,
+                int user_lookup_fd) {
+
+        int socket_fd, named_iofds[3] = { -1, -1, -1 }, *fds, exit_status = EXIT_SUCCESS, r;
+        size_t n_socket_fds, n_storage_fds;
+
+        assert(unit);
+        assert(command);
+
+        /* Sets up the execution environment in the current process and executes the command. Only returns on
+         * failure, or if the user chose not to execute the command after all, with the exit status to use. */
+
+        r = exec_prepare_fds(unit, context, params, &socket_fd, &fds, &n_socket_fds, &n_storage_fds, named_iofds);
+        if (r < 0)
+                return EXIT_FDS;
+
+        r = exec_child(unit,
+                       command,
+                       context,
+                       params,
+                       runtime,
+                       dcreds,
+                       socket_fd,
+                       named_iofds,
+                       fds,
+                       n_socket_fds,
+                       n_storage_fds,
+                       files_env,
+                       user_lookup_fd,
+                       &exit_status);
+
+        if (r < 0) {
+                const char *status =
+                        exit_status_to_string(exit_status,
+                                              EXIT_STATUS_LIBC | EXIT_STATUS_SYSTEMD);
+
+                log_struct_errno(LOG_ERR, r,
+                                 "MESSAGE_ID=" SD_MESSAGE_SPAWN_FAILED_STR,
+                                 LOG_UNIT_ID(unit),
+                                 LOG_UNIT_INVOCATION_ID(unit),
+                                 LOG_UNIT_MESSAGE(unit, "Failed at step %s spawning %s: %m",
+                                                  status, command->path),
+                                 "EXECUTABLE=%s", command->path);
+        }
+
+        return exit_status;
+}
+
+static bool exec_spawn_use_executor(const ExecParameters *params) {
+        static int cached = -1;
+        int r;
+
+        /* Asking for confirmation needs the job queue of the manager, which we don't pass on */
+        if (params->confirm_spawn)
+                return false;
+
+        if (cached < 0) {
+                r = getenv_bool("SYSTEMD_EXEC_EXECUTOR");
+                if (r < 0 && r != -ENXIO)
+                        log_warning_errno(r, "Failed to parse $SYSTEMD_EXEC_EXECUTOR, ignoring: %m");
+
+                cached = r > 0;
+        }
+
+        return cached;
+}
+
+static int exec_spawn_executor(
+                Unit *unit,
+                ExecCommand *command,
+                const ExecContext *context,
+                const ExecParameters *params,
+                ExecRuntime *runtime,
+                DynamicCreds *dcreds,
+                char **files_env,
+                pid_t *ret) {
+
+        _cleanup_fdset_free_ FDSet *fds = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        char serialization_fd[DECIMAL_STR_MAX(int)];
+        _cleanup_close_ int fd = -1;
+        pid_t pid;
+        int r;
+
+        assert(unit);
+        assert(ret);
+
+        /* Instead of forking off the manager, which copies its page tables and is hence slow if the manager is
+         * big, serialize everything exec_invoke() needs and let the small executor binary do the rest. As we
+         * don't touch our own memory in the child, posix_spawn() can use vfork() semantics. */
+
+        fd = open_serialization_fd("systemd-executor");
+        if (fd < 0)
+                return log_unit_error_errno(unit, fd, "Failed to create serialization file: %m");
+
+        f = fdopen(fd, "w+");
+        if (!f)
+                return log_unit_error_errno(unit, errno, "Failed to open serialization file: %m");
+        fd = -1; /* Now owned by f */
+
+        fds = fdset_new();
+        if (!fds)
+                return log_oom();
+
+        r = exec_invocation_serialize(f, fds, unit, command, context, params, runtime, dcreds, files_env,
+                                      unit->manager->user_lookup_fds[1]);
+        if (r < 0)
+                return log_unit_error_errno(unit, r, "Failed to serialize execution parameters: %m");
+
+        if (fseeko(f, 0, SEEK_SET) < 0)
+                return log_unit_error_errno(unit, errno, "Failed to rewind serialization file: %m");
+
+        /* The copies in the set are ours alone, hence it's fine to pass them on as they are */
+        r = fdset_cloexec(fds, false);
+        if (r < 0)
+                return log_unit_error_errno(unit, r, "Failed to disable O_CLOEXEC for serialized fds: %m");
+
+        r = fd_cloexec(fileno(f), false);
+        if (r < 0)
+                return log_unit_error_errno(unit, r, "Failed to disable O_CLOEXEC for serialization fd: %m");
+
+        xsprintf(serialization_fd, "%i", fileno(f));
+
+        r = posix_spawn(&pid, SYSTEMD_EXECUTOR_BINARY_PATH, NULL, NULL,
+                        STRV_MAKE("systemd-executor", "--deserialize", serialization_fd),
+                        environ);
+        if (r != 0)
+                return -r; /* Logged by the caller, as this might be ENOENT, which it handles gracefully */
+
+        *ret = pid;
+        return 0;
+}
+
+int exec_spawn(Unit *unit,
+               ExecCommand *command,
+               const ExecContext *context,
+               const ExecParameters *params,
+               ExecRuntime *runtime,
+               DynamicCreds *dcreds,
+               pid_t *ret) {
+
+        int socket_fd, r, named_iofds[3] = { -1, -1, -1 }, *fds = NULL;
+        _cleanup_free_ char *subcgroup_path = NULL;
+        _cleanup_strv_free_ char **files_env = NULL;
+        size_t n_storage_fds = 0, n_socket_fds = 0;
+        _cleanup_free_ char *line = NULL;
+        pid_t pid;
+
+        assert(unit);
+        assert(command);
+        assert(context);
+        assert(ret);
+        assert(params);
+
+        /* Validate the fds here already, so that we fail early and in the manager rather than in the child */
+        r = exec_prepare_fds(unit, context, params, &socket_fd, &fds, &n_socket_fds, &n_storage_fds, named_iofds);
+        if (r < 0)
+                return r;
+
         r = exec_context_load_environment(unit, context, &files_env);
         if (r < 0)
                 return log_unit_error_errno(unit, r, "Failed to load environment files: %m");
@@ -4140,43 +4309,29 @@ int exec_spawn(Unit *unit,
                 }
         }
 
-        pid = fork();
-        if (pid < 0)
-                return log_unit_error_errno(unit, errno, "Failed to fork: %m");
-
-        if (pid == 0) {
-                int exit_status = EXIT_SUCCESS;
-
-                r = exec_child(unit,
-                               command,
-                               context,
-                               params,
-                               runtime,
-                               dcreds,
-                               socket_fd,
-                               named_iofds,
-                               fds,
-                               n_socket_fds,
-                               n_storage_fds,
-                               files_env,
-                               unit->manager->user_lookup_fds[1],
-                               &exit_status);
-
-                if (r < 0) {
-                        const char *status =
-                                exit_status_to_string(exit_status,
-                                                      EXIT_STATUS_LIBC | EXIT_STATUS_SYSTEMD);
-
-                        log_struct_errno(LOG_ERR, r,
-                                         "MESSAGE_ID=" SD_MESSAGE_SPAWN_FAILED_STR,
-                                         LOG_UNIT_ID(unit),
-                                         LOG_UNIT_INVOCATION_ID(unit),
-                                         LOG_UNIT_MESSAGE(unit, "Failed at step %s spawning %s: %m",
-                                                          status, command->path),
-                                         "EXECUTABLE=%s", command->path);
-                }
+        r = -EOPNOTSUPP;
+        if (exec_spawn_use_executor(params)) {
+                r = exec_spawn_executor(unit, command, context, params, runtime, dcreds, files_env, &pid);
+                if (r == -ENOENT)
+                        log_unit_debug(unit, SYSTEMD_EXECUTOR_BINARY_PATH " not found, forking off the child directly.");
+                else if (r < 0)
+                        return log_unit_error_errno(unit, r, "Failed to spawn executor: %m");
+        }
 
-                _exit(exit_status);
+        if (r < 0) {
+                pid = fork();
+                if (pid < 0)
+                        return log_unit_error_errno(unit, errno, "Failed to fork: %m");
+
+                if (pid == 0)
+                        _exit(exec_invoke(unit,
+                                          command,
+                                          context,
+                                          params,
+                                          runtime,
+                                          dcreds,
+                                          files_env,
+                                          unit->manager->user_lookup_fds[1]));
         }
 
         log_unit_debug(unit, "Forked %s as "PID_FMT, command->path, pid);
@@ -364,6 +364,15 @@ int exec_spawn(Unit *unit,
                ExecRuntime *runtime,
                DynamicCreds *dynamic_creds,
                pid_t *ret);
+int exec_invoke(
+                Unit *unit,
+                const ExecCommand *command,
+                const ExecContext *context,
+                const ExecParameters *params,
+                ExecRuntime *runtime,
+                DynamicCreds *dynamic_creds,
+                char **files_env,
+                int user_lookup_fd);
 
 void exec_command_done_array(ExecCommand *c, size_t n);
 ExecCommand* exec_command_free_list(ExecCommand *c);
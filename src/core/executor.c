@@ -0,0 +1,148 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "execute-serialize.h"
+#include "fd-util.h"
+#include "fdset.h"
+#include "fileio.h"
+#include "log.h"
+#include "main-func.h"
+#include "parse-util.h"
+#include "selinux-util.h"
+#include "strv.h"
+#include "terminal-util.h"
+#include "util.h"
+
+static FILE *arg_serialization = NULL;
+
+STATIC_DESTRUCTOR_REGISTER(arg_serialization, fclosep);
+
+static int help(void) {
+        printf("%s [OPTIONS...]\n"
+               "\n%sSet up the execution environment of a unit process and execute it.%s\n\n"
+               "  -h --help              Show this help\n"
+               "     --version           Show package version\n"
+               "     --deserialize=FD    Read the process to execute from FD\n"
+               "\nThis program is spawned by the service manager, and not meant to be invoked directly.\n"
+               , program_invocation_short_name
+               , ansi_highlight(), ansi_normal()
+        );
+
+        return 0;
+}
+
+static int parse_argv(int argc, char *argv[]) {
+        enum {
+                ARG_VERSION = 0x100,
+                ARG_DESERIALIZE,
+        };
+
+        static const struct option options[] = {
+                { "help",        no_argument,       NULL, 'h'             },
+                { "version",     no_argument,       NULL, ARG_VERSION     },
+                { "deserialize", required_argument, NULL, ARG_DESERIALIZE },
+                {}
+        };
+
+        int c, fd, r;
+
+        assert(argc >= 0);
+        assert(argv);
+
+        while ((c = getopt_long(argc, argv, "h", options, NULL)) >= 0)
+                switch (c) {
+
+                case 'h':
+                        return help();
+
+                case ARG_VERSION:
+                        return version();
+
+                case ARG_DESERIALIZE:
+                        r = safe_atoi(optarg, &fd);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse serialization fd \"%s\": %m", optarg);
+                        if (fd < 0)
+                                return log_error_errno(SYNTHETIC_ERRNO(EBADF), "Invalid serialization fd: %d", fd);
+
+                        (void) fd_cloexec(fd, true);
+
+                        safe_fclose(arg_serialization);
+                        arg_serialization = fdopen(fd, "r");
+                        if (!arg_serialization)
+                                return log_error_errno(errno, "Failed to open serialization fd %d: %m", fd);
+
+                        break;
+
+                case '?':
+                        return -EINVAL;
+
+                default:
+                        assert_not_reached("Unhandled option");
+                }
+
+        if (optind < argc)
+                return log_error_errno(SYNTHETIC_ERRNO(EINVAL), "This program takes no arguments.");
+
+        if (!arg_serialization)
+                return log_error_errno(SYNTHETIC_ERRNO(EINVAL), "No serialization fd specified.");
+
+        return 1;
+}
+
+static int run(int argc, char *argv[]) {
+        _cleanup_(exec_invocation_done) ExecInvocation invocation;
+        _cleanup_fdset_free_ FDSet *fds = NULL;
+        ExecDirectoryType dt;
+        int r;
+
+        exec_invocation_init(&invocation);
+
+        /* Collect all fds we got passed before opening any ourselves, so that the deserialization can pick
+         * the ones it expects */
+        r = fdset_new_fill(&fds);
+        if (r < 0)
+                return log_error_errno(r, "Failed to allocate fd set: %m");
+
+        log_parse_environment();
+        log_open();
+
+        r = parse_argv(argc, argv);
+        if (r <= 0)
+                return r;
+
+        (void) fdset_remove(fds, fileno(arg_serialization));
+
+        r = exec_invocation_deserialize(&invocation, arg_serialization, fds);
+        if (r < 0)
+                return r;
+
+        arg_serialization = safe_fclose(arg_serialization);
+        fds = fdset_free(fds);
+
+        /* The manager loads the SELinux label database at start-up, and the child inherits it when forked
+         * off directly. It's only needed for labelling the runtime, state, cache, logs and configuration
+         * directories, hence only load it if there are any. */
+        for (dt = 0; dt < _EXEC_DIRECTORY_TYPE_MAX; dt++)
+                if (!strv_isempty(invocation.context.directories[dt].paths)) {
+                        (void) mac_selinux_init();
+                        break;
+                }
+
+        /* Like the child process forked off by exec_spawn(), exit right away if executing the command
+         * failed. exec_invoke() closed and rearranged fds, hence don't attempt to clean anything up. */
+        _exit(exec_invoke(&invocation.unit,
+                          &invocation.command,
+                          &invocation.context,
+                          &invocation.params,
+                          invocation.has_runtime ? &invocation.runtime : NULL,
+                          &invocation.dynamic_creds,
+                          invocation.files_env,
+                          invocation.user_lookup_fd));
+}
+
+DEFINE_MAIN_FUNCTION(run);
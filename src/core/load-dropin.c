@@ -4,6 +4,7 @@
 #include "fs-util.h"
 #include "load-dropin.h"
 #include "load-fragment.h"
+#include "load-prefetch.h"
 #include "log.h"
 #include "stat-util.h"
 #include "string-util.h"
@@ -11,17 +12,26 @@
 #include "unit-name.h"
 #include "unit.h"
 
+static int find_deps(Unit *u, const char *dir_suffix, char ***ret) {
+        return unit_file_find_dropin_paths(NULL,
+                                           u->manager->lookup_paths.search_path,
+                                           u->manager->unit_path_cache,
+                                           dir_suffix, NULL,
+                                           u->id, u->aliases,
+                                           ret);
+}
+
 static int process_deps(Unit *u, UnitDependency dependency, const char *dir_suffix) {
         _cleanup_strv_free_ char **paths = NULL;
         char **p;
         int r;
 
-        r = unit_file_find_dropin_paths(NULL,
-                                        u->manager->lookup_paths.search_path,
-                                        u->manager->unit_path_cache,
-                                        dir_suffix, NULL,
-                                        u->id, u->aliases,
-                                        &paths);
+        r = find_deps(u, dir_suffix, &paths);
+        if (r < 0)
+                return r;
+
+        /* Remember what we found, so that changes to the directories can be noticed later */
+        r = strv_extend_strv(&u->dropin_dependency_paths, paths, false);
         if (r < 0)
                 return r;
 
@@ -83,6 +93,32 @@ static int process_deps(Unit *u, UnitDependency dependency, const char *dir_suff
         return 0;
 }
 
+int unit_find_dependency_dropin_paths(Unit *u, char ***ret) {
+        _cleanup_strv_free_ char **wants = NULL, **requires = NULL;
+        int r;
+
+        assert(u);
+        assert(ret);
+
+        /* Returns the symlinks in the .wants and .requires directories, in the same order as
+         * u->dropin_dependency_paths */
+
+        r = find_deps(u, ".wants", &wants);
+        if (r < 0)
+                return r;
+
+        r = find_deps(u, ".requires", &requires);
+        if (r < 0)
+                return r;
+
+        r = strv_extend_strv(&wants, requires, false);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(wants);
+        return 0;
+}
+
 int unit_load_dropin(Unit *u) {
         _cleanup_strv_free_ char **l = NULL;
         char **f;
@@ -90,6 +126,8 @@ int unit_load_dropin(Unit *u) {
 
         assert(u);
 
+        u->dropin_dependency_paths = strv_free(u->dropin_dependency_paths);
+
         /* Load dependencies from .wants and .requires directories */
         r = process_deps(u, UNIT_WANTS, ".wants");
         if (r < 0)
@@ -100,7 +138,9 @@ int unit_load_dropin(Unit *u) {
                 return r;
 
         /* Load .conf dropins */
-        r = unit_find_dropin_paths(u, &l);
+        r = unit_prefetch_take_dropin_paths(u, &l);
+        if (r == -ENODATA)
+                r = unit_find_dropin_paths(u, &l);
         if (r <= 0)
                 return 0;
 
@@ -112,14 +152,27 @@ int unit_load_dropin(Unit *u) {
                         return log_oom();
         }
 
-        STRV_FOREACH(f, u->dropin_paths)
-                (void) config_parse(
-                                u->id, *f, NULL,
-                                UNIT_VTABLE(u)->sections,
-                                config_item_perf_lookup, load_fragment_gperf_lookup,
-                                0,
-                                u,
-                                &u->dropin_mtime);
+        STRV_FOREACH(f, u->dropin_paths) {
+                const ConfigFile *c;
+
+                c = unit_prefetch_get_file(u, *f);
+                if (c)
+                        (void) config_parse_file(
+                                        u->id, c,
+                                        UNIT_VTABLE(u)->sections,
+                                        config_item_perf_lookup, load_fragment_gperf_lookup,
+                                        0,
+                                        u,
+                                        &u->dropin_mtime);
+                else
+                        (void) config_parse(
+                                        u->id, *f, NULL,
+                                        UNIT_VTABLE(u)->sections,
+                                        config_item_perf_lookup, load_fragment_gperf_lookup,
+                                        0,
+                                        u,
+                                        &u->dropin_mtime);
+        }
 
         return 0;
 }
@@ -17,4 +17,5 @@ static inline int unit_find_dropin_paths(Unit *u, char ***paths) {
                                            paths);
 }
 
+int unit_find_dependency_dropin_paths(Unit *u, char ***ret);
 int unit_load_dropin(Unit *u);
@@ -40,6 +40,7 @@
 #include "journal-util.h"
 #include "limits-util.h"
 #include "load-fragment.h"
+#include "load-prefetch.h"
 #include "log.h"
 #include "mountpoint-util.h"
 #include "nulstr-util.h"
@@ -1853,7 +1854,7 @@ int config_parse_trigger_unit(
         assert(rvalue);
         assert(data);
 
-        if (!hashmap_isempty(u->dependencies[UNIT_TRIGGERS])) {
+        if (!unit_dependency_array_isempty(u->dependencies[UNIT_TRIGGERS])) {
                 log_syntax(unit, LOG_ERR, filename, line, 0, "Multiple units to trigger specified, ignoring: %s", rvalue);
                 return 0;
         }
@@ -4949,29 +4950,40 @@ int unit_load_fragment(Unit *u) {
                                      &u->manager->unit_path_cache);
         if (r < 0)
                 return log_error_errno(r, "Failed to rebuild name map: %m");
-
-        r = unit_file_find_fragment(u->manager->unit_id_map,
-                                    u->manager->unit_name_map,
-                                    u->id,
-                                    &fragment,
-                                    &names);
+        if (r > 0)
+                /* Whatever was read ahead might be outdated now */
+                unit_prefetch_flush(u->manager);
+
+        r = unit_prefetch_take_fragment(u, &fragment, &names);
+        if (r == -ENODATA)
+                r = unit_file_find_fragment(u->manager->unit_id_map,
+                                            u->manager->unit_name_map,
+                                            u->id,
+                                            &fragment,
+                                            &names);
         if (r < 0 && r != -ENOENT)
                 return r;
 
         if (fragment) {
                 /* Open the file, check if this is a mask, otherwise read. */
                 _cleanup_fclose_ FILE *f = NULL;
+                const ConfigFile *c;
                 struct stat st;
 
-                /* Try to open the file name. A symlink is OK, for example for linked files or masks. We
-                 * expect that all symlinks within the lookup paths have been already resolved, but we don't
-                 * verify this here. */
-                f = fopen(fragment, "re");
-                if (!f)
-                        return log_unit_notice_errno(u, errno, "Failed to open %s: %m", fragment);
-
-                if (fstat(fileno(f), &st) < 0)
-                        return -errno;
+                c = unit_prefetch_get_file(u, fragment);
+                if (c)
+                        st = c->st;
+                else {
+                        /* Try to open the file name. A symlink is OK, for example for linked files or masks.
+                         * We expect that all symlinks within the lookup paths have been already resolved, but
+                         * we don't verify this here. */
+                        f = fopen(fragment, "re");
+                        if (!f)
+                                return log_unit_notice_errno(u, errno, "Failed to open %s: %m", fragment);
+
+                        if (fstat(fileno(f), &st) < 0)
+                                return -errno;
+                }
 
                 r = free_and_strdup(&u->fragment_path, fragment);
                 if (r < 0)
@@ -4987,12 +4999,20 @@ int unit_load_fragment(Unit *u) {
                         u->fragment_mtime = timespec_load(&st.st_mtim);
 
                         /* Now, parse the file contents */
-                        r = config_parse(u->id, fragment, f,
-                                         UNIT_VTABLE(u)->sections,
-                                         config_item_perf_lookup, load_fragment_gperf_lookup,
-                                         0,
-                                         u,
-                                         NULL);
+                        if (c)
+                                r = config_parse_file(u->id, c,
+                                                      UNIT_VTABLE(u)->sections,
+                                                      config_item_perf_lookup, load_fragment_gperf_lookup,
+                                                      0,
+                                                      u,
+                                                      NULL);
+                        else
+                                r = config_parse(u->id, fragment, f,
+                                                 UNIT_VTABLE(u)->sections,
+                                                 config_item_perf_lookup, load_fragment_gperf_lookup,
+                                                 0,
+                                                 u,
+                                                 NULL);
                         if (r == -ENOEXEC)
                                 log_unit_notice_errno(u, r, "Unit configuration has fatal error, unit will not be started.");
                         if (r < 0)
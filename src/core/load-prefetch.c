@@ -0,0 +1,380 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <pthread.h>
+#include <signal.h>
+
+#include "alloc-util.h"
+#include "cpu-set-util.h"
+#include "dropin.h"
+#include "hashmap.h"
+#include "load-prefetch.h"
+#include "log.h"
+#include "manager.h"
+#include "strv.h"
+#include "unit-file.h"
+
+/* Reading a handful of files isn't worth starting threads for */
+#define PREFETCH_UNITS_MIN 16U
+#define PREFETCH_ITEMS_PER_THREAD 32U
+#define PREFETCH_THREADS_MAX 8U
+
+typedef struct PrefetchedUnit {
+        char *id;
+
+        int error;
+        const char *fragment;   /* points into the unit id map */
+        Set *names;
+        bool fragment_taken;
+
+        /* Looked up under the unit's own name only, i.e. only usable if it has no aliases */
+        int dropin_error;
+        char **dropin_paths;
+} PrefetchedUnit;
+
+typedef struct PrefetchedFile {
+        const char *path;
+        ConfigFile *file;
+} PrefetchedFile;
+
+typedef struct PrefetchRun {
+        Manager *manager;
+        void (*func)(Manager *m, void *item);
+        uint8_t *items;
+        size_t size;
+        size_t n_items;
+        size_t next;
+} PrefetchRun;
+
+static PrefetchedUnit *prefetched_unit_free(PrefetchedUnit *p) {
+        if (!p)
+                return NULL;
+
+        free(p->id);
+        set_free_free(p->names);
+        strv_free(p->dropin_paths);
+
+        return mfree(p);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(PrefetchedUnit*, prefetched_unit_free);
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(prefetched_unit_hash_ops, char, string_hash_func, string_compare_func,
+                                              PrefetchedUnit, prefetched_unit_free);
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(config_file_hash_ops, char, string_hash_func, string_compare_func,
+                                              ConfigFile, config_file_free);
+
+static void prefetch_unit(Manager *m, void *item) {
+        PrefetchedUnit *p = *(PrefetchedUnit**) item;
+
+        /* Both only read the lookup paths and the maps built from them, which don't change while the
+         * threads run. They also log, which is suppressed in the threads, see prefetch_thread(). */
+        p->error = unit_file_find_fragment(m->unit_id_map, m->unit_name_map, p->id, &p->fragment, &p->names);
+
+        p->dropin_error = unit_file_find_dropin_paths(NULL,
+                                                      m->lookup_paths.search_path,
+                                                      m->unit_path_cache,
+                                                      ".d", ".conf",
+                                                      p->id, NULL,
+                                                      &p->dropin_paths);
+}
+
+static void prefetch_file(Manager *m, void *item) {
+        PrefetchedFile *p = item;
+
+        /* Failures are left to the regular code path to report */
+        (void) config_file_read(p->path, NULL, &p->file);
+}
+
+static void *prefetch_thread(void *userdata) {
+        PrefetchRun *run = userdata;
+
+        /* Logging isn't thread-safe, errors are reported by the main thread when it takes the results */
+        log_set_thread_quiet(true);
+
+        for (;;) {
+                size_t i;
+
+                i = __sync_fetch_and_add(&run->next, 1);
+                if (i >= run->n_items)
+                        break;
+
+                run->func(run->manager, run->items + i * run->size);
+        }
+
+        /* The main thread runs this too */
+        log_set_thread_quiet(false);
+
+        return NULL;
+}
+
+static void prefetch_run(PrefetchRun *run) {
+        pthread_t threads[PREFETCH_THREADS_MAX - 1];
+        unsigned n_threads, n_started = 0, k;
+        sigset_t ss, saved_ss;
+        int cpus;
+
+        assert(run);
+
+        cpus = cpus_in_affinity_mask();
+        n_threads = MIN3(DIV_ROUND_UP(run->n_items, PREFETCH_ITEMS_PER_THREAD),
+                         cpus > 0 ? (unsigned) cpus : 1U,
+                         PREFETCH_THREADS_MAX);
+
+        /* No signals in the worker threads please, they are all handled by the event loop */
+        assert_se(sigfillset(&ss) >= 0);
+
+        if (n_threads > 1 && pthread_sigmask(SIG_BLOCK, &ss, &saved_ss) == 0) {
+                for (k = 0; k < n_threads - 1; k++) {
+                        if (pthread_create(threads + n_started, NULL, prefetch_thread, run) != 0)
+                                break;
+
+                        n_started++;
+                }
+
+                assert_se(pthread_sigmask(SIG_SETMASK, &saved_ss, NULL) == 0);
+        }
+
+        /* The main thread takes its share, and does everything itself if no threads could be started */
+        (void) prefetch_thread(run);
+
+        for (k = 0; k < n_started; k++)
+                assert_se(pthread_join(threads[k], NULL) == 0);
+}
+
+static PrefetchedUnit **prefetched_unit_list_free(PrefetchedUnit **l) {
+        PrefetchedUnit **p;
+
+        if (!l)
+                return NULL;
+
+        for (p = l; *p; p++)
+                prefetched_unit_free(*p);
+
+        return mfree(l);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(PrefetchedUnit**, prefetched_unit_list_free);
+
+static int prefetch_units(Manager *m, Unit *first, size_t n, PrefetchedUnit ***ret) {
+        _cleanup_(prefetched_unit_list_freep) PrefetchedUnit **units = NULL;
+        size_t n_units = 0, k;
+        Unit *u;
+
+        units = new0(PrefetchedUnit*, n + 1);
+        if (!units)
+                return -ENOMEM;
+
+        for (u = first, k = 0; u && k < n; u = u->load_queue_next, k++) {
+                _cleanup_(prefetched_unit_freep) PrefetchedUnit *p = NULL;
+
+                if (u->transient || hashmap_contains(m->prefetched_units, u->id))
+                        continue;
+
+                p = new0(PrefetchedUnit, 1);
+                if (!p)
+                        return -ENOMEM;
+
+                p->id = strdup(u->id);
+                if (!p->id)
+                        return -ENOMEM;
+
+                units[n_units++] = TAKE_PTR(p);
+        }
+
+        prefetch_run(&(PrefetchRun) {
+                .manager = m,
+                .func = prefetch_unit,
+                .items = (uint8_t*) units,
+                .size = sizeof(PrefetchedUnit*),
+                .n_items = n_units,
+        });
+
+        *ret = TAKE_PTR(units);
+        return 0;
+}
+
+static int prefetch_files(Manager *m, PrefetchedUnit **units) {
+        _cleanup_free_ PrefetchedFile *files = NULL;
+        _cleanup_set_free_ Set *paths = NULL;
+        PrefetchedUnit **p;
+        size_t n_files = 0, i;
+        const char *path;
+        Iterator it;
+        char **d;
+        int r;
+
+        /* Instances of a template share the template's fragment and drop-ins, read each file only once */
+        for (p = units; *p; p++) {
+                if ((*p)->fragment && !hashmap_contains(m->prefetched_files, (*p)->fragment)) {
+                        r = set_ensure_put(&paths, &string_hash_ops, (*p)->fragment);
+                        if (r < 0)
+                                return r;
+                }
+
+                STRV_FOREACH(d, (*p)->dropin_paths) {
+                        if (hashmap_contains(m->prefetched_files, *d))
+                                continue;
+
+                        r = set_ensure_put(&paths, &string_hash_ops, *d);
+                        if (r < 0)
+                                return r;
+                }
+        }
+
+        if (set_isempty(paths))
+                return 0;
+
+        files = new0(PrefetchedFile, set_size(paths));
+        if (!files)
+                return -ENOMEM;
+
+        SET_FOREACH(path, paths, it)
+                files[n_files++].path = path;
+
+        prefetch_run(&(PrefetchRun) {
+                .manager = m,
+                .func = prefetch_file,
+                .items = (uint8_t*) files,
+                .size = sizeof(PrefetchedFile),
+                .n_items = n_files,
+        });
+
+        r = hashmap_ensure_allocated(&m->prefetched_files, &config_file_hash_ops);
+        if (r < 0)
+                goto finish;
+
+        for (i = 0; i < n_files; i++) {
+                if (!files[i].file)
+                        continue;
+
+                r = hashmap_put(m->prefetched_files, files[i].file->filename, files[i].file);
+                if (r < 0)
+                        goto finish;
+
+                files[i].file = NULL;
+        }
+
+        r = 0;
+
+finish:
+        for (i = 0; i < n_files; i++)
+                config_file_free(files[i].file);
+
+        return r;
+}
+
+void unit_prefetch_load_queue(Manager *m) {
+        _cleanup_(prefetched_unit_list_freep) PrefetchedUnit **units = NULL;
+        PrefetchedUnit **p;
+        size_t n = 0;
+        Unit *u;
+        int r;
+
+        assert(m);
+
+        /* Units are prepended to the load queue, hence the ones we didn't look at yet are at its front */
+        LIST_FOREACH(load_queue, u, m->load_queue) {
+                if (u->load_prefetched)
+                        break;
+
+                u->load_prefetched = true;
+                n++;
+        }
+
+        /* Reading ahead costs a bit of copying, which doesn't pay off if there's no other CPU to do it */
+        if (n < PREFETCH_UNITS_MIN || cpus_in_affinity_mask() <= 1)
+                return;
+
+        /* Possibly rebuild the fragment map to catch new units, as unit_load_fragment() would */
+        r = unit_file_build_name_map(&m->lookup_paths,
+                                     &m->unit_cache_timestamp_hash,
+                                     &m->unit_id_map,
+                                     &m->unit_name_map,
+                                     &m->unit_path_cache);
+        if (r < 0)
+                return;
+        if (r > 0)
+                /* The fragments of earlier batches point into the map that was just freed */
+                unit_prefetch_flush(m);
+
+        r = prefetch_units(m, m->load_queue, n, &units);
+        if (r < 0)
+                goto fail;
+
+        r = prefetch_files(m, units);
+        if (r < 0)
+                goto fail;
+
+        r = hashmap_ensure_allocated(&m->prefetched_units, &prefetched_unit_hash_ops);
+        if (r < 0)
+                goto fail;
+
+        for (p = units; *p; p++) {
+                r = hashmap_put(m->prefetched_units, (*p)->id, *p);
+                if (r < 0)
+                        goto fail;
+
+                *p = NULL;
+        }
+
+        log_debug("Prefetched %zu units and %u unit files.", n, hashmap_size(m->prefetched_files));
+        return;
+
+fail:
+        log_debug_errno(r, "Failed to prefetch unit files, ignoring: %m");
+}
+
+void unit_prefetch_flush(Manager *m) {
+        assert(m);
+
+        m->prefetched_units = hashmap_free(m->prefetched_units);
+        m->prefetched_files = hashmap_free(m->prefetched_files);
+}
+
+int unit_prefetch_take_fragment(Unit *u, const char **ret_fragment, Set **ret_names) {
+        PrefetchedUnit *p;
+
+        assert(u);
+        assert(ret_fragment);
+        assert(ret_names);
+
+        p = hashmap_get(u->manager->prefetched_units, u->id);
+        if (!p || p->fragment_taken)
+                return -ENODATA;
+
+        p->fragment_taken = true;
+
+        /* The failed lookup didn't log anything, see prefetch_thread(). Let the caller look again, which
+         * reports the error. */
+        if (p->error < 0)
+                return -ENODATA;
+
+        *ret_fragment = p->fragment;
+        *ret_names = TAKE_PTR(p->names);
+        return 0;
+}
+
+int unit_prefetch_take_dropin_paths(Unit *u, char ***ret) {
+        _cleanup_(prefetched_unit_freep) PrefetchedUnit *p = NULL;
+
+        assert(u);
+        assert(ret);
+
+        if (!set_isempty(u->aliases))
+                return -ENODATA;
+
+        /* On failure the caller looks again, reporting the error itself, see prefetch_thread() */
+        p = hashmap_remove(u->manager->prefetched_units, u->id);
+        if (!p || p->dropin_error < 0)
+                return -ENODATA;
+
+        *ret = TAKE_PTR(p->dropin_paths);
+        return p->dropin_error;
+}
+
+const ConfigFile *unit_prefetch_get_file(Unit *u, const char *path) {
+        assert(u);
+        assert(path);
+
+        return hashmap_get(u->manager->prefetched_files, path);
+}
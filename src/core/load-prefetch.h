@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include "conf-parser.h"
+#include "set.h"
+#include "unit.h"
+
+/* Look up and read the unit files and drop-ins of the units in the load queue on worker threads, so that
+ * loading the units on the main thread only needs to parse them. The results are valid while the load
+ * queue is dispatched. */
+
+void unit_prefetch_load_queue(Manager *m);
+void unit_prefetch_flush(Manager *m);
+
+int unit_prefetch_take_fragment(Unit *u, const char **ret_fragment, Set **ret_names);
+int unit_prefetch_take_dropin_paths(Unit *u, char ***ret);
+const ConfigFile *unit_prefetch_get_file(Unit *u, const char *path);
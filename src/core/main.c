@@ -118,6 +118,7 @@ static StatusUnitFormat arg_status_unit_format;
 static bool arg_switched_root;
 static PagerFlags arg_pager_flags;
 static bool arg_service_watchdogs;
+static bool arg_serialize_binary_on_reexec;
 static ExecOutput arg_default_std_output;
 static ExecOutput arg_default_std_error;
 static usec_t arg_default_restart_usec;
@@ -666,6 +667,7 @@ static int parse_config_file(void) {
                 { "Manager", "DefaultTasksAccounting",       config_parse_bool,                  0, &arg_default_tasks_accounting          },
                 { "Manager", "DefaultTasksMax",              config_parse_tasks_max,             0, &arg_default_tasks_max                 },
                 { "Manager", "CtrlAltDelBurstAction",        config_parse_emergency_action,      0, &arg_cad_burst_action                  },
+                { "Manager", "SerializeBinaryOnReexec",      config_parse_bool,                  0, &arg_serialize_binary_on_reexec        },
                 { "Manager", "DefaultOOMPolicy",             config_parse_oom_policy,            0, &arg_default_oom_policy                },
                 {}
         };
@@ -749,6 +751,7 @@ static void set_manager_settings(Manager *m) {
         m->confirm_spawn = arg_confirm_spawn;
         m->service_watchdogs = arg_service_watchdogs;
         m->cad_burst_action = arg_cad_burst_action;
+        m->serialize_binary_on_reexec = arg_serialize_binary_on_reexec;
 
         manager_set_watchdog(m, WATCHDOG_RUNTIME, arg_runtime_watchdog);
         manager_set_watchdog(m, WATCHDOG_REBOOT, arg_reboot_watchdog);
@@ -1146,7 +1149,7 @@ static int prepare_reexecute(
         if (!fds)
                 return log_oom();
 
-        r = manager_serialize(m, f, fds, switching_root);
+        r = manager_serialize(m, f, fds, switching_root ? MANAGER_SWITCH_ROOT : MANAGER_REEXECUTE);
         if (r < 0)
                 return r;
 
@@ -1869,6 +1872,21 @@ static int invoke_main_loop(
 
                 switch ((ManagerObjective) r) {
 
+                case MANAGER_RELOAD_INCREMENTAL:
+                        log_info("Reloading changed units.");
+
+                        r = manager_reload_incremental(m);
+                        if (r >= 0)
+                                break;
+
+                        /* Something changed that needs a full reload, or we failed before the point of no
+                         * return. Either way, do it the long way instead. */
+                        if (r != -ESTALE)
+                                log_warning_errno(r, "Failed to reload changed units, doing a full reload: %m");
+
+                        m->objective = MANAGER_RELOAD;
+                        _fallthrough_;
+
                 case MANAGER_RELOAD: {
                         LogTarget saved_log_target;
                         int saved_log_level;
@@ -2293,6 +2311,7 @@ static void reset_arguments(void) {
         arg_switched_root = false;
         arg_pager_flags = 0;
         arg_service_watchdogs = true;
+        arg_serialize_binary_on_reexec = false;
         arg_default_std_output = EXEC_OUTPUT_JOURNAL;
         arg_default_std_error = EXEC_OUTPUT_INHERIT;
         arg_default_restart_usec = DEFAULT_RESTART_USEC;
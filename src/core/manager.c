@@ -38,6 +38,7 @@
 #include "dirent-util.h"
 #include "env-util.h"
 #include "escape.h"
+#include "event-util.h"
 #include "exec-util.h"
 #include "execute.h"
 #include "exit-status.h"
@@ -50,7 +51,9 @@
 #include "io-util.h"
 #include "label.h"
 #include "locale-setup.h"
+#include "load-dropin.h"
 #include "load-fragment.h"
+#include "load-prefetch.h"
 #include "log.h"
 #include "macro.h"
 #include "manager.h"
@@ -752,6 +755,25 @@ static int manager_setup_sigchld_event_source(Manager *m) {
         return 0;
 }
 
+void manager_setup_log_fields(Manager *m) {
+        assert(m);
+
+        /* Prepare log fields we can use for structured logging */
+        if (MANAGER_IS_SYSTEM(m)) {
+                m->unit_log_field = "UNIT=";
+                m->unit_log_format_string = "UNIT=%s";
+
+                m->invocation_log_field = "INVOCATION_ID=";
+                m->invocation_log_format_string = "INVOCATION_ID=%s";
+        } else {
+                m->unit_log_field = "USER_UNIT=";
+                m->unit_log_format_string = "USER_UNIT=%s";
+
+                m->invocation_log_field = "USER_INVOCATION_ID=";
+                m->invocation_log_format_string = "USER_INVOCATION_ID=%s";
+        }
+}
+
 int manager_new(UnitFileScope scope, ManagerTestRunFlags test_run_flags, Manager **_m) {
         _cleanup_(manager_freep) Manager *m = NULL;
         int r;
@@ -815,20 +837,7 @@ int manager_new(UnitFileScope scope, ManagerTestRunFlags test_run_flags, Manager
                                 m->timestamps + MANAGER_TIMESTAMP_LOADER);
 #endif
 
-        /* Prepare log fields we can use for structured logging */
-        if (MANAGER_IS_SYSTEM(m)) {
-                m->unit_log_field = "UNIT=";
-                m->unit_log_format_string = "UNIT=%s";
-
-                m->invocation_log_field = "INVOCATION_ID=";
-                m->invocation_log_format_string = "INVOCATION_ID=%s";
-        } else {
-                m->unit_log_field = "USER_UNIT=";
-                m->unit_log_format_string = "USER_UNIT=%s";
-
-                m->invocation_log_field = "USER_INVOCATION_ID=";
-                m->invocation_log_format_string = "USER_INVOCATION_ID=%s";
-        }
+        manager_setup_log_fields(m);
 
         /* Reboot immediately if the user hits C-A-D more often than 7x per 2s */
         m->ctrl_alt_del_ratelimit = (RateLimit) { .interval = 2 * USEC_PER_SEC, .burst = 7 };
@@ -979,6 +988,13 @@ static int manager_setup_notify(Manager *m) {
                         return log_error_errno(r, "Failed to set priority of notify event source: %m");
 
                 (void) sd_event_source_set_description(m->notify_event_source, "manager-notify");
+
+                /* Each dispatch processes a single message, and at this priority a client flooding us would
+                 * starve everything else. Hence, take a breather if we get more than we can reasonably
+                 * expect even during boot. */
+                r = sd_event_source_set_ratelimit(m->notify_event_source, 1 * USEC_PER_SEC, 2500);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to set rate limit of notify event source, ignoring: %m");
         }
 
         return 0;
@@ -1053,6 +1069,12 @@ static int manager_setup_cgroups_agent(Manager *m) {
                         return log_error_errno(r, "Failed to set priority of cgroups agent event source: %m");
 
                 (void) sd_event_source_set_description(m->cgroups_agent_event_source, "manager-cgroups-agent");
+
+                /* Same as for the notify socket above: don't let a storm of cgroup release notifications
+                 * starve the event loop. */
+                r = sd_event_source_set_ratelimit(m->cgroups_agent_event_source, 1 * USEC_PER_SEC, 2500);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to set rate limit of cgroups agent event source, ignoring: %m");
         }
 
         return 0;
@@ -1137,13 +1159,11 @@ enum {
 
 static void unit_gc_mark_good(Unit *u, unsigned gc_marker) {
         Unit *other;
-        Iterator i;
-        void *v;
 
         u->gc_marker = gc_marker + GC_OFFSET_GOOD;
 
         /* Recursively mark referenced units as GOOD as well */
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_REFERENCES], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REFERENCES)
                 if (other->gc_marker == gc_marker + GC_OFFSET_UNSURE)
                         unit_gc_mark_good(other, gc_marker);
 }
@@ -1151,8 +1171,6 @@ static void unit_gc_mark_good(Unit *u, unsigned gc_marker) {
 static void unit_gc_sweep(Unit *u, unsigned gc_marker) {
         Unit *other;
         bool is_bad;
-        Iterator i;
-        void *v;
 
         assert(u);
 
@@ -1170,7 +1188,7 @@ static void unit_gc_sweep(Unit *u, unsigned gc_marker) {
 
         is_bad = true;
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_REFERENCED_BY], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REFERENCED_BY) {
                 unit_gc_sweep(other, gc_marker);
 
                 if (other->gc_marker == gc_marker + GC_OFFSET_GOOD)
@@ -1892,10 +1910,8 @@ static int manager_dispatch_target_deps_queue(Manager *m) {
 
                 for (k = 0; k < ELEMENTSOF(deps); k++) {
                         Unit *target;
-                        Iterator i;
-                        void *v;
 
-                        HASHMAP_FOREACH_KEY(v, target, u->dependencies[deps[k]], i) {
+                        UNIT_FOREACH_DEPENDENCY(target, u, deps[k]) {
                                 r = unit_add_default_target_dependency(u, target);
                                 if (r < 0)
                                         return r;
@@ -1924,10 +1940,16 @@ unsigned manager_dispatch_load_queue(Manager *m) {
         while ((u = m->load_queue)) {
                 assert(u->in_load_queue);
 
+                /* Read the unit files of all units added to the queue since we last looked in one go */
+                if (!u->load_prefetched)
+                        unit_prefetch_load_queue(m);
+
                 unit_load(u);
                 n++;
         }
 
+        unit_prefetch_flush(m);
+
         m->dispatching_load_queue = false;
 
         /* Dispatch the units waiting for their target dependencies to be added now, as all targets that we know about
@@ -2004,9 +2026,10 @@ int manager_load_unit_prepare(
                  * we need to try again — even if the cache is current, it might have been
                  * updated in a different context before we had a chance to retry loading
                  * this particular unit. */
-                if (manager_unit_cache_should_retry_load(ret))
+                if (manager_unit_cache_should_retry_load(ret)) {
+                        bus_unit_invalidate_properties(ret);
                         ret->load_state = UNIT_STUB;
-                else {
+                } else {
                         *_ret = ret;
                         return 1;
                 }
@@ -2131,6 +2154,9 @@ void manager_dump(Manager *m, FILE *f, const char *prefix) {
 
         manager_dump_units(m, f, prefix);
         manager_dump_jobs(m, f, prefix);
+
+        /* Which event sources of the manager's event loop take up the most time */
+        (void) event_dump_sources(m->event, f, prefix);
 }
 
 int manager_get_dump_string(Manager *m, char **ret) {
@@ -3159,6 +3185,30 @@ int manager_open_serialization(Manager *m, FILE **_f) {
         return 0;
 }
 
+static bool manager_serialize_binary(Manager *m, ManagerObjective objective) {
+        int r;
+
+        assert(m);
+
+        /* The binary format is much quicker to read back, but only the very same version of systemd can
+         * be relied on to understand it. That's a given when reloading, but reexecuting is usually done to
+         * pick up a new version, hence stick to text there unless told otherwise. After switching root a
+         * different version is likely, hence always use text. */
+        if (objective == MANAGER_SWITCH_ROOT)
+                return false;
+
+        r = getenv_bool("SYSTEMD_SERIALIZE_BINARY");
+        if (r >= 0)
+                return r;
+        if (r != -ENXIO)
+                log_debug_errno(r, "Failed to parse $SYSTEMD_SERIALIZE_BINARY, ignoring: %m");
+
+        if (IN_SET(objective, MANAGER_RELOAD, MANAGER_RELOAD_INCREMENTAL))
+                return true;
+
+        return m->serialize_binary_on_reexec;
+}
+
 static bool manager_timestamp_shall_serialize(ManagerTimestamp t) {
 
         if (!in_initrd())
@@ -3169,7 +3219,8 @@ static bool manager_timestamp_shall_serialize(ManagerTimestamp t) {
                        MANAGER_TIMESTAMP_USERSPACE, MANAGER_TIMESTAMP_FINISH,
                        MANAGER_TIMESTAMP_SECURITY_START, MANAGER_TIMESTAMP_SECURITY_FINISH,
                        MANAGER_TIMESTAMP_GENERATORS_START, MANAGER_TIMESTAMP_GENERATORS_FINISH,
-                       MANAGER_TIMESTAMP_UNITS_LOAD_START, MANAGER_TIMESTAMP_UNITS_LOAD_FINISH);
+                       MANAGER_TIMESTAMP_UNITS_LOAD_START, MANAGER_TIMESTAMP_UNITS_LOAD_FINISH,
+                       MANAGER_TIMESTAMP_RELOAD_START, MANAGER_TIMESTAMP_RELOAD_FINISH);
 }
 
 #define DESTROY_IPC_FLAG (UINT32_C(1) << 31)
@@ -3217,8 +3268,11 @@ int manager_serialize(
                 Manager *m,
                 FILE *f,
                 FDSet *fds,
-                bool switching_root) {
+                ManagerObjective objective) {
 
+        bool switching_root = objective == MANAGER_SWITCH_ROOT;
+        _cleanup_fclose_ FILE *binary = NULL;
+        FILE *units_f = f;
         ManagerTimestamp q;
         const char *t;
         Iterator i;
@@ -3314,19 +3368,36 @@ int manager_serialize(
 
         (void) fputc('\n', f);
 
+        /* The manager's own state above is small, but the units make up most of the serialization */
+        if (manager_serialize_binary(m, objective)) {
+                r = serialize_binary_open(f, &binary);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to start binary serialization: %m");
+
+                units_f = binary;
+        }
+
         HASHMAP_FOREACH_KEY(u, t, m->units, i) {
                 if (u->id != t)
                         continue;
 
                 /* Start marker */
-                fputs(u->id, f);
-                fputc('\n', f);
+                fputs(u->id, units_f);
+                fputc('\n', units_f);
 
-                r = unit_serialize(u, f, fds, !switching_root);
+                r = unit_serialize(u, units_f, fds, !switching_root);
                 if (r < 0)
                         return r;
         }
 
+        if (binary) {
+                r = fflush_and_check(binary);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to flush binary serialization: %m");
+
+                binary = safe_fclose(binary);
+        }
+
         r = fflush_and_check(f);
         if (r < 0)
                 return log_error_errno(r, "Failed to flush serialization: %m");
@@ -3338,7 +3409,7 @@ int manager_serialize(
         return 0;
 }
 
-static int manager_deserialize_one_unit(Manager *m, const char *name, FILE *f, FDSet *fds) {
+static int manager_deserialize_one_unit(Manager *m, const char *name, Deserializer *d, FDSet *fds) {
         Unit *u;
         int r;
 
@@ -3349,36 +3420,93 @@ static int manager_deserialize_one_unit(Manager *m, const char *name, FILE *f, F
                 return log_notice_errno(r, "Failed to load unit \"%s\", skipping deserialization: %m", name);
         }
 
-        r = unit_deserialize(u, f, fds);
+        r = unit_deserialize(u, d, fds);
         if (r < 0) {
                 if (r == -ENOMEM)
                         return r;
-                return log_notice_errno(r, "Failed to deserialize unit \"%s\", skipping: %m", name);
+                /* The name might not be valid anymore once the unit's items were read */
+                return log_notice_errno(r, "Failed to deserialize unit \"%s\", skipping: %m", u->id);
         }
 
         return 0;
 }
 
+static int manager_load_serialized_units(Manager *m, FILE *f) {
+        _cleanup_(deserializer_freep) Deserializer *d = NULL;
+        off_t offset;
+        int r;
+
+        /* Queue all units in the serialization for loading before deserializing any of them, so that they
+         * are loaded in one go, and their unit files can be read ahead in parallel. Units loaded as a
+         * dependency of another one are otherwise loaded right away too, hence this doesn't change much
+         * in what state a unit is when it is deserialized. */
+
+        offset = ftello(f);
+        if (offset < 0)
+                return 0;
+
+        r = deserializer_new(f, &d);
+        if (r < 0)
+                return r;
+
+        for (;;) {
+                const char *name;
+                Unit *u;
+
+                r = deserializer_read_item(d, &name, NULL);
+                if (r < 0)
+                        break;
+                if (r == 0) {
+                        if (deserializer_eof(d))
+                                break;
+                        continue;
+                }
+
+                (void) manager_load_unit_prepare(m, name, NULL, NULL, &u);
+
+                if (unit_deserialize_skip(d) < 0)
+                        break;
+        }
+
+        d = deserializer_free(d);
+
+        manager_dispatch_load_queue(m);
+
+        if (fseeko(f, offset, SEEK_SET) < 0)
+                return log_error_errno(errno, "Failed to seek back in serialization: %m");
+
+        return 0;
+}
+
 static int manager_deserialize_units(Manager *m, FILE *f, FDSet *fds) {
+        _cleanup_(deserializer_freep) Deserializer *d = NULL;
         const char *unit_name;
         int r;
 
+        r = manager_load_serialized_units(m, f);
+        if (r < 0)
+                return r;
+
+        r = deserializer_new(f, &d);
+        if (r < 0)
+                return r;
+
         for (;;) {
-                _cleanup_free_ char *line = NULL;
                 /* Start marker */
-                r = read_line(f, LONG_LINE_MAX, &line);
+                r = deserializer_read_item(d, &unit_name, NULL);
                 if (r < 0)
-                        return log_error_errno(r, "Failed to read serialization line: %m");
-                if (r == 0)
-                        break;
-
-                unit_name = strstrip(line);
+                        return r;
+                if (r == 0) {
+                        if (deserializer_eof(d))
+                                break;
+                        continue;
+                }
 
-                r = manager_deserialize_one_unit(m, unit_name, f, fds);
+                r = manager_deserialize_one_unit(m, unit_name, d, fds);
                 if (r == -ENOMEM)
                         return r;
                 if (r < 0) {
-                        r = unit_deserialize_skip(f);
+                        r = unit_deserialize_skip(d);
                         if (r < 0)
                                 return r;
                 }
@@ -3726,10 +3854,13 @@ int manager_reload(Manager *m) {
         _cleanup_(manager_reloading_stopp) Manager *reloading = NULL;
         _cleanup_fdset_free_ FDSet *fds = NULL;
         _cleanup_fclose_ FILE *f = NULL;
+        dual_timestamp start;
         int r;
 
         assert(m);
 
+        dual_timestamp_get(&start);
+
         r = manager_open_serialization(m, &f);
         if (r < 0)
                 return log_error_errno(r, "Failed to create serialization file: %m");
@@ -3741,7 +3872,7 @@ int manager_reload(Manager *m) {
         /* We are officially in reload mode from here on. */
         reloading = manager_reloading_start(m);
 
-        r = manager_serialize(m, f, fds, false);
+        r = manager_serialize(m, f, fds, MANAGER_RELOAD);
         if (r < 0)
                 return r;
 
@@ -3811,10 +3942,378 @@ int manager_reload(Manager *m) {
 
         manager_ready(m);
 
+        /* Set after deserialization, which restored the timestamps of the previous reload */
+        m->timestamps[MANAGER_TIMESTAMP_RELOAD_START] = start;
+        dual_timestamp_get(m->timestamps + MANAGER_TIMESTAMP_RELOAD_FINISH);
+
         m->send_reloading_done = true;
         return 0;
 }
 
+typedef struct ReloadDependency {
+        Unit *unit;
+        UnitDependency dependency;
+        UnitDependencyMask mask;
+} ReloadDependency;
+
+typedef struct ReloadRef {
+        UnitRef *ref;
+        Unit *source;
+} ReloadRef;
+
+typedef struct ReloadUnit {
+        Unit *unit;
+        char *id;
+
+        /* Keeps a runtime shared with other units around while the unit is freed */
+        ExecRuntime *exec_runtime;
+
+        /* Dependencies on the unit that other units brought in, which go away with the unit */
+        ReloadDependency *dependencies;
+        size_t n_dependencies, n_allocated_dependencies;
+
+        /* References other units hold on the unit */
+        ReloadRef *refs;
+        size_t n_refs, n_allocated_refs;
+} ReloadUnit;
+
+static void reload_unit_list_free(ReloadUnit *l, size_t n) {
+        size_t k;
+
+        for (k = 0; k < n; k++) {
+                free(l[k].id);
+                exec_runtime_unref(l[k].exec_runtime, false);
+                free(l[k].dependencies);
+                free(l[k].refs);
+        }
+
+        free(l);
+}
+
+static int unit_changed_on_disk(Unit *u) {
+        _cleanup_set_free_free_ Set *names = NULL;
+        _cleanup_strv_free_ char **deps = NULL;
+        const char *fragment = NULL, *name;
+        Iterator i;
+        int r;
+
+        assert(u);
+
+        /* Returns > 0 if the unit files of the unit changed since it was loaded, and -ESTALE if the unit
+         * changed in a way that only a full reload can pick up. */
+
+        r = unit_file_find_fragment(u->manager->unit_id_map,
+                                    u->manager->unit_name_map,
+                                    u->id,
+                                    &fragment,
+                                    &names);
+        if (r < 0 && r != -ENOENT)
+                return r;
+
+        /* Symlinks added to or removed from .wants/ and .requires/ change the dependencies */
+        if (u->load_state == UNIT_LOADED) {
+                r = unit_find_dependency_dropin_paths(u, &deps);
+                if (r < 0)
+                        return r;
+        }
+
+        /* A unit file added in a directory with higher priority overrides the one we loaded */
+        if (path_equal_ptr(fragment, u->fragment_path) &&
+            !unit_need_daemon_reload(u) &&
+            (u->load_state != UNIT_LOADED || strv_equal(u->dropin_dependency_paths, deps)))
+                return 0;
+
+        if (u->transient || u->perpetual)
+                return log_unit_debug_errno(u, SYNTHETIC_ERRNO(ESTALE), "Transient or perpetual unit changed on disk.");
+        if (u->job || u->nop_job)
+                return log_unit_debug_errno(u, SYNTHETIC_ERRNO(ESTALE), "Unit with pending job changed on disk.");
+
+        /* Units enumerated from the kernel pick up their dependencies and state during enumeration */
+        if (UNIT_VTABLE(u)->enumerate)
+                return log_unit_debug_errno(u, SYNTHETIC_ERRNO(ESTALE), "Enumerated unit changed on disk.");
+
+        /* Units having or gaining aliases need to be merged */
+        if (!set_isempty(u->aliases))
+                return log_unit_debug_errno(u, SYNTHETIC_ERRNO(ESTALE), "Unit with aliases changed on disk.");
+        SET_FOREACH(name, names, i)
+                if (!streq(name, u->id))
+                        return log_unit_debug_errno(u, SYNTHETIC_ERRNO(ESTALE), "Unit gained alias %s.", name);
+
+        return 1;
+}
+
+static int reload_unit_save(ReloadUnit *r, Set *changed, FILE *f, FDSet *fds) {
+        _cleanup_set_free_ Set *others = NULL;
+        Unit *u = r->unit, *other;
+        UnitDependency d;
+        UnitRef *ref;
+        Iterator i;
+        int q;
+
+        /* Collect the units connected to this one… */
+        for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
+                UNIT_FOREACH_DEPENDENCY(other, u, d) {
+                        if (set_contains(changed, other))
+                                continue;
+
+                        q = set_ensure_put(&others, NULL, other);
+                        if (q < 0)
+                                return q;
+                }
+
+        /* … and remember which of their dependencies on this one originate from them. Every dependency
+         * has an inverse or comes with a reference, hence we find all of them this way. */
+        SET_FOREACH(other, others, i)
+                for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
+                        UnitDependencyInfo di;
+
+                        di = unit_dependency_array_get(other->dependencies[d], u);
+                        if (!di.data || di.origin_mask == 0)
+                                continue;
+
+                        if (!GREEDY_REALLOC(r->dependencies, r->n_allocated_dependencies, r->n_dependencies + 1))
+                                return -ENOMEM;
+
+                        r->dependencies[r->n_dependencies++] = (ReloadDependency) {
+                                .unit = other,
+                                .dependency = d,
+                                .mask = di.origin_mask,
+                        };
+                }
+
+        LIST_FOREACH(refs_by_target, ref, u->refs_by_target) {
+                if (set_contains(changed, ref->source))
+                        continue;
+
+                if (!GREEDY_REALLOC(r->refs, r->n_allocated_refs, r->n_refs + 1))
+                        return -ENOMEM;
+
+                r->refs[r->n_refs++] = (ReloadRef) {
+                        .ref = ref,
+                        .source = ref->source,
+                };
+        }
+
+        if (UNIT_VTABLE(u)->exec_runtime_offset > 0) {
+                ExecRuntime *rt;
+
+                rt = *(ExecRuntime**) ((uint8_t*) u + UNIT_VTABLE(u)->exec_runtime_offset);
+                if (rt)
+                        (void) exec_runtime_acquire(u->manager, NULL, rt->id, false, &r->exec_runtime);
+        }
+
+        /* Start marker, as in manager_serialize() */
+        fputs(u->id, f);
+        fputc('\n', f);
+
+        return unit_serialize(u, f, fds, false);
+}
+
+static void reload_unit_restore(Manager *m, ReloadUnit *r) {
+        size_t k;
+        Unit *u;
+        int q;
+
+        u = manager_get_unit(m, r->id);
+        if (!u)
+                return;
+
+        for (k = 0; k < r->n_dependencies; k++) {
+                q = unit_add_dependency(r->dependencies[k].unit, r->dependencies[k].dependency, u, false, r->dependencies[k].mask);
+                if (q < 0)
+                        log_unit_warning_errno(r->dependencies[k].unit, q,
+                                               "Failed to restore dependency %s=%s, ignoring: %m",
+                                               unit_dependency_to_string(r->dependencies[k].dependency), u->id);
+
+                if (r->dependencies[k].unit->job)
+                        job_add_to_run_queue(r->dependencies[k].unit->job);
+        }
+
+        for (k = 0; k < r->n_refs; k++)
+                unit_ref_set(r->refs[k].ref, r->refs[k].source, u);
+}
+
+int manager_reload_incremental(Manager *m) {
+        _cleanup_(manager_reloading_stopp) Manager *reloading = NULL;
+        _cleanup_set_free_ Set *changed = NULL;
+        _cleanup_fdset_free_ FDSet *fds = NULL;
+        _cleanup_fclose_ FILE *f = NULL, *binary = NULL;
+        char ts[FORMAT_TIMESPAN_MAX];
+        ReloadUnit *units = NULL;
+        size_t n_units = 0, n_allocated = 0, k;
+        dual_timestamp start;
+        Iterator i;
+        Unit *u;
+        char *t;
+        int r;
+
+        assert(m);
+
+        /* Reloads only the units whose unit files or drop-ins changed since they were loaded, by freeing
+         * them and loading them again, much like manager_reload() does with all units. Their runtime state
+         * is carried over through the serialization, and the dependencies and references other units have
+         * on them are put back in place afterwards. Returns -ESTALE if anything changed that needs a full
+         * reload. Generators are not run, and the manager configuration is not reread. */
+
+        dual_timestamp_get(&start);
+
+        r = unit_file_build_name_map(&m->lookup_paths,
+                                     &m->unit_cache_timestamp_hash,
+                                     &m->unit_id_map,
+                                     &m->unit_name_map,
+                                     &m->unit_path_cache);
+        if (r < 0)
+                return log_error_errno(r, "Failed to rebuild name map: %m");
+
+        HASHMAP_FOREACH_KEY(u, t, m->units, i) {
+
+                /* ignore aliases */
+                if (u->id != t)
+                        continue;
+
+                if (u->load_state == UNIT_STUB)
+                        continue;
+
+                r = unit_changed_on_disk(u);
+                if (r < 0)
+                        goto finish;
+                if (r == 0)
+                        continue;
+
+                r = set_ensure_put(&changed, NULL, u);
+                if (r < 0)
+                        goto finish;
+
+                if (!GREEDY_REALLOC0(units, n_allocated, n_units + 1)) {
+                        r = -ENOMEM;
+                        goto finish;
+                }
+
+                units[n_units].unit = u;
+                units[n_units].id = strdup(u->id);
+                if (!units[n_units].id) {
+                        r = -ENOMEM;
+                        goto finish;
+                }
+
+                n_units++;
+        }
+
+        if (n_units > 0) {
+                r = manager_open_serialization(m, &f);
+                if (r < 0) {
+                        log_error_errno(r, "Failed to create serialization file: %m");
+                        goto finish;
+                }
+
+                if (manager_serialize_binary(m, MANAGER_RELOAD_INCREMENTAL)) {
+                        r = serialize_binary_open(f, &binary);
+                        if (r < 0) {
+                                log_error_errno(r, "Failed to start binary serialization: %m");
+                                goto finish;
+                        }
+                }
+
+                fds = fdset_new();
+                if (!fds) {
+                        r = -ENOMEM;
+                        goto finish;
+                }
+        }
+
+        reloading = manager_reloading_start(m);
+
+        for (k = 0; k < n_units; k++) {
+                r = reload_unit_save(units + k, changed, binary ?: f, fds);
+                if (r < 0)
+                        goto finish;
+        }
+
+        if (binary) {
+                r = fflush_and_check(binary);
+                if (r < 0) {
+                        log_error_errno(r, "Failed to flush binary serialization: %m");
+                        goto finish;
+                }
+
+                binary = safe_fclose(binary);
+        }
+
+        if (f) {
+                r = fflush_and_check(f);
+                if (r < 0) {
+                        log_error_errno(r, "Failed to flush serialization: %m");
+                        goto finish;
+                }
+
+                if (fseeko(f, 0, SEEK_SET) < 0) {
+                        r = log_error_errno(errno, "Failed to seek to beginning of serialization: %m");
+                        goto finish;
+                }
+        }
+
+        /* From here on there is no way back, like in manager_reload(). */
+
+        bus_manager_send_reloading(m, true);
+
+        for (k = 0; k < n_units; k++)
+                unit_free(units[k].unit);
+        changed = set_free(changed);
+
+        if (f) {
+                r = manager_deserialize_units(m, f, fds);
+                if (r < 0)
+                        log_warning_errno(r, "Deserialization failed, proceeding anyway: %m");
+
+                f = safe_fclose(f);
+        }
+
+        for (k = 0; k < n_units; k++)
+                reload_unit_restore(m, units + k);
+
+        for (k = 0; k < n_units; k++) {
+                u = manager_get_unit(m, units[k].id);
+                if (!u)
+                        continue;
+
+                r = unit_coldplug(u);
+                if (r < 0)
+                        log_warning_errno(r, "We couldn't coldplug %s, proceeding anyway: %m", u->id);
+        }
+
+        manager_vacuum(m);
+
+        assert(m->n_reloading > 0);
+        m->n_reloading--;
+        reloading = NULL;
+
+        m->objective = MANAGER_OK;
+
+        for (k = 0; k < n_units; k++) {
+                u = manager_get_unit(m, units[k].id);
+                if (u)
+                        unit_catchup(u);
+        }
+
+        m->timestamps[MANAGER_TIMESTAMP_RELOAD_START] = start;
+        dual_timestamp_get(m->timestamps + MANAGER_TIMESTAMP_RELOAD_FINISH);
+
+        log_info("Reloaded %zu changed units in %s.", n_units,
+                 format_timespan(ts, sizeof(ts),
+                                 m->timestamps[MANAGER_TIMESTAMP_RELOAD_FINISH].monotonic - start.monotonic,
+                                 USEC_PER_MSEC));
+
+        m->send_reloading_done = true;
+        r = 0;
+
+finish:
+        if (r == -ENOMEM)
+                log_oom();
+
+        reload_unit_list_free(units, n_units);
+        return r;
+}
+
 void manager_reset_failed(Manager *m) {
         Unit *u;
         Iterator i;
@@ -4924,6 +5423,8 @@ static const char *const manager_timestamp_table[_MANAGER_TIMESTAMP_MAX] = {
         [MANAGER_TIMESTAMP_INITRD_GENERATORS_FINISH] = "initrd-generators-finish",
         [MANAGER_TIMESTAMP_INITRD_UNITS_LOAD_START] = "initrd-units-load-start",
         [MANAGER_TIMESTAMP_INITRD_UNITS_LOAD_FINISH] = "initrd-units-load-finish",
+        [MANAGER_TIMESTAMP_RELOAD_START] = "reload-start",
+        [MANAGER_TIMESTAMP_RELOAD_FINISH] = "reload-finish",
 };
 
 DEFINE_STRING_TABLE_LOOKUP(manager_timestamp, ManagerTimestamp);
@@ -350,12 +350,10 @@ static void slice_enumerate_perpetual(Manager *m) {
 
 static bool slice_freezer_action_supported_by_children(Unit *s) {
         Unit *member;
-        void *v;
-        Iterator i;
 
         assert(s);
 
-        HASHMAP_FOREACH_KEY(v, member, s->dependencies[UNIT_BEFORE], i) {
+        UNIT_FOREACH_DEPENDENCY(member, s, UNIT_BEFORE) {
                 int r;
 
                 if (UNIT_DEREF(member->slice) != s)
@@ -376,8 +374,6 @@ static bool slice_freezer_action_supported_by_children(Unit *s) {
 
 static int slice_freezer_action(Unit *s, FreezerAction action) {
         Unit *member;
-        void *v;
-        Iterator i;
         int r;
 
         assert(s);
@@ -388,7 +384,7 @@ static int slice_freezer_action(Unit *s, FreezerAction action) {
                 return 0;
         }
 
-        HASHMAP_FOREACH_KEY(v, member, s->dependencies[UNIT_BEFORE], i) {
+        UNIT_FOREACH_DEPENDENCY(member, s, UNIT_BEFORE) {
                 if (UNIT_DEREF(member->slice) != s)
                         continue;
 
@@ -0,0 +1,290 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <errno.h>
+#include <malloc.h>
+
+#include "alloc-util.h"
+#include "sort-util.h"
+#include "unit-dependency.h"
+
+/* How many recently added entries we scan linearly before merging them into the sorted part. Growing with the size of
+ * the array keeps the amortized cost of the merges constant per entry, while lookups stay cheap. */
+#define TAIL_MAX(a) (16U + (a)->n_sorted / 16U)
+
+static int entry_compare(const UnitDependencyEntry *x, const UnitDependencyEntry *y) {
+        return CMP((uintptr_t) x->unit, (uintptr_t) y->unit);
+}
+
+static UnitDependencyInfo info_normalize(UnitDependencyInfo info) {
+        UnitDependencyInfo n = { .data = NULL };
+
+        /* Only the masks are defined, make sure the rest of .data is zero, so that it can be used to tell
+         * whether an entry is set */
+        n.origin_mask = info.origin_mask;
+        n.destination_mask = info.destination_mask;
+        return n;
+}
+
+static UnitDependencyEntry *array_find(const UnitDependencyArray *a, const Unit *u) {
+        unsigned lo = 0, hi;
+
+        if (!a)
+                return NULL;
+
+        hi = a->n_sorted;
+        while (lo < hi) {
+                unsigned m = lo + (hi - lo) / 2;
+
+                if ((uintptr_t) a->entries[m].unit < (uintptr_t) u)
+                        lo = m + 1;
+                else
+                        hi = m;
+        }
+
+        if (lo < a->n_sorted && a->entries[lo].unit == u)
+                return (UnitDependencyEntry*) a->entries + lo;
+
+        for (unsigned i = a->n_sorted; i < a->n_entries; i++)
+                if (a->entries[i].unit == u)
+                        return (UnitDependencyEntry*) a->entries + i;
+
+        return NULL;
+}
+
+static void array_merge_tail(UnitDependencyArray *a) {
+        _cleanup_free_ UnitDependencyEntry *tail = NULL;
+        unsigned i, j, n_sorted = 0, n_tail, w;
+        UnitDependencyEntry *t;
+
+        assert(a);
+
+        /* Drop the removed entries first, keeping the order of the rest */
+        for (i = j = 0; i < a->n_entries; i++) {
+                if (!a->entries[i].info.data)
+                        continue;
+
+                if (i < a->n_sorted)
+                        n_sorted++;
+
+                a->entries[j++] = a->entries[i];
+        }
+
+        a->n_entries = j;
+        a->n_removed = 0;
+
+        t = a->entries + n_sorted;
+        n_tail = a->n_entries - n_sorted;
+        typesafe_qsort(t, n_tail, entry_compare);
+
+        tail = newdup(UnitDependencyEntry, t, n_tail);
+        if (!tail) {
+                /* Not worth failing for, just sort the whole thing in place */
+                typesafe_qsort(a->entries, a->n_entries, entry_compare);
+                a->n_sorted = a->n_entries;
+                return;
+        }
+
+        /* Merge from the back, so that the sorted part can be shifted up in place */
+        i = n_sorted;
+        j = n_tail;
+        w = a->n_entries;
+        while (j > 0) {
+                if (i > 0 && entry_compare(a->entries + i - 1, tail + j - 1) > 0)
+                        a->entries[--w] = a->entries[--i];
+                else
+                        a->entries[--w] = tail[--j];
+        }
+
+        a->n_sorted = a->n_entries;
+}
+
+UnitDependencyArray* unit_dependency_array_free(UnitDependencyArray *a) {
+        return mfree(a);
+}
+
+int unit_dependency_array_reserve(UnitDependencyArray **a, unsigned n) {
+        UnitDependencyArray *b;
+        unsigned n_entries, need;
+        size_t sz;
+
+        assert(a);
+
+        n_entries = *a ? (*a)->n_entries : 0;
+        if (n > UINT_MAX / 2 - n_entries)
+                return -ENOMEM;
+
+        need = n_entries + n;
+        if (*a && (*a)->n_allocated >= need)
+                return 0;
+
+        /* Most units only have a few dependencies of each type, hence start small, but grow exponentially for
+         * the ones that have many */
+        need = MAX(need, *a ? (*a)->n_allocated * 2 : 1U);
+
+        sz = offsetof(UnitDependencyArray, entries) + sizeof(UnitDependencyEntry) * need;
+        b = realloc(*a, sz);
+        if (!b)
+                return -ENOMEM;
+
+        if (!*a)
+                *b = (UnitDependencyArray) {};
+
+        b->n_allocated = (malloc_usable_size(b) - offsetof(UnitDependencyArray, entries)) / sizeof(UnitDependencyEntry);
+        *a = b;
+
+        return 0;
+}
+
+int unit_dependency_array_add(UnitDependencyArray **a, Unit *u, UnitDependencyInfo info) {
+        UnitDependencyEntry *e;
+        int r;
+
+        assert(a);
+        assert(u);
+
+        /* Adds the dependency on 'u', or merges the masks into an existing one. Returns > 0 if anything changed. */
+
+        info = info_normalize(info);
+        assert(info.data);
+
+        e = array_find(*a, u);
+        if (e) {
+                UnitDependencyInfo old = e->info;
+
+                if (!old.data) {
+                        e->info = info;
+                        (*a)->n_removed--;
+                        return 1;
+                }
+
+                e->info.origin_mask |= info.origin_mask;
+                e->info.destination_mask |= info.destination_mask;
+
+                return e->info.data != old.data;
+        }
+
+        r = unit_dependency_array_reserve(a, 1);
+        if (r < 0)
+                return r;
+
+        (*a)->entries[(*a)->n_entries++] = (UnitDependencyEntry) {
+                .unit = u,
+                .info = info,
+        };
+
+        if ((*a)->n_entries - (*a)->n_sorted > TAIL_MAX(*a))
+                array_merge_tail(*a);
+
+        return 1;
+}
+
+void unit_dependency_array_update(UnitDependencyArray *a, Unit *u, UnitDependencyInfo info) {
+        UnitDependencyEntry *e;
+
+        /* Replaces the masks of an existing dependency, and drops it if none are left */
+
+        e = array_find(a, u);
+        assert(e && e->info.data);
+
+        e->info = info_normalize(info);
+        if (!e->info.data)
+                a->n_removed++;
+}
+
+bool unit_dependency_array_remove(UnitDependencyArray *a, Unit *u) {
+        UnitDependencyEntry *e;
+
+        e = array_find(a, u);
+        if (!e || !e->info.data)
+                return false;
+
+        e->info = (UnitDependencyInfo) {};
+        a->n_removed++;
+
+        return true;
+}
+
+void unit_dependency_array_replace(UnitDependencyArray *a, Unit *old, Unit *u) {
+        UnitDependencyEntry *e, *f;
+        UnitDependencyInfo info;
+        unsigned i;
+
+        assert(old);
+        assert(u);
+        assert(old != u);
+
+        /* Moves the dependency on 'old' over to 'u', merging the masks into an existing dependency on 'u'.
+         * The entry of 'old' is reused if needed, hence this never allocates, and can't fail. */
+
+        e = array_find(a, old);
+        assert(e && e->info.data);
+        info = e->info;
+
+        f = array_find(a, u);
+        if (f) {
+                if (!f->info.data) {
+                        f->info = info;
+                        a->n_removed--;
+                } else {
+                        f->info.origin_mask |= info.origin_mask;
+                        f->info.destination_mask |= info.destination_mask;
+                }
+
+                e->info = (UnitDependencyInfo) {};
+                a->n_removed++;
+                return;
+        }
+
+        /* The tail isn't ordered, but in the sorted part the entry has to move to where 'u' belongs */
+        i = e - a->entries;
+        if (i < a->n_sorted) {
+                for (; i + 1 < a->n_sorted && (uintptr_t) a->entries[i + 1].unit < (uintptr_t) u; i++)
+                        a->entries[i] = a->entries[i + 1];
+                for (; i > 0 && (uintptr_t) a->entries[i - 1].unit > (uintptr_t) u; i--)
+                        a->entries[i] = a->entries[i - 1];
+        }
+
+        a->entries[i] = (UnitDependencyEntry) {
+                .unit = u,
+                .info = info,
+        };
+}
+
+int unit_dependency_array_move(UnitDependencyArray **a, UnitDependencyArray **other) {
+        UnitDependencyArray *o;
+        int r;
+
+        assert(a);
+        assert(other);
+
+        /* Moves all entries of 'other' into 'a', merging the masks of dependencies both have. This can't fail if
+         * enough space was reserved in 'a' beforehand. */
+
+        if (!*other)
+                return 0;
+
+        if (!*a) {
+                *a = TAKE_PTR(*other);
+                return 0;
+        }
+
+        o = *other;
+        for (unsigned i = 0; i < o->n_entries; i++) {
+                if (!o->entries[i].info.data)
+                        continue;
+
+                r = unit_dependency_array_add(a, o->entries[i].unit, o->entries[i].info);
+                if (r < 0)
+                        return r;
+        }
+
+        *other = unit_dependency_array_free(*other);
+        return 0;
+}
+
+UnitDependencyInfo unit_dependency_array_get(const UnitDependencyArray *a, const Unit *u) {
+        UnitDependencyEntry *e;
+
+        e = array_find(a, u);
+        return e ? e->info : (UnitDependencyInfo) {};
+}
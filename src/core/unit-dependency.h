@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stdbool.h>
+
+#include "macro.h"
+
+typedef struct Unit Unit;
+
+
+/* Stores the 'reason' a dependency was created as a bit mask, i.e. due to which configuration source it came to be. We
+ * use this so that we can selectively flush out parts of dependencies again. Note that the same dependency might be
+ * created as a result of multiple "reasons", hence the bitmask. */
+typedef enum UnitDependencyMask {
+        /* Configured directly by the unit file, .wants/.requires symlink or drop-in, or as an immediate result of a
+         * non-dependency option configured that way.  */
+        UNIT_DEPENDENCY_FILE               = 1 << 0,
+
+        /* As unconditional implicit dependency (not affected by unit configuration — except by the unit name and
+         * type) */
+        UNIT_DEPENDENCY_IMPLICIT           = 1 << 1,
+
+        /* A dependency effected by DefaultDependencies=yes. Note that dependencies marked this way are conceptually
+         * just a subset of UNIT_DEPENDENCY_FILE, as DefaultDependencies= is itself a unit file setting that can only
+         * be set in unit files. We make this two separate bits only to help debugging how dependencies came to be. */
+        UNIT_DEPENDENCY_DEFAULT            = 1 << 2,
+
+        /* A dependency created from udev rules */
+        UNIT_DEPENDENCY_UDEV               = 1 << 3,
+
+        /* A dependency created because of some unit's RequiresMountsFor= setting */
+        UNIT_DEPENDENCY_PATH               = 1 << 4,
+
+        /* A dependency created because of data read from /proc/self/mountinfo and no other configuration source */
+        UNIT_DEPENDENCY_MOUNTINFO_IMPLICIT = 1 << 5,
+
+        /* A dependency created because of data read from /proc/self/mountinfo, but conditionalized by
+         * DefaultDependencies= and thus also involving configuration from UNIT_DEPENDENCY_FILE sources */
+        UNIT_DEPENDENCY_MOUNTINFO_DEFAULT  = 1 << 6,
+
+        /* A dependency created because of data read from /proc/swaps and no other configuration source */
+        UNIT_DEPENDENCY_PROC_SWAP          = 1 << 7,
+
+        _UNIT_DEPENDENCY_MASK_FULL         = (1 << 8) - 1,
+} UnitDependencyMask;
+
+/* The Unit's dependencies[] arrays and its requires_mounts_for hashmap use this structure as value. It has the same size
+ * as a void pointer, and thus can be stored directly as hashmap value, without any indirection. Note that this stores
+ * two masks, as both the origin and the destination of a dependency might have created it. A dependency that exists has
+ * at least one bit set in either mask, hence .data is non-NULL for it. */
+typedef union UnitDependencyInfo {
+        void *data;
+        struct {
+                UnitDependencyMask origin_mask:16;
+                UnitDependencyMask destination_mask:16;
+        } _packed_;
+} UnitDependencyInfo;
+
+/* All dependencies of one type of a unit, i.e. what used to be a Hashmap with Unit* keys and UnitDependencyInfo
+ * values. The entries live in a single allocation, and all but a short tail of recently added ones are sorted by the
+ * Unit pointer, so that a lookup is a bisection plus a short linear scan. The tail is merged into the sorted part once
+ * it grows too long. Removed entries are only marked as such by clearing their info, so that removing dependencies
+ * while iterating is safe; they are dropped on the next merge, or revived if the same unit is added again. Hence
+ * every unit appears at most once. */
+typedef struct UnitDependencyEntry {
+        Unit *unit;
+        UnitDependencyInfo info;
+} UnitDependencyEntry;
+
+typedef struct UnitDependencyArray {
+        unsigned n_entries;     /* including the removed ones */
+        unsigned n_sorted;      /* entries[0] … entries[n_sorted-1] are ordered by the unit pointer */
+        unsigned n_removed;
+        unsigned n_allocated;
+        UnitDependencyEntry entries[];
+} UnitDependencyArray;
+
+UnitDependencyArray* unit_dependency_array_free(UnitDependencyArray *a);
+
+int unit_dependency_array_reserve(UnitDependencyArray **a, unsigned n);
+int unit_dependency_array_add(UnitDependencyArray **a, Unit *u, UnitDependencyInfo info);
+void unit_dependency_array_update(UnitDependencyArray *a, Unit *u, UnitDependencyInfo info);
+bool unit_dependency_array_remove(UnitDependencyArray *a, Unit *u);
+void unit_dependency_array_replace(UnitDependencyArray *a, Unit *old, Unit *u);
+int unit_dependency_array_move(UnitDependencyArray **a, UnitDependencyArray **other);
+
+UnitDependencyInfo unit_dependency_array_get(const UnitDependencyArray *a, const Unit *u);
+
+static inline bool unit_dependency_array_contains(const UnitDependencyArray *a, const Unit *u) {
+        return unit_dependency_array_get(a, u).data;
+}
+
+static inline unsigned unit_dependency_array_size(const UnitDependencyArray *a) {
+        return a ? a->n_entries - a->n_removed : 0;
+}
+
+static inline bool unit_dependency_array_isempty(const UnitDependencyArray *a) {
+        return unit_dependency_array_size(a) == 0;
+}
+
+static inline bool unit_dependency_array_next(const UnitDependencyArray *a, unsigned *i, Unit **ret, UnitDependencyInfo *ret_info) {
+        assert(i);
+        assert(ret);
+
+        if (!a)
+                return false;
+
+        for (; *i < a->n_entries; (*i)++) {
+                const UnitDependencyEntry *e = a->entries + *i;
+
+                if (!e->info.data)
+                        continue;
+
+                (*i)++;
+                *ret = e->unit;
+                if (ret_info)
+                        *ret_info = e->info;
+                return true;
+        }
+
+        return false;
+}
+
+static inline Unit* unit_dependency_array_first(const UnitDependencyArray *a) {
+        unsigned i = 0;
+        Unit *u;
+
+        return unit_dependency_array_next(a, &i, &u, NULL) ? u : NULL;
+}
+
+/* Iterate through the units 'u' has a dependency of type 'd' on. The array is looked up again on every step, hence
+ * it's fine to add or remove dependencies of the same type from the loop body, with the same caveats as for a
+ * Hashmap: entries added during the iteration might or might not be seen. */
+#define UNIT_FOREACH_DEPENDENCY(other, u, d)                            \
+        _UNIT_FOREACH_DEPENDENCY(other, NULL, u, d, UNIQ_T(i, UNIQ))
+
+#define UNIT_FOREACH_DEPENDENCY_INFO(other, info, u, d)                 \
+        _UNIT_FOREACH_DEPENDENCY(other, &(info), u, d, UNIQ_T(i, UNIQ))
+
+#define _UNIT_FOREACH_DEPENDENCY(other, ret_info, u, d, i)              \
+        for (unsigned i = 0; unit_dependency_array_next((u)->dependencies[d], &i, &(other), (ret_info)); )
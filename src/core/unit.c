@@ -312,6 +312,7 @@ int unit_add_name(Unit *u, const char *text) {
                 unit_init(u);
         }
 
+        bus_unit_invalidate_properties(u);
         unit_add_to_dbus_queue(u);
         return 0;
 }
@@ -351,6 +352,7 @@ int unit_choose_id(Unit *u, const char *name) {
                 assert_se(set_remove(u->aliases, name)); /* see set_get() above… */
 
         u->id = s; /* Old u->id is now stored in the set, and s is not stored anywhere */
+        bus_unit_invalidate_properties(u);
         unit_add_to_dbus_queue(u);
 
         return 0;
@@ -364,8 +366,10 @@ int unit_set_description(Unit *u, const char *description) {
         r = free_and_strdup(&u->description, empty_to_null(description));
         if (r < 0)
                 return r;
-        if (r > 0)
+        if (r > 0) {
+                bus_unit_invalidate_properties(u);
                 unit_add_to_dbus_queue(u);
+        }
 
         return 0;
 }
@@ -508,23 +512,22 @@ void unit_submit_to_stop_when_unneeded_queue(Unit *u) {
         u->in_stop_when_unneeded_queue = true;
 }
 
-static void bidi_set_free(Unit *u, Hashmap *h) {
+static void bidi_set_free(Unit *u, UnitDependency d) {
         Unit *other;
-        Iterator i;
-        void *v;
 
         assert(u);
 
-        /* Frees the hashmap and makes sure we are dropped from the inverse pointers */
+        /* Frees the dependency array and makes sure we are dropped from the inverse pointers */
 
-        HASHMAP_FOREACH_KEY(v, other, h, i) {
-                for (UnitDependency d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
-                        hashmap_remove(other->dependencies[d], u);
+        UNIT_FOREACH_DEPENDENCY(other, u, d) {
+                for (UnitDependency k = 0; k < _UNIT_DEPENDENCY_MAX; k++)
+                        unit_dependency_array_remove(other->dependencies[k], u);
 
+                bus_unit_invalidate_properties(other);
                 unit_add_to_gc_queue(other);
         }
 
-        hashmap_free(h);
+        u->dependencies[d] = unit_dependency_array_free(u->dependencies[d]);
 }
 
 static void unit_remove_transient(Unit *u) {
@@ -633,6 +636,7 @@ void unit_free(Unit *u) {
         if (!MANAGER_IS_RELOADING(u->manager))
                 unit_remove_transient(u);
 
+        bus_unit_invalidate_properties(u);
         bus_unit_send_removed_signal(u);
 
         unit_done(u);
@@ -667,7 +671,7 @@ void unit_free(Unit *u) {
         }
 
         for (UnitDependency d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
-                bidi_set_free(u, u->dependencies[d]);
+                bidi_set_free(u, d);
 
         if (u->on_console)
                 manager_unref_console(u->manager);
@@ -743,6 +747,7 @@ void unit_free(Unit *u) {
         free(u->fragment_path);
         free(u->source_path);
         strv_free(u->dropin_paths);
+        strv_free(u->dropin_dependency_paths);
         free(u->instance);
 
         free(u->job_timeout_reboot_arg);
@@ -805,21 +810,6 @@ const char* unit_sub_state_to_string(Unit *u) {
         return UNIT_VTABLE(u)->sub_state_to_string(u);
 }
 
-static int hashmap_complete_move(Hashmap **s, Hashmap **other) {
-        assert(s);
-        assert(other);
-
-        if (!*other)
-                return 0;
-
-        if (*s)
-                return hashmap_move(*s, *other);
-        else
-                *s = TAKE_PTR(*other);
-
-        return 0;
-}
-
 static int merge_names(Unit *u, Unit *other) {
         char *name;
         Iterator i;
@@ -857,22 +847,20 @@ static int reserve_dependencies(Unit *u, Unit *other, UnitDependency d) {
         /*
          * If u does not have this dependency set allocated, there is no need
          * to reserve anything. In that case other's set will be transferred
-         * as a whole to u by complete_move().
+         * as a whole to u by unit_dependency_array_move().
          */
         if (!u->dependencies[d])
                 return 0;
 
         /* merge_dependencies() will skip a u-on-u dependency */
-        n_reserve = hashmap_size(other->dependencies[d]) - !!hashmap_get(other->dependencies[d], u);
+        n_reserve = unit_dependency_array_size(other->dependencies[d]) -
+                unit_dependency_array_contains(other->dependencies[d], u);
 
-        return hashmap_reserve(u->dependencies[d], n_reserve);
+        return unit_dependency_array_reserve(&u->dependencies[d], n_reserve);
 }
 
 static void merge_dependencies(Unit *u, Unit *other, const char *other_id, UnitDependency d) {
-        Iterator i;
         Unit *back;
-        void *v;
-        int r;
 
         /* Merges all dependencies of type 'd' of the unit 'other' into the deps of the unit 'u' */
 
@@ -881,50 +869,34 @@ static void merge_dependencies(Unit *u, Unit *other, const char *other_id, UnitD
         assert(d < _UNIT_DEPENDENCY_MAX);
 
         /* Fix backwards pointers. Let's iterate through all dependent units of the other unit. */
-        HASHMAP_FOREACH_KEY(v, back, other->dependencies[d], i)
+        UNIT_FOREACH_DEPENDENCY(back, other, d) {
 
                 /* Let's now iterate through the dependencies of that dependencies of the other units,
                  * looking for pointers back, and let's fix them up, to instead point to 'u'. */
                 for (UnitDependency k = 0; k < _UNIT_DEPENDENCY_MAX; k++)
                         if (back == u) {
                                 /* Do not add dependencies between u and itself. */
-                                if (hashmap_remove(back->dependencies[k], other))
+                                if (unit_dependency_array_remove(back->dependencies[k], other))
                                         maybe_warn_about_dependency(u, other_id, k);
                         } else {
-                                UnitDependencyInfo di_u, di_other;
-
-                                /* Let's drop this dependency between "back" and "other", and let's create it between
-                                 * "back" and "u" instead. Let's merge the bit masks of the dependency we are moving,
-                                 * and any such dependency which might already exist */
-
-                                di_other.data = hashmap_get(back->dependencies[k], other);
-                                if (!di_other.data)
+                                if (!unit_dependency_array_contains(back->dependencies[k], other))
                                         continue; /* dependency isn't set, let's try the next one */
 
-                                di_u.data = hashmap_get(back->dependencies[k], u);
-
-                                UnitDependencyInfo di_merged = {
-                                        .origin_mask = di_u.origin_mask | di_other.origin_mask,
-                                        .destination_mask = di_u.destination_mask | di_other.destination_mask,
-                                };
-
-                                r = hashmap_remove_and_replace(back->dependencies[k], other, u, di_merged.data);
-                                if (r < 0)
-                                        log_warning_errno(r, "Failed to remove/replace: back=%s other=%s u=%s: %m", back->id, other_id, u->id);
-                                assert(r >= 0);
-
-                                /* assert_se(hashmap_remove_and_replace(back->dependencies[k], other, u, di_merged.data) >= 0); */
+                                /* Let's drop this dependency between "back" and "other", and let's create it between
+                                 * "back" and "u" instead, merging the bit masks with any such dependency which might
+                                 * already exist. This reuses the entry of "other", hence can't fail. */
+                                unit_dependency_array_replace(back->dependencies[k], other, u);
                         }
 
+                bus_unit_invalidate_properties(back);
+        }
+
         /* Also do not move dependencies on u to itself */
-        back = hashmap_remove(other->dependencies[d], u);
-        if (back)
+        if (unit_dependency_array_remove(other->dependencies[d], u))
                 maybe_warn_about_dependency(u, other_id, d);
 
         /* The move cannot fail. The caller must have performed a reservation. */
-        assert_se(hashmap_complete_move(&u->dependencies[d], &other->dependencies[d]) == 0);
-
-        other->dependencies[d] = hashmap_free(other->dependencies[d]);
+        assert_se(unit_dependency_array_move(&u->dependencies[d], &other->dependencies[d]) == 0);
 }
 
 int unit_merge(Unit *u, Unit *other) {
@@ -976,6 +948,9 @@ int unit_merge(Unit *u, Unit *other) {
                         return r;
         }
 
+        /* Once the names are merged, the bus paths of 'other' lead to 'u', hence drop its cache now */
+        bus_unit_invalidate_properties(other);
+
         /* Merge names */
         r = merge_names(u, other);
         if (r < 0)
@@ -992,6 +967,8 @@ int unit_merge(Unit *u, Unit *other) {
         other->load_state = UNIT_MERGED;
         other->merged_into = u;
 
+        bus_unit_invalidate_properties(u);
+
         /* If there is still some data attached to the other node, we
          * don't need it anymore, and can free it. */
         if (other->load_state != UNIT_STUB)
@@ -1379,7 +1356,7 @@ void unit_dump(Unit *u, FILE *f, const char *prefix) {
                 UnitDependencyInfo di;
                 Unit *other;
 
-                HASHMAP_FOREACH_KEY(di.data, other, u->dependencies[d], i) {
+                UNIT_FOREACH_DEPENDENCY_INFO(other, di, u, d) {
                         bool space = false;
 
                         fprintf(f, "%s\t%s: %s (", prefix, unit_dependency_to_string(d), other->id);
@@ -1513,7 +1490,7 @@ int unit_add_default_target_dependency(Unit *u, Unit *target) {
                 return 0;
 
         /* Don't create loops */
-        if (hashmap_get(target->dependencies[UNIT_BEFORE], u))
+        if (unit_dependency_array_contains(target->dependencies[UNIT_BEFORE], u))
                 return 0;
 
         return unit_add_dependency(target, UNIT_AFTER, u, true, UNIT_DEPENDENCY_DEFAULT);
@@ -1612,6 +1589,7 @@ int unit_load(Unit *u) {
         if (u->in_load_queue) {
                 LIST_REMOVE(load_queue, u->manager->load_queue, u);
                 u->in_load_queue = false;
+                u->load_prefetched = false;
         }
 
         if (u->type == _UNIT_TYPE_INVALID)
@@ -1653,7 +1631,7 @@ int unit_load(Unit *u) {
                 if (r < 0)
                         goto fail;
 
-                if (u->on_failure_job_mode == JOB_ISOLATE && hashmap_size(u->dependencies[UNIT_ON_FAILURE]) > 1) {
+                if (u->on_failure_job_mode == JOB_ISOLATE && unit_dependency_array_size(u->dependencies[UNIT_ON_FAILURE]) > 1) {
                         log_unit_error(u, "More than one OnFailure= dependencies specified but OnFailureJobMode=isolate set. Refusing.");
                         r = -ENOEXEC;
                         goto fail;
@@ -1668,6 +1646,7 @@ int unit_load(Unit *u) {
 
         assert((u->load_state != UNIT_MERGED) == !u->merged_into);
 
+        bus_unit_invalidate_properties(u);
         unit_add_to_dbus_queue(unit_follow_merge(u));
         unit_add_to_gc_queue(u);
 
@@ -1687,6 +1666,7 @@ fail:
         if (u->load_state == UNIT_NOT_FOUND)
                 u->fragment_not_found_timestamp_hash = u->manager->unit_cache_timestamp_hash;
 
+        bus_unit_invalidate_properties(u);
         unit_add_to_dbus_queue(u);
         unit_add_to_gc_queue(u);
 
@@ -1810,8 +1790,6 @@ bool unit_shall_confirm_spawn(Unit *u) {
 
 static bool unit_verify_deps(Unit *u) {
         Unit *other;
-        Iterator j;
-        void *v;
 
         assert(u);
 
@@ -1820,9 +1798,9 @@ static bool unit_verify_deps(Unit *u) {
          * processing, but do not have any effect afterwards. We don't check BindsTo= dependencies that are not used in
          * conjunction with After= as for them any such check would make things entirely racy. */
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BINDS_TO], j) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BINDS_TO) {
 
-                if (!hashmap_contains(u->dependencies[UNIT_AFTER], other))
+                if (!unit_dependency_array_contains(u->dependencies[UNIT_AFTER], other))
                         continue;
 
                 if (!UNIT_IS_ACTIVE_OR_RELOADING(unit_active_state(other))) {
@@ -2034,7 +2012,7 @@ bool unit_can_reload(Unit *u) {
         if (UNIT_VTABLE(u)->can_reload)
                 return UNIT_VTABLE(u)->can_reload(u);
 
-        if (!hashmap_isempty(u->dependencies[UNIT_PROPAGATES_RELOAD_TO]))
+        if (!unit_dependency_array_isempty(u->dependencies[UNIT_PROPAGATES_RELOAD_TO]))
                 return true;
 
         return UNIT_VTABLE(u)->reload;
@@ -2062,13 +2040,11 @@ bool unit_is_unneeded(Unit *u) {
 
         for (j = 0; j < ELEMENTSOF(deps); j++) {
                 Unit *other;
-                Iterator i;
-                void *v;
 
                 /* If a dependent unit has a job queued, is active or transitioning, or is marked for
                  * restart, then don't clean this one up. */
 
-                HASHMAP_FOREACH_KEY(v, other, u->dependencies[deps[j]], i) {
+                UNIT_FOREACH_DEPENDENCY(other, u, deps[j]) {
                         if (other->job)
                                 return false;
 
@@ -2099,10 +2075,8 @@ static void check_unneeded_dependencies(Unit *u) {
 
         for (j = 0; j < ELEMENTSOF(deps); j++) {
                 Unit *other;
-                Iterator i;
-                void *v;
 
-                HASHMAP_FOREACH_KEY(v, other, u->dependencies[deps[j]], i)
+                UNIT_FOREACH_DEPENDENCY(other, u, deps[j])
                         unit_submit_to_stop_when_unneeded_queue(other);
         }
 }
@@ -2111,8 +2085,6 @@ static void unit_check_binds_to(Unit *u) {
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         bool stop = false;
         Unit *other;
-        Iterator i;
-        void *v;
         int r;
 
         assert(u);
@@ -2123,7 +2095,7 @@ static void unit_check_binds_to(Unit *u) {
         if (unit_active_state(u) != UNIT_ACTIVE)
                 return;
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BINDS_TO], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BINDS_TO) {
                 if (other->job)
                         continue;
 
@@ -2159,65 +2131,59 @@ static void unit_check_binds_to(Unit *u) {
 }
 
 static void retroactively_start_dependencies(Unit *u) {
-        Iterator i;
         Unit *other;
-        void *v;
 
         assert(u);
         assert(UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(u)));
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_REQUIRES], i)
-                if (!hashmap_get(u->dependencies[UNIT_AFTER], other) &&
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUIRES)
+                if (!unit_dependency_array_contains(u->dependencies[UNIT_AFTER], other) &&
                     !UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_START, other, JOB_REPLACE, NULL, NULL, NULL);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BINDS_TO], i)
-                if (!hashmap_get(u->dependencies[UNIT_AFTER], other) &&
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BINDS_TO)
+                if (!unit_dependency_array_contains(u->dependencies[UNIT_AFTER], other) &&
                     !UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_START, other, JOB_REPLACE, NULL, NULL, NULL);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_WANTS], i)
-                if (!hashmap_get(u->dependencies[UNIT_AFTER], other) &&
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_WANTS)
+                if (!unit_dependency_array_contains(u->dependencies[UNIT_AFTER], other) &&
                     !UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_START, other, JOB_FAIL, NULL, NULL, NULL);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_CONFLICTS], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_CONFLICTS)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_STOP, other, JOB_REPLACE, NULL, NULL, NULL);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_CONFLICTED_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_CONFLICTED_BY)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_STOP, other, JOB_REPLACE, NULL, NULL, NULL);
 }
 
 static void retroactively_stop_dependencies(Unit *u) {
         Unit *other;
-        Iterator i;
-        void *v;
 
         assert(u);
         assert(UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(u)));
 
         /* Pull down units which are bound to us recursively if enabled */
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BOUND_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BOUND_BY)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_STOP, other, JOB_REPLACE, NULL, NULL, NULL);
 }
 
 void unit_start_on_failure(Unit *u) {
         Unit *other;
-        Iterator i;
-        void *v;
         int r;
 
         assert(u);
 
-        if (hashmap_size(u->dependencies[UNIT_ON_FAILURE]) <= 0)
+        if (unit_dependency_array_size(u->dependencies[UNIT_ON_FAILURE]) <= 0)
                 return;
 
         log_unit_info(u, "Triggering OnFailure= dependencies.");
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_ON_FAILURE], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_ON_FAILURE) {
                 _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
 
                 r = manager_add_job(u->manager, JOB_START, other, u->on_failure_job_mode, NULL, &error, NULL);
@@ -2228,12 +2194,10 @@ void unit_start_on_failure(Unit *u) {
 
 void unit_trigger_notify(Unit *u) {
         Unit *other;
-        Iterator i;
-        void *v;
 
         assert(u);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_TRIGGERED_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_TRIGGERED_BY)
                 if (UNIT_VTABLE(other)->trigger_notify)
                         UNIT_VTABLE(other)->trigger_notify(other, u);
 }
@@ -2969,51 +2933,23 @@ static void maybe_warn_about_dependency(Unit *u, const char *other, UnitDependen
                 log_unit_warning(u, "Dependency %s=%s dropped, merged into %s", unit_dependency_to_string(dependency), strna(other), u->id);
 }
 
-static int unit_add_dependency_hashmap(
-                Hashmap **h,
+static int unit_add_dependency_array(
+                UnitDependencyArray **a,
                 Unit *other,
                 UnitDependencyMask origin_mask,
                 UnitDependencyMask destination_mask) {
 
-        UnitDependencyInfo info;
-        int r;
-
-        assert(h);
+        assert(a);
         assert(other);
         assert(origin_mask < _UNIT_DEPENDENCY_MASK_FULL);
         assert(destination_mask < _UNIT_DEPENDENCY_MASK_FULL);
         assert(origin_mask > 0 || destination_mask > 0);
 
-        r = hashmap_ensure_allocated(h, NULL);
-        if (r < 0)
-                return r;
-
-        assert_cc(sizeof(void*) == sizeof(info));
-
-        info.data = hashmap_get(*h, other);
-        if (info.data) {
-                /* Entry already exists. Add in our mask. */
-
-                if (FLAGS_SET(origin_mask, info.origin_mask) &&
-                    FLAGS_SET(destination_mask, info.destination_mask))
-                        return 0; /* NOP */
-
-                info.origin_mask |= origin_mask;
-                info.destination_mask |= destination_mask;
-
-                r = hashmap_update(*h, other, info.data);
-        } else {
-                info = (UnitDependencyInfo) {
+        /* If the entry already exists, our masks are added in */
+        return unit_dependency_array_add(a, other, (UnitDependencyInfo) {
                         .origin_mask = origin_mask,
                         .destination_mask = destination_mask,
-                };
-
-                r = hashmap_put(*h, other, info.data);
-        }
-        if (r < 0)
-                return r;
-
-        return 1;
+                });
 }
 
 int unit_add_dependency(
@@ -3083,26 +3019,30 @@ int unit_add_dependency(
                 return log_unit_error_errno(u, SYNTHETIC_ERRNO(EINVAL),
                                             "Requested dependency TriggeredBy=%s refused (%s units cannot trigger other units).", other->id, unit_type_to_string(other->type));
 
-        r = unit_add_dependency_hashmap(u->dependencies + d, other, mask, 0);
+        r = unit_add_dependency_array(u->dependencies + d, other, mask, 0);
         if (r < 0)
                 return r;
 
         if (inverse_table[d] != _UNIT_DEPENDENCY_INVALID && inverse_table[d] != d) {
-                r = unit_add_dependency_hashmap(other->dependencies + inverse_table[d], u, 0, mask);
+                r = unit_add_dependency_array(other->dependencies + inverse_table[d], u, 0, mask);
                 if (r < 0)
                         return r;
         }
 
         if (add_reference) {
-                r = unit_add_dependency_hashmap(u->dependencies + UNIT_REFERENCES, other, mask, 0);
+                r = unit_add_dependency_array(u->dependencies + UNIT_REFERENCES, other, mask, 0);
                 if (r < 0)
                         return r;
 
-                r = unit_add_dependency_hashmap(other->dependencies + UNIT_REFERENCED_BY, u, 0, mask);
+                r = unit_add_dependency_array(other->dependencies + UNIT_REFERENCED_BY, u, 0, mask);
                 if (r < 0)
                         return r;
         }
 
+        /* The inverse dependency changed the other unit, but that's not worth a change signal */
+        bus_unit_invalidate_properties(u);
+        bus_unit_invalidate_properties(other);
+
         unit_add_to_dbus_queue(u);
         return 0;
 }
@@ -3631,18 +3571,18 @@ int unit_serialize(Unit *u, FILE *f, FDSet *fds, bool serialize_jobs) {
         return 0;
 }
 
-static int unit_deserialize_job(Unit *u, FILE *f) {
+static int unit_deserialize_job(Unit *u, Deserializer *d) {
         _cleanup_(job_freep) Job *j = NULL;
         int r;
 
         assert(u);
-        assert(f);
+        assert(d);
 
         j = job_new_raw(u);
         if (!j)
                 return log_oom();
 
-        r = job_deserialize(j, f);
+        r = job_deserialize(j, d);
         if (r < 0)
                 return r;
 
@@ -3654,41 +3594,27 @@ static int unit_deserialize_job(Unit *u, FILE *f) {
         return 0;
 }
 
-int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
+int unit_deserialize(Unit *u, Deserializer *d, FDSet *fds) {
         int r;
 
         assert(u);
-        assert(f);
+        assert(d);
         assert(fds);
 
         for (;;) {
-                _cleanup_free_ char *line = NULL;
-                char *l, *v;
+                const char *l, *v;
                 ssize_t m;
-                size_t k;
 
-                r = read_line(f, LONG_LINE_MAX, &line);
+                r = deserializer_read_item(d, &l, &v);
                 if (r < 0)
-                        return log_error_errno(r, "Failed to read serialization line: %m");
-                if (r == 0) /* eof */
-                        break;
-
-                l = strstrip(line);
-                if (isempty(l)) /* End marker */
+                        return r;
+                if (r == 0) /* End marker or EOF */
                         break;
 
-                k = strcspn(l, "=");
-
-                if (l[k] == '=') {
-                        l[k] = 0;
-                        v = l+k+1;
-                } else
-                        v = l+k;
-
                 if (streq(l, "job")) {
                         if (v[0] == '\0') {
                                 /* New-style serialized job */
-                                r = unit_deserialize_job(u, f);
+                                r = unit_deserialize_job(u, d);
                                 if (r < 0)
                                         return r;
                         } else  /* Legacy for pre-44 */
@@ -3994,28 +3920,23 @@ int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
         return 0;
 }
 
-int unit_deserialize_skip(FILE *f) {
+int unit_deserialize_skip(Deserializer *d) {
+        const char *l;
         int r;
-        assert(f);
+
+        assert(d);
 
         /* Skip serialized data for this unit. We don't know what it is. */
 
-        for (;;) {
-                _cleanup_free_ char *line = NULL;
-                char *l;
+        do
+                r = deserializer_read_item(d, &l, NULL);
+        while (r > 0);
 
-                r = read_line(f, LONG_LINE_MAX, &line);
-                if (r < 0)
-                        return log_error_errno(r, "Failed to read serialization line: %m");
-                if (r == 0)
-                        return 0;
-
-                l = strstrip(line);
+        if (r < 0)
+                return r;
 
-                /* End marker */
-                if (isempty(l))
-                        return 1;
-        }
+        /* End marker */
+        return !deserializer_eof(d);
 }
 
 int unit_add_node_dependency(Unit *u, const char *what, UnitDependency dep, UnitDependencyMask mask) {
@@ -4854,8 +4775,10 @@ int unit_make_transient(Unit *u) {
 
         u->source_path = mfree(u->source_path);
         u->dropin_paths = strv_free(u->dropin_paths);
+        u->dropin_dependency_paths = strv_free(u->dropin_dependency_paths);
         u->fragment_mtime = u->source_mtime = u->dropin_mtime = 0;
 
+        bus_unit_invalidate_properties(u);
         u->load_state = UNIT_STUB;
         u->load_error = 0;
         u->transient = true;
@@ -5114,8 +5037,6 @@ int unit_setup_exec_runtime(Unit *u) {
         ExecRuntime **rt;
         size_t offset;
         Unit *other;
-        Iterator i;
-        void *v;
         int r;
 
         offset = UNIT_VTABLE(u)->exec_runtime_offset;
@@ -5127,7 +5048,7 @@ int unit_setup_exec_runtime(Unit *u) {
                 return 0;
 
         /* Try to get it from somebody else */
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_JOINS_NAMESPACE_OF], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_JOINS_NAMESPACE_OF) {
                 r = exec_runtime_acquire(u->manager, NULL, other->id, false, rt);
                 if (r == 1)
                         return 1;
@@ -5505,13 +5426,10 @@ static void unit_update_dependency_mask(Unit *u, UnitDependency d, Unit *other,
         assert(d < _UNIT_DEPENDENCY_MAX);
         assert(other);
 
-        if (di.origin_mask == 0 && di.destination_mask == 0) {
-                /* No bit set anymore, let's drop the whole entry */
-                assert_se(hashmap_remove(u->dependencies[d], other));
+        /* If no bit is set anymore this drops the whole entry, otherwise the mask was reduced and is updated */
+        unit_dependency_array_update(u->dependencies[d], other, di);
+        if (di.origin_mask == 0 && di.destination_mask == 0)
                 log_unit_debug(u, "lost dependency %s=%s", unit_dependency_to_string(d), other->id);
-        } else
-                /* Mask was reduced, let's update the entry */
-                assert_se(hashmap_update(u->dependencies[d], other, di.data) == 0);
 }
 
 void unit_remove_dependencies(Unit *u, UnitDependencyMask mask) {
@@ -5523,44 +5441,37 @@ void unit_remove_dependencies(Unit *u, UnitDependencyMask mask) {
                 return;
 
         for (UnitDependency d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
-                bool done;
-
-                do {
-                        UnitDependencyInfo di;
-                        Unit *other;
-                        Iterator i;
-
-                        done = true;
-
-                        HASHMAP_FOREACH_KEY(di.data, other, u->dependencies[d], i) {
-                                if ((di.origin_mask & ~mask) == di.origin_mask)
-                                        continue;
-                                di.origin_mask &= ~mask;
-                                unit_update_dependency_mask(u, d, other, di);
-
-                                /* We updated the dependency from our unit to the other unit now. But most dependencies
-                                 * imply a reverse dependency. Hence, let's delete that one too. For that we go through
-                                 * all dependency types on the other unit and delete all those which point to us and
-                                 * have the right mask set. */
+                UnitDependencyInfo di;
+                Unit *other;
 
-                                for (UnitDependency q = 0; q < _UNIT_DEPENDENCY_MAX; q++) {
-                                        UnitDependencyInfo dj;
+                /* Dropping entries doesn't move the others around, hence we can continue the iteration */
+                UNIT_FOREACH_DEPENDENCY_INFO(other, di, u, d) {
+                        if ((di.origin_mask & ~mask) == di.origin_mask)
+                                continue;
+                        di.origin_mask &= ~mask;
+                        unit_update_dependency_mask(u, d, other, di);
 
-                                        dj.data = hashmap_get(other->dependencies[q], u);
-                                        if ((dj.destination_mask & ~mask) == dj.destination_mask)
-                                                continue;
-                                        dj.destination_mask &= ~mask;
+                        /* We updated the dependency from our unit to the other unit now. But most dependencies
+                         * imply a reverse dependency. Hence, let's delete that one too. For that we go through
+                         * all dependency types on the other unit and delete all those which point to us and
+                         * have the right mask set. */
 
-                                        unit_update_dependency_mask(other, q, u, dj);
-                                }
+                        for (UnitDependency q = 0; q < _UNIT_DEPENDENCY_MAX; q++) {
+                                UnitDependencyInfo dj;
 
-                                unit_add_to_gc_queue(other);
+                                dj = unit_dependency_array_get(other->dependencies[q], u);
+                                if ((dj.destination_mask & ~mask) == dj.destination_mask)
+                                        continue;
+                                dj.destination_mask &= ~mask;
 
-                                done = false;
-                                break;
+                                unit_update_dependency_mask(other, q, u, dj);
                         }
 
-                } while (!done);
+                        bus_unit_invalidate_properties(u);
+                        bus_unit_invalidate_properties(other);
+
+                        unit_add_to_gc_queue(other);
+                }
         }
 }
 
@@ -9,8 +9,10 @@
 #include "condition.h"
 #include "emergency-action.h"
 #include "list.h"
+#include "serialize.h"
 #include "show-status.h"
 #include "set.h"
+#include "unit-dependency.h"
 #include "unit-file.h"
 #include "cgroup.h"
 
@@ -49,53 +51,6 @@ static inline bool UNIT_IS_INACTIVE_OR_FAILED(UnitActiveState t) {
         return IN_SET(t, UNIT_INACTIVE, UNIT_FAILED);
 }
 
-/* Stores the 'reason' a dependency was created as a bit mask, i.e. due to which configuration source it came to be. We
- * use this so that we can selectively flush out parts of dependencies again. Note that the same dependency might be
- * created as a result of multiple "reasons", hence the bitmask. */
-typedef enum UnitDependencyMask {
-        /* Configured directly by the unit file, .wants/.requires symlink or drop-in, or as an immediate result of a
-         * non-dependency option configured that way.  */
-        UNIT_DEPENDENCY_FILE               = 1 << 0,
-
-        /* As unconditional implicit dependency (not affected by unit configuration — except by the unit name and
-         * type) */
-        UNIT_DEPENDENCY_IMPLICIT           = 1 << 1,
-
-        /* A dependency effected by DefaultDependencies=yes. Note that dependencies marked this way are conceptually
-         * just a subset of UNIT_DEPENDENCY_FILE, as DefaultDependencies= is itself a unit file setting that can only
-         * be set in unit files. We make this two separate bits only to help debugging how dependencies came to be. */
-        UNIT_DEPENDENCY_DEFAULT            = 1 << 2,
-
-        /* A dependency created from udev rules */
-        UNIT_DEPENDENCY_UDEV               = 1 << 3,
-
-        /* A dependency created because of some unit's RequiresMountsFor= setting */
-        UNIT_DEPENDENCY_PATH               = 1 << 4,
-
-        /* A dependency created because of data read from /proc/self/mountinfo and no other configuration source */
-        UNIT_DEPENDENCY_MOUNTINFO_IMPLICIT = 1 << 5,
-
-        /* A dependency created because of data read from /proc/self/mountinfo, but conditionalized by
-         * DefaultDependencies= and thus also involving configuration from UNIT_DEPENDENCY_FILE sources */
-        UNIT_DEPENDENCY_MOUNTINFO_DEFAULT  = 1 << 6,
-
-        /* A dependency created because of data read from /proc/swaps and no other configuration source */
-        UNIT_DEPENDENCY_PROC_SWAP          = 1 << 7,
-
-        _UNIT_DEPENDENCY_MASK_FULL         = (1 << 8) - 1,
-} UnitDependencyMask;
-
-/* The Unit's dependencies[] hashmaps use this structure as value. It has the same size as a void pointer, and thus can
- * be stored directly as hashmap value, without any indirection. Note that this stores two masks, as both the origin
- * and the destination of a dependency might have created it. */
-typedef union UnitDependencyInfo {
-        void *data;
-        struct {
-                UnitDependencyMask origin_mask:16;
-                UnitDependencyMask destination_mask:16;
-        } _packed_;
-} UnitDependencyInfo;
-
 #include "job.h"
 
 struct UnitRef {
@@ -122,9 +77,9 @@ typedef struct Unit {
 
         Set *aliases; /* All the other names. */
 
-        /* For each dependency type we maintain a Hashmap whose key is the Unit* object, and the value encodes why the
-         * dependency exists, using the UnitDependencyInfo type */
-        Hashmap *dependencies[_UNIT_DEPENDENCY_MAX];
+        /* For each dependency type we maintain an array of the Unit* objects we depend on, together with a
+         * UnitDependencyInfo that encodes why the dependency exists. Use UNIT_FOREACH_DEPENDENCY() to iterate. */
+        UnitDependencyArray *dependencies[_UNIT_DEPENDENCY_MAX];
 
         /* Similar, for RequiresMountsFor= path dependencies. The key is the path, the value the UnitDependencyInfo type */
         Hashmap *requires_mounts_for;
@@ -135,6 +90,7 @@ typedef struct Unit {
         char *fragment_path; /* if loaded from a config file this is the primary path to it */
         char *source_path; /* if converted, the source file */
         char **dropin_paths;
+        char **dropin_dependency_paths; /* the symlinks in .wants/ and .requires/ directories */
 
         usec_t fragment_not_found_timestamp_hash;
         usec_t fragment_mtime;
@@ -339,6 +295,7 @@ typedef struct Unit {
 
         /* Booleans indicating membership of this unit in the various queues */
         bool in_load_queue:1;
+        bool load_prefetched:1; /* Whether the unit files were looked up ahead of loading */
         bool in_dbus_queue:1;
         bool in_cleanup_queue:1;
         bool in_gc_queue:1;
@@ -651,7 +608,7 @@ static inline const UnitVTable* UNIT_VTABLE(Unit *u) {
 #define UNIT_HAS_KILL_CONTEXT(u) (UNIT_VTABLE(u)->kill_context_offset > 0)
 
 static inline Unit* UNIT_TRIGGER(Unit *u) {
-        return hashmap_first_key(u->dependencies[UNIT_TRIGGERS]);
+        return unit_dependency_array_first(u->dependencies[UNIT_TRIGGERS]);
 }
 
 Unit *unit_new(Manager *m, size_t size);
@@ -748,8 +705,8 @@ int unit_load_related_unit(Unit *u, const char *type, Unit **_found);
 bool unit_can_serialize(Unit *u) _pure_;
 
 int unit_serialize(Unit *u, FILE *f, FDSet *fds, bool serialize_jobs);
-int unit_deserialize(Unit *u, FILE *f, FDSet *fds);
-int unit_deserialize_skip(FILE *f);
+int unit_deserialize(Unit *u, Deserializer *d, FDSet *fds);
+int unit_deserialize_skip(Deserializer *d);
 
 int unit_add_node_dependency(Unit *u, const char *what, UnitDependency d, UnitDependencyMask mask);
 int unit_add_blockdev_dependency(Unit *u, const char *what, UnitDependencyMask mask);
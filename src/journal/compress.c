@@ -17,6 +17,7 @@
 #endif
 
 #if HAVE_ZSTD
+#include <zdict.h>
 #include <zstd.h>
 #include <zstd_errors.h>
 #endif
@@ -66,6 +67,111 @@ static const char* const object_compressed_table[_OBJECT_COMPRESSED_MAX] = {
 
 DEFINE_STRING_TABLE_LOOKUP(object_compressed, int);
 
+struct CompressDictionary {
+        void *data;
+        size_t size;
+
+#if HAVE_ZSTD
+        /* The decompression dictionary is set up right away, the compression dictionary and context only
+         * when we compress something, since most users only ever read. */
+        ZSTD_DDict *ddict;
+        ZSTD_CDict *cdict;
+        int cdict_level;
+        ZSTD_CCtx *cctx;
+#endif
+};
+
+int compress_dictionary_new(const void *data, size_t size, CompressDictionary **ret) {
+#if HAVE_ZSTD
+        _cleanup_(compress_dictionary_freep) CompressDictionary *d = NULL;
+
+        assert(data);
+        assert(size > 0);
+        assert(ret);
+
+        d = new0(CompressDictionary, 1);
+        if (!d)
+                return -ENOMEM;
+
+        d->data = memdup(data, size);
+        if (!d->data)
+                return -ENOMEM;
+        d->size = size;
+
+        d->ddict = ZSTD_createDDict(d->data, d->size);
+        if (!d->ddict)
+                return -ENOMEM;
+
+        *ret = TAKE_PTR(d);
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+CompressDictionary* compress_dictionary_free(CompressDictionary *d) {
+        if (!d)
+                return NULL;
+
+#if HAVE_ZSTD
+        ZSTD_freeCCtx(d->cctx);
+        ZSTD_freeCDict(d->cdict);
+        ZSTD_freeDDict(d->ddict);
+#endif
+        free(d->data);
+
+        return mfree(d);
+}
+
+int compress_dictionary_train(
+                const void *samples, const size_t *sample_sizes, size_t n_samples,
+                size_t max_size, void **ret, size_t *ret_size) {
+#if HAVE_ZSTD
+        _cleanup_free_ void *buf = NULL;
+        size_t k;
+
+        assert(samples);
+        assert(sample_sizes);
+        assert(max_size > 0);
+        assert(ret);
+        assert(ret_size);
+
+        /* Trains a dictionary from the concatenated samples, sample_sizes contains the size of each. Returns
+         * -ENODATA if there's not enough to learn from. */
+
+        if (n_samples == 0 || n_samples > UINT_MAX)
+                return -ENODATA;
+
+        buf = malloc(max_size);
+        if (!buf)
+                return -ENOMEM;
+
+        k = ZDICT_trainFromBuffer(buf, max_size, samples, sample_sizes, (unsigned) n_samples);
+        if (ZDICT_isError(k)) {
+                log_debug("ZSTD dictionary training failed: %s", ZDICT_getErrorName(k));
+                return -ENODATA;
+        }
+
+        *ret = TAKE_PTR(buf);
+        *ret_size = k;
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+int compress_level_zstd_check(int level) {
+#if HAVE_ZSTD
+        /* 0 selects the library's default level, hence is always accepted */
+        if (level != 0 && (level < ZSTD_minCLevel() || level > ZSTD_maxCLevel()))
+                return -ERANGE;
+
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
 int compress_blob_xz(const void *src, uint64_t src_size,
                      void *dst, size_t dst_alloc_size, size_t *dst_size) {
 #if HAVE_XZ
@@ -134,9 +240,10 @@ int compress_blob_lz4(const void *src, uint64_t src_size,
 #endif
 }
 
-int compress_blob_zstd(
+int compress_blob_zstd_full(
                 const void *src, uint64_t src_size,
-                void *dst, size_t dst_alloc_size, size_t *dst_size) {
+                void *dst, size_t dst_alloc_size, size_t *dst_size,
+                int level, CompressDictionary *dict) {
 #if HAVE_ZSTD
         size_t k;
 
@@ -146,7 +253,25 @@ int compress_blob_zstd(
         assert(dst_alloc_size > 0);
         assert(dst_size);
 
-        k = ZSTD_compress(dst, dst_alloc_size, src, src_size, 0);
+        if (dict) {
+                if (!dict->cdict || dict->cdict_level != level) {
+                        ZSTD_freeCDict(dict->cdict);
+
+                        dict->cdict = ZSTD_createCDict(dict->data, dict->size, level);
+                        if (!dict->cdict)
+                                return -ENOMEM;
+                        dict->cdict_level = level;
+                }
+
+                if (!dict->cctx) {
+                        dict->cctx = ZSTD_createCCtx();
+                        if (!dict->cctx)
+                                return -ENOMEM;
+                }
+
+                k = ZSTD_compress_usingCDict(dict->cctx, dst, dst_alloc_size, src, src_size, dict->cdict);
+        } else
+                k = ZSTD_compress(dst, dst_alloc_size, src, src_size, level);
         if (ZSTD_isError(k))
                 return zstd_ret_to_errno(k);
 
@@ -257,9 +382,10 @@ int decompress_blob_lz4(const void *src, uint64_t src_size,
 #endif
 }
 
-int decompress_blob_zstd(
+int decompress_blob_zstd_full(
                 const void *src, uint64_t src_size,
-                void **dst, size_t *dst_alloc_size, size_t *dst_size, size_t dst_max) {
+                void **dst, size_t *dst_alloc_size, size_t *dst_size, size_t dst_max,
+                CompressDictionary *dict) {
 
 #if HAVE_ZSTD
         uint64_t size;
@@ -287,6 +413,13 @@ int decompress_blob_zstd(
         if (!dctx)
                 return -ENOMEM;
 
+        /* Data written before the file's dictionary was trained was compressed without it */
+        if (dict && ZSTD_getDictID_fromFrame(src, src_size) != 0) {
+                size_t k = ZSTD_DCtx_refDDict(dctx, dict->ddict);
+                if (ZSTD_isError(k))
+                        return zstd_ret_to_errno(k);
+        }
+
         ZSTD_inBuffer input = {
                 .src = src,
                 .size = src_size,
@@ -312,6 +445,7 @@ int decompress_blob_zstd(
 
 int decompress_blob(
                 int compression,
+                CompressDictionary *dict,
                 const void *src, uint64_t src_size,
                 void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
 
@@ -324,9 +458,10 @@ int decompress_blob(
                                 src, src_size,
                                 dst, dst_alloc_size, dst_size, dst_max);
         else if (compression == OBJECT_COMPRESSED_ZSTD)
-                return decompress_blob_zstd(
+                return decompress_blob_zstd_full(
                                 src, src_size,
-                                dst, dst_alloc_size, dst_size, dst_max);
+                                dst, dst_alloc_size, dst_size, dst_max,
+                                dict);
         else
                 return -EPROTONOSUPPORT;
 }
@@ -452,11 +587,12 @@ int decompress_startswith_lz4(const void *src, uint64_t src_size,
 #endif
 }
 
-int decompress_startswith_zstd(
+int decompress_startswith_zstd_full(
                 const void *src, uint64_t src_size,
                 void **buffer, size_t *buffer_size,
                 const void *prefix, size_t prefix_len,
-                uint8_t extra) {
+                uint8_t extra,
+                CompressDictionary *dict) {
 #if HAVE_ZSTD
         assert(src);
         assert(src_size > 0);
@@ -476,6 +612,14 @@ int decompress_startswith_zstd(
         if (!dctx)
                 return -ENOMEM;
 
+        size_t k;
+
+        if (dict && ZSTD_getDictID_fromFrame(src, src_size) != 0) {
+                k = ZSTD_DCtx_refDDict(dctx, dict->ddict);
+                if (ZSTD_isError(k))
+                        return zstd_ret_to_errno(k);
+        }
+
         if (!(greedy_realloc(buffer, buffer_size, MAX(ZSTD_DStreamOutSize(), prefix_len + 1), 1)))
                 return -ENOMEM;
 
@@ -487,7 +631,6 @@ int decompress_startswith_zstd(
                 .dst = *buffer,
                 .size = *buffer_size,
         };
-        size_t k;
 
         k = ZSTD_decompressStream(dctx, &output, &input);
         if (ZSTD_isError(k)) {
@@ -505,6 +648,7 @@ int decompress_startswith_zstd(
 
 int decompress_startswith(
                 int compression,
+                CompressDictionary *dict,
                 const void *src, uint64_t src_size,
                 void **buffer, size_t *buffer_size,
                 const void *prefix, size_t prefix_len,
@@ -524,11 +668,12 @@ int decompress_startswith(
                                 prefix, prefix_len,
                                 extra);
         else if (compression == OBJECT_COMPRESSED_ZSTD)
-                return decompress_startswith_zstd(
+                return decompress_startswith_zstd_full(
                                 src, src_size,
                                 buffer, buffer_size,
                                 prefix, prefix_len,
-                                extra);
+                                extra,
+                                dict);
         else
                 return -EBADMSG;
 }
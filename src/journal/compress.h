@@ -4,22 +4,41 @@
 #include <unistd.h>
 
 #include "journal-def.h"
+#include "macro.h"
 
 const char* object_compressed_to_string(int compression);
 int object_compressed_from_string(const char *compression);
 
+typedef struct CompressDictionary CompressDictionary;
+
+int compress_dictionary_new(const void *data, size_t size, CompressDictionary **ret);
+CompressDictionary* compress_dictionary_free(CompressDictionary *d);
+DEFINE_TRIVIAL_CLEANUP_FUNC(CompressDictionary*, compress_dictionary_free);
+
+int compress_dictionary_train(const void *samples, const size_t *sample_sizes, size_t n_samples,
+                              size_t max_size, void **ret, size_t *ret_size);
+
+int compress_level_zstd_check(int level);
+
 int compress_blob_xz(const void *src, uint64_t src_size,
                      void *dst, size_t dst_alloc_size, size_t *dst_size);
 int compress_blob_lz4(const void *src, uint64_t src_size,
                       void *dst, size_t dst_alloc_size, size_t *dst_size);
-int compress_blob_zstd(const void *src, uint64_t src_size,
-                       void *dst, size_t dst_alloc_size, size_t *dst_size);
+int compress_blob_zstd_full(const void *src, uint64_t src_size,
+                            void *dst, size_t dst_alloc_size, size_t *dst_size,
+                            int level, CompressDictionary *dict);
+static inline int compress_blob_zstd(const void *src, uint64_t src_size,
+                                     void *dst, size_t dst_alloc_size, size_t *dst_size) {
+        return compress_blob_zstd_full(src, src_size, dst, dst_alloc_size, dst_size, 0, NULL);
+}
 
+/* The compression level and dictionary are only used by zstd. A level of 0 selects the default level. */
 static inline int compress_blob(const void *src, uint64_t src_size,
-                                void *dst, size_t dst_alloc_size, size_t *dst_size) {
+                                void *dst, size_t dst_alloc_size, size_t *dst_size,
+                                int level, CompressDictionary *dict) {
         int r;
 #if HAVE_ZSTD
-        r = compress_blob_zstd(src, src_size, dst, dst_alloc_size, dst_size);
+        r = compress_blob_zstd_full(src, src_size, dst, dst_alloc_size, dst_size, level, dict);
         if (r == 0)
                 return OBJECT_COMPRESSED_ZSTD;
 #elif HAVE_LZ4
@@ -40,9 +59,14 @@ int decompress_blob_xz(const void *src, uint64_t src_size,
                        void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max);
 int decompress_blob_lz4(const void *src, uint64_t src_size,
                         void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max);
-int decompress_blob_zstd(const void *src, uint64_t src_size,
-                        void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max);
-int decompress_blob(int compression,
+int decompress_blob_zstd_full(const void *src, uint64_t src_size,
+                              void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max,
+                              CompressDictionary *dict);
+static inline int decompress_blob_zstd(const void *src, uint64_t src_size,
+                                       void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
+        return decompress_blob_zstd_full(src, src_size, dst, dst_alloc_size, dst_size, dst_max, NULL);
+}
+int decompress_blob(int compression, CompressDictionary *dict,
                     const void *src, uint64_t src_size,
                     void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max);
 
@@ -54,11 +78,18 @@ int decompress_startswith_lz4(const void *src, uint64_t src_size,
                               void **buffer, size_t *buffer_size,
                               const void *prefix, size_t prefix_len,
                               uint8_t extra);
-int decompress_startswith_zstd(const void *src, uint64_t src_size,
-                               void **buffer, size_t *buffer_size,
-                               const void *prefix, size_t prefix_len,
-                               uint8_t extra);
-int decompress_startswith(int compression,
+int decompress_startswith_zstd_full(const void *src, uint64_t src_size,
+                                    void **buffer, size_t *buffer_size,
+                                    const void *prefix, size_t prefix_len,
+                                    uint8_t extra,
+                                    CompressDictionary *dict);
+static inline int decompress_startswith_zstd(const void *src, uint64_t src_size,
+                                             void **buffer, size_t *buffer_size,
+                                             const void *prefix, size_t prefix_len,
+                                             uint8_t extra) {
+        return decompress_startswith_zstd_full(src, src_size, buffer, buffer_size, prefix, prefix_len, extra, NULL);
+}
+int decompress_startswith(int compression, CompressDictionary *dict,
                           const void *src, uint64_t src_size,
                           void **buffer, size_t *buffer_size,
                           const void *prefix, size_t prefix_len,
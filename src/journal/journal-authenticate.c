@@ -268,6 +268,21 @@ int journal_file_hmac_put_object(JournalFile *f, ObjectType type, Object *o, uin
                 gcry_md_write(f->hmac, &o->tag.seqnum, sizeof(o->tag.seqnum));
                 gcry_md_write(f->hmac, &o->tag.epoch, sizeof(o->tag.epoch));
                 break;
+
+        case OBJECT_ENTRY_INDEX:
+                /* All */
+                gcry_md_write(f->hmac, &o->entry_index.n_entries, le64toh(o->object.size) - offsetof(EntryIndexObject, n_entries));
+                break;
+
+        case OBJECT_COMPRESSION_DICTIONARY:
+                /* All */
+                gcry_md_write(f->hmac, o->compression_dictionary.payload, le64toh(o->object.size) - offsetof(CompressionDictionaryObject, payload));
+                break;
+
+        case OBJECT_FIELD_VALUES:
+                /* All */
+                gcry_md_write(f->hmac, &o->field_values.field_offset, le64toh(o->object.size) - offsetof(FieldValuesObject, field_offset));
+                break;
         default:
                 return -EINVAL;
         }
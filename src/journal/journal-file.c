@@ -26,6 +26,7 @@
 #include "lookup3.h"
 #include "memory-util.h"
 #include "path-util.h"
+#include "prioq.h"
 #include "random-util.h"
 #include "set.h"
 #include "sort-util.h"
@@ -89,6 +90,120 @@
 #  pragma GCC diagnostic ignored "-Waddress-of-packed-member"
 #endif
 
+/* The data object cache is a small set-associative cache of the data objects most recently appended to or
+ * looked up in a journal file we write to, mapping payload hash to object offset. Each set is managed as
+ * a CLOCK. The payloads are kept in memory, so that a hit can be verified without touching the file, and
+ * so that the fields repeated in every entry (_HOSTNAME=, _BOOT_ID=, _MACHINE_ID=, …) never cause
+ * page-cache traffic. */
+#define DATA_CACHE_SETS 128U
+#define DATA_CACHE_WAYS 4U
+
+/* Larger payloads are rarely repeated and would make the cache expensive to keep in memory */
+#define DATA_CACHE_PAYLOAD_MAX 512U
+
+typedef struct DataCacheItem {
+        uint64_t hash;
+        uint64_t offset;
+        void *data;
+        size_t size;
+        bool referenced;
+} DataCacheItem;
+
+struct DataCache {
+        DataCacheItem items[DATA_CACHE_SETS][DATA_CACHE_WAYS];
+        unsigned hands[DATA_CACHE_SETS];
+};
+
+static DataCache* data_cache_free(DataCache *c) {
+        unsigned i, j;
+
+        if (!c)
+                return NULL;
+
+        for (i = 0; i < DATA_CACHE_SETS; i++)
+                for (j = 0; j < DATA_CACHE_WAYS; j++)
+                        free(c->items[i][j].data);
+
+        return mfree(c);
+}
+
+static bool data_cache_get(JournalFile *f, const void *data, uint64_t size, uint64_t hash, uint64_t *ret_offset) {
+        DataCacheItem *set;
+        unsigned i;
+
+        assert(f);
+        assert(ret_offset);
+
+        if (!f->data_cache || size > DATA_CACHE_PAYLOAD_MAX)
+                return false;
+
+        set = f->data_cache->items[hash % DATA_CACHE_SETS];
+        for (i = 0; i < DATA_CACHE_WAYS; i++)
+                if (set[i].offset > 0 &&
+                    set[i].hash == hash &&
+                    set[i].size == size &&
+                    memcmp_safe(set[i].data, data, size) == 0) {
+
+                        set[i].referenced = true;
+                        f->data_cache_hits++;
+
+                        *ret_offset = set[i].offset;
+                        return true;
+                }
+
+        f->data_cache_misses++;
+        return false;
+}
+
+static void data_cache_put(JournalFile *f, const void *data, uint64_t size, uint64_t hash, uint64_t offset) {
+        DataCacheItem *set, *victim;
+        unsigned *hand;
+        void *copy;
+
+        assert(f);
+        assert(offset > 0);
+
+        if (!f->writable || size > DATA_CACHE_PAYLOAD_MAX)
+                return;
+
+        if (!f->data_cache) {
+                f->data_cache = new0(DataCache, 1);
+                if (!f->data_cache)
+                        return; /* The cache is an optimization only, hence ignore OOM */
+        }
+
+        copy = memdup(data ?: "", size);
+        if (!copy)
+                return;
+
+        set = f->data_cache->items[hash % DATA_CACHE_SETS];
+        hand = f->data_cache->hands + hash % DATA_CACHE_SETS;
+
+        /* Advance the clock hand until we find an item that hasn't been referenced since the hand last
+         * passed it, giving every referenced item a second chance on the way. */
+        for (;;) {
+                victim = set + *hand;
+                *hand = (*hand + 1) % DATA_CACHE_WAYS;
+
+                if (!victim->referenced)
+                        break;
+
+                victim->referenced = false;
+        }
+
+        free(victim->data);
+        *victim = (DataCacheItem) {
+                .hash = hash,
+                .offset = offset,
+                .data = copy,
+                .size = size,
+        };
+}
+
+static int journal_file_append_summaries(JournalFile *f);
+static int journal_file_install_compression_dictionary(JournalFile *f);
+static void journal_file_stop_dictionary_training(JournalFile *f);
+
 /* This may be called from a separate thread to prevent blocking the caller for the duration of fsync().
  * As a result we use atomic operations on f->offline_state for inter-thread communications with
  * journal_file_set_offline() and journal_file_set_online(). */
@@ -115,6 +230,13 @@ static void journal_file_set_offline_internal(JournalFile *f) {
                         break;
 
                 case OFFLINE_SYNCING:
+                        /* Archived files are not written to anymore, hence this is never cancelled or
+                         * restarted, and only done once */
+                        if (f->summaries_pending) {
+                                f->summaries_error = journal_file_append_summaries(f);
+                                f->summaries_pending = false;
+                        }
+
                         (void) fsync(f->fd);
 
                         if (!__sync_bool_compare_and_swap(&f->offline_state, OFFLINE_SYNCING, OFFLINE_OFFLINING))
@@ -122,6 +244,10 @@ static void journal_file_set_offline_internal(JournalFile *f) {
 
                         f->header->state = f->archive ? STATE_ARCHIVED : STATE_OFFLINE;
                         (void) fsync(f->fd);
+
+                        /* Sync the rename done by journal_file_archive() to disk, too */
+                        if (f->archive)
+                                (void) fsync_directory_of_file(f->fd);
                         break;
 
                 case OFFLINE_OFFLINING:
@@ -138,27 +264,207 @@ static void journal_file_set_offline_internal(JournalFile *f) {
         }
 }
 
-static void * journal_file_set_offline_thread(void *arg) {
-        JournalFile *f = arg;
+/* Offlining is carried out by a single persistent worker thread, shared by all journal files of the
+ * process. Files are queued to it in FIFO order, hence a slow disk only delays the fsync()s, but never the
+ * caller, and we don't pay for a thread creation on every sync. The queue is protected by the mutex, and
+ * f->offline_queued is set for as long as the worker holds a reference to the file. Whoever needs to wait
+ * for a file takes it back from the queue if the worker didn't get to it yet, and only waits for the
+ * worker if it is busy with that very file, never for the files queued before it.
+ *
+ * Mostly the fsync()s are done by the worker. Growing the file with posix_fallocate() in
+ * journal_file_allocate() and the header updates done when appending entries stay on the caller's thread,
+ * i.e. on journald's event loop: both change the file's size and mapping, which the caller accesses right
+ * after, hence moving them here would require locking the mmap cache shared by all files. The exception
+ * are archived files, which the caller doesn't access anymore: they are moved to a private mmap cache, and
+ * the worker appends their entry index and field values summary before syncing them.
+ *
+ * Logging isn't thread-safe, hence the worker doesn't log. */
+static struct {
+        pthread_mutex_t mutex;
+        pthread_cond_t queued;
+        pthread_cond_t done;
+        bool running;
+        unsigned n_queued;
+        JournalFile *current;
+        LIST_HEAD(JournalFile, queue);
+} offline_worker = {
+        .mutex = PTHREAD_MUTEX_INITIALIZER,
+        .queued = PTHREAD_COND_INITIALIZER,
+        .done = PTHREAD_COND_INITIALIZER,
+};
 
+static void * journal_file_offline_worker(void *arg) {
         (void) pthread_setname_np(pthread_self(), "journal-offline");
 
-        journal_file_set_offline_internal(f);
+        log_set_thread_quiet(true);
+
+        assert_se(pthread_mutex_lock(&offline_worker.mutex) == 0);
+
+        for (;;) {
+                JournalFile *f;
+
+                while (!offline_worker.queue)
+                        assert_se(pthread_cond_wait(&offline_worker.queued, &offline_worker.mutex) == 0);
+
+                f = offline_worker.queue;
+                LIST_REMOVE(offline_queue, offline_worker.queue, f);
+                offline_worker.current = f;
+
+                assert_se(pthread_mutex_unlock(&offline_worker.mutex) == 0);
+
+                journal_file_set_offline_internal(f);
+
+                assert_se(pthread_mutex_lock(&offline_worker.mutex) == 0);
+
+                assert(offline_worker.n_queued > 0);
+                offline_worker.n_queued--;
+                offline_worker.current = NULL;
+                f->offline_queued = false;
+
+                assert_se(pthread_cond_broadcast(&offline_worker.done) == 0);
+        }
 
         return NULL;
 }
 
-static int journal_file_set_offline_thread_join(JournalFile *f) {
+static int journal_file_offline_worker_start(void) {
+        sigset_t ss, saved_ss;
+        pthread_attr_t attr;
+        pthread_t t;
+        int r, k;
+
+        /* Must be called with the mutex held */
+
+        if (offline_worker.running)
+                return 0;
+
+        r = pthread_attr_init(&attr);
+        if (r > 0)
+                return -r;
+
+        r = pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (r > 0)
+                goto finish;
+
+        assert_se(sigfillset(&ss) >= 0);
+        /* Don't block SIGBUS since the offlining thread accesses a memory mapped file.
+         * Asynchronous SIGBUS signals can safely be handled by either thread. */
+        assert_se(sigdelset(&ss, SIGBUS) >= 0);
+
+        r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+        if (r > 0)
+                goto finish;
+
+        r = pthread_create(&t, &attr, journal_file_offline_worker, NULL);
+
+        k = pthread_sigmask(SIG_SETMASK, &saved_ss, NULL);
+        if (r == 0 && k > 0)
+                r = k;
+        if (r == 0)
+                offline_worker.running = true;
+
+finish:
+        (void) pthread_attr_destroy(&attr);
+        return -r;
+}
+
+static int journal_file_offline_worker_enqueue(JournalFile *f) {
+        int r;
+
+        assert(f);
+        assert(!f->offline_queued);
+
+        assert_se(pthread_mutex_lock(&offline_worker.mutex) == 0);
+
+        r = journal_file_offline_worker_start();
+        if (r >= 0) {
+                LIST_APPEND(offline_queue, offline_worker.queue, f);
+                f->offline_queued = true;
+                offline_worker.n_queued++;
+
+                assert_se(pthread_cond_signal(&offline_worker.queued) == 0);
+        }
+
+        assert_se(pthread_mutex_unlock(&offline_worker.mutex) == 0);
+
+        return r;
+}
+
+unsigned journal_file_offline_queue_depth(void) {
+        unsigned n;
+
+        assert_se(pthread_mutex_lock(&offline_worker.mutex) == 0);
+        n = offline_worker.n_queued;
+        assert_se(pthread_mutex_unlock(&offline_worker.mutex) == 0);
+
+        return n;
+}
+
+static int journal_file_use_private_mmap_cache(JournalFile *f) {
+        MMapFileDescriptor *fd;
+        MMapCache *m;
+        void *h;
         int r;
 
         assert(f);
 
+        m = mmap_cache_new();
+        if (!m)
+                return -ENOMEM;
+
+        fd = mmap_cache_add_fd(m, f->fd);
+        if (!fd) {
+                mmap_cache_unref(m);
+                return -ENOMEM;
+        }
+
+        r = mmap_cache_get(m, fd, f->prot, CONTEXT_HEADER, true, 0, PAGE_ALIGN(sizeof(Header)), &f->last_stat, &h, NULL);
+        if (r < 0) {
+                mmap_cache_free_fd(m, fd);
+                mmap_cache_unref(m);
+                return r;
+        }
+
+        /* This unmaps everything we had mapped of the file so far, including the hash tables */
+        mmap_cache_free_fd(f->mmap, f->cache_fd);
+        mmap_cache_unref(f->mmap);
+
+        f->mmap = m;
+        f->cache_fd = fd;
+        f->header = h;
+        f->data_hash_table = f->field_hash_table = NULL;
+
+        return 0;
+}
+
+static int journal_file_set_offline_thread_join(JournalFile *f) {
+        bool dequeued = false;
+
+        assert(f);
+
         if (f->offline_state == OFFLINE_JOINED)
                 return 0;
 
-        r = pthread_join(f->offline_thread, NULL);
-        if (r)
-                return -r;
+        assert_se(pthread_mutex_lock(&offline_worker.mutex) == 0);
+
+        if (f->offline_queued && offline_worker.current != f) {
+                /* Still waiting in the queue, possibly behind other files on slow disks. Rather than
+                 * waiting for the worker to get to it, take it back and finish it ourselves. */
+                LIST_REMOVE(offline_queue, offline_worker.queue, f);
+                assert(offline_worker.n_queued > 0);
+                offline_worker.n_queued--;
+                f->offline_queued = false;
+                dequeued = true;
+        }
+
+        /* Otherwise the worker is busy with this very file, wait for it to finish */
+        while (f->offline_queued)
+                assert_se(pthread_cond_wait(&offline_worker.done, &offline_worker.mutex) == 0);
+
+        assert_se(pthread_mutex_unlock(&offline_worker.mutex) == 0);
+
+        if (dequeued)
+                journal_file_set_offline_internal(f);
 
         f->offline_state = OFFLINE_JOINED;
 
@@ -199,7 +505,7 @@ static bool journal_file_set_offline_try_restart(JournalFile *f) {
 
 /* Sets a journal offline.
  *
- * If wait is false then an offline is dispatched in a separate thread for a
+ * If wait is false then an offline is queued to the offline worker thread for a
  * subsequent journal_file_set_offline() or journal_file_set_online() of the
  * same journal to synchronize with.
  *
@@ -241,27 +547,18 @@ int journal_file_set_offline(JournalFile *f, bool wait) {
         if (wait) /* Without using a thread if waiting. */
                 journal_file_set_offline_internal(f);
         else {
-                sigset_t ss, saved_ss;
-                int k;
-
-                assert_se(sigfillset(&ss) >= 0);
-                /* Don't block SIGBUS since the offlining thread accesses a memory mapped file.
-                 * Asynchronous SIGBUS signals can safely be handled by either thread. */
-                assert_se(sigdelset(&ss, SIGBUS) >= 0);
-
-                r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
-                if (r > 0)
-                        return -r;
-
-                r = pthread_create(&f->offline_thread, NULL, journal_file_set_offline_thread, f);
+                /* Appending the summaries of an archived file accesses the mmap cache, which is shared with
+                 * the caller's other files. If we can't get a private one, append them right-away. */
+                if (f->summaries_pending && journal_file_use_private_mmap_cache(f) < 0) {
+                        f->summaries_error = journal_file_append_summaries(f);
+                        f->summaries_pending = false;
+                }
 
-                k = pthread_sigmask(SIG_SETMASK, &saved_ss, NULL);
-                if (r > 0) {
+                r = journal_file_offline_worker_enqueue(f);
+                if (r < 0) {
                         f->offline_state = OFFLINE_JOINED;
-                        return -r;
+                        return r;
                 }
-                if (k > 0)
-                        return -k;
         }
 
         return 0;
@@ -369,6 +666,14 @@ JournalFile* journal_file_close(JournalFile *f) {
 
         journal_file_set_offline(f, true);
 
+        if (f->summaries_error < 0)
+                log_debug_errno(f->summaries_error, "Failed to write entry index or field values summary to %s, ignoring: %m", f->path);
+
+        /* The counters only mean something for the process that wrote the file */
+        if (f->writable && f->data_cache_hits + f->data_cache_misses > 0)
+                log_debug("Data object cache of %s: %"PRIu64" hits, %"PRIu64" misses",
+                          f->path, f->data_cache_hits, f->data_cache_misses);
+
         if (f->mmap && f->cache_fd)
                 mmap_cache_free_fd(f->mmap, f->cache_fd);
 
@@ -391,10 +696,13 @@ JournalFile* journal_file_close(JournalFile *f) {
         mmap_cache_unref(f->mmap);
 
         ordered_hashmap_free_free(f->chain_cache);
+        data_cache_free(f->data_cache);
 
 #if HAVE_COMPRESSION
         free(f->compress_buffer);
 #endif
+        journal_file_stop_dictionary_training(f);
+        compress_dictionary_free(f->compress_dictionary);
 
 #if HAVE_GCRYPT
         if (f->fss_file)
@@ -492,13 +800,17 @@ static bool warn_wrong_flags(const JournalFile *f, bool compatible) {
                                   f->path, type, flags & ~any);
                 flags = (flags & any) & ~supported;
                 if (flags) {
-                        const char* strv[5];
+                        const char* strv[6];
                         unsigned n = 0;
                         _cleanup_free_ char *t = NULL;
 
                         if (compatible) {
                                 if (flags & HEADER_COMPATIBLE_SEALED)
                                         strv[n++] = "sealed";
+                                if (flags & HEADER_COMPATIBLE_ENTRY_INDEX)
+                                        strv[n++] = "entry-index";
+                                if (flags & HEADER_COMPATIBLE_FIELD_VALUES)
+                                        strv[n++] = "field-values";
                         } else {
                                 if (flags & HEADER_INCOMPATIBLE_COMPRESSED_XZ)
                                         strv[n++] = "xz-compressed";
@@ -506,6 +818,8 @@ static bool warn_wrong_flags(const JournalFile *f, bool compatible) {
                                         strv[n++] = "lz4-compressed";
                                 if (flags & HEADER_INCOMPATIBLE_COMPRESSED_ZSTD)
                                         strv[n++] = "zstd-compressed";
+                                if (flags & HEADER_INCOMPATIBLE_ZSTD_DICTIONARY)
+                                        strv[n++] = "zstd-dictionary";
                                 if (flags & HEADER_INCOMPATIBLE_KEYED_HASH)
                                         strv[n++] = "keyed-hash";
                         }
@@ -701,7 +1015,8 @@ static int journal_file_allocate(JournalFile *f, uint64_t offset, uint64_t size)
 
         /* Note that the glibc fallocate() fallback is very
            inefficient, hence we try to minimize the allocation area
-           as we can. */
+           as we can. This is done synchronously, see the comment
+           about the offline worker above. */
         r = posix_fallocate(f->fd, old_size, new_size - old_size);
         if (r != 0)
                 return -r;
@@ -764,6 +1079,9 @@ static uint64_t minimum_header_size(Object *o) {
                 [OBJECT_FIELD_HASH_TABLE] = sizeof(HashTableObject),
                 [OBJECT_ENTRY_ARRAY] = sizeof(EntryArrayObject),
                 [OBJECT_TAG] = sizeof(TagObject),
+                [OBJECT_ENTRY_INDEX] = sizeof(EntryIndexObject),
+                [OBJECT_COMPRESSION_DICTIONARY] = sizeof(CompressionDictionaryObject),
+                [OBJECT_FIELD_VALUES] = sizeof(FieldValuesObject),
         };
 
         if (o->object.type >= ELEMENTSOF(table) || table[o->object.type] <= 0)
@@ -915,6 +1233,53 @@ static int journal_file_check_object(JournalFile *f, uint64_t offset, Object *o)
                                                le64toh(o->tag.epoch), offset);
 
                 break;
+
+        case OBJECT_ENTRY_INDEX: {
+                uint64_t sz;
+
+                sz = le64toh(READ_NOW(o->object.size));
+                if (sz < offsetof(EntryIndexObject, items) ||
+                    (sz - offsetof(EntryIndexObject, items)) % sizeof(EntryIndexItem) != 0 ||
+                    (sz - offsetof(EntryIndexObject, items)) / sizeof(EntryIndexItem) <= 0)
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid object entry index size: %" PRIu64 ": %" PRIu64,
+                                               sz,
+                                               offset);
+
+                break;
+        }
+
+        case OBJECT_COMPRESSION_DICTIONARY:
+                if (le64toh(o->object.size) <= offsetof(CompressionDictionaryObject, payload))
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Bad object size (<= %zu): %" PRIu64 ": %" PRIu64,
+                                               offsetof(CompressionDictionaryObject, payload),
+                                               le64toh(o->object.size),
+                                               offset);
+                break;
+
+        case OBJECT_FIELD_VALUES: {
+                uint64_t sz, n;
+
+                sz = le64toh(READ_NOW(o->object.size));
+                n = le64toh(o->field_values.n_items);
+                if (n <= 0 ||
+                    n > (sz - offsetof(FieldValuesObject, items)) / sizeof(FieldValuesItem))
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid object field values size: %" PRIu64 ": %" PRIu64,
+                                               sz,
+                                               offset);
+
+                if (!VALID64(le64toh(o->field_values.field_offset)) ||
+                    !VALID64(le64toh(o->field_values.next_field_values_offset)))
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid offset, field_offset="OFSfmt", next_field_values_offset="OFSfmt": %" PRIu64,
+                                               le64toh(o->field_values.field_offset),
+                                               le64toh(o->field_values.next_field_values_offset),
+                                               offset);
+
+                break;
+        }
         }
 
         return 0;
@@ -1084,7 +1449,7 @@ int journal_file_append_object(
         return 0;
 }
 
-static int journal_file_setup_data_hash_table(JournalFile *f) {
+static int journal_file_setup_data_hash_table(JournalFile *f, uint64_t n_data) {
         uint64_t s, p;
         Object *o;
         int r;
@@ -1092,14 +1457,20 @@ static int journal_file_setup_data_hash_table(JournalFile *f) {
         assert(f);
         assert(f->header);
 
-        /* We estimate that we need 1 hash table entry per 768 bytes
-           of journal file and we want to make sure we never get
-           beyond 75% fill level. Calculate the hash table size for
-           the maximum file size based on these metrics. */
-
-        s = (f->metrics.max_size * 4 / 768 / 3) * sizeof(HashItem);
-        if (s < DEFAULT_DATA_HASH_TABLE_SIZE)
-                s = DEFAULT_DATA_HASH_TABLE_SIZE;
+        if (n_data > 0)
+                /* The number of data objects is known in advance, hence size the table to exactly stay
+                 * at a 75% fill level. */
+                s = (n_data * 4 / 3 + 1) * sizeof(HashItem);
+        else {
+                /* We estimate that we need 1 hash table entry per 768 bytes
+                   of journal file and we want to make sure we never get
+                   beyond 75% fill level. Calculate the hash table size for
+                   the maximum file size based on these metrics. */
+
+                s = (f->metrics.max_size * 4 / 768 / 3) * sizeof(HashItem);
+                if (s < DEFAULT_DATA_HASH_TABLE_SIZE)
+                        s = DEFAULT_DATA_HASH_TABLE_SIZE;
+        }
 
         log_debug("Reserving %"PRIu64" entries in data hash table.", s / sizeof(HashItem));
 
@@ -1118,7 +1489,7 @@ static int journal_file_setup_data_hash_table(JournalFile *f) {
         return 0;
 }
 
-static int journal_file_setup_field_hash_table(JournalFile *f) {
+static int journal_file_setup_field_hash_table(JournalFile *f, uint64_t n_fields) {
         uint64_t s, p;
         Object *o;
         int r;
@@ -1127,9 +1498,13 @@ static int journal_file_setup_field_hash_table(JournalFile *f) {
         assert(f->header);
 
         /* We use a fixed size hash table for the fields as this
-         * number should grow very slowly only */
+         * number should grow very slowly only, unless we know the
+         * number of fields in advance */
 
-        s = DEFAULT_FIELD_HASH_TABLE_SIZE;
+        if (n_fields > 0)
+                s = (n_fields * 4 / 3 + 1) * sizeof(HashItem);
+        else
+                s = DEFAULT_FIELD_HASH_TABLE_SIZE;
         log_debug("Reserving %"PRIu64" entries in field hash table.", s / sizeof(HashItem));
 
         r = journal_file_append_object(f,
@@ -1414,6 +1789,144 @@ int journal_file_find_field_object(
                         ret, ret_offset);
 }
 
+static int field_value_compare(const void *a, size_t a_size, const void *b, size_t b_size) {
+        int r;
+
+        r = memcmp_safe(a, b, MIN(a_size, b_size));
+        if (r != 0)
+                return r;
+
+        return CMP(a_size, b_size);
+}
+
+int journal_file_find_field_values(
+                JournalFile *f,
+                const void *field, uint64_t size,
+                Object **ret, uint64_t *ret_offset) {
+
+        uint64_t p, q, n, i;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+        assert(field && size > 0);
+
+        /* Looks for the summary of the values of a field written by journal_file_append_field_values().
+         * Returns 0 if there is none, in which case the values need to be enumerated by following the
+         * chain of data objects of the field. */
+
+        if (!JOURNAL_HEADER_FIELD_VALUES(f->header) ||
+            !JOURNAL_HEADER_CONTAINS(f->header, field_values_offset))
+                return 0;
+
+        q = le64toh(READ_NOW(f->header->field_values_offset));
+        if (q == 0)
+                return 0;
+
+        r = journal_file_find_field_object(f, field, size, NULL, &p);
+        if (r <= 0)
+                return r;
+
+        /* Enumerating the values of a field requires looking up the same summary again and again, hence
+         * remember the last one */
+        if (f->field_values_field_offset != p) {
+                n = le64toh(f->header->n_fields);
+
+                for (i = 0; q > 0; i++) {
+                        if (i >= n)
+                                return -EBADMSG;
+
+                        r = journal_file_move_to_object(f, OBJECT_FIELD_VALUES, q, &o);
+                        if (r < 0)
+                                return r;
+
+                        if (le64toh(o->field_values.field_offset) == p)
+                                break;
+
+                        q = le64toh(o->field_values.next_field_values_offset);
+                }
+
+                f->field_values_field_offset = p;
+                f->field_values_offset = q;
+        }
+
+        if (f->field_values_offset == 0)
+                return 0;
+
+        if (ret) {
+                r = journal_file_move_to_object(f, OBJECT_FIELD_VALUES, f->field_values_offset, ret);
+                if (r < 0)
+                        return r;
+        }
+
+        if (ret_offset)
+                *ret_offset = f->field_values_offset;
+
+        return 1;
+}
+
+int journal_file_field_values_get(Object *o, uint64_t i, const void **ret_data, size_t *ret_size) {
+        uint64_t sz, n, offset, size;
+
+        assert(o);
+        assert(o->object.type == OBJECT_FIELD_VALUES);
+        assert(ret_data);
+        assert(ret_size);
+
+        n = le64toh(o->field_values.n_items);
+        if (i >= n)
+                return -ERANGE;
+
+        sz = le64toh(READ_NOW(o->object.size));
+        offset = le64toh(o->field_values.items[i].offset);
+        size = le64toh(o->field_values.items[i].size);
+
+        if (offset < offsetof(FieldValuesObject, items) + n * sizeof(FieldValuesItem) ||
+            offset > sz ||
+            size > sz - offset)
+                return -EBADMSG;
+
+        /* We can't read objects larger than 4G on a 32bit machine */
+        if ((uint64_t) (size_t) size != size)
+                return -E2BIG;
+
+        *ret_data = (const uint8_t*) o + offset;
+        *ret_size = (size_t) size;
+        return 0;
+}
+
+int journal_file_field_values_contains(Object *o, const void *data, size_t size) {
+        uint64_t a = 0, b;
+        int r;
+
+        assert(o);
+        assert(o->object.type == OBJECT_FIELD_VALUES);
+        assert(data || size == 0);
+
+        /* The values are sorted, hence bisect */
+        b = le64toh(o->field_values.n_items);
+        while (a < b) {
+                uint64_t m = a + (b - a) / 2;
+                const void *v;
+                size_t l;
+
+                r = journal_file_field_values_get(o, m, &v, &l);
+                if (r < 0)
+                        return r;
+
+                r = field_value_compare(data, size, v, l);
+                if (r == 0)
+                        return 1;
+                if (r < 0)
+                        b = m;
+                else
+                        a = m + 1;
+        }
+
+        return 0;
+}
+
 int journal_file_find_data_object_with_hash(
                 JournalFile *f,
                 const void *data, uint64_t size, uint64_t hash,
@@ -1466,6 +1979,7 @@ int journal_file_find_data_object_with_hash(
                         l -= offsetof(Object, data.payload);
 
                         r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK,
+                                            journal_file_compress_dictionary(f),
                                             o->data.payload, l, &f->compress_buffer, &f->compress_buffer_size, &rsize, 0);
                         if (r < 0)
                                 return r;
@@ -1590,9 +2104,10 @@ static int journal_file_append_field(
 static int journal_file_append_data(
                 JournalFile *f,
                 const void *data, uint64_t size,
+                uint64_t hash,
                 Object **ret, uint64_t *ret_offset) {
 
-        uint64_t hash, p;
+        uint64_t p;
         uint64_t osize;
         Object *o;
         int r, compression = 0;
@@ -1601,12 +2116,25 @@ static int journal_file_append_data(
         assert(f);
         assert(data || size == 0);
 
-        hash = journal_file_hash_data(f, data, size);
+        if (data_cache_get(f, data, size, hash, &p)) {
+
+                if (ret) {
+                        r = journal_file_move_to_object(f, OBJECT_DATA, p, ret);
+                        if (r < 0)
+                                return r;
+                }
+
+                if (ret_offset)
+                        *ret_offset = p;
+
+                return 0;
+        }
 
         r = journal_file_find_data_object_with_hash(f, data, size, hash, &o, &p);
         if (r < 0)
                 return r;
         if (r > 0) {
+                data_cache_put(f, data, size, hash, p);
 
                 if (ret)
                         *ret = o;
@@ -1617,6 +2145,13 @@ static int journal_file_append_data(
                 return 0;
         }
 
+        if (f->dictionary_training) {
+                /* The dictionary is just an optimization, hence don't fail on errors */
+                r = journal_file_install_compression_dictionary(f);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to set up compression dictionary for %s, ignoring: %m", f->path);
+        }
+
         osize = offsetof(Object, data.payload) + size;
         r = journal_file_append_object(f, OBJECT_DATA, osize, &o, &p);
         if (r < 0)
@@ -1628,7 +2163,8 @@ static int journal_file_append_data(
         if (JOURNAL_FILE_COMPRESS(f) && size >= f->compress_threshold_bytes) {
                 size_t rsize = 0;
 
-                compression = compress_blob(data, size, o->data.payload, size - 1, &rsize);
+                compression = compress_blob(data, size, o->data.payload, size - 1, &rsize,
+                                            f->compress_level, f->compress_dictionary);
 
                 if (compression >= 0) {
                         o->object.size = htole64(offsetof(Object, data.payload) + rsize);
@@ -1679,6 +2215,8 @@ static int journal_file_append_data(
                 fo->field.head_data_offset = le64toh(p);
         }
 
+        data_cache_put(f, data, size, hash, p);
+
         if (ret)
                 *ret = o;
 
@@ -1688,6 +2226,58 @@ static int journal_file_append_data(
         return 0;
 }
 
+static int journal_file_data_payload(
+                JournalFile *f,
+                Object *o,
+                const void **ret_data,
+                uint64_t *ret_size) {
+
+        uint64_t l;
+        size_t t;
+
+        assert(f);
+        assert(o);
+        assert(ret_data);
+        assert(ret_size);
+
+        /* Returns the uncompressed payload of a data object. If it needs decompression, the returned pointer
+         * refers to the file's compression buffer, and is only valid until the next call. */
+
+        l = le64toh(READ_NOW(o->object.size));
+        if (l < offsetof(Object, data.payload))
+                return -EBADMSG;
+
+        l -= offsetof(Object, data.payload);
+        t = (size_t) l;
+
+        /* We hit the limit on 32bit machines */
+        if ((uint64_t) t != l)
+                return -E2BIG;
+
+        if (o->object.flags & OBJECT_COMPRESSION_MASK) {
+#if HAVE_COMPRESSION
+                size_t rsize = 0;
+                int r;
+
+                r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK,
+                                    journal_file_compress_dictionary(f),
+                                    o->data.payload, l, &f->compress_buffer, &f->compress_buffer_size, &rsize, 0);
+                if (r < 0)
+                        return r;
+
+                *ret_data = f->compress_buffer;
+                *ret_size = rsize;
+#else
+                return -EPROTONOSUPPORT;
+#endif
+        } else {
+                *ret_data = o->data.payload;
+                *ret_size = l;
+        }
+
+        return 0;
+}
+
 uint64_t journal_file_entry_n_items(Object *o) {
         uint64_t sz;
         assert(o);
@@ -1717,6 +2307,21 @@ uint64_t journal_file_entry_array_n_items(Object *o) {
         return (sz - offsetof(Object, entry_array.items)) / sizeof(uint64_t);
 }
 
+uint64_t journal_file_entry_index_n_items(Object *o) {
+        uint64_t sz;
+
+        assert(o);
+
+        if (o->object.type != OBJECT_ENTRY_INDEX)
+                return 0;
+
+        sz = le64toh(READ_NOW(o->object.size));
+        if (sz < offsetof(Object, entry_index.items))
+                return 0;
+
+        return (sz - offsetof(Object, entry_index.items)) / sizeof(EntryIndexItem);
+}
+
 uint64_t journal_file_hash_table_n_items(Object *o) {
         uint64_t sz;
 
@@ -1732,19 +2337,26 @@ uint64_t journal_file_hash_table_n_items(Object *o) {
         return (sz - offsetof(Object, hash_table.items)) / sizeof(HashItem);
 }
 
-static int link_entry_into_array(JournalFile *f,
-                                 le64_t *first,
-                                 le64_t *idx,
-                                 uint64_t p) {
+static int link_entries_into_array(JournalFile *f,
+                                   le64_t *first,
+                                   le64_t *idx,
+                                   const uint64_t p[],
+                                   size_t n_p) {
         int r;
         uint64_t n = 0, ap = 0, q, i, a, hidx;
+        size_t k = 0;
         Object *o;
 
         assert(f);
         assert(f->header);
         assert(first);
         assert(idx);
-        assert(p > 0);
+        assert(p);
+        assert(n_p > 0);
+
+        /* Appends the n_p entry offsets in p to the entry array chain starting at *first, walking the chain
+         * only once. When linking a batch of entries this amortizes both the chain walk and the array
+         * growth over all of them. */
 
         a = le64toh(*first);
         i = hidx = le64toh(READ_NOW(*idx));
@@ -1755,9 +2367,11 @@ static int link_entry_into_array(JournalFile *f,
                         return r;
 
                 n = journal_file_entry_array_n_items(o);
-                if (i < n) {
-                        o->entry_array.items[i] = htole64(p);
-                        *idx = htole64(hidx + 1);
+                while (i < n && k < n_p)
+                        o->entry_array.items[i++] = htole64(p[k++]);
+
+                if (k >= n_p) {
+                        *idx = htole64(hidx + k);
                         return 0;
                 }
 
@@ -1766,79 +2380,121 @@ static int link_entry_into_array(JournalFile *f,
                 a = le64toh(o->entry_array.next_entry_array_offset);
         }
 
-        if (hidx > n)
-                n = (hidx+1) * 2;
-        else
-                n = n * 2;
+        while (k < n_p) {
+                size_t j = k;
 
-        if (n < 4)
-                n = 4;
+                if (hidx + k > n)
+                        n = (hidx + k + 1) * 2;
+                else
+                        n = n * 2;
 
-        r = journal_file_append_object(f, OBJECT_ENTRY_ARRAY,
-                                       offsetof(Object, entry_array.items) + n * sizeof(uint64_t),
-                                       &o, &q);
-        if (r < 0)
-                return r;
+                if (n < 4)
+                        n = 4;
+
+                /* Make sure the rest of the batch fits into this array, so that it stays contiguous */
+                n = MAX(n, (uint64_t) (n_p - k));
+
+                r = journal_file_append_object(f, OBJECT_ENTRY_ARRAY,
+                                               offsetof(Object, entry_array.items) + n * sizeof(uint64_t),
+                                               &o, &q);
+                if (r < 0)
+                        goto finish;
 
 #if HAVE_GCRYPT
-        r = journal_file_hmac_put_object(f, OBJECT_ENTRY_ARRAY, o, q);
-        if (r < 0)
-                return r;
+                r = journal_file_hmac_put_object(f, OBJECT_ENTRY_ARRAY, o, q);
+                if (r < 0)
+                        goto finish;
 #endif
 
-        o->entry_array.items[i] = htole64(p);
+                while (i < n && j < n_p)
+                        o->entry_array.items[i++] = htole64(p[j++]);
 
-        if (ap == 0)
-                *first = htole64(q);
-        else {
-                r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY, ap, &o);
-                if (r < 0)
-                        return r;
+                if (ap == 0)
+                        *first = htole64(q);
+                else {
+                        r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY, ap, &o);
+                        if (r < 0)
+                                goto finish;
 
-                o->entry_array.next_entry_array_offset = htole64(q);
+                        o->entry_array.next_entry_array_offset = htole64(q);
+                }
+
+                if (JOURNAL_HEADER_CONTAINS(f->header, n_entry_arrays))
+                        f->header->n_entry_arrays = htole64(le64toh(f->header->n_entry_arrays) + 1);
+
+                ap = q;
+                i = 0;
+                k = j;
         }
 
-        if (JOURNAL_HEADER_CONTAINS(f->header, n_entry_arrays))
-                f->header->n_entry_arrays = htole64(le64toh(f->header->n_entry_arrays) + 1);
+        r = 0;
 
-        *idx = htole64(hidx + 1);
+finish:
+        /* Whatever made it into a linked array so far is accounted for, even on failure */
+        if (k > 0)
+                *idx = htole64(hidx + k);
 
-        return 0;
+        return r;
 }
 
-static int link_entry_into_array_plus_one(JournalFile *f,
-                                          le64_t *extra,
-                                          le64_t *first,
-                                          le64_t *idx,
-                                          uint64_t p) {
+static int link_entry_into_array(JournalFile *f,
+                                 le64_t *first,
+                                 le64_t *idx,
+                                 uint64_t p) {
+
+        assert(p > 0);
+
+        return link_entries_into_array(f, first, idx, &p, 1);
+}
+
+static int link_entries_into_array_plus_one(JournalFile *f,
+                                            le64_t *extra,
+                                            le64_t *first,
+                                            le64_t *idx,
+                                            const uint64_t p[],
+                                            size_t n_p) {
 
         uint64_t hidx;
+        size_t k = 0;
         int r;
 
         assert(f);
         assert(extra);
         assert(first);
         assert(idx);
-        assert(p > 0);
+        assert(p);
+        assert(n_p > 0);
 
         hidx = le64toh(READ_NOW(*idx));
-        if (hidx == UINT64_MAX)
+        if (hidx > UINT64_MAX - n_p)
                 return -EBADMSG;
         if (hidx == 0)
-                *extra = htole64(p);
-        else {
+                *extra = htole64(p[k++]);
+
+        if (k < n_p) {
                 le64_t i;
 
-                i = htole64(hidx - 1);
-                r = link_entry_into_array(f, first, &i, p);
+                i = htole64(hidx + k - 1);
+                r = link_entries_into_array(f, first, &i, p + k, n_p - k);
                 if (r < 0)
                         return r;
         }
 
-        *idx = htole64(hidx + 1);
+        *idx = htole64(hidx + n_p);
         return 0;
 }
 
+static int link_entry_into_array_plus_one(JournalFile *f,
+                                          le64_t *extra,
+                                          le64_t *first,
+                                          le64_t *idx,
+                                          uint64_t p) {
+
+        assert(p > 0);
+
+        return link_entries_into_array_plus_one(f, extra, first, idx, &p, 1);
+}
+
 static int journal_file_link_entry_item(JournalFile *f, Object *o, uint64_t offset, uint64_t i) {
         uint64_t p;
         int r;
@@ -1900,7 +2556,7 @@ static int journal_file_link_entry(JournalFile *f, Object *o, uint64_t offset) {
         return 0;
 }
 
-static int journal_file_append_entry_internal(
+static int journal_file_append_entry_object(
                 JournalFile *f,
                 const dual_timestamp *ts,
                 const sd_id128_t *boot_id,
@@ -1939,6 +2595,31 @@ static int journal_file_append_entry_internal(
                 return r;
 #endif
 
+        if (ret)
+                *ret = o;
+
+        if (ret_offset)
+                *ret_offset = np;
+
+        return 0;
+}
+
+static int journal_file_append_entry_internal(
+                JournalFile *f,
+                const dual_timestamp *ts,
+                const sd_id128_t *boot_id,
+                uint64_t xor_hash,
+                const EntryItem items[], unsigned n_items,
+                uint64_t *seqnum,
+                Object **ret, uint64_t *ret_offset) {
+        uint64_t np;
+        Object *o;
+        int r;
+
+        r = journal_file_append_entry_object(f, ts, boot_id, xor_hash, items, n_items, seqnum, &o, &np);
+        if (r < 0)
+                return r;
+
         r = journal_file_link_entry(f, o, np);
         if (r < 0)
                 return r;
@@ -2087,10 +2768,11 @@ int journal_file_append_entry(
         items = newa(EntryItem, MAX(1u, n_iovec));
 
         for (i = 0; i < n_iovec; i++) {
-                uint64_t p;
-                Object *o;
+                uint64_t p, h;
 
-                r = journal_file_append_data(f, iovec[i].iov_base, iovec[i].iov_len, &o, &p);
+                h = journal_file_hash_data(f, iovec[i].iov_base, iovec[i].iov_len);
+
+                r = journal_file_append_data(f, iovec[i].iov_base, iovec[i].iov_len, h, NULL, &p);
                 if (r < 0)
                         return r;
 
@@ -2106,10 +2788,10 @@ int journal_file_append_entry(
                 if (JOURNAL_HEADER_KEYED_HASH(f->header))
                         xor_hash ^= jenkins_hash64(iovec[i].iov_base, iovec[i].iov_len);
                 else
-                        xor_hash ^= le64toh(o->data.hash);
+                        xor_hash ^= h;
 
                 items[i].object_offset = htole64(p);
-                items[i].hash = o->data.hash;
+                items[i].hash = htole64(h);
         }
 
         /* Order by the position on disk, in order to improve seek
@@ -2134,6 +2816,228 @@ int journal_file_append_entry(
         return r;
 }
 
+typedef struct EntryDataLink {
+        uint64_t data_offset;
+        uint64_t entry_offset;
+} EntryDataLink;
+
+static int entry_data_link_cmp(const EntryDataLink *a, const EntryDataLink *b) {
+        int r;
+
+        r = CMP(a->data_offset, b->data_offset);
+        if (r != 0)
+                return r;
+
+        return CMP(a->entry_offset, b->entry_offset);
+}
+
+static int journal_file_append_batch_entry(
+                JournalFile *f,
+                const JournalBatchEntry *e,
+                EntryItem items[],
+                uint64_t *seqnum,
+                uint64_t *ret_offset) {
+
+        uint64_t xor_hash = 0;
+        unsigned i;
+        int r;
+
+        assert(f);
+        assert(e);
+        assert(e->iovec || e->n_iovec == 0);
+        assert(items);
+
+        if (!VALID_REALTIME(e->ts.realtime))
+                return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                       "Invalid realtime timestamp %" PRIu64 ", refusing entry.",
+                                       e->ts.realtime);
+        if (!VALID_MONOTONIC(e->ts.monotonic))
+                return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                       "Invalid monotomic timestamp %" PRIu64 ", refusing entry.",
+                                       e->ts.monotonic);
+
+#if HAVE_GCRYPT
+        r = journal_file_maybe_append_tag(f, e->ts.realtime);
+        if (r < 0)
+                return r;
+#endif
+
+        for (i = 0; i < e->n_iovec; i++) {
+                uint64_t h, p;
+
+                h = journal_file_hash_data(f, e->iovec[i].iov_base, e->iovec[i].iov_len);
+
+                r = journal_file_append_data(f, e->iovec[i].iov_base, e->iovec[i].iov_len, h, NULL, &p);
+                if (r < 0)
+                        return r;
+
+                /* See journal_file_append_entry() for details on the XOR hash */
+                if (JOURNAL_HEADER_KEYED_HASH(f->header))
+                        xor_hash ^= jenkins_hash64(e->iovec[i].iov_base, e->iovec[i].iov_len);
+                else
+                        xor_hash ^= h;
+
+                items[i].object_offset = htole64(p);
+                items[i].hash = htole64(h);
+        }
+
+        typesafe_qsort(items, e->n_iovec, entry_item_cmp);
+
+        return journal_file_append_entry_object(f, &e->ts, NULL, xor_hash, items, e->n_iovec, seqnum, NULL, ret_offset);
+}
+
+static int journal_file_link_entries(
+                JournalFile *f,
+                const JournalBatchEntry entries[],
+                const uint64_t offsets[], size_t n_entries,
+                EntryDataLink links[], size_t n_links) {
+
+        _cleanup_free_ uint64_t *run = NULL;
+        size_t i, j;
+        int r;
+
+        assert(f);
+        assert(f->header);
+        assert(entries);
+        assert(offsets);
+        assert(n_entries > 0);
+        assert(links || n_links == 0);
+
+        __sync_synchronize();
+
+        /* Link up all entries in the global entry array in one go */
+        r = link_entries_into_array(f,
+                                    &f->header->entry_array_offset,
+                                    &f->header->n_entries,
+                                    offsets, n_entries);
+        if (r < 0)
+                return r;
+
+        if (f->header->head_entry_realtime == 0)
+                f->header->head_entry_realtime = htole64(entries[0].ts.realtime);
+
+        f->header->tail_entry_realtime = htole64(entries[n_entries - 1].ts.realtime);
+        f->header->tail_entry_monotonic = htole64(entries[n_entries - 1].ts.monotonic);
+
+        if (n_links == 0)
+                return 0;
+
+        /* Then link up the items, grouped by data object, so that each data object's entry array chain is
+         * walked (and grown) only once per batch, however many of the entries reference it. Within each
+         * group the entries remain ordered by offset, as required for bisection. */
+        typesafe_qsort(links, n_links, entry_data_link_cmp);
+
+        run = new(uint64_t, n_links);
+        if (!run)
+                return -ENOMEM;
+
+        for (i = 0; i < n_links; i = j) {
+                Object *o;
+
+                for (j = i; j < n_links && links[j].data_offset == links[i].data_offset; j++)
+                        run[j - i] = links[j].entry_offset;
+
+                r = journal_file_move_to_object(f, OBJECT_DATA, links[i].data_offset, &o);
+                if (r < 0)
+                        return r;
+
+                r = link_entries_into_array_plus_one(f,
+                                                     &o->data.entry_offset,
+                                                     &o->data.entry_array_offset,
+                                                     &o->data.n_entries,
+                                                     run, j - i);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+int journal_file_append_entries(
+                JournalFile *f,
+                const JournalBatchEntry entries[], size_t n_entries,
+                uint64_t *seqnum,
+                size_t *ret_n_appended) {
+
+        _cleanup_free_ EntryDataLink *links = NULL;
+        _cleanup_free_ uint64_t *offsets = NULL;
+        _cleanup_free_ EntryItem *items = NULL;
+        size_t i, n_appended = 0, n_links = 0, n_links_max = 0;
+        unsigned n_items_max = 0;
+        int r = 0, k;
+
+        assert(f);
+        assert(f->header);
+        assert(entries || n_entries == 0);
+
+        /* Appends a number of entries to the journal file at once. This is equivalent to calling
+         * journal_file_append_entry() for each of them, except that the linking of entry arrays and the
+         * change notification are shared by the whole batch. Returns the number of
+         * entries appended in ret_n_appended, also on failure, so that the caller may retry the rest
+         * elsewhere. */
+
+        for (i = 0; i < n_entries; i++) {
+                n_links_max += entries[i].n_iovec;
+                n_items_max = MAX(n_items_max, entries[i].n_iovec);
+        }
+
+        if (n_entries == 0)
+                goto finish;
+
+        offsets = new(uint64_t, n_entries);
+        links = new(EntryDataLink, MAX((size_t) 1, n_links_max));
+        items = new(EntryItem, MAX(1u, n_items_max));
+        if (!offsets || !links || !items) {
+                r = -ENOMEM;
+                goto finish;
+        }
+
+        for (i = 0; i < n_entries; i++) {
+                unsigned j;
+
+                r = journal_file_append_batch_entry(f, entries + i, items, seqnum, offsets + n_appended);
+                if (r < 0)
+                        break;
+
+                for (j = 0; j < entries[i].n_iovec; j++)
+                        links[n_links++] = (EntryDataLink) {
+                                .data_offset = le64toh(items[j].object_offset),
+                                .entry_offset = offsets[n_appended],
+                        };
+
+                n_appended++;
+        }
+
+        /* Link up whatever we managed to append, even if we failed half-way, so that the file stays
+         * consistent. */
+        if (n_appended > 0) {
+                k = journal_file_link_entries(f, entries, offsets, n_appended, links, n_links);
+                if (k < 0) {
+                        n_appended = 0;
+                        if (r >= 0)
+                                r = k;
+                }
+        }
+
+        /* If the memory mapping triggered a SIGBUS then we return an IO error, see
+         * journal_file_append_entry() */
+        if (mmap_cache_got_sigbus(f->mmap, f->cache_fd)) {
+                n_appended = 0;
+                r = -EIO;
+        }
+
+        if (f->post_change_timer)
+                schedule_post_change(f);
+        else
+                journal_file_post_change(f);
+
+finish:
+        if (ret_n_appended)
+                *ret_n_appended = n_appended;
+
+        return r;
+}
+
 typedef struct ChainCacheItem {
         uint64_t first; /* the array at the beginning of the chain */
         uint64_t array; /* the cached array */
@@ -2600,32 +3504,13 @@ static int test_object_seqnum(JournalFile *f, uint64_t p, uint64_t needle) {
                 return TEST_RIGHT;
 }
 
-int journal_file_move_to_entry_by_seqnum(
-                JournalFile *f,
-                uint64_t seqnum,
-                direction_t direction,
-                Object **ret,
-                uint64_t *ret_offset) {
+static int test_object_realtime(JournalFile *f, uint64_t p, uint64_t needle) {
+        Object *o;
+        uint64_t rt;
+        int r;
+
         assert(f);
-        assert(f->header);
-
-        return generic_array_bisect(
-                        f,
-                        le64toh(f->header->entry_array_offset),
-                        le64toh(f->header->n_entries),
-                        seqnum,
-                        test_object_seqnum,
-                        direction,
-                        ret, ret_offset, NULL);
-}
-
-static int test_object_realtime(JournalFile *f, uint64_t p, uint64_t needle) {
-        Object *o;
-        uint64_t rt;
-        int r;
-
-        assert(f);
-        assert(p > 0);
+        assert(p > 0);
 
         r = journal_file_move_to_object(f, OBJECT_ENTRY, p, &o);
         if (r < 0)
@@ -2640,15 +3525,185 @@ static int test_object_realtime(JournalFile *f, uint64_t p, uint64_t needle) {
                 return TEST_RIGHT;
 }
 
+static bool entry_index_item_is_left(const EntryIndexItem *i, bool by_realtime, uint64_t needle, direction_t direction) {
+        uint64_t k;
+
+        k = le64toh(by_realtime ? i->realtime : i->seqnum);
+
+        return k < needle || (direction == DIRECTION_UP && k == needle);
+}
+
+static int entry_index_bisect(
+                JournalFile *f,
+                uint64_t needle,
+                bool by_realtime,
+                direction_t direction,
+                Object **ret,
+                uint64_t *ret_offset) {
+
+        uint64_t q, n, left, right, i, j, p;
+        EntryIndexItem item;
+        Object *o, *array;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        /* Seeks with the entry index written when the file was archived, see
+         * journal_file_append_entry_index(): we bisect the index to find the stretch of entries the needle
+         * falls into, and then bisect that stretch, which lives within a single entry array. Returns
+         * -EOPNOTSUPP if the file has no usable index. */
+
+        if (!JOURNAL_HEADER_ENTRY_INDEX(f->header) ||
+            !JOURNAL_HEADER_CONTAINS(f->header, entry_index_offset))
+                return -EOPNOTSUPP;
+
+        q = le64toh(f->header->entry_index_offset);
+        if (q == 0)
+                return -EOPNOTSUPP;
+
+        r = journal_file_move_to_object(f, OBJECT_ENTRY_INDEX, q, &o);
+        if (r < 0)
+                return r;
+
+        /* Don't use the index if somebody appended entries after it was written */
+        if (le64toh(o->entry_index.n_entries) != le64toh(f->header->n_entries))
+                return -EOPNOTSUPP;
+
+        /* Find the first stretch that starts right of the needle */
+        n = journal_file_entry_index_n_items(o);
+        left = 0;
+        right = n;
+        while (left < right) {
+                i = (left + right) / 2;
+
+                if (entry_index_item_is_left(o->entry_index.items + i, by_realtime, needle, direction))
+                        left = i + 1;
+                else
+                        right = i;
+        }
+        i = left;
+
+        if (i == 0) {
+                if (direction == DIRECTION_UP)
+                        return 0;
+
+                /* Everything is right of the needle, hence the first entry it is */
+                item = o->entry_index.items[0];
+                j = 0;
+                goto found;
+        }
+
+        /* The needle falls into the stretch before that one, or right behind it. We already know that the
+         * first entry of the stretch is left of the needle. */
+        item = o->entry_index.items[i - 1];
+
+        r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY, le64toh(item.entry_array_offset), &array);
+        if (r < 0)
+                return r;
+
+        if (le64toh(item.n_entries) <= 0 ||
+            le64toh(item.entry_array_index) + le64toh(item.n_entries) > journal_file_entry_array_n_items(array))
+                return -EBADMSG;
+
+        left = 1;
+        right = le64toh(item.n_entries);
+        while (left < right) {
+                j = (left + right) / 2;
+
+                p = le64toh(array->entry_array.items[le64toh(item.entry_array_index) + j]);
+                if (p <= 0)
+                        return -EBADMSG;
+
+                r = by_realtime ? test_object_realtime(f, p, needle) : test_object_seqnum(f, p, needle);
+                if (r < 0)
+                        return r;
+
+                if (r == TEST_LEFT || (direction == DIRECTION_UP && r == TEST_FOUND))
+                        left = j + 1;
+                else
+                        right = j;
+        }
+
+        if (direction == DIRECTION_UP)
+                j = left - 1;
+        else if (left < le64toh(item.n_entries))
+                j = left;
+        else if (i < n) {
+                /* The needle falls between two stretches, hence the first entry of the next one it is */
+                item = o->entry_index.items[i];
+                j = 0;
+        } else
+                return 0;
+
+found:
+        r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY, le64toh(item.entry_array_offset), &array);
+        if (r < 0)
+                return r;
+
+        if (le64toh(item.entry_array_index) + j >= journal_file_entry_array_n_items(array))
+                return -EBADMSG;
+
+        p = le64toh(array->entry_array.items[le64toh(item.entry_array_index) + j]);
+        if (p <= 0)
+                return -EBADMSG;
+
+        r = journal_file_move_to_object(f, OBJECT_ENTRY, p, &o);
+        if (r < 0)
+                return r;
+
+        if (ret)
+                *ret = o;
+        if (ret_offset)
+                *ret_offset = p;
+
+        return 1;
+}
+
+int journal_file_move_to_entry_by_seqnum(
+                JournalFile *f,
+                uint64_t seqnum,
+                direction_t direction,
+                Object **ret,
+                uint64_t *ret_offset) {
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        r = entry_index_bisect(f, seqnum, false, direction, ret, ret_offset);
+        if (r >= 0)
+                return r;
+        if (r != -EOPNOTSUPP)
+                log_debug_errno(r, "Failed to seek with entry index of %s, ignoring: %m", f->path);
+
+        return generic_array_bisect(
+                        f,
+                        le64toh(f->header->entry_array_offset),
+                        le64toh(f->header->n_entries),
+                        seqnum,
+                        test_object_seqnum,
+                        direction,
+                        ret, ret_offset, NULL);
+}
+
 int journal_file_move_to_entry_by_realtime(
                 JournalFile *f,
                 uint64_t realtime,
                 direction_t direction,
                 Object **ret,
                 uint64_t *ret_offset) {
+        int r;
+
         assert(f);
         assert(f->header);
 
+        r = entry_index_bisect(f, realtime, true, direction, ret, ret_offset);
+        if (r >= 0)
+                return r;
+        if (r != -EOPNOTSUPP)
+                log_debug_errno(r, "Failed to seek with entry index of %s, ignoring: %m", f->path);
+
         return generic_array_bisect(
                         f,
                         le64toh(f->header->entry_array_offset),
@@ -3183,6 +4238,21 @@ void journal_file_dump(JournalFile *f) {
                                le64toh(o->tag.epoch));
                         break;
 
+                case OBJECT_ENTRY_INDEX:
+                        printf("Type: OBJECT_ENTRY_INDEX n_entries=%"PRIu64"\n",
+                               le64toh(o->entry_index.n_entries));
+                        break;
+
+                case OBJECT_COMPRESSION_DICTIONARY:
+                        printf("Type: OBJECT_COMPRESSION_DICTIONARY size=%"PRIu64"\n",
+                               le64toh(o->object.size) - offsetof(CompressionDictionaryObject, payload));
+                        break;
+
+                case OBJECT_FIELD_VALUES:
+                        printf("Type: OBJECT_FIELD_VALUES n_items=%"PRIu64"\n",
+                               le64toh(o->field_values.n_items));
+                        break;
+
                 default:
                         printf("Type: unknown (%i)\n", o->object.type);
                         break;
@@ -3227,8 +4297,8 @@ void journal_file_print_header(JournalFile *f) {
                "Boot ID: %s\n"
                "Sequential number ID: %s\n"
                "State: %s\n"
-               "Compatible flags:%s%s\n"
-               "Incompatible flags:%s%s%s%s%s\n"
+               "Compatible flags:%s%s%s%s\n"
+               "Incompatible flags:%s%s%s%s%s%s\n"
                "Header size: %"PRIu64"\n"
                "Arena size: %"PRIu64"\n"
                "Data hash table size: %"PRIu64"\n"
@@ -3250,10 +4320,13 @@ void journal_file_print_header(JournalFile *f) {
                f->header->state == STATE_ONLINE ? "ONLINE" :
                f->header->state == STATE_ARCHIVED ? "ARCHIVED" : "UNKNOWN",
                JOURNAL_HEADER_SEALED(f->header) ? " SEALED" : "",
+               JOURNAL_HEADER_ENTRY_INDEX(f->header) ? " ENTRY-INDEX" : "",
+               JOURNAL_HEADER_FIELD_VALUES(f->header) ? " FIELD-VALUES" : "",
                (le32toh(f->header->compatible_flags) & ~HEADER_COMPATIBLE_ANY) ? " ???" : "",
                JOURNAL_HEADER_COMPRESSED_XZ(f->header) ? " COMPRESSED-XZ" : "",
                JOURNAL_HEADER_COMPRESSED_LZ4(f->header) ? " COMPRESSED-LZ4" : "",
                JOURNAL_HEADER_COMPRESSED_ZSTD(f->header) ? " COMPRESSED-ZSTD" : "",
+               JOURNAL_HEADER_ZSTD_DICTIONARY(f->header) ? " ZSTD-DICTIONARY" : "",
                JOURNAL_HEADER_KEYED_HASH(f->header) ? " KEYED-HASH" : "",
                (le32toh(f->header->incompatible_flags) & ~HEADER_INCOMPATIBLE_ANY) ? " ???" : "",
                le64toh(f->header->header_size),
@@ -3287,6 +4360,12 @@ void journal_file_print_header(JournalFile *f) {
         if (JOURNAL_HEADER_CONTAINS(f->header, n_entry_arrays))
                 printf("Entry array objects: %"PRIu64"\n",
                        le64toh(f->header->n_entry_arrays));
+        if (JOURNAL_HEADER_CONTAINS(f->header, entry_index_offset))
+                printf("Entry index: %s\n",
+                       yes_no(f->header->entry_index_offset != 0));
+        if (JOURNAL_HEADER_CONTAINS(f->header, field_values_offset))
+                printf("Field values summary: %s\n",
+                       yes_no(f->header->field_values_offset != 0));
 
         if (JOURNAL_HEADER_CONTAINS(f->header, field_hash_chain_depth))
                 printf("Deepest field hash chain: %" PRIu64"\n",
@@ -3335,138 +4414,446 @@ static int journal_file_warn_btrfs(JournalFile *f) {
         return 1;
 }
 
-int journal_file_open(
-                int fd,
-                const char *fname,
-                int flags,
-                mode_t mode,
-                bool compress,
-                uint64_t compress_threshold_bytes,
-                bool seal,
-                JournalMetrics *metrics,
-                MMapCache *mmap_cache,
-                Set *deferred_closes,
-                JournalFile *template,
-                JournalFile **ret) {
+/* Limits for the zstd dictionary we train from the data objects of the file we are rotating away from. The
+ * samples are copied out synchronously while the new file is opened, i.e. on journald's event loop during
+ * rotation, the training itself is done by a thread. The samples are capped well below what zstd would like
+ * to see (about 100 times the dictionary size): with 256K of samples, training takes some tens of
+ * milliseconds, which we have to wait for if the file is closed before it is done. */
+#define COMPRESSION_DICTIONARY_SIZE_MAX (16U * 1024U)
+#define COMPRESSION_DICTIONARY_SAMPLES_MAX 2048U
+#define COMPRESSION_DICTIONARY_SAMPLE_BYTES_MAX (256U * 1024U)
 
-        bool newly_created = false;
-        JournalFile *f;
-        void *h;
+static int journal_file_load_compression_dictionary(JournalFile *f) {
+        uint64_t p;
+        Object *o;
         int r;
 
-        assert(ret);
-        assert(fd >= 0 || fname);
-
-        if (!IN_SET((flags & O_ACCMODE), O_RDONLY, O_RDWR))
-                return -EINVAL;
+        assert(f);
+        assert(f->header);
 
-        if (fname && (flags & O_CREAT) && !endswith(fname, ".journal"))
-                return -EINVAL;
+        if (!JOURNAL_HEADER_ZSTD_DICTIONARY(f->header))
+                return 0;
 
-        f = new(JournalFile, 1);
-        if (!f)
-                return -ENOMEM;
+        if (!JOURNAL_HEADER_CONTAINS(f->header, compression_dictionary_offset))
+                return -EBADMSG;
 
-        *f = (JournalFile) {
-                .fd = fd,
-                .mode = mode,
+        p = le64toh(READ_NOW(f->header->compression_dictionary_offset));
+        if (p == 0)
+                return -EBADMSG;
 
-                .flags = flags,
-                .prot = prot_from_flags(flags),
-                .writable = (flags & O_ACCMODE) != O_RDONLY,
+        r = journal_file_move_to_object(f, OBJECT_COMPRESSION_DICTIONARY, p, &o);
+        if (r < 0)
+                return r;
 
-#if HAVE_ZSTD
-                .compress_zstd = compress,
-#elif HAVE_LZ4
-                .compress_lz4 = compress,
-#elif HAVE_XZ
-                .compress_xz = compress,
-#endif
-                .compress_threshold_bytes = compress_threshold_bytes == (uint64_t) -1 ?
-                                            DEFAULT_COMPRESS_THRESHOLD :
-                                            MAX(MIN_COMPRESS_THRESHOLD, compress_threshold_bytes),
-#if HAVE_GCRYPT
-                .seal = seal,
-#endif
-        };
+        return compress_dictionary_new(o->compression_dictionary.payload,
+                                       le64toh(o->object.size) - offsetof(CompressionDictionaryObject, payload),
+                                       &f->compress_dictionary);
+}
 
-        /* We turn on keyed hashes by default, but provide an environment variable to turn them off, if
-         * people really want that */
-        r = getenv_bool("SYSTEMD_JOURNAL_KEYED_HASH");
-        if (r < 0) {
-                if (r != -ENXIO)
-                        log_debug_errno(r, "Failed to parse $SYSTEMD_JOURNAL_KEYED_HASH environment variable, ignoring.");
-                f->keyed_hash = true;
-        } else
-                f->keyed_hash = r;
+CompressDictionary* journal_file_compress_dictionary(JournalFile *f) {
+        int r;
 
-        if (DEBUG_LOGGING) {
-                static int last_seal = -1, last_compress = -1, last_keyed_hash = -1;
-                static uint64_t last_bytes = UINT64_MAX;
-                char bytes[FORMAT_BYTES_MAX];
+        assert(f);
 
-                if (last_seal != f->seal ||
-                    last_keyed_hash != f->keyed_hash ||
-                    last_compress != JOURNAL_FILE_COMPRESS(f) ||
-                    last_bytes != f->compress_threshold_bytes) {
+        /* The writer adds the dictionary once it is trained, which is after the file was created, and
+         * possibly after we opened it. Hence look for it again until we found it. */
 
-                        log_debug("Journal effective settings seal=%s keyed_hash=%s compress=%s compress_threshold_bytes=%s",
-                                  yes_no(f->seal), yes_no(f->keyed_hash), yes_no(JOURNAL_FILE_COMPRESS(f)),
-                                  format_bytes(bytes, sizeof bytes, f->compress_threshold_bytes));
-                        last_seal = f->seal;
-                        last_keyed_hash = f->keyed_hash;
-                        last_compress = JOURNAL_FILE_COMPRESS(f);
-                        last_bytes = f->compress_threshold_bytes;
-                }
+        if (!f->compress_dictionary && f->header && JOURNAL_HEADER_ZSTD_DICTIONARY(f->header)) {
+                r = journal_file_load_compression_dictionary(f);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to load compression dictionary of %s, ignoring: %m", f->path);
         }
 
-        if (mmap_cache)
-                f->mmap = mmap_cache_ref(mmap_cache);
-        else {
-                f->mmap = mmap_cache_new();
-                if (!f->mmap) {
-                        r = -ENOMEM;
-                        goto fail;
-                }
-        }
+        return f->compress_dictionary;
+}
 
-        if (fname) {
-                f->path = strdup(fname);
-                if (!f->path) {
-                        r = -ENOMEM;
-                        goto fail;
-                }
-        } else {
-                assert(fd >= 0);
+static int journal_file_collect_dictionary_samples(
+                JournalFile *f,
+                void **ret_samples,
+                size_t **ret_sample_sizes,
+                size_t *ret_n_samples) {
+
+        _cleanup_free_ size_t *sizes = NULL;
+        _cleanup_free_ void *samples = NULL;
+        size_t n_samples = 0, samples_allocated = 0, sizes_allocated = 0, total = 0;
+        uint64_t i, m;
+        int r;
 
-                /* If we don't know the path, fill in something explanatory and vaguely useful */
-                if (asprintf(&f->path, "/proc/self/%i", fd) < 0) {
-                        r = -ENOMEM;
-                        goto fail;
-                }
-        }
+        assert(f);
+        assert(ret_samples);
+        assert(ret_sample_sizes);
+        assert(ret_n_samples);
 
-        f->chain_cache = ordered_hashmap_new(&uint64_hash_ops);
-        if (!f->chain_cache) {
-                r = -ENOMEM;
-                goto fail;
-        }
+        /* Collects the payloads of data objects as training samples. We walk the data hash table, hence the
+         * samples are spread over all fields, rather than biased towards the first entries of the file. */
 
-        if (f->fd < 0) {
-                /* We pass O_NONBLOCK here, so that in case somebody pointed us to some character device node or FIFO
-                 * or so, we likely fail quickly than block for long. For regular files O_NONBLOCK has no effect, hence
-                 * it doesn't hurt in that case. */
+        if (le64toh(f->header->data_hash_table_size) <= 0)
+                return -ENODATA;
 
-                f->fd = open(f->path, f->flags|O_CLOEXEC|O_NONBLOCK, f->mode);
-                if (f->fd < 0) {
-                        r = -errno;
-                        goto fail;
-                }
+        r = journal_file_map_data_hash_table(f);
+        if (r < 0)
+                return r;
 
-                /* fds we opened here by us should also be closed by us. */
-                f->close_fd = true;
+        m = le64toh(READ_NOW(f->header->data_hash_table_size)) / sizeof(HashItem);
 
-                r = fd_nonblock(f->fd, false);
+        for (i = 0; i < m; i++) {
+                uint64_t p;
+
+                p = le64toh(f->data_hash_table[i].head_hash_offset);
+                while (p > 0) {
+                        const void *data;
+                        uint64_t l;
+                        Object *o;
+
+                        if (n_samples >= COMPRESSION_DICTIONARY_SAMPLES_MAX)
+                                goto finish;
+
+                        r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                        if (r < 0)
+                                return r;
+
+                        l = le64toh(READ_NOW(o->object.size));
+                        if (l <= offsetof(Object, data.payload))
+                                return -EBADMSG;
+                        l -= offsetof(Object, data.payload);
+
+                        if (o->object.flags & OBJECT_COMPRESSION_MASK) {
+#if HAVE_COMPRESSION
+                                size_t rsize = 0;
+
+                                r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK,
+                                                    journal_file_compress_dictionary(f),
+                                                    o->data.payload, l, &f->compress_buffer, &f->compress_buffer_size, &rsize, 0);
+                                if (r < 0)
+                                        return r;
+
+                                data = f->compress_buffer;
+                                l = rsize;
+#else
+                                return -EPROTONOSUPPORT;
+#endif
+                        } else
+                                data = o->data.payload;
+
+                        if (l >= MIN_COMPRESS_THRESHOLD) {
+                                if (total + l > COMPRESSION_DICTIONARY_SAMPLE_BYTES_MAX)
+                                        goto finish;
+
+                                if (!GREEDY_REALLOC(samples, samples_allocated, total + l) ||
+                                    !GREEDY_REALLOC(sizes, sizes_allocated, n_samples + 1))
+                                        return -ENOMEM;
+
+                                memcpy((uint8_t*) samples + total, data, l);
+                                sizes[n_samples++] = l;
+                                total += l;
+                        }
+
+                        p = le64toh(o->data.next_hash_offset);
+                }
+        }
+
+finish:
+        if (n_samples == 0)
+                return -ENODATA;
+
+        *ret_samples = TAKE_PTR(samples);
+        *ret_sample_sizes = TAKE_PTR(sizes);
+        *ret_n_samples = n_samples;
+        return 0;
+}
+
+typedef struct DictionaryTraining {
+        pthread_t thread;
+
+        void *samples;
+        size_t *sample_sizes;
+        size_t n_samples;
+
+        /* Set by the thread, only to be looked at once it has been joined */
+        void *dict;
+        size_t dict_size;
+        CompressDictionary *dictionary;
+        usec_t duration;
+        int error;
+} DictionaryTraining;
+
+static DictionaryTraining* dictionary_training_free(DictionaryTraining *t) {
+        if (!t)
+                return NULL;
+
+        free(t->samples);
+        free(t->sample_sizes);
+        free(t->dict);
+        compress_dictionary_free(t->dictionary);
+
+        return mfree(t);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(DictionaryTraining*, dictionary_training_free);
+
+static void journal_file_stop_dictionary_training(JournalFile *f) {
+        assert(f);
+
+        if (!f->dictionary_training)
+                return;
+
+        /* The result is of no use anymore, but we can't interrupt the training either */
+        assert_se(pthread_join(f->dictionary_training->thread, NULL) == 0);
+        f->dictionary_training = dictionary_training_free(f->dictionary_training);
+}
+
+static void *journal_file_dictionary_thread(void *userdata) {
+        DictionaryTraining *t = userdata;
+        usec_t start;
+        int r;
+
+        (void) pthread_setname_np(pthread_self(), "journal-dict");
+
+        /* Logging isn't thread-safe, the caller reports the result when it installs the dictionary */
+        log_set_thread_quiet(true);
+
+        start = now(CLOCK_MONOTONIC);
+
+        r = compress_dictionary_train(t->samples, t->sample_sizes, t->n_samples, COMPRESSION_DICTIONARY_SIZE_MAX,
+                                      &t->dict, &t->dict_size);
+        if (r >= 0)
+                r = compress_dictionary_new(t->dict, t->dict_size, &t->dictionary);
+
+        t->duration = now(CLOCK_MONOTONIC) - start;
+        t->error = r;
+
+        return NULL;
+}
+
+static int journal_file_setup_compression_dictionary(JournalFile *f, JournalFile *template) {
+        _cleanup_(dictionary_training_freep) DictionaryTraining *t = NULL;
+        sigset_t ss, saved_ss;
+        int r, k;
+
+        assert(f);
+
+        /* Trains a zstd dictionary from the data of the file we are replacing, to be stored in this, newly
+         * created file. Journal data objects are mostly short and similar to each other, which zstd can't
+         * make much use of when compressing each of them on its own. Sealed files don't get a dictionary, so
+         * that older versions can still verify them.
+         *
+         * Training takes too long to do it on the event loop, hence only the samples are collected here,
+         * and a thread trains the dictionary from them. Until journal_file_install_compression_dictionary()
+         * picks up the result, data is compressed without a dictionary. */
+
+        if (!f->compress_zstd || f->seal || !template)
+                return 0;
+
+        r = getenv_bool("SYSTEMD_JOURNAL_ZSTD_DICTIONARY");
+        if (r == 0)
+                return 0;
+        if (r < 0 && r != -ENXIO)
+                log_debug_errno(r, "Failed to parse $SYSTEMD_JOURNAL_ZSTD_DICTIONARY environment variable, ignoring.");
+
+        t = new0(DictionaryTraining, 1);
+        if (!t)
+                return -ENOMEM;
+
+        r = journal_file_collect_dictionary_samples(template, &t->samples, &t->sample_sizes, &t->n_samples);
+        if (r == -ENODATA)
+                return 0;
+        if (r < 0)
+                return r;
+
+        assert_se(sigfillset(&ss) >= 0);
+
+        r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+        if (r > 0)
+                return -r;
+
+        r = pthread_create(&t->thread, NULL, journal_file_dictionary_thread, t);
+
+        k = pthread_sigmask(SIG_SETMASK, &saved_ss, NULL);
+        if (r > 0)
+                return -r;
+
+        /* The thread is running and uses t now, hence don't free it on the way out */
+        f->dictionary_training = TAKE_PTR(t);
+
+        return k > 0 ? -k : 0;
+}
+
+static int journal_file_install_compression_dictionary(JournalFile *f) {
+        _cleanup_(dictionary_training_freep) DictionaryTraining *t = NULL;
+        char ts[FORMAT_TIMESPAN_MAX];
+        uint64_t p;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->dictionary_training);
+
+        r = pthread_tryjoin_np(f->dictionary_training->thread, NULL);
+        if (r == EBUSY)
+                return 0; /* Not done yet, try again with the next data object */
+        assert(r == 0);
+
+        t = TAKE_PTR(f->dictionary_training);
+
+        if (t->error == -ENODATA)
+                return 0;
+        if (t->error < 0)
+                return t->error;
+
+        /* The data objects appended so far were compressed without it, the frames say so */
+        r = journal_file_append_object(f, OBJECT_COMPRESSION_DICTIONARY,
+                                       offsetof(Object, compression_dictionary.payload) + t->dict_size,
+                                       &o, &p);
+        if (r < 0)
+                return r;
+
+        memcpy(o->compression_dictionary.payload, t->dict, t->dict_size);
+
+        f->header->compression_dictionary_offset = htole64(p);
+        f->header->incompatible_flags |= htole32(HEADER_INCOMPATIBLE_ZSTD_DICTIONARY);
+        f->compress_dictionary = TAKE_PTR(t->dictionary);
+
+        log_debug("Trained %zu byte compression dictionary for %s from %zu samples in %s.",
+                  t->dict_size, f->path, t->n_samples,
+                  format_timespan(ts, sizeof(ts), t->duration, USEC_PER_MSEC));
+        return 1;
+}
+
+static int journal_file_open_internal(
+                int fd,
+                const char *fname,
+                int flags,
+                mode_t mode,
+                bool compress,
+                uint64_t compress_threshold_bytes,
+                bool seal,
+                JournalMetrics *metrics,
+                MMapCache *mmap_cache,
+                Set *deferred_closes,
+                JournalFile *template,
+                bool fit_template,
+                JournalFile **ret) {
+
+        bool newly_created = false;
+        JournalFile *f;
+        void *h;
+        int r;
+
+        assert(ret);
+        assert(fd >= 0 || fname);
+
+        if (!IN_SET((flags & O_ACCMODE), O_RDONLY, O_RDWR))
+                return -EINVAL;
+
+        if (fname && (flags & O_CREAT) && !endswith(fname, ".journal"))
+                return -EINVAL;
+
+        f = new(JournalFile, 1);
+        if (!f)
+                return -ENOMEM;
+
+        *f = (JournalFile) {
+                .fd = fd,
+                .mode = mode,
+
+                .flags = flags,
+                .prot = prot_from_flags(flags),
+                .writable = (flags & O_ACCMODE) != O_RDONLY,
+                .merge_index = PRIOQ_IDX_NULL,
+
+#if HAVE_ZSTD
+                .compress_zstd = compress,
+#elif HAVE_LZ4
+                .compress_lz4 = compress,
+#elif HAVE_XZ
+                .compress_xz = compress,
+#endif
+                .compress_threshold_bytes = compress_threshold_bytes == (uint64_t) -1 ?
+                                            DEFAULT_COMPRESS_THRESHOLD :
+                                            MAX(MIN_COMPRESS_THRESHOLD, compress_threshold_bytes),
+                .compress_level = template ? template->compress_level : 0,
+#if HAVE_GCRYPT
+                .seal = seal,
+#endif
+        };
+
+        /* We turn on keyed hashes by default, but provide an environment variable to turn them off, if
+         * people really want that */
+        r = getenv_bool("SYSTEMD_JOURNAL_KEYED_HASH");
+        if (r < 0) {
+                if (r != -ENXIO)
+                        log_debug_errno(r, "Failed to parse $SYSTEMD_JOURNAL_KEYED_HASH environment variable, ignoring.");
+                f->keyed_hash = true;
+        } else
+                f->keyed_hash = r;
+
+        if (DEBUG_LOGGING) {
+                static int last_seal = -1, last_compress = -1, last_keyed_hash = -1;
+                static uint64_t last_bytes = UINT64_MAX;
+                char bytes[FORMAT_BYTES_MAX];
+
+                if (last_seal != f->seal ||
+                    last_keyed_hash != f->keyed_hash ||
+                    last_compress != JOURNAL_FILE_COMPRESS(f) ||
+                    last_bytes != f->compress_threshold_bytes) {
+
+                        log_debug("Journal effective settings seal=%s keyed_hash=%s compress=%s compress_threshold_bytes=%s",
+                                  yes_no(f->seal), yes_no(f->keyed_hash), yes_no(JOURNAL_FILE_COMPRESS(f)),
+                                  format_bytes(bytes, sizeof bytes, f->compress_threshold_bytes));
+                        last_seal = f->seal;
+                        last_keyed_hash = f->keyed_hash;
+                        last_compress = JOURNAL_FILE_COMPRESS(f);
+                        last_bytes = f->compress_threshold_bytes;
+                }
+        }
+
+        if (mmap_cache)
+                f->mmap = mmap_cache_ref(mmap_cache);
+        else {
+                f->mmap = mmap_cache_new();
+                if (!f->mmap) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+        }
+
+        if (fname) {
+                f->path = strdup(fname);
+                if (!f->path) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+        } else {
+                assert(fd >= 0);
+
+                /* If we don't know the path, fill in something explanatory and vaguely useful */
+                if (asprintf(&f->path, "/proc/self/%i", fd) < 0) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+        }
+
+        f->chain_cache = ordered_hashmap_new(&uint64_hash_ops);
+        if (!f->chain_cache) {
+                r = -ENOMEM;
+                goto fail;
+        }
+
+        if (f->fd < 0) {
+                /* We pass O_NONBLOCK here, so that in case somebody pointed us to some character device node or FIFO
+                 * or so, we likely fail quickly than block for long. For regular files O_NONBLOCK has no effect, hence
+                 * it doesn't hurt in that case. */
+
+                f->fd = open(f->path, f->flags|O_CLOEXEC|O_NONBLOCK, f->mode);
+                if (f->fd < 0) {
+                        r = -errno;
+                        goto fail;
+                }
+
+                /* fds we opened here by us should also be closed by us. */
+                f->close_fd = true;
+
+                r = fd_nonblock(f->fd, false);
                 if (r < 0)
                         goto fail;
         }
@@ -3529,86 +4916,388 @@ int journal_file_open(
         if (r < 0)
                 goto fail;
 
-        f->header = h;
+        f->header = h;
+
+        if (!newly_created) {
+                set_clear_with_destructor(deferred_closes, journal_file_close);
+
+                r = journal_file_verify_header(f);
+                if (r < 0)
+                        goto fail;
+
+                r = journal_file_load_compression_dictionary(f);
+                if (r < 0)
+                        goto fail;
+        }
+
+#if HAVE_GCRYPT
+        if (!newly_created && f->writable) {
+                r = journal_file_fss_load(f);
+                if (r < 0)
+                        goto fail;
+        }
+#endif
+
+        if (f->writable) {
+                if (metrics) {
+                        journal_default_metrics(metrics, f->fd);
+                        f->metrics = *metrics;
+                } else if (template)
+                        f->metrics = template->metrics;
+
+                r = journal_file_refresh_header(f);
+                if (r < 0)
+                        goto fail;
+        }
+
+#if HAVE_GCRYPT
+        r = journal_file_hmac_setup(f);
+        if (r < 0)
+                goto fail;
+#endif
+
+        if (newly_created) {
+                uint64_t n_data = 0, n_fields = 0;
+
+                /* If the file is going to receive exactly the contents of the template, size the hash
+                 * tables to fit them */
+                if (fit_template) {
+                        assert(template);
+
+                        if (JOURNAL_HEADER_CONTAINS(template->header, n_data))
+                                n_data = MAX(le64toh(template->header->n_data), 1u);
+                        if (JOURNAL_HEADER_CONTAINS(template->header, n_fields))
+                                n_fields = MAX(le64toh(template->header->n_fields), 1u);
+                }
+
+                r = journal_file_setup_field_hash_table(f, n_fields);
+                if (r < 0)
+                        goto fail;
+
+                r = journal_file_setup_data_hash_table(f, n_data);
+                if (r < 0)
+                        goto fail;
+
+                /* The dictionary is just an optimization, hence don't fail on errors */
+                r = journal_file_setup_compression_dictionary(f, template);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to set up compression dictionary for %s, ignoring: %m", f->path);
+
+#if HAVE_GCRYPT
+                r = journal_file_append_first_tag(f);
+                if (r < 0)
+                        goto fail;
+#endif
+        }
+
+        if (mmap_cache_got_sigbus(f->mmap, f->cache_fd)) {
+                r = -EIO;
+                goto fail;
+        }
+
+        if (template && template->post_change_timer) {
+                r = journal_file_enable_post_change_timer(
+                                f,
+                                sd_event_source_get_event(template->post_change_timer),
+                                template->post_change_timer_period);
+
+                if (r < 0)
+                        goto fail;
+        }
+
+        /* The file is opened now successfully, thus we take possession of any passed in fd. */
+        f->close_fd = true;
+
+        *ret = f;
+        return 0;
+
+fail:
+        if (f->cache_fd && mmap_cache_got_sigbus(f->mmap, f->cache_fd))
+                r = -EIO;
+
+        (void) journal_file_close(f);
+
+        return r;
+}
+
+int journal_file_open(
+                int fd,
+                const char *fname,
+                int flags,
+                mode_t mode,
+                bool compress,
+                uint64_t compress_threshold_bytes,
+                bool seal,
+                JournalMetrics *metrics,
+                MMapCache *mmap_cache,
+                Set *deferred_closes,
+                JournalFile *template,
+                JournalFile **ret) {
+
+        return journal_file_open_internal(fd, fname, flags, mode, compress, compress_threshold_bytes, seal,
+                                          metrics, mmap_cache, deferred_closes, template, false, ret);
+}
+
+/* Number of entries covered by each item of the entry index. This keeps the index at about 1/100 of the
+ * size of the entry arrays it covers, while the stretch bisected after a lookup in the index stays short. */
+#define ENTRY_INDEX_STRIDE 512U
+
+static int journal_file_append_entry_index(JournalFile *f) {
+        _cleanup_free_ EntryIndexItem *items = NULL;
+        size_t n_items = 0, n_allocated = 0;
+        uint64_t a, n, p;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        /* Writes a compact index of the global entry array chain, with the seqnum and realtime timestamp
+         * of every ENTRY_INDEX_STRIDE-th entry, so that seeking in archived files requires only a few page
+         * accesses, instead of bisecting a long chain of entry arrays. This only makes sense for files that
+         * won't be written to anymore. Sealed files are left alone, as older verifiers wouldn't know how to
+         * authenticate the new object type.
+         *
+         * Note that this walks the whole entry array chain, and is called synchronously when the file is
+         * archived, i.e. from the event loop of journald during rotation. The cost is one read of each
+         * entry array, plus one entry object per ENTRY_INDEX_STRIDE entries, which is small compared to
+         * writing these in the first place, and is paid once per file. */
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, entry_index_offset) ||
+            JOURNAL_HEADER_SEALED(f->header) ||
+            f->header->entry_index_offset != 0)
+                return 0;
+
+        n = le64toh(f->header->n_entries);
+        if (n <= ENTRY_INDEX_STRIDE)
+                return 0;
+
+        a = le64toh(f->header->entry_array_offset);
+        while (n > 0) {
+                uint64_t i, k;
+
+                if (a <= 0)
+                        return -EBADMSG;
+
+                r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY, a, &o);
+                if (r < 0)
+                        return r;
+
+                k = MIN(journal_file_entry_array_n_items(o), n);
+                if (k <= 0)
+                        return -EBADMSG;
+
+                for (i = 0; i < k; i += ENTRY_INDEX_STRIDE) {
+                        Object *e;
+
+                        p = le64toh(o->entry_array.items[i]);
+                        if (p <= 0)
+                                return -EBADMSG;
+
+                        r = journal_file_move_to_object(f, OBJECT_ENTRY, p, &e);
+                        if (r < 0)
+                                return r;
+
+                        if (!GREEDY_REALLOC(items, n_allocated, n_items + 1))
+                                return -ENOMEM;
+
+                        items[n_items++] = (EntryIndexItem) {
+                                .entry_array_offset = htole64(a),
+                                .entry_array_index = htole64(i),
+                                .n_entries = htole64(MIN(k - i, (uint64_t) ENTRY_INDEX_STRIDE)),
+                                .seqnum = e->entry.seqnum,
+                                .realtime = e->entry.realtime,
+                        };
+                }
+
+                n -= k;
+                a = le64toh(o->entry_array.next_entry_array_offset);
+        }
+
+        r = journal_file_append_object(f, OBJECT_ENTRY_INDEX,
+                                       offsetof(Object, entry_index.items) + n_items * sizeof(EntryIndexItem),
+                                       &o, &p);
+        if (r < 0)
+                return r;
+
+        o->entry_index.n_entries = f->header->n_entries;
+        memcpy(o->entry_index.items, items, n_items * sizeof(EntryIndexItem));
+
+        f->header->entry_index_offset = htole64(p);
+        f->header->compatible_flags |= htole32(HEADER_COMPATIBLE_ENTRY_INDEX);
+
+        return 0;
+}
+
+/* Fields with more values than this, or with more value data in total, are rather not useful to enumerate
+ * (think MESSAGE= or _PID=), and are left out of the summary. */
+#define FIELD_VALUES_MAX 4096U
+#define FIELD_VALUES_SIZE_MAX (256U*1024U)
+
+typedef struct FieldValue {
+        size_t offset;
+        size_t size;
+} FieldValue;
+
+static int field_value_compare_by_payload(const FieldValue *a, const FieldValue *b, uint8_t *buffer) {
+        return field_value_compare(buffer + a->offset, a->size, buffer + b->offset, b->size);
+}
+
+static int journal_file_append_field_values_one(JournalFile *f, uint64_t field_offset, uint64_t *next) {
+        _cleanup_free_ FieldValue *values = NULL;
+        _cleanup_free_ uint8_t *buffer = NULL;
+        size_t n_values = 0, n_allocated = 0, buffer_size = 0, buffer_allocated = 0, i;
+        uint64_t p, q, v;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(next);
+
+        r = journal_file_move_to_object(f, OBJECT_FIELD, field_offset, &o);
+        if (r < 0)
+                return r;
+
+        for (p = le64toh(o->field.head_data_offset); p > 0; p = le64toh(o->data.next_field_offset)) {
+                const void *data;
+                uint64_t l;
+
+                if (n_values >= FIELD_VALUES_MAX)
+                        return 0;
+
+                r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                if (r < 0)
+                        return r;
+
+                r = journal_file_data_payload(f, o, &data, &l);
+                if (r < 0)
+                        return r;
+
+                if (l > FIELD_VALUES_SIZE_MAX - buffer_size)
+                        return 0;
+
+                if (!GREEDY_REALLOC(values, n_allocated, n_values + 1) ||
+                    !GREEDY_REALLOC(buffer, buffer_allocated, buffer_size + l))
+                        return -ENOMEM;
+
+                memcpy_safe(buffer + buffer_size, data, l);
+                values[n_values++] = (FieldValue) {
+                        .offset = buffer_size,
+                        .size = l,
+                };
+                buffer_size += l;
+        }
+
+        if (n_values == 0)
+                return 0;
+
+        typesafe_qsort_r(values, n_values, field_value_compare_by_payload, buffer);
 
-        if (!newly_created) {
-                set_clear_with_destructor(deferred_closes, journal_file_close);
+        v = offsetof(Object, field_values.items) + n_values * sizeof(FieldValuesItem);
+        r = journal_file_append_object(f, OBJECT_FIELD_VALUES, v + buffer_size, &o, &q);
+        if (r < 0)
+                return r;
 
-                r = journal_file_verify_header(f);
-                if (r < 0)
-                        goto fail;
+        o->field_values.field_offset = htole64(field_offset);
+        o->field_values.next_field_values_offset = htole64(*next);
+        o->field_values.n_items = htole64(n_values);
+
+        for (i = 0; i < n_values; i++) {
+                memcpy_safe((uint8_t*) o + v, buffer + values[i].offset, values[i].size);
+                o->field_values.items[i] = (FieldValuesItem) {
+                        .offset = htole64(v),
+                        .size = htole64(values[i].size),
+                };
+                v += values[i].size;
         }
 
 #if HAVE_GCRYPT
-        if (!newly_created && f->writable) {
-                r = journal_file_fss_load(f);
-                if (r < 0)
-                        goto fail;
-        }
+        r = journal_file_hmac_put_object(f, OBJECT_FIELD_VALUES, o, q);
+        if (r < 0)
+                return r;
 #endif
 
-        if (f->writable) {
-                if (metrics) {
-                        journal_default_metrics(metrics, f->fd);
-                        f->metrics = *metrics;
-                } else if (template)
-                        f->metrics = template->metrics;
+        *next = q;
+        return 1;
+}
 
-                r = journal_file_refresh_header(f);
-                if (r < 0)
-                        goto fail;
-        }
+static int journal_file_append_field_values(JournalFile *f) {
+        _cleanup_free_ uint64_t *fields = NULL;
+        size_t n_fields = 0, n_allocated = 0, i;
+        uint64_t head = 0, k, m;
+        int r;
 
-#if HAVE_GCRYPT
-        r = journal_file_hmac_setup(f);
+        assert(f);
+        assert(f->header);
+
+        /* Writes a sorted summary of the values of each field, so that sd_journal_enumerate_unique() can
+         * list them without following the chain of data objects of the field, and can check whether a
+         * value exists with a bisection. Like the entry index, this only makes sense for files that won't
+         * be written to anymore, and sealed files are left alone. */
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, field_values_offset) ||
+            JOURNAL_HEADER_SEALED(f->header) ||
+            f->header->field_values_offset != 0)
+                return 0;
+
+        r = journal_file_map_field_hash_table(f);
         if (r < 0)
-                goto fail;
-#endif
+                return r;
 
-        if (newly_created) {
-                r = journal_file_setup_field_hash_table(f);
-                if (r < 0)
-                        goto fail;
+        /* First collect the fields, as appending objects might move the hash table around */
+        m = le64toh(f->header->field_hash_table_size) / sizeof(HashItem);
+        for (k = 0; k < m; k++) {
+                uint64_t p;
 
-                r = journal_file_setup_data_hash_table(f);
-                if (r < 0)
-                        goto fail;
+                for (p = le64toh(f->field_hash_table[k].head_hash_offset); p > 0; ) {
+                        Object *o;
 
-#if HAVE_GCRYPT
-                r = journal_file_append_first_tag(f);
-                if (r < 0)
-                        goto fail;
-#endif
-        }
+                        if (n_fields >= le64toh(f->header->n_fields))
+                                return -EBADMSG;
 
-        if (mmap_cache_got_sigbus(f->mmap, f->cache_fd)) {
-                r = -EIO;
-                goto fail;
-        }
+                        r = journal_file_move_to_object(f, OBJECT_FIELD, p, &o);
+                        if (r < 0)
+                                return r;
 
-        if (template && template->post_change_timer) {
-                r = journal_file_enable_post_change_timer(
-                                f,
-                                sd_event_source_get_event(template->post_change_timer),
-                                template->post_change_timer_period);
+                        if (!GREEDY_REALLOC(fields, n_allocated, n_fields + 1))
+                                return -ENOMEM;
+
+                        fields[n_fields++] = p;
+                        p = le64toh(o->field.next_hash_offset);
+                }
+        }
 
+        for (i = 0; i < n_fields; i++) {
+                r = journal_file_append_field_values_one(f, fields[i], &head);
                 if (r < 0)
-                        goto fail;
+                        return r;
         }
 
-        /* The file is opened now successfully, thus we take possession of any passed in fd. */
-        f->close_fd = true;
+        if (head == 0)
+                return 0;
+
+        f->header->field_values_offset = htole64(head);
+        f->header->compatible_flags |= htole32(HEADER_COMPATIBLE_FIELD_VALUES);
 
-        *ret = f;
         return 0;
+}
 
-fail:
-        if (f->cache_fd && mmap_cache_got_sigbus(f->mmap, f->cache_fd))
-                r = -EIO;
+static int journal_file_append_summaries(JournalFile *f) {
+        int r, ret = 0;
 
-        (void) journal_file_close(f);
+        assert(f);
 
-        return r;
+        /* These are just optimizations, hence keep going on errors, and let the caller ignore them */
+
+        r = journal_file_append_entry_index(f);
+        if (r < 0)
+                ret = r;
+
+        r = journal_file_append_field_values(f);
+        if (r < 0 && ret >= 0)
+                ret = r;
+
+        return ret;
 }
 
 int journal_file_archive(JournalFile *f) {
@@ -3634,19 +5323,21 @@ int journal_file_archive(JournalFile *f) {
                      le64toh(f->header->head_entry_realtime)) < 0)
                 return -ENOMEM;
 
+        /* The file is complete now, hence write an index for faster seeking, and a summary of the field
+         * values for faster enumeration. This is done when offlining the file, i.e. usually by the offline
+         * worker, so that it doesn't delay the caller. */
+        f->summaries_pending = true;
+
         /* Try to rename the file to the archived version. If the file already was deleted, we'll get ENOENT, let's
          * ignore that case. */
         if (rename(f->path, p) < 0 && errno != ENOENT)
                 return -errno;
 
-        /* Sync the rename to disk */
-        (void) fsync_directory_of_file(f->fd);
-
         /* Set as archive so offlining commits w/state=STATE_ARCHIVED. Previously we would set old_file->header->state
          * to STATE_ARCHIVED directly here, but journal_file_set_offline() short-circuits when state != STATE_ONLINE,
          * which would result in the rotated journal never getting fsync() called before closing.  Now we simply queue
          * the archive state by setting an archive bit, leaving the state as STATE_ONLINE so proper offlining
-         * occurs. */
+         * occurs. The rename is synced to disk as part of the offlining, too. */
         f->archive = true;
 
         /* Currently, btrfs is not very good with out write patterns and fragments heavily. Let's defrag our journal
@@ -3799,7 +5490,7 @@ int journal_file_open_reliably(
                                  deferred_closes, template, ret);
 }
 
-int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint64_t p) {
+int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint64_t p, uint64_t *seqnum) {
         uint64_t i, n;
         uint64_t q, xor_hash = 0;
         int r;
@@ -3824,11 +5515,9 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
         items = newa(EntryItem, MAX(1u, n));
 
         for (i = 0; i < n; i++) {
-                uint64_t l, h;
+                uint64_t l, h, hash;
                 le64_t le_hash;
-                size_t t;
-                void *data;
-                Object *u;
+                const void *data;
 
                 q = le64toh(o->entry.items[i].object_offset);
                 le_hash = o->entry.items[i].hash;
@@ -3840,45 +5529,23 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
                 if (le_hash != o->data.hash)
                         return -EBADMSG;
 
-                l = le64toh(READ_NOW(o->object.size));
-                if (l < offsetof(Object, data.payload))
-                        return -EBADMSG;
-
-                l -= offsetof(Object, data.payload);
-                t = (size_t) l;
-
-                /* We hit the limit on 32bit machines */
-                if ((uint64_t) t != l)
-                        return -E2BIG;
-
-                if (o->object.flags & OBJECT_COMPRESSION_MASK) {
-#if HAVE_COMPRESSION
-                        size_t rsize = 0;
-
-                        r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK,
-                                            o->data.payload, l, &from->compress_buffer, &from->compress_buffer_size, &rsize, 0);
-                        if (r < 0)
-                                return r;
+                r = journal_file_data_payload(from, o, &data, &l);
+                if (r < 0)
+                        return r;
 
-                        data = from->compress_buffer;
-                        l = rsize;
-#else
-                        return -EPROTONOSUPPORT;
-#endif
-                } else
-                        data = o->data.payload;
+                hash = journal_file_hash_data(to, data, l);
 
-                r = journal_file_append_data(to, data, l, &u, &h);
+                r = journal_file_append_data(to, data, l, hash, NULL, &h);
                 if (r < 0)
                         return r;
 
                 if (JOURNAL_HEADER_KEYED_HASH(to->header))
                         xor_hash ^= jenkins_hash64(data, l);
                 else
-                        xor_hash ^= le64toh(u->data.hash);
+                        xor_hash ^= hash;
 
                 items[i].object_offset = htole64(h);
-                items[i].hash = u->data.hash;
+                items[i].hash = htole64(hash);
 
                 r = journal_file_move_to_object(from, OBJECT_ENTRY, p, &o);
                 if (r < 0)
@@ -3886,7 +5553,7 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
         }
 
         r = journal_file_append_entry_internal(to, &ts, boot_id, xor_hash, items, n,
-                                               NULL, NULL, NULL);
+                                               seqnum, NULL, NULL);
 
         if (mmap_cache_got_sigbus(to->mmap, to->cache_fd))
                 return -EIO;
@@ -3894,6 +5561,242 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
         return r;
 }
 
+static int journal_file_reserve_entry_array(JournalFile *f, le64_t *first, uint64_t n) {
+        uint64_t q;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+        assert(first);
+        assert(*first == 0);
+        assert(n > 0);
+
+        /* Starts an empty entry array chain with a single array of n items, which link_entries_into_array()
+         * fills up before growing the chain any further. */
+
+        r = journal_file_append_object(f, OBJECT_ENTRY_ARRAY,
+                                       offsetof(Object, entry_array.items) + n * sizeof(uint64_t),
+                                       &o, &q);
+        if (r < 0)
+                return r;
+
+#if HAVE_GCRYPT
+        r = journal_file_hmac_put_object(f, OBJECT_ENTRY_ARRAY, o, q);
+        if (r < 0)
+                return r;
+#endif
+
+        *first = htole64(q);
+
+        if (JOURNAL_HEADER_CONTAINS(f->header, n_entry_arrays))
+                f->header->n_entry_arrays = htole64(le64toh(f->header->n_entry_arrays) + 1);
+
+        return 0;
+}
+
+static int journal_file_reserve_data(JournalFile *from, JournalFile *to, Object *o, uint64_t p) {
+        uint64_t i, n;
+        int r;
+
+        assert(from);
+        assert(to);
+        assert(o);
+        assert(p);
+
+        /* Appends the data objects of an entry to the file, and gives every new one a single entry array
+         * right behind it, large enough to hold all entries referencing it. */
+
+        n = journal_file_entry_n_items(o);
+        for (i = 0; i < n; i++) {
+                uint64_t q, l, h, hash, n_entries;
+                const void *data;
+                Object *d;
+
+                r = journal_file_move_to_object(from, OBJECT_ENTRY, p, &o);
+                if (r < 0)
+                        return r;
+
+                q = le64toh(o->entry.items[i].object_offset);
+
+                r = journal_file_move_to_object(from, OBJECT_DATA, q, &d);
+                if (r < 0)
+                        return r;
+
+                n_entries = le64toh(d->data.n_entries);
+
+                r = journal_file_data_payload(from, d, &data, &l);
+                if (r < 0)
+                        return r;
+
+                hash = journal_file_hash_data(to, data, l);
+
+                r = journal_file_append_data(to, data, l, hash, &d, &h);
+                if (r < 0)
+                        return r;
+
+                /* The first entry is stored in the data object itself */
+                if (n_entries > 1 && d->data.entry_array_offset == 0) {
+                        r = journal_file_reserve_entry_array(to, &d->data.entry_array_offset, n_entries - 1);
+                        if (r < 0)
+                                return r;
+                }
+        }
+
+        return 0;
+}
+
+static int journal_file_trim(JournalFile *f) {
+        uint64_t p, sz;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        /* Returns the space preallocated behind the last object to the file system. This only makes sense
+         * for files that won't be written to anymore. */
+
+        p = le64toh(f->header->tail_object_offset);
+        if (p == 0)
+                return 0;
+
+        r = journal_file_move_to_object(f, OBJECT_UNUSED, p, &o);
+        if (r < 0)
+                return r;
+
+        sz = PAGE_ALIGN(p + ALIGN64(le64toh(o->object.size)));
+        if (sz >= (uint64_t) f->last_stat.st_size)
+                return 0;
+
+        f->header->arena_size = htole64(sz - le64toh(f->header->header_size));
+
+        if (ftruncate(f->fd, sz) < 0)
+                return -errno;
+
+        return journal_file_fstat(f);
+}
+
+int journal_file_compact(JournalFile *from, int fd, const char *fname, JournalFile **ret) {
+        JournalFile *to = NULL;
+        uint64_t i, n, first;
+        struct stat st;
+        Object *o;
+        int r;
+
+        assert(from);
+        assert(from->header);
+        assert(fd >= 0);
+        assert(fname);
+        assert(ret);
+
+        /* Rewrites all entries of the (archived) journal file 'from' into the empty file 'fd' refers to,
+         * laying them out as densely as possible: the hash tables are sized to fit the contents, the data
+         * objects are stored in the order they are first referenced, each one followed by a single entry
+         * array covering all its entries, and the entries are stored contiguously, referenced from a single
+         * entry array. Data is recompressed with the current settings. Sequence numbers and the machine ID
+         * are retained, so that the result can take the place of the original file. Sealed files are
+         * refused, as the sealing can't be reproduced. The resulting file is marked as archived once
+         * closed. We use a separate mmap cache here, since objects of both files are accessed at the same
+         * time. On success we take possession of fd. */
+
+        if (JOURNAL_HEADER_SEALED(from->header))
+                return -EPERM;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+        if (st.st_size > 0)
+                return -EEXIST;
+
+        r = journal_file_open_internal(fd, fname, O_RDWR, 0, true, (uint64_t) -1, false,
+                                       NULL, NULL, NULL, from, true, &to);
+        if (r < 0)
+                return r;
+
+        to->header->machine_id = from->header->machine_id;
+        to->header->tail_entry_seqnum = 0;
+
+        first = le64toh(from->header->entry_array_offset);
+        n = le64toh(from->header->n_entries);
+        if (n > 0) {
+                r = journal_file_reserve_entry_array(to, &to->header->entry_array_offset, n);
+                if (r < 0)
+                        goto fail;
+        }
+
+        for (i = 0; i < n; i++) {
+                uint64_t p;
+
+                r = generic_array_get(from, first, i, &o, &p);
+                if (r == 0)
+                        break;
+                if (r == -EBADMSG) {
+                        log_debug_errno(r, "Entry item %" PRIu64 " of %s is bad, skipping over it.", i, from->path);
+                        continue;
+                }
+                if (r < 0)
+                        goto fail;
+
+                r = journal_file_reserve_data(from, to, o, p);
+                if (r == -EBADMSG)
+                        log_debug_errno(r, "Entry %" PRIu64 " of %s is bad, skipping over it.", p, from->path);
+                else if (r < 0)
+                        goto fail;
+        }
+
+        for (i = 0; i < n; i++) {
+                uint64_t p, seqnum;
+
+                r = generic_array_get(from, first, i, &o, &p);
+                if (r == 0)
+                        break;
+                if (r == -EBADMSG)
+                        continue;
+                if (r < 0)
+                        goto fail;
+
+                seqnum = le64toh(o->entry.seqnum);
+                if (seqnum > 0)
+                        seqnum--;
+
+                r = journal_file_copy_entry(from, to, o, p, &seqnum);
+                if (r == -EBADMSG)
+                        log_debug_errno(r, "Entry %" PRIu64 " of %s is bad, skipping over it.", p, from->path);
+                else if (r < 0)
+                        goto fail;
+        }
+
+        /* These are just optimizations, hence don't fail on errors */
+        r = journal_file_append_entry_index(to);
+        if (r < 0)
+                log_debug_errno(r, "Failed to write entry index to %s, ignoring: %m", to->path);
+
+        r = journal_file_append_field_values(to);
+        if (r < 0)
+                log_debug_errno(r, "Failed to write field values summary to %s, ignoring: %m", to->path);
+
+        r = journal_file_trim(to);
+        if (r < 0)
+                goto fail;
+
+        if (mmap_cache_got_sigbus(to->mmap, to->cache_fd)) {
+                r = -EIO;
+                goto fail;
+        }
+
+        to->archive = true;
+
+        *ret = to;
+        return 0;
+
+fail:
+        /* Don't close the fd on failure, like journal_file_open() */
+        to->close_fd = false;
+        (void) journal_file_close(to);
+
+        return r;
+}
+
 void journal_reset_metrics(JournalMetrics *m) {
         assert(m);
 
@@ -11,8 +11,10 @@
 #include "sd-event.h"
 #include "sd-id128.h"
 
+#include "compress.h"
 #include "hashmap.h"
 #include "journal-def.h"
+#include "list.h"
 #include "mmap-cache.h"
 #include "sparse-endian.h"
 #include "time-util.h"
@@ -56,6 +58,8 @@ typedef enum OfflineState {
         OFFLINE_DONE
 } OfflineState;
 
+typedef struct DataCache DataCache;
+
 typedef struct JournalFile {
         int fd;
         MMapFileDescriptor *cache_fd;
@@ -77,6 +81,7 @@ typedef struct JournalFile {
         direction_t last_direction;
         LocationType location_type;
         uint64_t last_n_entries;
+        unsigned merge_index; /* position in the sd_journal merge queue, when iterating in parallel mode */
 
         char *path;
         struct stat last_stat;
@@ -101,12 +106,31 @@ typedef struct JournalFile {
 
         OrderedHashmap *chain_cache;
 
-        pthread_t offline_thread;
+        DataCache *data_cache;
+        uint64_t data_cache_hits;
+        uint64_t data_cache_misses;
+
+        /* The result of the last lookup of journal_file_find_field_values() */
+        uint64_t field_values_field_offset;
+        uint64_t field_values_offset;
+
+        /* Protected by the mutex of the offline worker, see journal-file.c */
+        bool offline_queued;
+        LIST_FIELDS(struct JournalFile, offline_queue);
         volatile OfflineState offline_state;
 
+        /* Set by journal_file_archive(), the entry index and field values summary are then written as part
+         * of the offlining, possibly by the offline worker */
+        bool summaries_pending;
+        int summaries_error;
+
         unsigned last_seen_generation;
 
         uint64_t compress_threshold_bytes;
+        int compress_level;
+        CompressDictionary *compress_dictionary;
+        /* Set while the dictionary of a newly created file is trained in the background */
+        struct DictionaryTraining *dictionary_training;
 #if HAVE_COMPRESSION
         void *compress_buffer;
         size_t compress_buffer_size;
@@ -146,6 +170,7 @@ int journal_file_open(
 
 int journal_file_set_offline(JournalFile *f, bool wait);
 bool journal_file_is_offlining(JournalFile *f);
+unsigned journal_file_offline_queue_depth(void);
 JournalFile* journal_file_close(JournalFile *j);
 int journal_file_fstat(JournalFile *f);
 DEFINE_TRIVIAL_CLEANUP_FUNC(JournalFile*, journal_file_close);
@@ -191,6 +216,12 @@ static inline bool VALID_EPOCH(uint64_t u) {
 #define JOURNAL_HEADER_SEALED(h) \
         FLAGS_SET(le32toh((h)->compatible_flags), HEADER_COMPATIBLE_SEALED)
 
+#define JOURNAL_HEADER_ENTRY_INDEX(h) \
+        FLAGS_SET(le32toh((h)->compatible_flags), HEADER_COMPATIBLE_ENTRY_INDEX)
+
+#define JOURNAL_HEADER_FIELD_VALUES(h) \
+        FLAGS_SET(le32toh((h)->compatible_flags), HEADER_COMPATIBLE_FIELD_VALUES)
+
 #define JOURNAL_HEADER_COMPRESSED_XZ(h) \
         FLAGS_SET(le32toh((h)->incompatible_flags), HEADER_INCOMPATIBLE_COMPRESSED_XZ)
 
@@ -200,6 +231,9 @@ static inline bool VALID_EPOCH(uint64_t u) {
 #define JOURNAL_HEADER_COMPRESSED_ZSTD(h) \
         FLAGS_SET(le32toh((h)->incompatible_flags), HEADER_INCOMPATIBLE_COMPRESSED_ZSTD)
 
+#define JOURNAL_HEADER_ZSTD_DICTIONARY(h) \
+        FLAGS_SET(le32toh((h)->incompatible_flags), HEADER_INCOMPATIBLE_ZSTD_DICTIONARY)
+
 #define JOURNAL_HEADER_KEYED_HASH(h) \
         FLAGS_SET(le32toh((h)->incompatible_flags), HEADER_INCOMPATIBLE_KEYED_HASH)
 
@@ -207,6 +241,7 @@ int journal_file_move_to_object(JournalFile *f, ObjectType type, uint64_t offset
 
 uint64_t journal_file_entry_n_items(Object *o) _pure_;
 uint64_t journal_file_entry_array_n_items(Object *o) _pure_;
+uint64_t journal_file_entry_index_n_items(Object *o) _pure_;
 uint64_t journal_file_hash_table_n_items(Object *o) _pure_;
 
 int journal_file_append_object(JournalFile *f, ObjectType type, uint64_t size, Object **ret, uint64_t *offset);
@@ -219,12 +254,28 @@ int journal_file_append_entry(
                 Object **ret,
                 uint64_t *offset);
 
+typedef struct JournalBatchEntry {
+        dual_timestamp ts;
+        const struct iovec *iovec;
+        unsigned n_iovec;
+} JournalBatchEntry;
+
+int journal_file_append_entries(
+                JournalFile *f,
+                const JournalBatchEntry entries[], size_t n_entries,
+                uint64_t *seqno,
+                size_t *ret_n_appended);
+
 int journal_file_find_data_object(JournalFile *f, const void *data, uint64_t size, Object **ret, uint64_t *offset);
 int journal_file_find_data_object_with_hash(JournalFile *f, const void *data, uint64_t size, uint64_t hash, Object **ret, uint64_t *offset);
 
 int journal_file_find_field_object(JournalFile *f, const void *field, uint64_t size, Object **ret, uint64_t *offset);
 int journal_file_find_field_object_with_hash(JournalFile *f, const void *field, uint64_t size, uint64_t hash, Object **ret, uint64_t *offset);
 
+int journal_file_find_field_values(JournalFile *f, const void *field, uint64_t size, Object **ret, uint64_t *offset);
+int journal_file_field_values_get(Object *o, uint64_t i, const void **ret_data, size_t *ret_size);
+int journal_file_field_values_contains(Object *o, const void *data, size_t size);
+
 void journal_file_reset_location(JournalFile *f);
 void journal_file_save_location(JournalFile *f, Object *o, uint64_t offset);
 int journal_file_compare_locations(JournalFile *af, JournalFile *bf);
@@ -241,7 +292,8 @@ int journal_file_move_to_entry_by_seqnum_for_data(JournalFile *f, uint64_t data_
 int journal_file_move_to_entry_by_realtime_for_data(JournalFile *f, uint64_t data_offset, uint64_t realtime, direction_t direction, Object **ret, uint64_t *offset);
 int journal_file_move_to_entry_by_monotonic_for_data(JournalFile *f, uint64_t data_offset, sd_id128_t boot_id, uint64_t monotonic, direction_t direction, Object **ret, uint64_t *offset);
 
-int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint64_t p);
+int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint64_t p, uint64_t *seqnum);
+int journal_file_compact(JournalFile *from, int fd, const char *fname, JournalFile **ret);
 
 void journal_file_dump(JournalFile *f);
 void journal_file_print_header(JournalFile *f);
@@ -266,6 +318,8 @@ bool journal_file_rotate_suggested(JournalFile *f, usec_t max_file_usec);
 int journal_file_map_data_hash_table(JournalFile *f);
 int journal_file_map_field_hash_table(JournalFile *f);
 
+CompressDictionary* journal_file_compress_dictionary(JournalFile *f);
+
 static inline bool JOURNAL_FILE_COMPRESS(JournalFile *f) {
         assert(f);
         return f->compress_xz || f->compress_lz4 || f->compress_zstd;
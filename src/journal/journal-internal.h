@@ -12,6 +12,7 @@
 #include "journal-def.h"
 #include "journal-file.h"
 #include "list.h"
+#include "prioq.h"
 #include "set.h"
 
 typedef struct Match Match;
@@ -93,6 +94,8 @@ struct sd_journal {
         char *unique_field;
         JournalFile *unique_file;
         uint64_t unique_offset;
+        uint64_t unique_values_offset; /* if the file has a summary of the field's values, its offset */
+        uint64_t unique_values_index;
 
         /* Iterating through known fields */
         JournalFile *fields_file;
@@ -120,6 +123,11 @@ struct sd_journal {
         Hashmap *directories_by_wd;
 
         Hashmap *errors;
+
+        /* Only used with SD_JOURNAL_PARALLEL: files with a candidate entry, ordered by location */
+        Prioq *merge_queue;
+        direction_t merge_direction;
+        bool merge_queue_dirty;
 };
 
 char *journal_make_match_string(sd_journal *j);
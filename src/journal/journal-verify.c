@@ -16,6 +16,7 @@
 #include "journal-verify.h"
 #include "lookup3.h"
 #include "macro.h"
+#include "memory-util.h"
 #include "terminal-util.h"
 #include "tmpfile-util.h"
 #include "util.h"
@@ -154,6 +155,7 @@ static int journal_file_object_verify(JournalFile *f, uint64_t offset, Object *o
                         size_t alloc = 0, b_size;
 
                         r = decompress_blob(compression,
+                                            journal_file_compress_dictionary(f),
                                             o->data.payload,
                                             le64toh(o->object.size) - offsetof(Object, data.payload),
                                             &b, &alloc, &b_size, 0);
@@ -345,6 +347,69 @@ static int journal_file_object_verify(JournalFile *f, uint64_t offset, Object *o
                 }
 
                 break;
+
+        case OBJECT_ENTRY_INDEX:
+                if ((le64toh(o->object.size) - offsetof(EntryIndexObject, items)) % sizeof(EntryIndexItem) != 0 ||
+                    (le64toh(o->object.size) - offsetof(EntryIndexObject, items)) / sizeof(EntryIndexItem) <= 0) {
+                        error(offset,
+                              "Invalid object entry index size: %"PRIu64,
+                              le64toh(o->object.size));
+                        return -EBADMSG;
+                }
+
+                for (i = 0; i < journal_file_entry_index_n_items(o); i++)
+                        if (!VALID64(le64toh(o->entry_index.items[i].entry_array_offset)) ||
+                            le64toh(o->entry_index.items[i].n_entries) <= 0) {
+                                error(offset,
+                                      "Invalid object entry index item (%"PRIu64"/%"PRIu64"): entry_array_offset="OFSfmt" n_entries=%"PRIu64,
+                                      i, journal_file_entry_index_n_items(o),
+                                      le64toh(o->entry_index.items[i].entry_array_offset),
+                                      le64toh(o->entry_index.items[i].n_entries));
+                                return -EBADMSG;
+                        }
+
+                break;
+
+        case OBJECT_COMPRESSION_DICTIONARY:
+                if (le64toh(o->object.size) <= offsetof(CompressionDictionaryObject, payload)) {
+                        error(offset,
+                              "Invalid object compression dictionary size: %"PRIu64,
+                              le64toh(o->object.size));
+                        return -EBADMSG;
+                }
+
+                break;
+
+        case OBJECT_FIELD_VALUES: {
+                const void *prev = NULL;
+                size_t prev_size = 0;
+
+                for (i = 0; i < le64toh(o->field_values.n_items); i++) {
+                        const void *v;
+                        size_t l;
+                        int r;
+
+                        r = journal_file_field_values_get(o, i, &v, &l);
+                        if (r < 0) {
+                                error_errno(offset, r, "Invalid field values item (%"PRIu64"/%"PRIu64"): %m",
+                                            i, le64toh(o->field_values.n_items));
+                                return r;
+                        }
+
+                        if (prev &&
+                            (memcmp_safe(prev, v, MIN(prev_size, l)) > 0 ||
+                             (memcmp_safe(prev, v, MIN(prev_size, l)) == 0 && prev_size >= l))) {
+                                error(offset, "Field values item (%"PRIu64"/%"PRIu64") out of order",
+                                      i, le64toh(o->field_values.n_items));
+                                return -EBADMSG;
+                        }
+
+                        prev = v;
+                        prev_size = l;
+                }
+
+                break;
+        }
         }
 
         return 0;
@@ -799,6 +864,197 @@ static int verify_entry_array(
         return 0;
 }
 
+static int verify_field_values(JournalFile *f, uint64_t n_field_values) {
+        uint64_t q, n = 0;
+        Object *o;
+        int r;
+
+        assert(f);
+
+        /* Check that the summary covers exactly the values of each field, see
+         * journal_file_append_field_values() */
+
+        q = le64toh(f->header->field_values_offset);
+        while (q > 0) {
+                _cleanup_free_ void *field = NULL;
+                uint64_t i, k, p, fp, m = 0;
+                size_t l, field_size;
+                const void *v;
+
+                if (n >= n_field_values) {
+                        error(q, "Field values chain too long");
+                        return -EBADMSG;
+                }
+                n++;
+
+                r = journal_file_move_to_object(f, OBJECT_FIELD_VALUES, q, &o);
+                if (r < 0) {
+                        error_errno(q, r, "Invalid field values object: %m");
+                        return r;
+                }
+
+                fp = le64toh(o->field_values.field_offset);
+                k = le64toh(o->field_values.n_items);
+
+                r = journal_file_move_to_object(f, OBJECT_FIELD, fp, &o);
+                if (r < 0) {
+                        error_errno(q, r, "Invalid field object in field values: %m");
+                        return r;
+                }
+
+                field_size = le64toh(o->object.size) - offsetof(FieldObject, payload);
+                field = memdup(o->field.payload, field_size);
+                if (!field)
+                        return -ENOMEM;
+
+                r = journal_file_move_to_object(f, OBJECT_FIELD, fp, &o);
+                if (r < 0)
+                        return r;
+
+                for (p = le64toh(o->field.head_data_offset); p > 0; p = le64toh(o->data.next_field_offset)) {
+                        if (m >= k) {
+                                error(q, "Field values summary lacks values of field");
+                                return -EBADMSG;
+                        }
+                        m++;
+
+                        r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                        if (r < 0)
+                                return r;
+                }
+
+                if (m != k) {
+                        error(q, "Field values summary has %"PRIu64" values, field %"PRIu64, k, m);
+                        return -EBADMSG;
+                }
+
+                for (i = 0; i < k; i++) {
+                        r = journal_file_move_to_object(f, OBJECT_FIELD_VALUES, q, &o);
+                        if (r < 0)
+                                return r;
+
+                        r = journal_file_field_values_get(o, i, &v, &l);
+                        if (r < 0)
+                                return r;
+
+                        if (l <= field_size ||
+                            memcmp(v, field, field_size) != 0 ||
+                            ((const char*) v)[field_size] != '=') {
+                                error(q, "Field values item %"PRIu64" of %"PRIu64" belongs to another field", i, k);
+                                return -EBADMSG;
+                        }
+
+                        r = journal_file_find_data_object(f, v, l, NULL, NULL);
+                        if (r < 0)
+                                return r;
+                        if (r == 0) {
+                                error(q, "Field values item %"PRIu64" of %"PRIu64" has no data object", i, k);
+                                return -EBADMSG;
+                        }
+                }
+
+                r = journal_file_move_to_object(f, OBJECT_FIELD_VALUES, q, &o);
+                if (r < 0)
+                        return r;
+
+                q = le64toh(o->field_values.next_field_values_offset);
+        }
+
+        if (n != n_field_values) {
+                error(offsetof(Header, field_values_offset), "Unreferenced field values objects");
+                return -EBADMSG;
+        }
+
+        return 0;
+}
+
+static int verify_entry_index(
+                JournalFile *f,
+                MMapFileDescriptor *cache_entry_array_fd, uint64_t n_entry_arrays) {
+
+        uint64_t i, n, q, total = 0, last_array = 0, next_index = 0;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(cache_entry_array_fd);
+
+        q = le64toh(f->header->entry_index_offset);
+
+        r = journal_file_move_to_object(f, OBJECT_ENTRY_INDEX, q, &o);
+        if (r < 0) {
+                error_errno(q, r, "Invalid entry index: %m");
+                return r;
+        }
+
+        if (le64toh(o->entry_index.n_entries) != le64toh(f->header->n_entries)) {
+                error(q, "Entry index covers %"PRIu64" of %"PRIu64" entries",
+                      le64toh(o->entry_index.n_entries), le64toh(f->header->n_entries));
+                return -EBADMSG;
+        }
+
+        n = journal_file_entry_index_n_items(o);
+        for (i = 0; i < n; i++) {
+                EntryIndexItem item;
+                uint64_t a, p;
+                Object *e;
+
+                item = o->entry_index.items[i];
+                a = le64toh(item.entry_array_offset);
+
+                /* Stretches have to follow each other without gaps */
+                if (a != last_array) {
+                        if (a <= last_array || item.entry_array_index != 0) {
+                                error(q, "Entry index item %"PRIu64" of %"PRIu64" out of order", i, n);
+                                return -EBADMSG;
+                        }
+
+                        last_array = a;
+                } else if (le64toh(item.entry_array_index) != next_index) {
+                        error(q, "Entry index item %"PRIu64" of %"PRIu64" out of order", i, n);
+                        return -EBADMSG;
+                }
+                next_index = le64toh(item.entry_array_index) + le64toh(item.n_entries);
+                total += le64toh(item.n_entries);
+
+                if (!contains_uint64(f->mmap, cache_entry_array_fd, n_entry_arrays, a)) {
+                        error(q, "Invalid entry array in entry index item %"PRIu64" of %"PRIu64, i, n);
+                        return -EBADMSG;
+                }
+
+                r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY, a, &e);
+                if (r < 0)
+                        return r;
+
+                if (next_index > journal_file_entry_array_n_items(e)) {
+                        error(q, "Entry index item %"PRIu64" of %"PRIu64" exceeds entry array", i, n);
+                        return -EBADMSG;
+                }
+
+                p = le64toh(e->entry_array.items[le64toh(item.entry_array_index)]);
+                r = journal_file_move_to_object(f, OBJECT_ENTRY, p, &e);
+                if (r < 0)
+                        return r;
+
+                if (e->entry.seqnum != item.seqnum || e->entry.realtime != item.realtime) {
+                        error(q, "Entry index item %"PRIu64" of %"PRIu64" does not match entry", i, n);
+                        return -EBADMSG;
+                }
+
+                /* Pointer might have moved, reposition */
+                r = journal_file_move_to_object(f, OBJECT_ENTRY_INDEX, q, &o);
+                if (r < 0)
+                        return r;
+        }
+
+        if (total != le64toh(f->header->n_entries)) {
+                error(q, "Entry index covers %"PRIu64" of %"PRIu64" entries", total, le64toh(f->header->n_entries));
+                return -EBADMSG;
+        }
+
+        return 0;
+}
+
 int journal_file_verify(
                 JournalFile *f,
                 const char *key,
@@ -810,8 +1066,8 @@ int journal_file_verify(
 
         uint64_t entry_seqnum = 0, entry_monotonic = 0, entry_realtime = 0;
         sd_id128_t entry_boot_id;
-        bool entry_seqnum_set = false, entry_monotonic_set = false, entry_realtime_set = false, found_main_entry_array = false;
-        uint64_t n_weird = 0, n_objects = 0, n_entries = 0, n_data = 0, n_fields = 0, n_data_hash_tables = 0, n_field_hash_tables = 0, n_entry_arrays = 0, n_tags = 0;
+        bool entry_seqnum_set = false, entry_monotonic_set = false, entry_realtime_set = false, found_main_entry_array = false, found_entry_index = false, found_compression_dictionary = false;
+        uint64_t n_weird = 0, n_objects = 0, n_entries = 0, n_data = 0, n_fields = 0, n_data_hash_tables = 0, n_field_hash_tables = 0, n_entry_arrays = 0, n_tags = 0, n_field_values = 0;
         usec_t last_usec = 0;
         int data_fd = -1, entry_fd = -1, entry_array_fd = -1;
         MMapFileDescriptor *cache_data_fd = NULL, *cache_entry_fd = NULL, *cache_entry_array_fd = NULL;
@@ -1076,6 +1332,43 @@ int journal_file_verify(
                         n_entry_arrays++;
                         break;
 
+                case OBJECT_ENTRY_INDEX:
+                        if (!JOURNAL_HEADER_ENTRY_INDEX(f->header) ||
+                            !JOURNAL_HEADER_CONTAINS(f->header, entry_index_offset) ||
+                            p != le64toh(f->header->entry_index_offset) ||
+                            found_entry_index) {
+                                error(p, "Unreferenced or duplicate entry index");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+
+                        found_entry_index = true;
+                        break;
+
+                case OBJECT_COMPRESSION_DICTIONARY:
+                        if (!JOURNAL_HEADER_ZSTD_DICTIONARY(f->header) ||
+                            !JOURNAL_HEADER_CONTAINS(f->header, compression_dictionary_offset) ||
+                            p != le64toh(f->header->compression_dictionary_offset) ||
+                            found_compression_dictionary) {
+                                error(p, "Unreferenced or duplicate compression dictionary");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+
+                        found_compression_dictionary = true;
+                        break;
+
+                case OBJECT_FIELD_VALUES:
+                        if (!JOURNAL_HEADER_FIELD_VALUES(f->header) ||
+                            !JOURNAL_HEADER_CONTAINS(f->header, field_values_offset)) {
+                                error(p, "Field values object in file without field values summary");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+
+                        n_field_values++;
+                        break;
+
                 case OBJECT_TAG:
                         if (!JOURNAL_HEADER_SEALED(f->header)) {
                                 error(p, "Tag object in file without sealing");
@@ -1228,6 +1521,28 @@ int journal_file_verify(
                 goto fail;
         }
 
+        if (!found_entry_index &&
+            (JOURNAL_HEADER_ENTRY_INDEX(f->header) ||
+             (JOURNAL_HEADER_CONTAINS(f->header, entry_index_offset) &&
+              le64toh(f->header->entry_index_offset) != 0))) {
+                error(offsetof(Header, entry_index_offset), "Missing entry index");
+                r = -EBADMSG;
+                goto fail;
+        }
+
+        if (JOURNAL_HEADER_FIELD_VALUES(f->header) !=
+            (JOURNAL_HEADER_CONTAINS(f->header, field_values_offset) && le64toh(f->header->field_values_offset) != 0)) {
+                error(offsetof(Header, field_values_offset), "Field values summary doesn't match header flag");
+                r = -EBADMSG;
+                goto fail;
+        }
+
+        if (!found_compression_dictionary && JOURNAL_HEADER_ZSTD_DICTIONARY(f->header)) {
+                error(offsetof(Header, compression_dictionary_offset), "Missing compression dictionary");
+                r = -EBADMSG;
+                goto fail;
+        }
+
         if (entry_seqnum_set &&
             entry_seqnum != le64toh(f->header->tail_entry_seqnum)) {
                 error(offsetof(Header, tail_entry_seqnum), "Invalid tail seqnum");
@@ -1266,6 +1581,18 @@ int journal_file_verify(
         if (r < 0)
                 goto fail;
 
+        if (found_entry_index) {
+                r = verify_entry_index(f, cache_entry_array_fd, n_entry_arrays);
+                if (r < 0)
+                        goto fail;
+        }
+
+        if (JOURNAL_HEADER_CONTAINS(f->header, field_values_offset)) {
+                r = verify_field_values(f, n_field_values);
+                if (r < 0)
+                        goto fail;
+        }
+
         r = verify_hash_table(f,
                               cache_data_fd, n_data,
                               cache_entry_fd, n_entries,
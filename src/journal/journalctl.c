@@ -29,6 +29,7 @@
 #include "bus-util.h"
 #include "catalog.h"
 #include "chattr-util.h"
+#include "copy.h"
 #include "def.h"
 #include "device-private.h"
 #include "fd-util.h"
@@ -137,6 +138,7 @@ static enum {
         ACTION_PRINT_HEADER,
         ACTION_SETUP_KEYS,
         ACTION_VERIFY,
+        ACTION_COMPACT,
         ACTION_DISK_USAGE,
         ACTION_LIST_CATALOG,
         ACTION_DUMP_CATALOG,
@@ -388,6 +390,7 @@ static int help(void) {
                "     --vacuum-files=INT      Leave only the specified number of journal files\n"
                "     --vacuum-time=TIME      Remove journal files older than specified time\n"
                "     --verify                Verify journal file consistency\n"
+               "     --compact               Rewrite archived journal files densely\n"
                "     --sync                  Synchronize unwritten journal messages to disk\n"
                "     --relinquish-var        Stop logging to disk, log to temporary file system\n"
                "     --smart-relinquish-var  Similar, but NOP if log directory is on root mount\n"
@@ -428,6 +431,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_INTERVAL,
                 ARG_VERIFY,
                 ARG_VERIFY_KEY,
+                ARG_COMPACT,
                 ARG_DISK_USAGE,
                 ARG_AFTER_CURSOR,
                 ARG_CURSOR_FILE,
@@ -487,6 +491,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "interval",             required_argument, NULL, ARG_INTERVAL             },
                 { "verify",               no_argument,       NULL, ARG_VERIFY               },
                 { "verify-key",           required_argument, NULL, ARG_VERIFY_KEY           },
+                { "compact",              no_argument,       NULL, ARG_COMPACT              },
                 { "disk-usage",           no_argument,       NULL, ARG_DISK_USAGE           },
                 { "cursor",               required_argument, NULL, 'c'                      },
                 { "cursor-file",          required_argument, NULL, ARG_CURSOR_FILE          },
@@ -741,6 +746,10 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_action = ACTION_VERIFY;
                         break;
 
+                case ARG_COMPACT:
+                        arg_action = ACTION_COMPACT;
+                        break;
+
                 case ARG_DISK_USAGE:
                         arg_action = ACTION_DISK_USAGE;
                         break;
@@ -2015,6 +2024,109 @@ static int verify(sd_journal *j) {
         return r;
 }
 
+static int compact_file(JournalFile *f) {
+        char a[FORMAT_BYTES_MAX], b[FORMAT_BYTES_MAX];
+        _cleanup_free_ char *t = NULL;
+        _cleanup_close_ int fd = -1;
+        JournalFile *c = NULL;
+        int r;
+
+        assert(f);
+
+        r = tempfn_random(f->path, NULL, &t);
+        if (r < 0)
+                return log_oom();
+
+        fd = open(t, O_RDWR|O_CREAT|O_EXCL|O_CLOEXEC|O_NOCTTY|O_NOFOLLOW, f->last_stat.st_mode & 07777);
+        if (fd < 0)
+                return log_error_errno(errno, "Failed to create %s: %m", t);
+
+        r = journal_file_compact(f, fd, t, &c);
+        if (r < 0) {
+                log_error_errno(r, "Failed to compact %s: %m", f->path);
+                goto fail;
+        }
+        TAKE_FD(fd); /* Donated to journal_file_compact() */
+
+        /* Closing the file marks it as archived and syncs it to disk */
+        (void) journal_file_close(c);
+
+        r = journal_file_open(-1, t, O_RDONLY, 0, false, 0, false, NULL, NULL, NULL, NULL, &c);
+        if (r < 0) {
+                log_error_errno(r, "Failed to open %s: %m", t);
+                goto fail;
+        }
+
+        r = journal_file_verify(c, NULL, NULL, NULL, NULL, false);
+        if (r < 0) {
+                log_error_errno(r, "Compacted journal file %s failed verification, leaving %s untouched: %m", t, f->path);
+                goto fail;
+        }
+
+        if (c->last_stat.st_size >= f->last_stat.st_size) {
+                log_info("Journal file %s is already compact.", f->path);
+                r = 0;
+                goto fail;
+        }
+
+        (void) fchown(c->fd, f->last_stat.st_uid, f->last_stat.st_gid);
+
+        /* Retain ACLs, and the creation time the vacuuming logic relies on */
+        r = copy_xattr(f->fd, c->fd);
+        if (r < 0)
+                log_debug_errno(r, "Failed to copy extended attributes of %s, ignoring: %m", f->path);
+
+        if (rename(t, f->path) < 0) {
+                r = log_error_errno(errno, "Failed to replace %s: %m", f->path);
+                goto fail;
+        }
+
+        (void) fsync_directory_of_file(c->fd);
+
+        log_info("Compacted %s from %s to %s.", f->path,
+                 format_bytes(a, sizeof(a), f->last_stat.st_size),
+                 format_bytes(b, sizeof(b), c->last_stat.st_size));
+
+        (void) journal_file_close(c);
+        return 1;
+
+fail:
+        (void) journal_file_close(c);
+        (void) unlink(t);
+        return r;
+}
+
+static int compact(sd_journal *j) {
+        int r = 0;
+        Iterator i;
+        JournalFile *f;
+
+        assert(j);
+
+        ORDERED_HASHMAP_FOREACH(f, j->files, i) {
+                const char *fn;
+                int k;
+
+                /* Only archived files won't be written to anymore, i.e. files that were rotated away
+                 * cleanly, or were disposed of after an unclean shutdown. */
+                fn = basename(f->path);
+                if (!endswith(fn, ".journal~") &&
+                    !(endswith(fn, ".journal") && strchr(fn, '@') && f->header->state == STATE_ARCHIVED))
+                        continue;
+
+                if (JOURNAL_HEADER_SEALED(f->header)) {
+                        log_notice("Journal file %s has sealing enabled, not compacting.", f->path);
+                        continue;
+                }
+
+                k = compact_file(f);
+                if (k < 0)
+                        r = k;
+        }
+
+        return r;
+}
+
 static int simple_varlink_call(const char *option, const char *method) {
         _cleanup_(varlink_flush_close_unrefp) Varlink *link = NULL;
         const char *error, *fn;
@@ -2183,6 +2295,7 @@ int main(int argc, char *argv[]) {
         case ACTION_SHOW:
         case ACTION_PRINT_HEADER:
         case ACTION_VERIFY:
+        case ACTION_COMPACT:
         case ACTION_DISK_USAGE:
         case ACTION_LIST_BOOTS:
         case ACTION_VACUUM:
@@ -2289,6 +2402,10 @@ int main(int argc, char *argv[]) {
                 r = verify(j);
                 goto finish;
 
+        case ACTION_COMPACT:
+                r = compact(j);
+                goto finish;
+
         case ACTION_DISK_USAGE: {
                 uint64_t bytes = 0;
                 char sbytes[FORMAT_BYTES_MAX];
@@ -404,6 +404,14 @@ int server_open_dev_kmsg(Server *s) {
                 goto fail;
         }
 
+        /* We read one record per dispatch, at a high priority. Don't let a flood of kernel messages starve
+         * the other sources entirely, the kernel's ring buffer holds on to them in the meantime. */
+        r = sd_event_source_set_ratelimit(s->dev_kmsg_event_source, 1 * USEC_PER_SEC, 5000);
+        if (r < 0) {
+                log_error_errno(r, "Failed to set rate limit of kmsg event source: %m");
+                goto fail;
+        }
+
         s->dev_kmsg_readable = true;
 
         return 0;
@@ -94,7 +94,7 @@ static void server_process_entry_meta(
 
 static int server_process_entry(
                 Server *s,
-                const void *buffer, size_t *remaining,
+                void *buffer, size_t *remaining,
                 ClientContext *context,
                 const struct ucred *ucred,
                 const struct timeval *tv,
@@ -103,20 +103,22 @@ static int server_process_entry(
         /* Process a single entry from a native message. Returns 0 if nothing special happened and the message
          * processing should continue, and a negative or positive value otherwise.
          *
-         * Note that *remaining is altered on both success and failure. */
+         * Note that *remaining is altered on both success and failure. Binary fields are rewritten in
+         * place in the buffer, so that all fields of the entry can be referenced from there without
+         * copying them. */
 
-        size_t n = 0, j, tn = (size_t) -1, m = 0, entry_size = 0;
+        size_t n = 0, m = 0, entry_size = 0;
         char *identifier = NULL, *message = NULL;
         struct iovec *iovec = NULL;
         int priority = LOG_INFO;
         pid_t object_pid = 0;
-        const char *p;
+        char *p;
         int r = 1;
 
         p = buffer;
 
         while (*remaining > 0) {
-                const char *e, *q;
+                char *e, *q;
 
                 e = memchr(p, '\n', *remaining);
 
@@ -173,7 +175,7 @@ static int server_process_entry(
 
                                 /* If the field name starts with an underscore, skip the variable, since that indicates
                                  * a trusted field */
-                                iovec[n++] = IOVEC_MAKE((char*) p, l);
+                                iovec[n++] = IOVEC_MAKE(p, l);
                                 entry_size += l;
 
                                 server_process_entry_meta(p, l, ucred,
@@ -214,28 +216,24 @@ static int server_process_entry(
                                 break;
                         }
 
-                        k = malloc(total);
-                        if (!k) {
-                                log_oom();
-                                break;
-                        }
-
-                        memcpy(k, p, e - p);
-                        k[e - p] = '=';
-                        memcpy(k + (e - p) + 1, e + 1 + sizeof(uint64_t), l);
-
                         if (journal_field_valid(p, e - p, false)) {
-                                iovec[n] = IOVEC_MAKE(k, (e - p) + 1 + l);
+                                /* The field name and the newline plus the 64bit size take up more room
+                                 * than the field name and "=", hence move the name up to right before
+                                 * the data, and reference the field in the buffer, instead of copying
+                                 * the data, which can be large. */
+                                k = memmove(p + sizeof(uint64_t), p, e - p);
+                                k[e - p] = '=';
+
+                                iovec[n] = IOVEC_MAKE(k, total);
                                 entry_size += iovec[n].iov_len;
                                 n++;
 
-                                server_process_entry_meta(k, (e - p) + 1 + l, ucred,
+                                server_process_entry_meta(k, total, ucred,
                                                           &priority,
                                                           &identifier,
                                                           &message,
                                                           &object_pid);
-                        } else
-                                free(k);
+                        }
 
                         *remaining -= (e - p) + 1 + sizeof(uint64_t) + l + 1;
                         p = e + 1 + sizeof(uint64_t) + l + 1;
@@ -245,8 +243,7 @@ static int server_process_entry(
         if (n <= 0)
                 goto finish;
 
-        tn = n++;
-        iovec[tn] = IOVEC_MAKE_STRING("_TRANSPORT=journal");
+        iovec[n++] = IOVEC_MAKE_STRING("_TRANSPORT=journal");
         entry_size += STRLEN("_TRANSPORT=journal");
 
         if (entry_size + n + 1 > ENTRY_SIZE_MAX) { /* data + separators + trailer */
@@ -276,15 +273,6 @@ static int server_process_entry(
         server_dispatch_message(s, iovec, n, m, context, tv, priority, object_pid);
 
 finish:
-        for (j = 0; j < n; j++)  {
-                if (j == tn)
-                        continue;
-
-                if (iovec[j].iov_base < buffer ||
-                    (const char*) iovec[j].iov_base >= p + *remaining)
-                        free(iovec[j].iov_base);
-        }
-
         free(iovec);
         free(identifier);
         free(message);
@@ -294,7 +282,7 @@ finish:
 
 void server_process_native_message(
                 Server *s,
-                const char *buffer, size_t buffer_size,
+                char *buffer, size_t buffer_size,
                 const struct ucred *ucred,
                 const struct timeval *tv,
                 const char *label, size_t label_len) {
@@ -314,7 +302,7 @@ void server_process_native_message(
 
         do {
                 r = server_process_entry(s,
-                                         (const uint8_t*) buffer + (buffer_size - remaining), &remaining,
+                                         (uint8_t*) buffer + (buffer_size - remaining), &remaining,
                                          context, ucred, tv, label, label_len);
         } while (r == 0);
 }
@@ -385,20 +373,33 @@ void server_process_native_file(
         }
 
         if (sealed) {
+                _cleanup_(pending_mapping_unrefp) PendingMapping *mapping = NULL;
                 void *p;
                 size_t ps;
 
-                /* The file is sealed, we can just map it and use it. */
+                /* The file is sealed, we can just map it and use it. The mapping is private, so that we
+                 * can rewrite the headers of binary fields in place, which only copies the pages touched
+                 * by that, and never changes the file itself. */
 
                 ps = PAGE_ALIGN(st.st_size);
-                p = mmap(NULL, ps, PROT_READ, MAP_PRIVATE, fd, 0);
+                p = mmap(NULL, ps, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
                 if (p == MAP_FAILED) {
                         log_error_errno(errno, "Failed to map memfd, ignoring: %m");
                         return;
                 }
 
+                mapping = pending_mapping_new(p, ps);
+                if (!mapping) {
+                        assert_se(munmap(p, ps) >= 0);
+                        log_oom();
+                        return;
+                }
+
+                /* The queued up entries reference the fields in the mapping rather than copying them, see
+                 * write_to_journal() */
+                s->dispatch_mapping = mapping;
                 server_process_native_message(s, p, st.st_size, ucred, tv, label, label_len);
-                assert_se(munmap(p, ps) >= 0);
+                s->dispatch_mapping = NULL;
         } else {
                 _cleanup_free_ void *p = NULL;
                 struct statvfs vfs;
@@ -17,8 +17,10 @@
 #include "alloc-util.h"
 #include "audit-util.h"
 #include "cgroup-util.h"
+#include "compress.h"
 #include "conf-parser.h"
 #include "dirent-util.h"
+#include "event-util.h"
 #include "extract-word.h"
 #include "fd-util.h"
 #include "fileio.h"
@@ -41,6 +43,7 @@
 #include "journald-stream.h"
 #include "journald-syslog.h"
 #include "log.h"
+#include "memory-util.h"
 #include "missing_audit.h"
 #include "mkdir.h"
 #include "parse-util.h"
@@ -288,6 +291,9 @@ static int open_journal(
         if (r < 0)
                 return r;
 
+        /* Files created by rotation inherit this from the file they replace */
+        f->compress_level = s->compress.level;
+
         r = journal_file_enable_post_change_timer(f, s->event, POST_CHANGE_TIMER_INTERVAL_USEC);
         if (r < 0)
                 return r;
@@ -636,11 +642,13 @@ void server_rotate(Server *s) {
                 (void) vacuum_offline_user_journals(s);
 
         server_process_deferred_closes(s);
+        server_update_status(s);
 }
 
 void server_sync(Server *s) {
         JournalFile *f;
         Iterator i;
+        unsigned n;
         int r;
 
         if (s->system_journal) {
@@ -655,6 +663,12 @@ void server_sync(Server *s) {
                         log_warning_errno(r, "Failed to sync user journal, ignoring: %m");
         }
 
+        n = journal_file_offline_queue_depth();
+        if (n > 0)
+                log_debug("%u journal files queued for offlining.", n);
+
+        server_update_status(s);
+
         if (s->sync_event_source) {
                 r = sd_event_source_set_enabled(s->sync_event_source, SD_EVENT_OFF);
                 if (r < 0)
@@ -743,6 +757,72 @@ static void server_cache_hostname(Server *s) {
         free_and_replace(s->hostname_field, x);
 }
 
+/* Upper bound on the number of messages we queue before writing them out, even if the event loop didn't get
+ * around to it yet because the log sources are flooded. */
+#define PENDING_ENTRIES_MAX 256U
+
+struct PendingEntry {
+        uid_t uid;
+        int priority;
+        dual_timestamp ts;
+        PendingMapping *mapping;
+        size_t n_iovec;
+        struct iovec iovec[];
+};
+
+struct PendingMapping {
+        unsigned n_ref;
+        void *p;
+        size_t size;
+};
+
+PendingMapping* pending_mapping_new(void *p, size_t size) {
+        PendingMapping *m;
+
+        /* Takes possession of the mapping, which is unmapped when the last reference is dropped */
+
+        m = new(PendingMapping, 1);
+        if (!m)
+                return NULL;
+
+        *m = (PendingMapping) {
+                .n_ref = 1,
+                .p = p,
+                .size = size,
+        };
+
+        return m;
+}
+
+static PendingMapping* pending_mapping_free(PendingMapping *m) {
+        assert(m);
+
+        assert_se(munmap(m->p, m->size) >= 0);
+        return mfree(m);
+}
+
+DEFINE_TRIVIAL_REF_UNREF_FUNC(PendingMapping, pending_mapping, pending_mapping_free);
+
+static bool pending_mapping_contains(PendingMapping *m, const struct iovec *iovec) {
+        uintptr_t b, q;
+
+        if (!m)
+                return false;
+
+        b = (uintptr_t) m->p;
+        q = (uintptr_t) iovec->iov_base;
+
+        return q >= b && q - b <= m->size && iovec->iov_len <= m->size - (q - b);
+}
+
+static PendingEntry* pending_entry_free(PendingEntry *e) {
+        if (!e)
+                return NULL;
+
+        pending_mapping_unref(e->mapping);
+        return mfree(e);
+}
+
 static bool shall_try_append_again(JournalFile *f, int r) {
         switch(r) {
 
@@ -792,23 +872,32 @@ static bool shall_try_append_again(JournalFile *f, int r) {
         }
 }
 
-static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n, int priority) {
+static size_t write_pending_entries_run(Server *s, PendingEntry **entries, size_t n) {
+        _cleanup_free_ JournalBatchEntry *batch = NULL;
         bool vacuumed = false, rotate = false;
-        struct dual_timestamp ts;
+        size_t i, k, done = 0, done_retry = 0;
+        int priority = LOG_DEBUG;
         JournalFile *f;
+        uid_t uid;
         int r;
 
         assert(s);
-        assert(iovec);
+        assert(entries);
         assert(n > 0);
 
-        /* Get the closest, linearized time we have for this log event from the event loop. (Note that we do not use
-         * the source time, and not even the time the event was originally seen, but instead simply the time we started
-         * processing it, as we want strictly linear ordering in what we write out.) */
-        assert_se(sd_event_now(s->event, CLOCK_REALTIME, &ts.realtime) >= 0);
-        assert_se(sd_event_now(s->event, CLOCK_MONOTONIC, &ts.monotonic) >= 0);
+        /* Writes out a run of consecutive pending entries destined for the same journal file in one
+         * batch. Returns the number of pending entries consumed, which is always at least one. */
+
+        uid = entries[0]->uid;
+
+        /* A run ends where the next entry goes to a different file, or where time jumps backwards, since
+         * the latter requires rotation before we may write it, see below. */
+        for (k = 1; k < n; k++)
+                if (entries[k]->uid != uid ||
+                    entries[k]->ts.realtime < entries[k-1]->ts.realtime)
+                        break;
 
-        if (ts.realtime < s->last_realtime_clock) {
+        if (entries[0]->ts.realtime < s->last_realtime_clock) {
                 /* When the time jumps backwards, let's immediately rotate. Of course, this should not happen during
                  * regular operation. However, when it does happen, then we should make sure that we start fresh files
                  * to ensure that the entries in the journal files are strictly ordered by time, in order to ensure
@@ -820,7 +909,7 @@ static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n
 
                 f = find_journal(s, uid);
                 if (!f)
-                        return;
+                        return k;
 
                 if (journal_file_rotate_suggested(f, s->max_file_usec)) {
                         log_debug("%s: Journal header limits reached or header out-of-date, rotating.", f->path);
@@ -835,20 +924,37 @@ static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n
 
                 f = find_journal(s, uid);
                 if (!f)
-                        return;
+                        return k;
+        }
+
+        batch = new(JournalBatchEntry, k);
+        if (!batch) {
+                log_oom();
+                return k;
+        }
+
+        for (i = 0; i < k; i++) {
+                batch[i] = (JournalBatchEntry) {
+                        .ts = entries[i]->ts,
+                        .iovec = entries[i]->iovec,
+                        .n_iovec = entries[i]->n_iovec,
+                };
+
+                priority = MIN(priority, LOG_PRI(entries[i]->priority));
         }
 
-        s->last_realtime_clock = ts.realtime;
+        s->last_realtime_clock = entries[k-1]->ts.realtime;
 
-        r = journal_file_append_entry(f, &ts, NULL, iovec, n, &s->seqnum, NULL, NULL);
+        r = journal_file_append_entries(f, batch, k, &s->seqnum, &done);
         if (r >= 0) {
                 server_schedule_sync(s, priority);
-                return;
+                return k;
         }
 
         if (vacuumed || !shall_try_append_again(f, r)) {
-                log_error_errno(r, "Failed to write entry (%zu items, %zu bytes), ignoring: %m", n, IOVEC_TOTAL_SIZE(iovec, n));
-                return;
+                log_error_errno(r, "Failed to write entry (%zu items, %zu bytes), ignoring: %m",
+                                entries[done]->n_iovec, IOVEC_TOTAL_SIZE(entries[done]->iovec, entries[done]->n_iovec));
+                return done + 1;
         }
 
         server_rotate(s);
@@ -856,14 +962,157 @@ static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n
 
         f = find_journal(s, uid);
         if (!f)
-                return;
+                return k;
 
         log_debug("Retrying write.");
-        r = journal_file_append_entry(f, &ts, NULL, iovec, n, &s->seqnum, NULL, NULL);
-        if (r < 0)
-                log_error_errno(r, "Failed to write entry (%zu items, %zu bytes) despite vacuuming, ignoring: %m", n, IOVEC_TOTAL_SIZE(iovec, n));
-        else
+        r = journal_file_append_entries(f, batch + done, k - done, &s->seqnum, &done_retry);
+        if (r >= 0) {
+                server_schedule_sync(s, priority);
+                return k;
+        }
+
+        done += done_retry;
+        log_error_errno(r, "Failed to write entry (%zu items, %zu bytes) despite vacuuming, ignoring: %m",
+                        entries[done]->n_iovec, IOVEC_TOTAL_SIZE(entries[done]->iovec, entries[done]->n_iovec));
+        if (done > 0)
                 server_schedule_sync(s, priority);
+
+        return done + 1;
+}
+
+static void server_write_pending_entries(Server *s) {
+        PendingEntry **entries;
+        size_t i, n;
+        int r;
+
+        assert(s);
+
+        if (s->n_pending_entries == 0)
+                return;
+
+        /* Take possession of the queue first: rotation, vacuuming and opening journal files might log
+         * messages of their own while we write, which are queued up anew. */
+        entries = TAKE_PTR(s->pending_entries);
+        n = s->n_pending_entries;
+        s->n_pending_entries = s->n_pending_entries_allocated = 0;
+
+        if (s->pending_entries_event_source) {
+                r = sd_event_source_set_enabled(s->pending_entries_event_source, SD_EVENT_OFF);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to disable pending entries event source, ignoring: %m");
+        }
+
+        for (i = 0; i < n; )
+                i += write_pending_entries_run(s, entries + i, n - i);
+
+        for (i = 0; i < n; i++)
+                pending_entry_free(entries[i]);
+        free(entries);
+}
+
+static int dispatch_pending_entries(sd_event_source *es, void *userdata) {
+        Server *s = userdata;
+
+        assert(s);
+
+        server_write_pending_entries(s);
+        return 0;
+}
+
+static int server_schedule_pending_entries(Server *s) {
+        int r;
+
+        assert(s);
+
+        if (!s->pending_entries_event_source) {
+                r = sd_event_add_defer(s->event, &s->pending_entries_event_source, dispatch_pending_entries, s);
+                if (r < 0)
+                        return r;
+
+                /* Run after the log sources (which are at NORMAL+5) are drained in this iteration, so that all
+                 * messages read in one go end up in the same batch, but before deferred synchronization
+                 * requests (which are at NORMAL+15). */
+                r = sd_event_source_set_priority(s->pending_entries_event_source, SD_EVENT_PRIORITY_NORMAL+10);
+                if (r < 0)
+                        return r;
+
+                (void) sd_event_source_set_description(s->pending_entries_event_source, "pending-entries");
+        }
+
+        return sd_event_source_set_enabled(s->pending_entries_event_source, SD_EVENT_ONESHOT);
+}
+
+static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n, int priority) {
+        bool referenced = false;
+        size_t i, copy = 0;
+        PendingEntry *e;
+        uint8_t *p;
+        int r;
+
+        assert(s);
+        assert(iovec);
+        assert(n > 0);
+
+        /* Messages are not written out immediately, but queued up and written in one batch once the log
+         * sources have been drained in the current event loop iteration. Since the iovecs passed in here
+         * usually point to stack memory, we need to copy them. The exception are fields in a memfd the
+         * message was received in: the entry takes a reference to its mapping instead, which keeps it
+         * around until the entry is written. */
+
+        for (i = 0; i < n; i++)
+                if (!pending_mapping_contains(s->dispatch_mapping, iovec + i))
+                        copy += iovec[i].iov_len;
+
+        if (!GREEDY_REALLOC(s->pending_entries, s->n_pending_entries_allocated, s->n_pending_entries + 1)) {
+                log_oom();
+                return;
+        }
+
+        e = malloc(offsetof(PendingEntry, iovec) + n * sizeof(struct iovec) + copy);
+        if (!e) {
+                log_oom();
+                return;
+        }
+
+        e->uid = uid;
+        e->priority = priority;
+        e->mapping = NULL;
+        e->n_iovec = n;
+
+        /* Get the closest, linearized time we have for this log event from the event loop. (Note that we do not use
+         * the source time, and not even the time the event was originally seen, but instead simply the time we started
+         * processing it, as we want strictly linear ordering in what we write out.) */
+        assert_se(sd_event_now(s->event, CLOCK_REALTIME, &e->ts.realtime) >= 0);
+        assert_se(sd_event_now(s->event, CLOCK_MONOTONIC, &e->ts.monotonic) >= 0);
+
+        p = (uint8_t*) (e->iovec + n);
+        for (i = 0; i < n; i++) {
+                if (pending_mapping_contains(s->dispatch_mapping, iovec + i)) {
+                        e->iovec[i] = iovec[i];
+                        referenced = true;
+                        continue;
+                }
+
+                memcpy_safe(p, iovec[i].iov_base, iovec[i].iov_len);
+                e->iovec[i] = IOVEC_MAKE(p, iovec[i].iov_len);
+                p += iovec[i].iov_len;
+        }
+
+        if (referenced)
+                e->mapping = pending_mapping_ref(s->dispatch_mapping);
+
+        s->pending_entries[s->n_pending_entries++] = e;
+
+        if (s->n_pending_entries >= PENDING_ENTRIES_MAX) {
+                server_write_pending_entries(s);
+                return;
+        }
+
+        r = server_schedule_pending_entries(s);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to schedule writing of pending entries, writing them immediately: %m");
+                server_write_pending_entries(s);
+        }
 }
 
 #define IOVEC_ADD_NUMERIC_FIELD(iovec, n, value, type, isset, format, field)  \
@@ -1137,6 +1386,13 @@ int server_flush_to_var(Server *s, bool require_flag_file) {
         if (require_flag_file && !flushed_flag_is_set(s))
                 return 0;
 
+        /* Note that the flush is done synchronously on the event loop, reading every entry of the runtime
+         * journal and writing it to the system journal. It's done once per boot, and only the fsync()s of
+         * the files closed along the way are left to the offline worker. */
+
+        /* Make sure everything that is still queued up ends up in the runtime journal before we copy it */
+        server_write_pending_entries(s);
+
         (void) system_journal_open(s, true, false);
 
         if (!s->system_journal)
@@ -1167,7 +1423,7 @@ int server_flush_to_var(Server *s, bool require_flag_file) {
                         goto finish;
                 }
 
-                r = journal_file_copy_entry(f, s->system_journal, o, f->current_offset);
+                r = journal_file_copy_entry(f, s->system_journal, o, f->current_offset, NULL);
                 if (r >= 0)
                         continue;
 
@@ -1186,7 +1442,7 @@ int server_flush_to_var(Server *s, bool require_flag_file) {
                 }
 
                 log_debug("Retrying write.");
-                r = journal_file_copy_entry(f, s->system_journal, o, f->current_offset);
+                r = journal_file_copy_entry(f, s->system_journal, o, f->current_offset, NULL);
                 if (r < 0) {
                         log_error_errno(r, "Can't write entry: %m");
                         goto finish;
@@ -1237,6 +1493,8 @@ static int server_relinquish_var(Server *s) {
 
         log_debug("Relinquishing %s...", s->system_storage.path);
 
+        server_write_pending_entries(s);
+
         (void) system_journal_open(s, false, true);
 
         s->system_journal = journal_file_close(s->system_journal);
@@ -1409,6 +1667,8 @@ static void server_full_rotate(Server *s) {
 
         assert(s);
 
+        server_write_pending_entries(s);
+
         server_rotate(s);
         server_vacuum(s, true);
 
@@ -1452,6 +1712,7 @@ static void server_full_sync(Server *s) {
 
         assert(s);
 
+        server_write_pending_entries(s);
         server_sync(s);
 
         /* Let clients know when the most recent sync happened. */
@@ -1800,12 +2061,34 @@ static int dispatch_notify_event(sd_event_source *es, int fd, uint32_t revents,
                 s->send_watchdog = false;
                 log_debug("Sent WATCHDOG=1 notification.");
 
+        } else if (s->send_status) {
+
+                char p[STRLEN("STATUS=Processing requests,  journal files queued for offlining...") + DECIMAL_STR_MAX(unsigned)];
+                ssize_t l;
+
+                if (s->notified_offline_queue_depth > 0)
+                        xsprintf(p, "STATUS=Processing requests, %u journal files queued for offlining...",
+                                 s->notified_offline_queue_depth);
+                else
+                        strcpy(p, "STATUS=Processing requests...");
+
+                l = send(s->notify_fd, p, strlen(p), MSG_DONTWAIT);
+                if (l < 0) {
+                        if (errno == EAGAIN)
+                                return 0;
+
+                        return log_error_errno(errno, "Failed to send STATUS= notification message: %m");
+                }
+
+                s->send_status = false;
+                log_debug("Sent STATUS= notification.");
+
         } else if (s->stdout_streams_notify_queue)
                 /* Dispatch one stream notification event */
                 stdout_stream_send_notify(s->stdout_streams_notify_queue);
 
         /* Leave us enabled if there's still more to do. */
-        if (s->send_watchdog || s->stdout_streams_notify_queue)
+        if (s->send_watchdog || s->send_status || s->stdout_streams_notify_queue)
                 return 0;
 
         /* There was nothing to do anymore, let's turn ourselves off. */
@@ -1816,6 +2099,30 @@ static int dispatch_notify_event(sd_event_source *es, int fd, uint32_t revents,
         return 0;
 }
 
+void server_update_status(Server *s) {
+        unsigned n;
+        int r;
+
+        assert(s);
+
+        /* Queues a STATUS= notification if the number of files waiting for the offline worker changed since
+         * the last one. The worker doesn't notify us when it's done, hence this is refreshed on sync, rotation
+         * and watchdog pings only. */
+
+        n = journal_file_offline_queue_depth();
+        if (n == s->notified_offline_queue_depth)
+                return;
+
+        s->notified_offline_queue_depth = n;
+        s->send_status = true;
+
+        if (s->notify_event_source) {
+                r = sd_event_source_set_enabled(s->notify_event_source, SD_EVENT_ON);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to enable notify event source: %m");
+        }
+}
+
 static int dispatch_watchdog(sd_event_source *es, uint64_t usec, void *userdata) {
         Server *s = userdata;
         int r;
@@ -1823,6 +2130,7 @@ static int dispatch_watchdog(sd_event_source *es, uint64_t usec, void *userdata)
         assert(s);
 
         s->send_watchdog = true;
+        server_update_status(s);
 
         r = sd_event_source_set_enabled(s->notify_event_source, SD_EVENT_ON);
         if (r < 0)
@@ -2016,6 +2324,108 @@ static int vl_method_relinquish_var(Varlink *link, JsonVariant *parameters, Varl
         return varlink_reply(link, NULL);
 }
 
+static int append_file_statistics(JsonVariant **array, JournalFile *f) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        int r;
+
+        assert(array);
+
+        if (!f)
+                return 0;
+
+        r = json_build(&v, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("path", JSON_BUILD_STRING(f->path)),
+                                       JSON_BUILD_PAIR("dataCacheHits", JSON_BUILD_UNSIGNED(f->data_cache_hits)),
+                                       JSON_BUILD_PAIR("dataCacheMisses", JSON_BUILD_UNSIGNED(f->data_cache_misses))));
+        if (r < 0)
+                return r;
+
+        return json_variant_append_array(array, v);
+}
+
+static int append_event_source_statistics(JsonVariant **array, sd_event_source *s) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        sd_event_source_statistics st;
+        const char *description = NULL;
+        int64_t priority;
+        int r;
+
+        assert(array);
+        assert(s);
+
+        (void) sd_event_source_get_description(s, &description);
+
+        r = sd_event_source_get_priority(s, &priority);
+        if (r < 0)
+                return r;
+
+        r = sd_event_source_get_statistics(s, &st, sizeof(st));
+        if (r < 0)
+                return r;
+
+        r = json_build(&v, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("description", JSON_BUILD_STRING(description)),
+                                       JSON_BUILD_PAIR("type", JSON_BUILD_STRING(event_source_type_name(s))),
+                                       JSON_BUILD_PAIR("priority", JSON_BUILD_INTEGER(priority)),
+                                       JSON_BUILD_PAIR("dispatched", JSON_BUILD_UNSIGNED(st.n_dispatched)),
+                                       JSON_BUILD_PAIR("dispatchUSec", JSON_BUILD_UNSIGNED(st.dispatch_usec)),
+                                       JSON_BUILD_PAIR("dispatchMaxUSec", JSON_BUILD_UNSIGNED(st.dispatch_max_usec)),
+                                       JSON_BUILD_PAIR("pendingUSec", JSON_BUILD_UNSIGNED(st.pending_usec)),
+                                       JSON_BUILD_PAIR("pendingMaxUSec", JSON_BUILD_UNSIGNED(st.pending_max_usec))));
+        if (r < 0)
+                return r;
+
+        return json_variant_append_array(array, v);
+}
+
+static int vl_method_get_statistics(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+        _cleanup_(json_variant_unrefp) JsonVariant *files = NULL, *sources = NULL;
+        sd_event_source *es;
+        Server *s = userdata;
+        JournalFile *f;
+        Iterator i;
+        int r;
+
+        assert(link);
+        assert(s);
+
+        if (json_variant_elements(parameters) > 0)
+                return varlink_error_invalid_parameter(link, parameters);
+
+        r = json_variant_new_array(&files, NULL, 0);
+        if (r < 0)
+                return r;
+
+        r = append_file_statistics(&files, s->runtime_journal);
+        if (r < 0)
+                return r;
+
+        r = append_file_statistics(&files, s->system_journal);
+        if (r < 0)
+                return r;
+
+        ORDERED_HASHMAP_FOREACH(f, s->user_journals, i) {
+                r = append_file_statistics(&files, f);
+                if (r < 0)
+                        return r;
+        }
+
+        r = json_variant_new_array(&sources, NULL, 0);
+        if (r < 0)
+                return r;
+
+        EVENT_FOREACH_SOURCE(es, s->event) {
+                r = append_event_source_statistics(&sources, es);
+                if (r < 0)
+                        return r;
+        }
+
+        return varlink_replyb(link, JSON_BUILD_OBJECT(
+                                              JSON_BUILD_PAIR("files", JSON_BUILD_VARIANT(files)),
+                                              JSON_BUILD_PAIR("eventSources", JSON_BUILD_VARIANT(sources)),
+                                              JSON_BUILD_PAIR("offlineQueueDepth", JSON_BUILD_UNSIGNED(journal_file_offline_queue_depth()))));
+}
+
 static int vl_connect(VarlinkServer *server, Varlink *link, void *userdata) {
         Server *s = userdata;
 
@@ -2054,7 +2464,8 @@ static int server_open_varlink(Server *s, const char *socket, int fd) {
                         "io.systemd.Journal.Synchronize",   vl_method_synchronize,
                         "io.systemd.Journal.Rotate",        vl_method_rotate,
                         "io.systemd.Journal.FlushToVar",    vl_method_flush_to_var,
-                        "io.systemd.Journal.RelinquishVar", vl_method_relinquish_var);
+                        "io.systemd.Journal.RelinquishVar", vl_method_relinquish_var,
+                        "io.systemd.Journal.GetStatistics", vl_method_get_statistics);
         if (r < 0)
                 return r;
 
@@ -2288,6 +2699,12 @@ int server_init(Server *s, const char *namespace) {
         if (r < 0)
                 return log_error_errno(r, "Failed to create event loop: %m");
 
+        /* With many busy stdout streams, work through a batch of the ready ones per event loop iteration,
+         * instead of polling all of them again after each single one */
+        r = sd_event_set_dispatch_budget(s->event, 64);
+        if (r < 0)
+                return log_error_errno(r, "Failed to set event loop dispatch budget: %m");
+
         n = sd_listen_fds(true);
         if (n < 0)
                 return log_error_errno(n, "Failed to read listening file descriptors from environment: %m");
@@ -2467,6 +2884,8 @@ void server_maybe_append_tags(Server *s) {
 void server_done(Server *s) {
         assert(s);
 
+        server_write_pending_entries(s);
+
         free(s->namespace);
         free(s->namespace_field);
 
@@ -2499,6 +2918,7 @@ void server_done(Server *s) {
         sd_event_source_unref(s->notify_event_source);
         sd_event_source_unref(s->watchdog_event_source);
         sd_event_source_unref(s->idle_event_source);
+        sd_event_source_unref(s->pending_entries_event_source);
         sd_event_unref(s->event);
 
         safe_close(s->syslog_fd);
@@ -2515,6 +2935,10 @@ void server_done(Server *s) {
         if (s->kernel_seqnum)
                 munmap(s->kernel_seqnum, sizeof(uint64_t));
 
+        for (size_t i = 0; i < s->n_pending_entries; i++)
+                pending_entry_free(s->pending_entries[i]);
+        free(s->pending_entries);
+
         free(s->buffer);
         free(s->tty_path);
         free(s->cgroup_root);
@@ -2597,6 +3021,49 @@ int config_parse_line_max(
         return 0;
 }
 
+int config_parse_compress_level(
+                const char* unit,
+                const char *filename,
+                unsigned line,
+                const char *section,
+                unsigned section_line,
+                const char *lvalue,
+                int ltype,
+                const char *rvalue,
+                void *data,
+                void *userdata) {
+
+        int *level = data, v, r;
+
+        assert(filename);
+        assert(lvalue);
+        assert(rvalue);
+        assert(data);
+
+        if (isempty(rvalue)) {
+                *level = 0;
+                return 0;
+        }
+
+        r = safe_atoi(rvalue, &v);
+        if (r < 0) {
+                log_syntax(unit, LOG_WARNING, filename, line, r,
+                           "Failed to parse CompressLevel= value, ignoring: %s", rvalue);
+                return 0;
+        }
+
+        /* Without zstd support the setting has no effect, hence there's nothing to check it against */
+        r = compress_level_zstd_check(v);
+        if (r == -ERANGE) {
+                log_syntax(unit, LOG_WARNING, filename, line, r,
+                           "CompressLevel= value out of range for zstd, ignoring: %s", rvalue);
+                return 0;
+        }
+
+        *level = v;
+        return 0;
+}
+
 int config_parse_compress(
                 const char* unit,
                 const char *filename,
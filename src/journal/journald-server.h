@@ -7,6 +7,8 @@
 #include "sd-event.h"
 
 typedef struct Server Server;
+typedef struct PendingEntry PendingEntry;
+typedef struct PendingMapping PendingMapping;
 
 #include "conf-parser.h"
 #include "hashmap.h"
@@ -39,6 +41,7 @@ typedef enum SplitMode {
 typedef struct JournalCompressOptions {
         bool enabled;
         uint64_t threshold_bytes;
+        int level;
 } JournalCompressOptions;
 
 typedef struct JournalStorageSpace {
@@ -87,6 +90,7 @@ struct Server {
         sd_event_source *notify_event_source;
         sd_event_source *watchdog_event_source;
         sd_event_source *idle_event_source;
+        sd_event_source *pending_entries_event_source;
 
         JournalFile *runtime_journal;
         JournalFile *system_journal;
@@ -94,6 +98,13 @@ struct Server {
 
         uint64_t seqnum;
 
+        /* Messages received but not written yet, see write_to_journal() */
+        PendingEntry **pending_entries;
+        size_t n_pending_entries, n_pending_entries_allocated;
+
+        /* The mapped memfd the message currently being dispatched was received in, if any */
+        PendingMapping *dispatch_mapping;
+
         char *buffer;
         size_t buffer_size;
 
@@ -145,6 +156,7 @@ struct Server {
         bool dev_kmsg_readable:1;
 
         bool send_watchdog:1;
+        bool send_status:1;
         bool sent_notify_ready:1;
         bool sync_scheduled:1;
 
@@ -159,6 +171,9 @@ struct Server {
 
         usec_t watchdog_usec;
 
+        /* The number of files queued for offlining, as last reported with STATUS= */
+        unsigned notified_offline_queue_depth;
+
         usec_t last_realtime_clock;
 
         size_t line_max;
@@ -201,6 +216,7 @@ const struct ConfigPerfItem* journald_gperf_lookup(const char *key, GPERF_LEN_TY
 CONFIG_PARSER_PROTOTYPE(config_parse_storage);
 CONFIG_PARSER_PROTOTYPE(config_parse_line_max);
 CONFIG_PARSER_PROTOTYPE(config_parse_compress);
+CONFIG_PARSER_PROTOTYPE(config_parse_compress_level);
 
 const char *storage_to_string(Storage s) _const_;
 Storage storage_from_string(const char *s) _pure_;
@@ -218,6 +234,12 @@ void server_rotate(Server *s);
 int server_schedule_sync(Server *s, int priority);
 int server_flush_to_var(Server *s, bool require_flag_file);
 void server_maybe_append_tags(Server *s);
+void server_update_status(Server *s);
+
+PendingMapping* pending_mapping_new(void *p, size_t size);
+PendingMapping* pending_mapping_ref(PendingMapping *m);
+PendingMapping* pending_mapping_unref(PendingMapping *m);
+DEFINE_TRIVIAL_CLEANUP_FUNC(PendingMapping*, pending_mapping_unref);
 int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void *userdata);
 void server_space_usage_message(Server *s, JournalStorage *storage);
 
@@ -658,6 +658,13 @@ int stdout_stream_install(Server *s, int fd, StdoutStream **ret) {
         if (r < 0)
                 return log_error_errno(r, "Failed to adjust stdout event source priority: %m");
 
+        /* A single chatty service shouldn't be able to keep us from servicing everybody else's streams
+         * and sockets. Unlike RateLimitBurst= this doesn't drop anything, the data just stays in the
+         * socket buffer until the source is turned back on. */
+        r = sd_event_source_set_ratelimit(stream->event_source, 1 * USEC_PER_SEC, 1000);
+        if (r < 0)
+                return log_error_errno(r, "Failed to set rate limit of stdout event source: %m");
+
         stream->fd = fd;
 
         stream->server = s;
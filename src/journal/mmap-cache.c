@@ -7,6 +7,7 @@
 #include "alloc-util.h"
 #include "errno-util.h"
 #include "fd-util.h"
+#include "format-util.h"
 #include "hashmap.h"
 #include "list.h"
 #include "log.h"
@@ -30,6 +31,9 @@ struct Window {
         uint64_t offset;
         size_t size;
 
+        /* The madvise() advice we gave for the mapping, according to the access pattern */
+        int advice;
+
         MMapFileDescriptor *fd;
 
         LIST_FIELDS(Window, by_fd);
@@ -38,6 +42,13 @@ struct Window {
         LIST_HEAD(Context, contexts);
 };
 
+typedef enum AccessPattern {
+        ACCESS_UNKNOWN,
+        ACCESS_FORWARD,
+        ACCESS_BACKWARD,
+        ACCESS_RANDOM,
+} AccessPattern;
+
 struct Context {
         MMapCache *cache;
         unsigned id;
@@ -46,11 +57,21 @@ struct Context {
         LIST_FIELDS(Context, by_window);
 };
 
+/* The last window used for a context in a file, and the size to use for the next one, to adapt to the
+ * access pattern. This is tracked per file, since a cache is usually shared by all files of a journal, and
+ * walking them interleaved would otherwise look like random access. */
+typedef struct AccessState {
+        uint64_t last_offset;
+        uint64_t last_size;
+        uint64_t window_size;
+} AccessState;
+
 struct MMapFileDescriptor {
         MMapCache *cache;
         int fd;
         bool sigbus;
         LIST_HEAD(Window, windows);
+        AccessState access[MMAP_CACHE_MAX_CONTEXTS];
 };
 
 struct MMapCache {
@@ -58,6 +79,8 @@ struct MMapCache {
         unsigned n_windows;
 
         unsigned n_hit, n_missed;
+        unsigned n_sequential, n_random;
+        uint64_t mapped_size;
 
         Hashmap *fds;
         Context *contexts[MMAP_CACHE_MAX_CONTEXTS];
@@ -71,8 +94,11 @@ struct MMapCache {
 #if ENABLE_DEBUG_MMAP_CACHE
 /* Tiny windows increase mmap activity and the chance of exposing unsafe use. */
 # define WINDOW_SIZE (page_size())
+# define WINDOW_SIZE_MAX (page_size())
 #else
 # define WINDOW_SIZE (8ULL*1024ULL*1024ULL)
+/* Don't use up too much of the address space on 32bit */
+# define WINDOW_SIZE_MAX (sizeof(void*) > 4 ? 64ULL*1024ULL*1024ULL : WINDOW_SIZE)
 #endif
 
 MMapCache* mmap_cache_new(void) {
@@ -91,8 +117,10 @@ static void window_unlink(Window *w) {
 
         assert(w);
 
-        if (w->ptr)
+        if (w->ptr) {
                 munmap(w->ptr, w->size);
+                w->cache->mapped_size -= w->size;
+        }
 
         if (w->fd)
                 LIST_REMOVE(by_fd, w->fd->windows, w);
@@ -184,6 +212,7 @@ static Window *window_add(MMapCache *m, MMapFileDescriptor *f, int prot, bool ke
         };
 
         LIST_PREPEND(by_fd, f->windows, w);
+        m->mapped_size += size;
 
         return w;
 }
@@ -348,6 +377,45 @@ static int try_context(
         return 1;
 }
 
+static AccessPattern access_pattern(const AccessState *a, uint64_t offset, size_t size) {
+        assert(a);
+
+        if (a->last_size == 0)
+                return ACCESS_UNKNOWN;
+
+        /* Right behind the window we used last for this context in this file, or overlapping its end? */
+        if (offset >= a->last_offset && offset < a->last_offset + 2 * a->last_size)
+                return ACCESS_FORWARD;
+
+        /* Right before it, or overlapping its beginning? */
+        if (offset < a->last_offset && offset + size + a->last_size >= a->last_offset)
+                return ACCESS_BACKWARD;
+
+        return ACCESS_RANDOM;
+}
+
+static int access_pattern_to_advice(AccessPattern pattern, int prot) {
+        /* MADV_SEQUENTIAL lets the kernel drop pages soon after they were accessed, which is bad for files
+         * we write to, as we keep coming back to the hash tables and the tail of those. */
+        if (pattern == ACCESS_FORWARD && !(prot & PROT_WRITE))
+                return MADV_SEQUENTIAL;
+        if (pattern == ACCESS_RANDOM)
+                return MADV_RANDOM;
+
+        return MADV_NORMAL;
+}
+
+static void window_advise(Window *w, int advice) {
+        assert(w);
+
+        if (w->advice == advice)
+                return;
+
+        /* This is just a hint, hence ignore errors */
+        (void) madvise(w->ptr, w->size, advice);
+        w->advice = advice;
+}
+
 static int find_mmap(
                 MMapCache *m,
                 MMapFileDescriptor *f,
@@ -359,6 +427,8 @@ static int find_mmap(
                 void **ret,
                 size_t *ret_size) {
 
+        AccessPattern pattern;
+        AccessState *a;
         Window *w;
         Context *c;
 
@@ -384,6 +454,16 @@ static int find_mmap(
         context_attach_window(c, w);
         w->keep_always = w->keep_always || keep_always;
 
+        /* The window may have been mapped for a different access pattern, e.g. by a bisection, and now be
+         * walked through sequentially, or the other way round. Adjust the advice then. */
+        a = f->access + context;
+        pattern = access_pattern(a, offset, size);
+        if (pattern != ACCESS_UNKNOWN)
+                window_advise(w, access_pattern_to_advice(pattern, prot));
+
+        a->last_offset = w->offset;
+        a->last_size = w->size;
+
         *ret = (uint8_t*) w->ptr + (offset - w->offset);
         if (ret_size)
                 *ret_size = w->size - (offset - w->offset);
@@ -430,7 +510,9 @@ static int add_mmap(
                 void **ret,
                 size_t *ret_size) {
 
-        uint64_t woffset, wsize;
+        uint64_t woffset, wsize, wend;
+        AccessPattern pattern;
+        AccessState *a;
         Context *c;
         Window *w;
         void *d;
@@ -442,21 +524,56 @@ static int add_mmap(
         assert(size > 0);
         assert(ret);
 
+        c = context_add(m, context);
+        if (!c)
+                return -ENOMEM;
+
+        a = f->access + context;
+
+        /* Adapt the window size to the access pattern of the context in this file: if we missed right next
+         * to the window we mapped last for it, this is a sequential scan, hence let's map increasingly larger windows in
+         * the direction of the scan, and ask the kernel to read ahead. Otherwise it's most likely a
+         * bisection, which touches only very few pages of each window, hence go back to the default window
+         * size, and ask the kernel not to read around the pages we touch. Note that we don't go below the
+         * default size: the pages of a window are only faulted in when accessed, and smaller windows would
+         * just make us unmap and map again more often. */
+        pattern = access_pattern(a, offset, size);
+        switch (pattern) {
+
+        case ACCESS_FORWARD:
+        case ACCESS_BACKWARD:
+                a->window_size = MIN(a->window_size * 2, (uint64_t) WINDOW_SIZE_MAX);
+                m->n_sequential++;
+                break;
+
+        case ACCESS_RANDOM:
+                m->n_random++;
+                _fallthrough_;
+
+        default:
+                a->window_size = WINDOW_SIZE;
+        }
+
         woffset = offset & ~((uint64_t) page_size() - 1ULL);
-        wsize = size + (offset - woffset);
-        wsize = PAGE_ALIGN(wsize);
+        wend = PAGE_ALIGN(offset + size);
+        wsize = wend - woffset;
 
-        if (wsize < WINDOW_SIZE) {
+        if (wsize < a->window_size) {
                 uint64_t delta;
 
-                delta = PAGE_ALIGN((WINDOW_SIZE - wsize) / 2);
+                if (pattern == ACCESS_FORWARD)
+                        delta = 0;
+                else if (pattern == ACCESS_BACKWARD)
+                        delta = a->window_size - wsize;
+                else
+                        delta = PAGE_ALIGN((a->window_size - wsize) / 2);
 
-                if (delta > offset)
+                if (delta > woffset)
                         woffset = 0;
                 else
                         woffset -= delta;
 
-                wsize = WINDOW_SIZE;
+                wsize = a->window_size;
         }
 
         if (st) {
@@ -475,25 +592,26 @@ static int add_mmap(
         if (r < 0)
                 return r;
 
-        c = context_add(m, context);
-        if (!c)
-                goto outofmem;
-
         w = window_add(m, f, prot, keep_always, woffset, wsize, d);
-        if (!w)
-                goto outofmem;
+        if (!w) {
+                (void) munmap(d, wsize);
+                return -ENOMEM;
+        }
+
+        window_advise(w, access_pattern_to_advice(pattern, prot));
+        if (IN_SET(pattern, ACCESS_FORWARD, ACCESS_BACKWARD))
+                (void) madvise(d, wsize, MADV_WILLNEED);
 
         context_attach_window(c, w);
 
+        a->last_offset = woffset;
+        a->last_size = wsize;
+
         *ret = (uint8_t*) w->ptr + (offset - w->offset);
         if (ret_size)
                 *ret_size = w->size - (offset - w->offset);
 
         return 1;
-
-outofmem:
-        (void) munmap(d, wsize);
-        return -ENOMEM;
 }
 
 int mmap_cache_get(
@@ -549,6 +667,28 @@ unsigned mmap_cache_get_missed(MMapCache *m) {
         return m->n_missed;
 }
 
+unsigned mmap_cache_get_sequential(MMapCache *m) {
+        assert(m);
+
+        return m->n_sequential;
+}
+
+unsigned mmap_cache_get_random(MMapCache *m) {
+        assert(m);
+
+        return m->n_random;
+}
+
+void mmap_cache_stats_log_debug(MMapCache *m) {
+        char bytes[FORMAT_BYTES_MAX];
+
+        assert(m);
+
+        log_debug("mmap cache statistics: %u hit, %u miss (%u sequential, %u random), %u windows mapping %s",
+                  m->n_hit, m->n_missed, m->n_sequential, m->n_random, m->n_windows,
+                  format_bytes(bytes, sizeof(bytes), m->mapped_size));
+}
+
 static void mmap_cache_process_sigbus(MMapCache *m) {
         bool found = false;
         MMapFileDescriptor *f;
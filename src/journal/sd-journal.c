@@ -5,6 +5,8 @@
 #include <inttypes.h>
 #include <linux/magic.h>
 #include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stddef.h>
 #include <sys/inotify.h>
 #include <sys/vfs.h>
@@ -112,6 +114,7 @@ static void detach_location(sd_journal *j) {
 
         j->current_file = NULL;
         j->current_field = 0;
+        j->merge_queue_dirty = true;
 
         ORDERED_HASHMAP_FOREACH(f, j->files, i)
                 journal_file_reset_location(f);
@@ -749,7 +752,14 @@ static int next_with_matches(
                               direction, ret, offset);
 }
 
-static int next_beyond_location(sd_journal *j, JournalFile *f, direction_t direction) {
+typedef struct LocationPrefetch {
+        JournalFile *shadow;
+        bool done;
+        int result;
+        uint64_t offset;
+} LocationPrefetch;
+
+static int next_beyond_location(sd_journal *j, JournalFile *f, direction_t direction, const LocationPrefetch *prefetch) {
         Object *c;
         uint64_t cp, n_entries;
         int r;
@@ -781,9 +791,21 @@ static int next_beyond_location(sd_journal *j, JournalFile *f, direction_t direc
         } else {
                 f->last_direction = direction;
 
-                r = find_location_with_matches(j, f, direction, &c, &cp);
-                if (r <= 0)
-                        return r;
+                if (prefetch && prefetch->done) {
+                        /* The lookup was already done on a private copy of the file, just map the
+                         * resulting entry into our own cache. */
+                        if (prefetch->result <= 0)
+                                return prefetch->result;
+
+                        cp = prefetch->offset;
+                        r = journal_file_move_to_object(f, OBJECT_ENTRY, cp, &c);
+                        if (r < 0)
+                                return r;
+                } else {
+                        r = find_location_with_matches(j, f, direction, &c, &cp);
+                        if (r <= 0)
+                                return r;
+                }
 
                 journal_file_save_location(f, c, cp);
         }
@@ -817,48 +839,343 @@ static int next_beyond_location(sd_journal *j, JournalFile *f, direction_t direc
         }
 }
 
-static int real_journal_next(sd_journal *j, direction_t direction) {
-        JournalFile *new_file = NULL;
-        unsigned i, n_files;
-        const void **files;
-        Object *o;
+/* Upper bound on the number of threads we use to look up the initial location in each journal file,
+ * when SD_JOURNAL_PARALLEL is set. */
+#define PREFETCH_THREADS_MAX 16U
+
+typedef struct PrefetchQueue {
+        sd_journal *journal;
+        direction_t direction;
+        LocationPrefetch **items;
+        size_t n_items;
+        size_t next;
+} PrefetchQueue;
+
+static bool file_needs_find_location(JournalFile *f, direction_t direction) {
+        assert(f);
+
+        /* Mirrors the checks in next_beyond_location() */
+
+        if (f->last_direction != direction)
+                return true;
+
+        if (f->location_type == LOCATION_TAIL &&
+            le64toh(f->header->n_entries) == f->last_n_entries)
+                return false;
+
+        return f->current_offset == 0;
+}
+
+static int journal_open_shadow_file(JournalFile *f, JournalFile **ret) {
+        JournalFile *shadow;
+        MMapCache *m;
         int r;
 
-        assert_return(j, -EINVAL);
-        assert_return(!journal_pid_changed(j), -ECHILD);
+        assert(f);
+        assert(ret);
 
-        r = iterated_cache_get(j->files_cache, NULL, &files, &n_files);
+        /* The MMapCache and JournalFile objects are not thread-safe, hence give every thread its own
+         * view of the file. The fd is shared, and stays owned by the original object. */
+        m = mmap_cache_new();
+        if (!m)
+                return -ENOMEM;
+
+        r = journal_file_open(f->fd, f->path, O_RDONLY, 0, false, 0, false, NULL, m, NULL, NULL, &shadow);
+        mmap_cache_unref(m);
         if (r < 0)
                 return r;
 
+        shadow->close_fd = false;
+
+        *ret = shadow;
+        return 0;
+}
+
+static void *prefetch_thread(void *userdata) {
+        PrefetchQueue *q = userdata;
+
+        for (;;) {
+                LocationPrefetch *p;
+                Object *o;
+                size_t i;
+
+                i = __sync_fetch_and_add(&q->next, 1);
+                if (i >= q->n_items)
+                        break;
+
+                p = q->items[i];
+                p->result = find_location_with_matches(q->journal, p->shadow, q->direction, &o, &p->offset);
+        }
+
+        return NULL;
+}
+
+static int prefetch_locations(
+                sd_journal *j,
+                direction_t direction,
+                const void **files,
+                unsigned n_files,
+                LocationPrefetch **ret) {
+
+        _cleanup_free_ LocationPrefetch *prefetch = NULL;
+        _cleanup_free_ LocationPrefetch **items = NULL;
+        pthread_t threads[PREFETCH_THREADS_MAX];
+        sigset_t ss, saved_ss;
+        size_t n_candidates = 0, n_items = 0, n_threads = 0, i;
+        PrefetchQueue q;
+        long n_cpus;
+        int r;
+
+        assert(j);
+        assert(ret);
+
+        /* Looking up the initial location requires bisecting the entry arrays of each file (and of each
+         * matched data object), which is dominated by page faults when there are many archived files.
+         * These lookups are independent of each other, hence do them on a few threads, each on its own
+         * copy of the file. The results are applied to the real file objects by the caller, on this
+         * thread. The copies only live for the duration of this call. */
+
+        prefetch = new0(LocationPrefetch, n_files);
+        if (!prefetch)
+                return -ENOMEM;
+
+        for (i = 0; i < n_files; i++)
+                if (file_needs_find_location((JournalFile *) files[i], direction))
+                        n_candidates++;
+
+        /* Copying the files doesn't pay off if there's nothing to do in parallel */
+        n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (n_candidates < 2 || n_cpus < 2) {
+                *ret = TAKE_PTR(prefetch);
+                return 0;
+        }
+
+        items = new(LocationPrefetch*, n_candidates);
+        if (!items)
+                return -ENOMEM;
+
         for (i = 0; i < n_files; i++) {
-                JournalFile *f = (JournalFile *)files[i];
-                bool found;
+                JournalFile *f = (JournalFile *) files[i];
+
+                if (!file_needs_find_location(f, direction))
+                        continue;
 
-                r = next_beyond_location(j, f, direction);
+                r = journal_open_shadow_file(f, &prefetch[i].shadow);
+                if (r < 0) {
+                        /* Not fatal, next_beyond_location() will do the lookup itself then */
+                        log_debug_errno(r, "Failed to open private copy of journal file %s, ignoring: %m", f->path);
+                        continue;
+                }
+
+                items[n_items++] = prefetch + i;
+        }
+
+        q = (PrefetchQueue) {
+                .journal = j,
+                .direction = direction,
+                .items = items,
+                .n_items = n_items,
+        };
+
+        assert_se(sigfillset(&ss) >= 0);
+        /* Don't block SIGBUS since the threads access memory mapped files. */
+        assert_se(sigdelset(&ss, SIGBUS) >= 0);
+
+        /* If we can't block signals, this thread does all the work */
+        if (n_items > 1 && pthread_sigmask(SIG_BLOCK, &ss, &saved_ss) == 0) {
+                /* This thread participates too, hence one less. */
+                for (; n_threads < MIN3(n_items, (size_t) n_cpus, PREFETCH_THREADS_MAX) - 1; n_threads++) {
+                        r = pthread_create(threads + n_threads, NULL, prefetch_thread, &q);
+                        if (r > 0) {
+                                log_debug_errno(r, "Failed to start journal seek thread, continuing with %zu: %m", n_threads);
+                                break;
+                        }
+                }
+
+                assert_se(pthread_sigmask(SIG_SETMASK, &saved_ss, NULL) == 0);
+        }
+
+        (void) prefetch_thread(&q);
+
+        for (i = 0; i < n_threads; i++)
+                assert_se(pthread_join(threads[i], NULL) == 0);
+
+        for (i = 0; i < n_items; i++) {
+                items[i]->done = true;
+                items[i]->shadow = journal_file_close(items[i]->shadow);
+        }
+
+        *ret = TAKE_PTR(prefetch);
+        return 0;
+}
+
+static int journal_file_compare_locations_down(const void *a, const void *b) {
+        return journal_file_compare_locations((JournalFile *) a, (JournalFile *) b);
+}
+
+static int journal_file_compare_locations_up(const void *a, const void *b) {
+        return journal_file_compare_locations((JournalFile *) b, (JournalFile *) a);
+}
+
+static int merge_queue_add(sd_journal *j, JournalFile *f, direction_t direction, const LocationPrefetch *prefetch) {
+        int r;
+
+        assert(j);
+        assert(f);
+
+        r = next_beyond_location(j, f, direction, prefetch);
+        if (r < 0) {
+                log_debug_errno(r, "Can't iterate through %s, ignoring: %m", f->path);
+                remove_file_real(j, f);
+                return 0;
+        }
+        if (r == 0) {
+                f->location_type = LOCATION_TAIL;
+                return 0;
+        }
+
+        return prioq_put(j->merge_queue, f, &f->merge_index);
+}
+
+static int merge_queue_rebuild(sd_journal *j, direction_t direction, const void **files, unsigned n_files) {
+        _cleanup_free_ LocationPrefetch *prefetch = NULL;
+        JournalFile *f;
+        unsigned i;
+        int r;
+
+        assert(j);
+
+        PRIOQ_FOREACH_ITEM(j->merge_queue, f)
+                f->merge_index = PRIOQ_IDX_NULL;
+        j->merge_queue = prioq_free(j->merge_queue);
+
+        j->merge_queue = prioq_new(direction == DIRECTION_DOWN ?
+                                   journal_file_compare_locations_down :
+                                   journal_file_compare_locations_up);
+        if (!j->merge_queue)
+                return -ENOMEM;
+
+        r = prefetch_locations(j, direction, files, n_files, &prefetch);
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < n_files; i++) {
+                r = merge_queue_add(j, (JournalFile *) files[i], direction, prefetch + i);
+                if (r < 0)
+                        return r;
+        }
+
+        j->merge_direction = direction;
+        j->merge_queue_dirty = false;
+
+        return 0;
+}
+
+static int merge_queue_next(sd_journal *j, direction_t direction, const void **files, unsigned n_files, JournalFile **ret) {
+        JournalFile *f;
+        unsigned i;
+        int r;
+
+        assert(j);
+        assert(ret);
+
+        /* Like the loop in real_journal_next(), but keeps the files ordered by their candidate entry in a
+         * priority queue, so that only the file we picked last time needs to be advanced, instead of
+         * comparing the locations of all files on each step. */
+
+        if (!j->merge_queue || j->merge_queue_dirty || j->merge_direction != direction) {
+                r = merge_queue_rebuild(j, direction, files, n_files);
+                if (r < 0)
+                        return r;
+        } else
+                /* Archived files never change, but online ones might have gained new entries since we
+                 * reached their end. */
+                for (i = 0; i < n_files; i++) {
+                        f = (JournalFile *) files[i];
+
+                        if (f->merge_index != PRIOQ_IDX_NULL || f->header->state == STATE_ARCHIVED)
+                                continue;
+
+                        r = merge_queue_add(j, f, direction, NULL);
+                        if (r < 0)
+                                return r;
+                }
+
+        while ((f = prioq_peek(j->merge_queue))) {
+                r = next_beyond_location(j, f, direction, NULL);
                 if (r < 0) {
                         log_debug_errno(r, "Can't iterate through %s, ignoring: %m", f->path);
                         remove_file_real(j, f);
                         continue;
                 } else if (r == 0) {
+                        (void) prioq_remove(j->merge_queue, f, &f->merge_index);
                         f->location_type = LOCATION_TAIL;
                         continue;
                 }
 
-                if (!new_file)
-                        found = true;
-                else {
-                        int k;
-
-                        k = journal_file_compare_locations(f, new_file);
+                /* If the candidate entry of the file didn't change, the file is still first in line
+                 * and we found our entry. Otherwise, check the next file. */
+                r = prioq_reshuffle(j->merge_queue, f, &f->merge_index);
+                if (r < 0)
+                        return r;
 
-                        found = direction == DIRECTION_DOWN ? k < 0 : k > 0;
+                if (prioq_peek(j->merge_queue) == f) {
+                        *ret = f;
+                        return 1;
                 }
-
-                if (found)
-                        new_file = f;
         }
 
+        *ret = NULL;
+        return 0;
+}
+
+static int real_journal_next(sd_journal *j, direction_t direction) {
+        JournalFile *new_file = NULL;
+        unsigned i, n_files;
+        const void **files;
+        Object *o;
+        int r;
+
+        assert_return(j, -EINVAL);
+        assert_return(!journal_pid_changed(j), -ECHILD);
+
+        r = iterated_cache_get(j->files_cache, NULL, &files, &n_files);
+        if (r < 0)
+                return r;
+
+        if (FLAGS_SET(j->flags, SD_JOURNAL_PARALLEL)) {
+                r = merge_queue_next(j, direction, files, n_files, &new_file);
+                if (r < 0)
+                        return r;
+        } else
+                for (i = 0; i < n_files; i++) {
+                        JournalFile *f = (JournalFile *)files[i];
+                        bool found;
+
+                        r = next_beyond_location(j, f, direction, NULL);
+                        if (r < 0) {
+                                log_debug_errno(r, "Can't iterate through %s, ignoring: %m", f->path);
+                                remove_file_real(j, f);
+                                continue;
+                        } else if (r == 0) {
+                                f->location_type = LOCATION_TAIL;
+                                continue;
+                        }
+
+                        if (!new_file)
+                                found = true;
+                        else {
+                                int k;
+
+                                k = journal_file_compare_locations(f, new_file);
+
+                                found = direction == DIRECTION_DOWN ? k < 0 : k > 0;
+                        }
+
+                        if (found)
+                                new_file = f;
+                }
+
         if (!new_file)
                 return 0;
 
@@ -1363,6 +1680,7 @@ static int add_any_file(
         close_fd = false; /* the fd is now owned by the JournalFile object */
 
         f->last_seen_generation = j->generation;
+        j->merge_queue_dirty = true;
 
         track_file_disposition(j, f);
         check_network(j, f->fd);
@@ -1444,6 +1762,7 @@ static void remove_file_real(sd_journal *j, JournalFile *f) {
                 /* Jump to the next unique_file or NULL if that one was last */
                 j->unique_file = ordered_hashmap_next(j->files, j->unique_file->path);
                 j->unique_offset = 0;
+                j->unique_values_offset = 0;
                 if (!j->unique_file)
                         j->unique_file_lost = true;
         }
@@ -1455,6 +1774,8 @@ static void remove_file_real(sd_journal *j, JournalFile *f) {
                         j->fields_file_lost = true;
         }
 
+        (void) prioq_remove(j->merge_queue, f, &f->merge_index);
+
         (void) journal_file_close(f);
 
         j->current_invalidate_counter++;
@@ -1947,7 +2268,8 @@ static sd_journal *journal_new(int flags, const char *path, const char *namespac
          SD_JOURNAL_SYSTEM |                            \
          SD_JOURNAL_CURRENT_USER |                      \
          SD_JOURNAL_ALL_NAMESPACES |                    \
-         SD_JOURNAL_INCLUDE_DEFAULT_NAMESPACE)
+         SD_JOURNAL_INCLUDE_DEFAULT_NAMESPACE |         \
+         SD_JOURNAL_PARALLEL)
 
 _public_ int sd_journal_open_namespace(sd_journal **ret, const char *namespace, int flags) {
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
@@ -1973,7 +2295,7 @@ _public_ int sd_journal_open(sd_journal **ret, int flags) {
 }
 
 #define OPEN_CONTAINER_ALLOWED_FLAGS                    \
-        (SD_JOURNAL_LOCAL_ONLY | SD_JOURNAL_SYSTEM)
+        (SD_JOURNAL_LOCAL_ONLY | SD_JOURNAL_SYSTEM | SD_JOURNAL_PARALLEL)
 
 _public_ int sd_journal_open_container(sd_journal **ret, const char *machine, int flags) {
         _cleanup_free_ char *root = NULL, *class = NULL;
@@ -2017,7 +2339,8 @@ _public_ int sd_journal_open_container(sd_journal **ret, const char *machine, in
 
 #define OPEN_DIRECTORY_ALLOWED_FLAGS                    \
         (SD_JOURNAL_OS_ROOT |                           \
-         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER )
+         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER |  \
+         SD_JOURNAL_PARALLEL)
 
 _public_ int sd_journal_open_directory(sd_journal **ret, const char *path, int flags) {
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
@@ -2048,7 +2371,7 @@ _public_ int sd_journal_open_files(sd_journal **ret, const char **paths, int fla
         int r;
 
         assert_return(ret, -EINVAL);
-        assert_return(flags == 0, -EINVAL);
+        assert_return((flags & ~SD_JOURNAL_PARALLEL) == 0, -EINVAL);
 
         j = journal_new(flags, NULL, NULL);
         if (!j)
@@ -2068,7 +2391,8 @@ _public_ int sd_journal_open_files(sd_journal **ret, const char **paths, int fla
 
 #define OPEN_DIRECTORY_FD_ALLOWED_FLAGS         \
         (SD_JOURNAL_OS_ROOT |                           \
-         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER )
+         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER |  \
+         SD_JOURNAL_PARALLEL)
 
 _public_ int sd_journal_open_directory_fd(sd_journal **ret, int fd, int flags) {
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
@@ -2111,7 +2435,7 @@ _public_ int sd_journal_open_files_fd(sd_journal **ret, int fds[], unsigned n_fd
 
         assert_return(ret, -EINVAL);
         assert_return(n_fds > 0, -EBADF);
-        assert_return(flags == 0, -EINVAL);
+        assert_return((flags & ~SD_JOURNAL_PARALLEL) == 0, -EINVAL);
 
         j = journal_new(flags, NULL, NULL);
         if (!j)
@@ -2162,6 +2486,7 @@ _public_ void sd_journal_close(sd_journal *j) {
 
         sd_journal_flush_matches(j);
 
+        prioq_free(j->merge_queue);
         ordered_hashmap_free_with_destructor(j->files, journal_file_close);
         iterated_cache_free(j->files_cache);
 
@@ -2177,7 +2502,7 @@ _public_ void sd_journal_close(sd_journal *j) {
         safe_close(j->inotify_fd);
 
         if (j->mmap) {
-                log_debug("mmap cache statistics: %u hit, %u miss", mmap_cache_get_hit(j->mmap), mmap_cache_get_missed(j->mmap));
+                mmap_cache_stats_log_debug(j->mmap);
                 mmap_cache_unref(j->mmap);
         }
 
@@ -2329,6 +2654,7 @@ _public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **
                 if (compression) {
 #if HAVE_COMPRESSION
                         r = decompress_startswith(compression,
+                                                  journal_file_compress_dictionary(f),
                                                   o->data.payload, l,
                                                   &f->compress_buffer, &f->compress_buffer_size,
                                                   field, field_length, '=');
@@ -2340,6 +2666,7 @@ _public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **
                                 size_t rsize;
 
                                 r = decompress_blob(compression,
+                                                    journal_file_compress_dictionary(f),
                                                     o->data.payload, l,
                                                     &f->compress_buffer, &f->compress_buffer_size, &rsize,
                                                     j->data_threshold);
@@ -2399,6 +2726,7 @@ static int return_data(sd_journal *j, JournalFile *f, Object *o, const void **da
                 int r;
 
                 r = decompress_blob(compression,
+                                    journal_file_compress_dictionary(f),
                                     o->data.payload, l, &f->compress_buffer,
                                     &f->compress_buffer_size, &rsize, j->data_threshold);
                 if (r < 0)
@@ -2890,11 +3218,47 @@ _public_ int sd_journal_query_unique(sd_journal *j, const char *field) {
         j->unique_field = f;
         j->unique_file = NULL;
         j->unique_offset = 0;
+        j->unique_values_offset = 0;
         j->unique_file_lost = false;
 
         return 0;
 }
 
+static int unique_value_seen(sd_journal *j, const void *data, size_t size) {
+        JournalFile *of;
+        Iterator i;
+        int r;
+
+        assert(j);
+
+        /* Let's see if we already returned this data object by checking if it exists in the earlier
+         * traversed files. Use the summary of the field's values where the file has one, a bisection is
+         * cheaper than a hash table lookup that might need to decompress the object. */
+
+        ORDERED_HASHMAP_FOREACH(of, j->files, i) {
+                Object *v;
+
+                if (of == j->unique_file)
+                        break;
+
+                /* Skip this file it didn't have any fields indexed */
+                if (JOURNAL_HEADER_CONTAINS(of->header, n_fields) && le64toh(of->header->n_fields) <= 0)
+                        continue;
+
+                r = journal_file_find_field_values(of, j->unique_field, strlen(j->unique_field), &v, NULL);
+                if (r > 0)
+                        r = journal_file_field_values_contains(v, data, size);
+                else if (r == 0)
+                        /* Don't reuse the hash of the data object, files with keyed hashes use a
+                         * different one each */
+                        r = journal_file_find_data_object(of, data, size, NULL, NULL);
+                if (r != 0)
+                        return r;
+        }
+
+        return 0;
+}
+
 _public_ int sd_journal_enumerate_unique(sd_journal *j, const void **data, size_t *l) {
         size_t k;
 
@@ -2915,98 +3279,128 @@ _public_ int sd_journal_enumerate_unique(sd_journal *j, const void **data, size_
                         return 0;
 
                 j->unique_offset = 0;
+                j->unique_values_offset = 0;
         }
 
         for (;;) {
-                JournalFile *of;
-                Iterator i;
                 Object *o;
                 const void *odata;
                 size_t ol;
-                bool found;
+                uint64_t p;
                 int r;
 
-                /* Proceed to next data object in the field's linked list */
-                if (j->unique_offset == 0) {
-                        r = journal_file_find_field_object(j->unique_file, j->unique_field, k, &o, NULL);
+                /* Archived files carry a sorted summary of the values of most fields, use it instead of
+                 * following the field's linked list of data objects if there is one */
+                if (j->unique_offset == 0 && j->unique_values_offset == 0) {
+                        r = journal_file_find_field_values(j->unique_file, j->unique_field, k, NULL, &j->unique_values_offset);
                         if (r < 0)
                                 return r;
 
-                        j->unique_offset = r > 0 ? le64toh(o->field.head_data_offset) : 0;
-                } else {
-                        r = journal_file_move_to_object(j->unique_file, OBJECT_DATA, j->unique_offset, &o);
+                        j->unique_values_index = 0;
+                }
+
+                if (j->unique_values_offset > 0) {
+                        p = j->unique_values_offset;
+
+                        /* Again, OBJECT_UNUSED context, so that we can look at the summary of another
+                         * file at the same time */
+                        r = journal_file_move_to_object(j->unique_file, OBJECT_UNUSED, p, &o);
                         if (r < 0)
                                 return r;
 
-                        j->unique_offset = le64toh(o->data.next_field_offset);
-                }
+                        if (o->object.type != OBJECT_FIELD_VALUES)
+                                return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                                       "%s:offset " OFSfmt ": object has type %d, expected %d",
+                                                       j->unique_file->path,
+                                                       p, o->object.type, OBJECT_FIELD_VALUES);
 
-                /* We reached the end of the list? Then start again, with the next file */
-                if (j->unique_offset == 0) {
-                        j->unique_file = ordered_hashmap_next(j->files, j->unique_file->path);
-                        if (!j->unique_file)
-                                return 0;
+                        /* We reached the end of the summary? Then start again, with the next file */
+                        if (j->unique_values_index >= le64toh(o->field_values.n_items)) {
+                                j->unique_values_offset = 0;
 
-                        continue;
-                }
+                                j->unique_file = ordered_hashmap_next(j->files, j->unique_file->path);
+                                if (!j->unique_file)
+                                        return 0;
 
-                /* We do not use OBJECT_DATA context here, but OBJECT_UNUSED
-                 * instead, so that we can look at this data object at the same
-                 * time as one on another file */
-                r = journal_file_move_to_object(j->unique_file, OBJECT_UNUSED, j->unique_offset, &o);
-                if (r < 0)
-                        return r;
+                                continue;
+                        }
 
-                /* Let's do the type check by hand, since we used 0 context above. */
-                if (o->object.type != OBJECT_DATA)
-                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
-                                               "%s:offset " OFSfmt ": object has type %d, expected %d",
-                                               j->unique_file->path,
-                                               j->unique_offset,
-                                               o->object.type, OBJECT_DATA);
+                        r = journal_file_field_values_get(o, j->unique_values_index++, &odata, &ol);
+                        if (r < 0)
+                                return r;
+                } else {
+                        /* Proceed to next data object in the field's linked list */
+                        if (j->unique_offset == 0) {
+                                r = journal_file_find_field_object(j->unique_file, j->unique_field, k, &o, NULL);
+                                if (r < 0)
+                                        return r;
 
-                r = return_data(j, j->unique_file, o, &odata, &ol);
-                if (r < 0)
-                        return r;
+                                j->unique_offset = r > 0 ? le64toh(o->field.head_data_offset) : 0;
+                        } else {
+                                r = journal_file_move_to_object(j->unique_file, OBJECT_DATA, j->unique_offset, &o);
+                                if (r < 0)
+                                        return r;
+
+                                j->unique_offset = le64toh(o->data.next_field_offset);
+                        }
+
+                        /* We reached the end of the list? Then start again, with the next file */
+                        if (j->unique_offset == 0) {
+                                j->unique_file = ordered_hashmap_next(j->files, j->unique_file->path);
+                                if (!j->unique_file)
+                                        return 0;
+
+                                continue;
+                        }
+
+                        p = j->unique_offset;
+
+                        /* We do not use OBJECT_DATA context here, but OBJECT_UNUSED
+                         * instead, so that we can look at this data object at the same
+                         * time as one on another file */
+                        r = journal_file_move_to_object(j->unique_file, OBJECT_UNUSED, p, &o);
+                        if (r < 0)
+                                return r;
+
+                        /* Let's do the type check by hand, since we used 0 context above. */
+                        if (o->object.type != OBJECT_DATA)
+                                return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                                       "%s:offset " OFSfmt ": object has type %d, expected %d",
+                                                       j->unique_file->path,
+                                                       p, o->object.type, OBJECT_DATA);
+
+                        r = return_data(j, j->unique_file, o, &odata, &ol);
+                        if (r < 0)
+                                return r;
+                }
 
                 /* Check if we have at least the field name and "=". */
                 if (ol <= k)
                         return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
                                                "%s:offset " OFSfmt ": object has size %zu, expected at least %zu",
                                                j->unique_file->path,
-                                               j->unique_offset, ol, k + 1);
+                                               p, ol, k + 1);
 
                 if (memcmp(odata, j->unique_field, k) || ((const char*) odata)[k] != '=')
                         return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
                                                "%s:offset " OFSfmt ": object does not start with \"%s=\"",
                                                j->unique_file->path,
-                                               j->unique_offset,
-                                               j->unique_field);
-
-                /* OK, now let's see if we already returned this data
-                 * object by checking if it exists in the earlier
-                 * traversed files. */
-                found = false;
-                ORDERED_HASHMAP_FOREACH(of, j->files, i) {
-                        if (of == j->unique_file)
-                                break;
+                                               p, j->unique_field);
 
-                        /* Skip this file it didn't have any fields indexed */
-                        if (JOURNAL_HEADER_CONTAINS(of->header, n_fields) && le64toh(of->header->n_fields) <= 0)
-                                continue;
+                r = unique_value_seen(j, odata, ol);
+                if (r < 0)
+                        return r;
+                if (r > 0)
+                        continue;
 
-                        r = journal_file_find_data_object_with_hash(of, odata, ol, le64toh(o->data.hash), NULL, NULL);
-                        if (r < 0)
-                                return r;
-                        if (r > 0) {
-                                found = true;
-                                break;
-                        }
+                /* The values in the summary are stored uncompressed and in full, only apply the threshold
+                 * return_data() applies when decompressing */
+                if (j->unique_values_offset > 0) {
+                        *data = odata;
+                        *l = j->data_threshold > 0 ? MIN(ol, j->data_threshold) : ol;
+                        return 1;
                 }
 
-                if (found)
-                        continue;
-
                 r = return_data(j, j->unique_file, o, data, l);
                 if (r < 0)
                         return r;
@@ -3035,6 +3429,7 @@ _public_ void sd_journal_restart_unique(sd_journal *j) {
 
         j->unique_file = NULL;
         j->unique_offset = 0;
+        j->unique_values_offset = 0;
         j->unique_file_lost = false;
 }
 
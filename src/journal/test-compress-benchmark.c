@@ -140,6 +140,95 @@ static void test_compress_decompress(const char* label, const char* type,
                  100 - compressed * 100. / total,
                  skipped);
 }
+
+#if HAVE_ZSTD
+#define N_MESSAGES 20000U
+
+static char* make_message(unsigned i) {
+        static const char *const templates[] = {
+                "MESSAGE=Started Session %u of user user%u.",
+                "MESSAGE=pam_unix(sshd:session): session opened for user user%u by (uid=%u)",
+                "MESSAGE=Accepted publickey for user%u from 10.0.%u.1 port 22 ssh2",
+                "_SYSTEMD_UNIT=session-%u.scope _SYSTEMD_SLICE=user-%u.slice",
+                "MESSAGE=wlan0: Limiting certificate chain length to %u (cert %u)",
+                "MESSAGE=Received disconnect from 10.0.%u.1 port %u:11: disconnected by user",
+        };
+        char *m;
+
+        assert_se(asprintf(&m, templates[i % ELEMENTSOF(templates)], random_u32() % 10000, random_u32() % 10000) >= 0);
+        return m;
+}
+
+static void test_compress_decompress_messages(const char *label, CompressDictionary *dict) {
+        _cleanup_free_ void *buf2 = NULL;
+        size_t buf2_allocated = 0, compressed = 0, total = 0;
+        char buf[1024];
+        usec_t n, n2;
+        float dt;
+
+        n = now(CLOCK_MONOTONIC);
+
+        for (unsigned i = 0; i < N_MESSAGES; i++) {
+                _cleanup_free_ char *m = NULL;
+                size_t j = 0, k = 0, size;
+                int r;
+
+                m = make_message(i);
+                size = strlen(m);
+
+                r = compress_blob_zstd_full(m, size, buf, sizeof(buf), &j, 0, dict);
+                assert_se(r == 0);
+
+                r = decompress_blob_zstd_full(buf, j, &buf2, &buf2_allocated, &k, 0, dict);
+                assert_se(r == 0);
+                assert_se(k == size);
+                assert_se(memcmp(m, buf2, size) == 0);
+
+                total += size;
+                compressed += j;
+        }
+
+        n2 = now(CLOCK_MONOTONIC);
+        dt = (n2-n) / 1e6;
+
+        log_info("ZSTD/messages/%s: compressed & decompressed %u messages, %zu bytes in %.2fs (%.2fMiB/s), "
+                 "mean compression %.2f%%",
+                 label, N_MESSAGES, total, dt,
+                 total / 1024. / 1024 / dt,
+                 100 - compressed * 100. / total);
+}
+
+static void test_zstd_dictionary(void) {
+        _cleanup_(compress_dictionary_freep) CompressDictionary *dict = NULL;
+        _cleanup_free_ size_t *sizes = NULL;
+        _cleanup_free_ void *samples = NULL, *d = NULL;
+        size_t samples_allocated = 0, total = 0, d_size;
+
+        /* Short, similar messages are what dominates the journal. Compare how zstd deals with those with and
+         * without a dictionary trained from other messages of the same kind. */
+
+        sizes = new(size_t, N_MESSAGES);
+        assert_se(sizes);
+
+        for (unsigned i = 0; i < N_MESSAGES; i++) {
+                _cleanup_free_ char *m = NULL;
+
+                m = make_message(i);
+                sizes[i] = strlen(m);
+
+                assert_se(GREEDY_REALLOC(samples, samples_allocated, total + sizes[i]));
+                memcpy((uint8_t*) samples + total, m, sizes[i]);
+                total += sizes[i];
+        }
+
+        assert_se(compress_dictionary_train(samples, sizes, N_MESSAGES, 16 * 1024, &d, &d_size) >= 0);
+        assert_se(compress_dictionary_new(d, d_size, &dict) >= 0);
+        log_info("ZSTD/messages: trained %zu byte dictionary from %zu bytes", d_size, total);
+
+        test_compress_decompress_messages("no-dictionary", NULL);
+        test_compress_decompress_messages("dictionary", dict);
+}
+#endif
 #endif
 
 int main(int argc, char *argv[]) {
@@ -172,6 +261,9 @@ int main(int argc, char *argv[]) {
                 test_compress_decompress("ZSTD", i, compress_blob_zstd, decompress_blob_zstd);
 #endif
         }
+#if HAVE_ZSTD
+        test_zstd_dictionary();
+#endif
         return 0;
 #else
         return log_tests_skipped("No compression feature is enabled");
@@ -46,8 +46,35 @@ static void test_config_compress(void) {
         COMPRESS_PARSE_CHECK("", true, (uint64_t)-1);
 }
 
+#define COMPRESS_LEVEL_PARSE_CHECK(str, expected)                       \
+        do {                                                            \
+                int level = 111;                                        \
+                config_parse_compress_level("", "", 0, "", 0, "", 0, str, \
+                                            &level, NULL);              \
+                assert_se(level == (expected));                         \
+        } while (0)
+
+static void test_config_compress_level(void) {
+        COMPRESS_LEVEL_PARSE_CHECK("", 0);
+        COMPRESS_LEVEL_PARSE_CHECK("0", 0);
+        COMPRESS_LEVEL_PARSE_CHECK("blah", 111);
+        COMPRESS_LEVEL_PARSE_CHECK("1.5", 111);
+
+#if HAVE_ZSTD
+        COMPRESS_LEVEL_PARSE_CHECK("3", 3);
+        COMPRESS_LEVEL_PARSE_CHECK("-1", -1);
+        COMPRESS_LEVEL_PARSE_CHECK("19", 19);
+        COMPRESS_LEVEL_PARSE_CHECK("23", 111);
+        COMPRESS_LEVEL_PARSE_CHECK("1000000", 111);
+        COMPRESS_LEVEL_PARSE_CHECK("-1000000", 111);
+#else
+        COMPRESS_LEVEL_PARSE_CHECK("1000000", 1000000);
+#endif
+}
+
 int main(int argc, char *argv[]) {
         test_config_compress();
+        test_config_compress_level();
 
         return 0;
 }
@@ -7,12 +7,15 @@
 
 #include "alloc-util.h"
 #include "chattr-util.h"
+#include "dirent-util.h"
+#include "fd-util.h"
 #include "io-util.h"
 #include "journal-file.h"
 #include "journal-vacuum.h"
 #include "log.h"
 #include "parse-util.h"
 #include "rm-rf.h"
+#include "stdio-util.h"
 #include "tests.h"
 #include "util.h"
 
@@ -140,7 +143,7 @@ static void mkdtemp_chdir_chattr(char *path) {
         (void) chattr_path(path, FS_NOCOW_FL, FS_NOCOW_FL, NULL);
 }
 
-static void test_skip(void (*setup)(void)) {
+static void test_skip(void (*setup)(void), int flags) {
         char t[] = "/var/tmp/journal-skip-XXXXXX";
         sd_journal *j;
         int r;
@@ -151,7 +154,7 @@ static void test_skip(void (*setup)(void)) {
 
         /* Seek to head, iterate down.
          */
-        assert_ret(sd_journal_open_directory(&j, t, 0));
+        assert_ret(sd_journal_open_directory(&j, t, flags));
         assert_ret(sd_journal_seek_head(j));
         assert_ret(sd_journal_next(j));
         test_check_numbers_down(j, 4);
@@ -159,7 +162,7 @@ static void test_skip(void (*setup)(void)) {
 
         /* Seek to tail, iterate up.
          */
-        assert_ret(sd_journal_open_directory(&j, t, 0));
+        assert_ret(sd_journal_open_directory(&j, t, flags));
         assert_ret(sd_journal_seek_tail(j));
         assert_ret(sd_journal_previous(j));
         test_check_numbers_up(j, 4);
@@ -167,7 +170,7 @@ static void test_skip(void (*setup)(void)) {
 
         /* Seek to tail, skip to head, iterate down.
          */
-        assert_ret(sd_journal_open_directory(&j, t, 0));
+        assert_ret(sd_journal_open_directory(&j, t, flags));
         assert_ret(sd_journal_seek_tail(j));
         assert_ret(r = sd_journal_previous_skip(j, 4));
         assert_se(r == 4);
@@ -176,7 +179,7 @@ static void test_skip(void (*setup)(void)) {
 
         /* Seek to head, skip to tail, iterate up.
          */
-        assert_ret(sd_journal_open_directory(&j, t, 0));
+        assert_ret(sd_journal_open_directory(&j, t, flags));
         assert_ret(sd_journal_seek_head(j));
         assert_ret(r = sd_journal_next_skip(j, 4));
         assert_se(r == 4);
@@ -278,6 +281,100 @@ static void test_sequence_numbers(void) {
         }
 }
 
+#define N_BENCHMARK_FILES 128U
+#define N_BENCHMARK_ENTRIES 4096U
+#define N_BENCHMARK_UNITS 16U
+
+static void drop_caches(const char *path) {
+        _cleanup_closedir_ DIR *d = NULL;
+        struct dirent *de;
+
+        assert_se(d = opendir(path));
+
+        FOREACH_DIRENT(de, d, assert_not_reached("Failed to read directory")) {
+                _cleanup_close_ int fd = -1;
+
+                assert_se((fd = openat(dirfd(d), de->d_name, O_RDONLY|O_CLOEXEC)) >= 0);
+                assert_se(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0);
+        }
+}
+
+static void benchmark_seek(const char *path, int flags, usec_t realtime, bool cold) {
+        char ts[FORMAT_TIMESPAN_MAX];
+        sd_journal *j;
+        usec_t t;
+
+        if (cold)
+                drop_caches(path);
+
+        assert_ret(sd_journal_open_directory(&j, path, flags));
+        assert_ret(sd_journal_add_match(j, "UNIT=unit-3.service", 0));
+        assert_ret(sd_journal_seek_realtime_usec(j, realtime));
+
+        /* The first step after the seek looks up the location in each file */
+        t = now(CLOCK_MONOTONIC);
+        assert_se(sd_journal_next(j) == 1);
+        t = now(CLOCK_MONOTONIC) - t;
+
+        sd_journal_close(j);
+
+        log_info("Seek in %u files, %s, %s cache: %s",
+                 N_BENCHMARK_FILES, flags & SD_JOURNAL_PARALLEL ? "parallel" : "serial", cold ? "cold" : "warm",
+                 format_timespan(ts, sizeof(ts), t, 1));
+}
+
+static void test_parallel_seek_benchmark(void) {
+        char t[] = "/var/tmp/journal-seek-XXXXXX";
+        usec_t middle = 0;
+        unsigned i, k;
+
+        if (!slow_tests_enabled()) {
+                log_notice("Not running %s, since slow tests are disabled.", __func__);
+                return;
+        }
+
+        mkdtemp_chdir_chattr(t);
+
+        /* Like a host with many archived files, each with entries of many units */
+        for (i = 0; i < N_BENCHMARK_FILES; i++) {
+                char fn[STRLEN("bench-.journal") + DECIMAL_STR_MAX(unsigned)];
+                JournalFile *f;
+
+                xsprintf(fn, "bench-%u.journal", i);
+                f = test_open(fn);
+
+                for (k = 0; k < N_BENCHMARK_ENTRIES; k++) {
+                        char message[STRLEN("MESSAGE=") + DECIMAL_STR_MAX(unsigned)],
+                                unit[STRLEN("UNIT=unit-.service") + DECIMAL_STR_MAX(unsigned)];
+                        struct iovec iovec[2];
+                        dual_timestamp ts;
+
+                        xsprintf(message, "MESSAGE=%u", k);
+                        xsprintf(unit, "UNIT=unit-%u.service", k % N_BENCHMARK_UNITS);
+                        iovec[0] = IOVEC_MAKE_STRING(message);
+                        iovec[1] = IOVEC_MAKE_STRING(unit);
+
+                        assert_se(dual_timestamp_get(&ts));
+                        assert_ret(journal_file_append_entry(f, &ts, NULL, iovec, ELEMENTSOF(iovec), NULL, NULL, NULL));
+
+                        if (i == N_BENCHMARK_FILES / 2 && k == 0)
+                                middle = ts.realtime;
+                }
+
+                test_close(f);
+        }
+
+        for (i = 0; i < 2; i++) {
+                benchmark_seek(t, 0, middle, i == 0);
+                benchmark_seek(t, SD_JOURNAL_PARALLEL, middle, i == 0);
+        }
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+}
+
 int main(int argc, char *argv[]) {
         test_setup_logging(LOG_DEBUG);
 
@@ -287,10 +384,14 @@ int main(int argc, char *argv[]) {
 
         arg_keep = argc > 1;
 
-        test_skip(setup_sequential);
-        test_skip(setup_interleaved);
+        test_skip(setup_sequential, 0);
+        test_skip(setup_interleaved, 0);
+        test_skip(setup_sequential, SD_JOURNAL_PARALLEL);
+        test_skip(setup_interleaved, SD_JOURNAL_PARALLEL);
 
         test_sequence_numbers();
 
+        test_parallel_seek_benchmark();
+
         return 0;
 }
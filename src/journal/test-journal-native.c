@@ -0,0 +1,215 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "sd-event.h"
+#include "sd-journal.h"
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "journald-native.h"
+#include "journald-server.h"
+#include "memfd-util.h"
+#include "memory-util.h"
+#include "random-util.h"
+#include "rm-rf.h"
+#include "tests.h"
+#include "time-util.h"
+#include "tmpfile-util.h"
+#include "unaligned.h"
+
+static void server_init_dummy(Server *s, const char *runtime_path) {
+        *s = (Server) {
+                .syslog_fd = -1,
+                .native_fd = -1,
+                .stdout_fd = -1,
+                .dev_kmsg_fd = -1,
+                .audit_fd = -1,
+                .hostname_fd = -1,
+                .notify_fd = -1,
+                .storage = STORAGE_NONE,
+                .max_level_store = LOG_DEBUG,
+                .line_max = 64,
+                .runtime_storage.name = "Runtime Journal",
+        };
+        assert_se(sd_event_default(&s->event) >= 0);
+
+        /* With a path, messages are written to a volatile journal there, uncompressed */
+        if (runtime_path) {
+                s->storage = STORAGE_VOLATILE;
+                journal_reset_metrics(&s->runtime_storage.metrics);
+                assert_se(s->runtime_storage.path = strdup(runtime_path));
+                assert_se(s->mmap = mmap_cache_new());
+                assert_se(s->deferred_closes = set_new(NULL));
+        }
+}
+
+#define MESSAGE "MESSAGE=Process 4711 (foo) dumped core.\n"
+#define HEAD MESSAGE "COREDUMP\n"
+#define TAIL "\nPRIORITY=2\n"
+
+static char *make_message(size_t size, size_t *ret_size) {
+        size_t n;
+        char *m;
+
+        /* A native protocol message with a binary field of the given size, like the ones
+         * systemd-coredump sends */
+
+        n = STRLEN(HEAD) + sizeof(uint64_t) + size + STRLEN(TAIL);
+        m = malloc(n);
+        assert_se(m);
+
+        memcpy(m, HEAD, STRLEN(HEAD));
+        unaligned_write_le64(m + STRLEN(HEAD), size);
+        random_bytes(m + STRLEN(HEAD) + sizeof(uint64_t), size);
+        memcpy(m + STRLEN(HEAD) + sizeof(uint64_t) + size, TAIL, STRLEN(TAIL));
+
+        *ret_size = n;
+        return m;
+}
+
+static int make_sealed_memfd(const void *data, size_t size) {
+        _cleanup_close_ int fd = -1;
+
+        fd = memfd_new(NULL);
+        assert_se(fd >= 0);
+        assert_se(write(fd, data, size) == (ssize_t) size);
+        assert_se(memfd_set_sealed(fd) >= 0);
+
+        return TAKE_FD(fd);
+}
+
+static void test_binary_field(void) {
+        _cleanup_free_ char *m = NULL, *b = NULL;
+        _cleanup_close_ int fd = -1;
+        uint64_t size;
+        size_t n;
+        void *p;
+        Server s;
+
+        log_info("/* %s */", __func__);
+
+        server_init_dummy(&s, NULL);
+
+        m = make_message(4096, &n);
+
+        /* Binary fields are rewritten in the buffer of a datagram... */
+        b = memdup(m, n);
+        assert_se(b);
+        server_process_native_message(&s, b, n, NULL, NULL, NULL, 0);
+        assert_se(memcmp(b, m, STRLEN(MESSAGE)) == 0);
+        assert_se(memcmp(b + STRLEN(MESSAGE) + sizeof(uint64_t), "COREDUMP=", STRLEN("COREDUMP=")) == 0);
+        assert_se(memcmp(b + STRLEN(HEAD) + sizeof(uint64_t),
+                         m + STRLEN(HEAD) + sizeof(uint64_t),
+                         n - STRLEN(HEAD) - sizeof(uint64_t)) == 0);
+
+        /* ... but never in a sealed memfd */
+        fd = make_sealed_memfd(m, n);
+        server_process_native_file(&s, fd, NULL, NULL, NULL, 0);
+
+        assert_se(memfd_get_size(fd, &size) >= 0);
+        assert_se(size == n);
+        p = mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, 0);
+        assert_se(p != MAP_FAILED);
+        assert_se(memcmp(p, m, n) == 0);
+        assert_se(munmap(p, n) >= 0);
+
+        server_done(&s);
+}
+
+static void test_memfd_lifetime(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *t = NULL;
+        _cleanup_(sd_journal_closep) sd_journal *j = NULL;
+        _cleanup_free_ char *m = NULL;
+        const void *data;
+        size_t n, l;
+        Server s;
+        int fd;
+
+        log_info("/* %s */", __func__);
+
+        /* Entries received in a sealed memfd reference the mapping until they are written out, which
+         * happens only after the fd is gone */
+
+        assert_se(mkdtemp_malloc("/tmp/test-journal-native-XXXXXX", &t) >= 0);
+        server_init_dummy(&s, t);
+
+        m = make_message(1024 * 1024, &n);
+        fd = make_sealed_memfd(m, n);
+        server_process_native_file(&s, fd, NULL, NULL, NULL, 0);
+        safe_close(fd);
+
+        assert_se(sd_event_run(s.event, 0) >= 0);
+        server_done(&s);
+
+        assert_se(sd_journal_open_directory(&j, t, 0) >= 0);
+        assert_se(sd_journal_set_data_threshold(j, 0) >= 0);
+        assert_se(sd_journal_next(j) > 0);
+        assert_se(sd_journal_get_data(j, "COREDUMP", &data, &l) >= 0);
+        assert_se(l == STRLEN("COREDUMP=") + 1024 * 1024);
+        assert_se(memcmp((const uint8_t*) data + STRLEN("COREDUMP="),
+                         m + STRLEN(HEAD) + sizeof(uint64_t), 1024 * 1024) == 0);
+        assert_se(sd_journal_next(j) == 0);
+}
+
+static void test_benchmark(void) {
+        static const size_t sizes[] = { 64 * 1024, 256 * 1024, 1024 * 1024, 8 * 1024 * 1024 };
+        _cleanup_(rm_rf_physical_and_freep) char *d = NULL;
+        usec_t duration;
+        unsigned i;
+        Server s;
+
+        log_info("/* %s */", __func__);
+
+        duration = slow_tests_enabled() ? 2 * USEC_PER_SEC : USEC_PER_SEC / 20;
+
+        /* Write to an actual journal file, so that the queueing of the entries is included. Each message
+         * is followed by an event loop iteration, which writes it out. */
+        assert_se(mkdtemp_malloc("/tmp/test-journal-native-XXXXXX", &d) >= 0);
+        server_init_dummy(&s, d);
+
+        for (i = 0; i < ELEMENTSOF(sizes); i++) {
+                _cleanup_free_ char *m = NULL, *b = NULL;
+                _cleanup_close_ int fd = -1;
+                usec_t n1, n2, t;
+                uint64_t k;
+                size_t n;
+
+                m = make_message(sizes[i], &n);
+                b = malloc(n);
+                assert_se(b);
+
+                /* A datagram is copied into the receive buffer first, include that */
+                n1 = now(CLOCK_MONOTONIC);
+                for (k = 0, t = n1; t < n1 + duration; k++, t = now(CLOCK_MONOTONIC)) {
+                        memcpy(b, m, n);
+                        server_process_native_message(&s, b, n, NULL, NULL, NULL, 0);
+                        assert_se(sd_event_run(s.event, 0) >= 0);
+                }
+                log_info("datagram: %8zu bytes: %6"PRIu64" messages, %7.1f MiB/s",
+                         n, k, (double) (n * k) / ((double) (t - n1) / USEC_PER_SEC) / (1024 * 1024));
+
+                fd = make_sealed_memfd(m, n);
+
+                n2 = now(CLOCK_MONOTONIC);
+                for (k = 0, t = n2; t < n2 + duration; k++, t = now(CLOCK_MONOTONIC)) {
+                        server_process_native_file(&s, fd, NULL, NULL, NULL, 0);
+                        assert_se(sd_event_run(s.event, 0) >= 0);
+                }
+                log_info("memfd:    %8zu bytes: %6"PRIu64" messages, %7.1f MiB/s",
+                         n, k, (double) (n * k) / ((double) (t - n2) / USEC_PER_SEC) / (1024 * 1024));
+        }
+
+        server_done(&s);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        test_binary_field();
+        test_memfd_lifetime();
+        test_benchmark();
+
+        return 0;
+}
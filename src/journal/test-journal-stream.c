@@ -63,6 +63,7 @@ static void run_test(void) {
         char t[] = "/var/tmp/journal-stream-XXXXXX";
         unsigned i;
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
+        _cleanup_free_ char *archived = NULL;
         char *z;
         const void *data;
         size_t l;
@@ -114,6 +115,13 @@ static void run_test(void) {
         }
 
         (void) journal_file_close(one);
+        /* Archive one of the files, so that sd_journal_enumerate_unique() has the summary of the field
+         * values to work with for it */
+        assert_se(asprintf(&archived, "%s/two@" SD_ID128_FORMAT_STR "-%016"PRIx64"-%016"PRIx64".journal", t,
+                           SD_ID128_FORMAT_VAL(two->header->seqnum_id),
+                           le64toh(two->header->head_entry_seqnum),
+                           le64toh(two->header->head_entry_realtime)) >= 0);
+        assert_se(journal_file_archive(two) == 0);
         (void) journal_file_close(two);
         (void) journal_file_close(three);
 
@@ -167,8 +175,31 @@ static void run_test(void) {
         verify_contents(j, 0);
 
         assert_se(sd_journal_query_unique(j, "NUMBER") >= 0);
-        SD_JOURNAL_FOREACH_UNIQUE(j, data, l)
+        i = 0;
+        SD_JOURNAL_FOREACH_UNIQUE(j, data, l) {
                 printf("%.*s\n", (int) l, (const char*) data);
+                i++;
+        }
+        assert_se(i == N_ENTRIES);
+
+        assert_se(sd_journal_query_unique(j, "MAGIC") >= 0);
+        i = 0;
+        SD_JOURNAL_FOREACH_UNIQUE(j, data, l)
+                i++;
+        assert_se(i == 2);
+
+        /* The data threshold applies to the values taken from the summary, too */
+        sd_journal_close(j);
+        assert_se(sd_journal_open_files(&j, (const char*[]) { archived, NULL }, 0) >= 0);
+        assert_se(sd_journal_set_data_threshold(j, 8) >= 0);
+        assert_se(sd_journal_query_unique(j, "NUMBER") >= 0);
+        i = 0;
+        SD_JOURNAL_FOREACH_UNIQUE(j, data, l) {
+                assert_se(l <= 8);
+                assert_se(l > STRLEN("NUMBER=") && memcmp(data, "NUMBER=", STRLEN("NUMBER=")) == 0);
+                i++;
+        }
+        assert_se(i > 0);
 
         assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
 }
@@ -3,13 +3,16 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include "alloc-util.h"
 #include "chattr-util.h"
 #include "io-util.h"
 #include "journal-authenticate.h"
 #include "journal-file.h"
 #include "journal-vacuum.h"
+#include "journal-verify.h"
 #include "log.h"
 #include "rm-rf.h"
+#include "stdio-util.h"
 #include "tests.h"
 
 static bool arg_keep = false;
@@ -116,6 +119,424 @@ static void test_non_empty(void) {
         puts("------------------------------------------------------------");
 }
 
+static void test_append_entries(void) {
+        static const char test[] = "TEST1=1", test2[] = "TEST2=2", common[] = "COMMON=yes";
+        JournalBatchEntry batch[3];
+        struct iovec iovec[3][2];
+        dual_timestamp ts;
+        JournalFile *f;
+        size_t n_appended;
+        unsigned i;
+        Object *o;
+        uint64_t p;
+        char t[] = "/var/tmp/journal-XXXXXX";
+
+        test_setup_logging(LOG_DEBUG);
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, true, NULL, NULL, NULL, NULL, &f) == 0);
+
+        assert_se(dual_timestamp_get(&ts));
+
+        for (i = 0; i < ELEMENTSOF(batch); i++) {
+                iovec[i][0] = IOVEC_MAKE_STRING(common);
+                iovec[i][1] = i == 1 ? IOVEC_MAKE_STRING(test2) : IOVEC_MAKE_STRING(test);
+
+                batch[i] = (JournalBatchEntry) {
+                        .ts = ts,
+                        .iovec = iovec[i],
+                        .n_iovec = 2,
+                };
+        }
+
+        assert_se(journal_file_append_entries(f, batch, ELEMENTSOF(batch), NULL, &n_appended) == 0);
+        assert_se(n_appended == ELEMENTSOF(batch));
+
+        /* And another one on top, through the classic single entry path */
+        assert_se(journal_file_append_entry(f, &ts, NULL, iovec[0], 2, NULL, NULL, NULL) == 0);
+
+        assert_se(le64toh(f->header->n_entries) == 4);
+
+        /* COMMON= and TEST1= are repeated, and hence must have been served by the data object cache */
+        assert_se(f->data_cache_hits >= 5);
+
+        assert_se(journal_file_next_entry(f, 0, DIRECTION_DOWN, &o, &p) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 1);
+        assert_se(journal_file_next_entry(f, p, DIRECTION_DOWN, &o, &p) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 2);
+        assert_se(journal_file_next_entry(f, p, DIRECTION_DOWN, &o, &p) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 3);
+        assert_se(journal_file_next_entry(f, p, DIRECTION_DOWN, &o, &p) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 4);
+        assert_se(journal_file_next_entry(f, p, DIRECTION_DOWN, &o, &p) == 0);
+
+        assert_se(journal_file_find_data_object(f, common, strlen(common), &o, &p) == 1);
+        assert_se(le64toh(o->data.n_entries) == 4);
+        assert_se(journal_file_next_entry_for_data(f, NULL, 0, p, DIRECTION_DOWN, &o, NULL) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 1);
+        assert_se(journal_file_next_entry_for_data(f, NULL, 0, p, DIRECTION_UP, &o, NULL) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 4);
+
+        assert_se(journal_file_find_data_object(f, test, strlen(test), &o, &p) == 1);
+        assert_se(le64toh(o->data.n_entries) == 3);
+
+        assert_se(journal_file_find_data_object(f, test2, strlen(test2), &o, &p) == 1);
+        assert_se(le64toh(o->data.n_entries) == 1);
+        assert_se(journal_file_next_entry_for_data(f, NULL, 0, p, DIRECTION_DOWN, &o, NULL) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 2);
+
+        (void) journal_file_close(f);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+static void test_entry_index(void) {
+        static const uint64_t seqnums[] = { 0, 1, 2, 511, 512, 513, 1024, 2047, 2999, 3000, 3001 };
+        uint64_t base, realtime[ELEMENTSOF(seqnums) * 3][2] = {}, seqnum[ELEMENTSOF(seqnums)][2] = {}, p;
+        _cleanup_free_ char *archived = NULL;
+        dual_timestamp ts;
+        JournalFile *f;
+        struct iovec iovec;
+        direction_t d;
+        unsigned i;
+        Object *o;
+        char t[] = "/var/tmp/journal-XXXXXX";
+
+        test_setup_logging(LOG_DEBUG);
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        assert_se(dual_timestamp_get(&ts));
+        base = ts.realtime;
+
+        iovec = IOVEC_MAKE_STRING("TEST=1");
+        for (i = 0; i < 3000; i++) {
+                assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+                ts.realtime += 2;
+                ts.monotonic += 2;
+        }
+
+        /* Seek without the index first, to compare with the results with the index below */
+        for (d = DIRECTION_UP; d <= DIRECTION_DOWN; d++)
+                for (i = 0; i < ELEMENTSOF(seqnums); i++) {
+                        uint64_t k;
+
+                        assert_se(journal_file_move_to_entry_by_seqnum(f, seqnums[i], d, NULL, &seqnum[i][d]) >= 0);
+
+                        for (k = 0; k < 3; k++)
+                                assert_se(journal_file_move_to_entry_by_realtime(f, base + seqnums[i] * 2 - 3 + k, d, NULL, &realtime[i * 3 + k][d]) >= 0);
+                }
+
+        /* Archiving writes the index */
+        assert_se(f->header->entry_index_offset == 0);
+        assert_se(!JOURNAL_HEADER_ENTRY_INDEX(f->header));
+        assert_se(asprintf(&archived, "test@" SD_ID128_FORMAT_STR "-%016"PRIx64"-%016"PRIx64".journal",
+                           SD_ID128_FORMAT_VAL(f->header->seqnum_id),
+                           le64toh(f->header->head_entry_seqnum),
+                           le64toh(f->header->head_entry_realtime)) >= 0);
+        assert_se(journal_file_archive(f) == 0);
+
+        /* The index is written when offlining the file, here by the offline worker */
+        assert_se(journal_file_set_offline(f, false) == 0);
+        (void) journal_file_close(f);
+
+        assert_se(journal_file_open(-1, archived, O_RDONLY, 0, false, 0, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        assert_se(f->header->entry_index_offset != 0);
+        assert_se(JOURNAL_HEADER_ENTRY_INDEX(f->header));
+        assert_se(journal_file_verify(f, NULL, NULL, NULL, NULL, false) == 0);
+
+        /* ... and the summary of the field values */
+        assert_se(f->header->field_values_offset != 0);
+        assert_se(JOURNAL_HEADER_FIELD_VALUES(f->header));
+        assert_se(journal_file_find_field_values(f, "TEST", 4, &o, NULL) > 0);
+        assert_se(le64toh(o->field_values.n_items) == 1);
+        assert_se(journal_file_field_values_contains(o, "TEST=1", 6) > 0);
+        assert_se(journal_file_field_values_contains(o, "TEST=2", 6) == 0);
+        assert_se(journal_file_find_field_values(f, "NOPE", 4, &o, NULL) == 0);
+
+        for (d = DIRECTION_UP; d <= DIRECTION_DOWN; d++)
+                for (i = 0; i < ELEMENTSOF(seqnums); i++) {
+                        uint64_t k;
+
+                        p = 0;
+                        assert_se(journal_file_move_to_entry_by_seqnum(f, seqnums[i], d, &o, &p) >= 0);
+                        assert_se(p == seqnum[i][d]);
+
+                        for (k = 0; k < 3; k++) {
+                                p = 0;
+                                assert_se(journal_file_move_to_entry_by_realtime(f, base + seqnums[i] * 2 - 3 + k, d, &o, &p) >= 0);
+                                assert_se(p == realtime[i * 3 + k][d]);
+                        }
+                }
+
+        (void) journal_file_close(f);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+static void test_compact(void) {
+        _cleanup_free_ char *archived = NULL;
+        char t[] = "/var/tmp/journal-XXXXXX";
+        uint64_t p = 0, q = 0, size;
+        JournalFile *f, *c;
+        dual_timestamp ts;
+        unsigned i;
+        Object *o;
+        int fd;
+
+        test_setup_logging(LOG_DEBUG);
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        assert_se(dual_timestamp_get(&ts));
+
+        for (i = 0; i < 2000; i++) {
+                char m[STRLEN("MESSAGE=") + DECIMAL_STR_MAX(unsigned)], n[STRLEN("NUMBER=") + DECIMAL_STR_MAX(unsigned)];
+                struct iovec iovec[3];
+
+                xsprintf(m, "MESSAGE=%u", i);
+                xsprintf(n, "NUMBER=%u", i % 7);
+                iovec[0] = IOVEC_MAKE_STRING("TEST=1");
+                iovec[1] = IOVEC_MAKE_STRING(m);
+                iovec[2] = IOVEC_MAKE_STRING(n);
+
+                assert_se(journal_file_append_entry(f, &ts, NULL, iovec, ELEMENTSOF(iovec), NULL, NULL, NULL) == 0);
+                ts.realtime++;
+                ts.monotonic++;
+        }
+
+        assert_se(asprintf(&archived, "test@" SD_ID128_FORMAT_STR "-%016"PRIx64"-%016"PRIx64".journal",
+                           SD_ID128_FORMAT_VAL(f->header->seqnum_id),
+                           le64toh(f->header->head_entry_seqnum),
+                           le64toh(f->header->head_entry_realtime)) >= 0);
+        assert_se(journal_file_archive(f) == 0);
+        (void) journal_file_close(f);
+
+        assert_se(journal_file_open(-1, archived, O_RDONLY, 0, false, 0, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        assert_se((fd = open("compact.journal", O_RDWR|O_CREAT|O_EXCL|O_CLOEXEC, 0666)) >= 0);
+        assert_se(journal_file_compact(f, fd, "compact.journal", &c) == 0);
+
+        /* One array for all entries, and one for each of the data objects referenced more than once */
+        assert_se(le64toh(c->header->n_entry_arrays) == 1 + 1 + 7);
+        assert_se(le64toh(c->header->n_data) == le64toh(f->header->n_data));
+        assert_se(le64toh(c->header->data_hash_table_size) == (le64toh(c->header->n_data) * 4 / 3 + 1) * sizeof(HashItem));
+        assert_se(le64toh(c->header->field_hash_table_size) < le64toh(f->header->field_hash_table_size));
+        assert_se(c->header->entry_index_offset != 0);
+        (void) journal_file_close(c);
+
+        assert_se(journal_file_open(-1, "compact.journal", O_RDONLY, 0, false, 0, false, NULL, NULL, NULL, NULL, &c) == 0);
+        assert_se(c->header->state == STATE_ARCHIVED);
+        assert_se(sd_id128_equal(c->header->seqnum_id, f->header->seqnum_id));
+        assert_se(sd_id128_equal(c->header->machine_id, f->header->machine_id));
+        assert_se(c->header->n_entries == f->header->n_entries);
+        assert_se(c->header->head_entry_seqnum == f->header->head_entry_seqnum);
+        assert_se(c->header->tail_entry_seqnum == f->header->tail_entry_seqnum);
+        assert_se(c->last_stat.st_size < f->last_stat.st_size);
+        assert_se(journal_file_verify(c, NULL, NULL, NULL, NULL, false) == 0);
+
+        for (i = 0; i < 2000; i++) {
+                uint64_t seqnum, realtime;
+
+                assert_se(journal_file_next_entry(f, p, DIRECTION_DOWN, &o, &p) == 1);
+                seqnum = le64toh(o->entry.seqnum);
+                realtime = le64toh(o->entry.realtime);
+
+                assert_se(journal_file_next_entry(c, q, DIRECTION_DOWN, &o, &q) == 1);
+                assert_se(le64toh(o->entry.seqnum) == seqnum);
+                assert_se(le64toh(o->entry.realtime) == realtime);
+                assert_se(journal_file_entry_n_items(o) == 3);
+        }
+        assert_se(journal_file_next_entry(c, q, DIRECTION_DOWN, &o, &q) == 0);
+
+        size = c->last_stat.st_size;
+        log_info("Compacted %"PRIu64" bytes to %"PRIu64" bytes.", (uint64_t) f->last_stat.st_size, size);
+
+        (void) journal_file_close(c);
+        (void) journal_file_close(f);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+#if HAVE_ZSTD
+static void append_sessions(JournalFile *f, unsigned first, unsigned n) {
+        char m[LINE_MAX];
+        dual_timestamp ts;
+        struct iovec iovec;
+        unsigned i;
+
+        for (i = first; i < first + n; i++) {
+                xsprintf(m, "MESSAGE=Started Session %u of user user%u.", i, i % 7);
+                iovec = IOVEC_MAKE_STRING(m);
+                assert_se(dual_timestamp_get(&ts));
+                assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+        }
+}
+
+static unsigned find_sessions(JournalFile *f, unsigned first, unsigned n) {
+        unsigned i, n_compressed = 0;
+        char m[LINE_MAX];
+        uint64_t p;
+        Object *o;
+
+        for (i = first; i < first + n; i++) {
+                xsprintf(m, "MESSAGE=Started Session %u of user user%u.", i, i % 7);
+                assert_se(journal_file_find_data_object(f, m, strlen(m), &o, &p) == 1);
+                if (o->object.flags & OBJECT_COMPRESSED_ZSTD)
+                        n_compressed++;
+        }
+
+        return n_compressed;
+}
+
+static void find_long_message(JournalFile *f, const char *m) {
+        uint64_t p;
+        Object *o;
+
+        assert_se(journal_file_find_data_object(f, m, strlen(m), &o, &p) == 1);
+        assert_se(o->object.flags & OBJECT_COMPRESSED_ZSTD);
+}
+
+static void test_compression_dictionary(void) {
+        char t[] = "/var/tmp/journal-XXXXXX", m[STRLEN("MESSAGE=") + 512 + 1];
+        JournalFile *f, *reader;
+        dual_timestamp ts;
+        struct iovec iovec;
+        unsigned i;
+
+        test_setup_logging(LOG_DEBUG);
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, 8, false, NULL, NULL, NULL, NULL, &f) == 0);
+        assert_se(!JOURNAL_HEADER_ZSTD_DICTIONARY(f->header));
+
+        append_sessions(f, 0, 2000);
+
+        /* The file replacing the rotated one gets a dictionary trained from its data, but not right away */
+        assert_se(journal_file_rotate(&f, true, 8, false, NULL) >= 0);
+        assert_se(!JOURNAL_HEADER_ZSTD_DICTIONARY(f->header));
+        assert_se(!f->compress_dictionary);
+        assert_se(f->dictionary_training);
+
+        append_sessions(f, 5000, 100);
+
+        /* Compresses well enough without a dictionary */
+        memset(stpcpy(m, "MESSAGE="), 'x', 512);
+        m[sizeof(m) - 1] = 0;
+        iovec = IOVEC_MAKE_STRING(m);
+        assert_se(dual_timestamp_get(&ts));
+        assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+
+        /* Opened before the dictionary is added */
+        assert_se(journal_file_open(-1, "test.journal", O_RDONLY, 0, false, 0, false, NULL, NULL, NULL, NULL, &reader) == 0);
+
+        /* Once trained, the dictionary is added with the next data object */
+        for (i = 0; !JOURNAL_HEADER_ZSTD_DICTIONARY(f->header); i++) {
+                assert_se(i < 1000);
+                (void) usleep(10 * USEC_PER_MSEC);
+                append_sessions(f, 6000 + i, 1);
+        }
+        assert_se(f->compress_dictionary);
+        assert_se(!f->dictionary_training);
+
+        append_sessions(f, 7000, 100);
+
+        /* Both the data compressed without and with the dictionary is found */
+        find_long_message(f, m);
+        assert_se(find_sessions(f, 7000, 100) > 0);
+        (void) find_sessions(reader, 5000, 100);
+        find_long_message(reader, m);
+        assert_se(find_sessions(reader, 7000, 100) > 0);
+        assert_se(reader->compress_dictionary);
+
+        (void) journal_file_close(reader);
+        (void) journal_file_close(f);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDONLY, 0, false, 0, false, NULL, NULL, NULL, NULL, &f) == 0);
+        assert_se(journal_file_verify(f, NULL, NULL, NULL, NULL, false) == 0);
+        (void) find_sessions(f, 5000, 100);
+        find_long_message(f, m);
+        assert_se(find_sessions(f, 7000, 100) > 0);
+
+        (void) journal_file_close(f);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+#endif
+
+static void test_offline_queue(void) {
+        static const char test[] = "TEST1=1";
+        char t[] = "/var/tmp/journal-XXXXXX";
+        JournalFile *f[8];
+        dual_timestamp ts;
+        struct iovec iovec;
+        unsigned i;
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(dual_timestamp_get(&ts));
+        iovec = IOVEC_MAKE_STRING(test);
+
+        for (i = 0; i < ELEMENTSOF(f); i++) {
+                char fn[STRLEN("test-.journal") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(fn, "test-%u.journal", i);
+                assert_se(journal_file_open(-1, fn, O_RDWR|O_CREAT, 0666, false, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f[i]) == 0);
+                assert_se(journal_file_append_entry(f[i], &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+        }
+
+        /* Queue them all to the worker, then close them in reverse order: files the worker didn't get to
+         * yet are taken back from the queue rather than waited for */
+        for (i = 0; i < ELEMENTSOF(f); i++)
+                assert_se(journal_file_set_offline(f[i], false) == 0);
+
+        for (i = ELEMENTSOF(f); i > 0; i--)
+                (void) journal_file_close(f[i-1]);
+
+        assert_se(journal_file_offline_queue_depth() == 0);
+
+        for (i = 0; i < ELEMENTSOF(f); i++) {
+                char fn[STRLEN("test-.journal") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(fn, "test-%u.journal", i);
+                assert_se(journal_file_open(-1, fn, O_RDONLY, 0, false, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f[i]) == 0);
+                assert_se(f[i]->header->state == STATE_OFFLINE);
+                (void) journal_file_close(f[i]);
+        }
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+}
+
 static void test_empty(void) {
         JournalFile *f1, *f2, *f3, *f4;
         char t[] = "/var/tmp/journal-XXXXXX";
@@ -250,6 +671,13 @@ int main(int argc, char *argv[]) {
                 return log_tests_skipped("/etc/machine-id not found");
 
         test_non_empty();
+        test_append_entries();
+        test_entry_index();
+        test_compact();
+        test_offline_queue();
+#if HAVE_ZSTD
+        test_compression_dictionary();
+#endif
         test_empty();
 #if HAVE_COMPRESSION
         test_min_compress_size();
@@ -8,9 +8,111 @@
 #include "fd-util.h"
 #include "macro.h"
 #include "mmap-cache.h"
+#include "random-util.h"
+#include "time-util.h"
 #include "tmpfile-util.h"
 #include "util.h"
 
+#define BENCHMARK_FILE_SIZE (256ULL*1024ULL*1024ULL)
+
+static void test_access_patterns(void) {
+        char px[] = "/tmp/testmmapXXXXXXX", t[FORMAT_TIMESPAN_MAX];
+        MMapFileDescriptor *fx, *fy;
+        unsigned missed, i;
+        volatile uint8_t sum = 0;
+        struct stat st;
+        MMapCache *m;
+        uint64_t o;
+        usec_t ts;
+        void *p;
+        int x, y;
+
+        /* A sequential scan should map few, increasingly larger windows */
+
+        x = mkostemp_safe(px);
+        assert_se(x >= 0);
+        unlink(px);
+
+        assert_se(ftruncate(x, BENCHMARK_FILE_SIZE) >= 0);
+        assert_se(fstat(x, &st) >= 0);
+
+        assert_se(m = mmap_cache_new());
+        assert_se(fx = mmap_cache_add_fd(m, x));
+
+        ts = now(CLOCK_MONOTONIC);
+        for (o = 0; o < BENCHMARK_FILE_SIZE; o += page_size()) {
+                assert_se(mmap_cache_get(m, fx, PROT_READ, 0, false, o, 8, &st, &p, NULL) > 0);
+                sum += *(uint8_t*) p;
+        }
+        ts = now(CLOCK_MONOTONIC) - ts;
+
+        missed = mmap_cache_get_missed(m);
+        log_info("Sequential access to %llu pages: %u hit, %u missed, %u sequential, %s",
+                 BENCHMARK_FILE_SIZE / page_size(), mmap_cache_get_hit(m), missed,
+                 mmap_cache_get_sequential(m), format_timespan(t, sizeof(t), ts, 1));
+        mmap_cache_stats_log_debug(m);
+
+        assert_se(mmap_cache_get_random(m) == 0);
+        assert_se(mmap_cache_get_sequential(m) == missed - 1);
+        /* With fixed size windows we'd need BENCHMARK_FILE_SIZE / 8M of them */
+        assert_se(missed < BENCHMARK_FILE_SIZE / (8ULL*1024ULL*1024ULL) / 2);
+
+        mmap_cache_free_fd(m, fx);
+        mmap_cache_unref(m);
+
+        assert_se(m = mmap_cache_new());
+        assert_se(fx = mmap_cache_add_fd(m, x));
+
+        ts = now(CLOCK_MONOTONIC);
+        for (i = 0; i < 16384; i++) {
+                o = random_u64() % BENCHMARK_FILE_SIZE;
+                assert_se(mmap_cache_get(m, fx, PROT_READ, 0, false, o, 8, &st, &p, NULL) > 0);
+                sum += *(uint8_t*) p;
+        }
+        ts = now(CLOCK_MONOTONIC) - ts;
+
+        log_info("Random access to %u pages: %u hit, %u missed, %u random, %s",
+                 i, mmap_cache_get_hit(m), mmap_cache_get_missed(m),
+                 mmap_cache_get_random(m), format_timespan(t, sizeof(t), ts, 1));
+        mmap_cache_stats_log_debug(m);
+
+        assert_se(mmap_cache_get_random(m) > 0);
+
+        mmap_cache_free_fd(m, fx);
+        mmap_cache_unref(m);
+
+        /* Scanning two files interleaved, like sd_journal does, is still sequential access to each */
+
+        y = fcntl(x, F_DUPFD_CLOEXEC, 3);
+        assert_se(y >= 0);
+
+        assert_se(m = mmap_cache_new());
+        assert_se(fx = mmap_cache_add_fd(m, x));
+        assert_se(fy = mmap_cache_add_fd(m, y));
+
+        for (o = 0; o < BENCHMARK_FILE_SIZE; o += page_size()) {
+                assert_se(mmap_cache_get(m, fx, PROT_READ, 0, false, o, 8, &st, &p, NULL) > 0);
+                sum += *(uint8_t*) p;
+                assert_se(mmap_cache_get(m, fy, PROT_READ, 0, false, BENCHMARK_FILE_SIZE - o - 8, 8, &st, &p, NULL) > 0);
+                sum += *(uint8_t*) p;
+        }
+
+        log_info("Interleaved sequential access to %llu pages: %u hit, %u missed, %u sequential",
+                 2 * BENCHMARK_FILE_SIZE / page_size(), mmap_cache_get_hit(m), mmap_cache_get_missed(m),
+                 mmap_cache_get_sequential(m));
+
+        assert_se(mmap_cache_get_random(m) == 0);
+        assert_se(mmap_cache_get_sequential(m) == mmap_cache_get_missed(m) - 2);
+        assert_se(sum == 0);
+
+        mmap_cache_free_fd(m, fx);
+        mmap_cache_free_fd(m, fy);
+        mmap_cache_unref(m);
+
+        safe_close(x);
+        safe_close(y);
+}
+
 int main(int argc, char *argv[]) {
         MMapFileDescriptor *fx;
         int x, y, z, r;
@@ -62,5 +164,7 @@ int main(int argc, char *argv[]) {
         safe_close(y);
         safe_close(z);
 
+        test_access_patterns();
+
         return 0;
 }
@@ -102,6 +102,10 @@ struct node_vtable {
         const sd_bus_vtable *vtable;
         sd_bus_object_find_t find;
 
+        /* Serialized properties of the objects implementing this vtable, if SD_BUS_VTABLE_PROPERTY_CACHE is
+         * set. Indexed by the object pointer if there's a find() callback, by the object path otherwise. */
+        Hashmap *property_cache;
+
         LIST_FIELDS(struct node_vtable, vtables);
 };
 
@@ -214,6 +218,7 @@ struct sd_bus {
         bool attach_timestamp:1;
         bool connected_signal:1;
         bool close_on_exit:1;
+        bool batch_send:1;
 
         signed int use_memfd:2;
 
@@ -229,6 +234,10 @@ struct sd_bus {
         size_t windex;
         size_t wqueue_allocated;
 
+        /* The number of read and write calls made on the connection, for benchmarking */
+        uint64_t n_read_calls;
+        uint64_t n_write_calls;
+
         uint64_t cookie;
         uint64_t read_counter; /* A counter for each incoming msg */
 
@@ -244,6 +253,9 @@ struct sd_bus {
         Hashmap *vtable_methods;
         Hashmap *vtable_properties;
 
+        /* Total size of the serialized properties in the caches of all vtables */
+        size_t property_cache_size;
+
         union sockaddr_union sockaddr;
         socklen_t sockaddr_size;
 
@@ -287,6 +299,9 @@ struct sd_bus {
         struct memfd_cache memfd_cache[MEMFD_CACHE_MAX];
         unsigned n_memfd_cache;
 
+        /* Recycled message objects and buffers, see bus-message.h */
+        struct BusMessagePool *message_pool;
+
         pid_t original_pid;
         pid_t busexec_pid;
 
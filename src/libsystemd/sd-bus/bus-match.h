@@ -36,7 +36,8 @@ struct bus_match_node {
 
         union {
                 struct {
-                        char *str;
+                        /* Interned in the root node's atom table */
+                        const char *str;
                         uint8_t u8;
                 } value;
                 struct {
@@ -45,7 +46,13 @@ struct bus_match_node {
                 struct {
                         /* If this is set, then the child is NULL */
                         Hashmap *children;
+                        /* If the hash table has exactly one entry, this is it */
+                        struct bus_match_node *single;
                 } compare;
+                struct {
+                        /* All value strings of the tree, mapped to their reference counter */
+                        Hashmap *atoms;
+                } root;
         };
 };
 
@@ -22,6 +22,9 @@
 #include "time-util.h"
 #include "utf8.h"
 
+/* Messages we create locally are allocated together with their initial header */
+#define MESSAGE_ALLOCATION_SIZE (ALIGN(sizeof(sd_bus_message)) + sizeof(struct bus_header))
+
 static int message_append_basic(sd_bus_message *m, char type, const void *p, const void **stored);
 
 static void *adjust_pointer(const void *p, void *old_base, size_t sz, void *new_base) {
@@ -60,8 +63,15 @@ static void message_free_part(sd_bus_message *m, struct bus_body_part *part) {
                 if (m->sensitive)
                         explicit_bzero_safe(part->data, part->size);
 
-                if (part->free_this)
-                        free(part->data);
+                if (part->free_this) {
+                        /* Keep one buffer around, in case this message goes back into the pool */
+                        if (m->pool && !m->body_spare &&
+                            part->allocated > 0 && part->allocated <= BUS_MESSAGE_POOL_BUFFER_MAX) {
+                                m->body_spare = part->data;
+                                m->body_spare_allocated = part->allocated;
+                        } else
+                                free(part->data);
+                }
         }
 
         if (part != &m->body)
@@ -122,13 +132,157 @@ static void message_reset_containers(sd_bus_message *m) {
         m->root_container.index = 0;
 }
 
+BusMessagePool *bus_message_pool_new(unsigned max_messages) {
+        BusMessagePool *p;
+
+        p = new(BusMessagePool, 1);
+        if (!p)
+                return NULL;
+
+        *p = (BusMessagePool) {
+                .n_ref = 1,
+                .max_messages = max_messages,
+        };
+
+        assert_se(pthread_mutex_init(&p->mutex, NULL) == 0);
+
+        return p;
+}
+
+static BusMessagePool *bus_message_pool_free(BusMessagePool *p) {
+        sd_bus_message *m;
+
+        assert(p);
+
+        assert_se(pthread_mutex_destroy(&p->mutex) == 0);
+
+        while ((m = p->messages)) {
+                p->messages = m->pool_next;
+
+                if (m->free_header)
+                        free(m->header);
+                free(m->body_spare);
+                free(m->containers);
+                free(m);
+        }
+
+        return mfree(p);
+}
+
+BusMessagePool *bus_message_pool_ref(BusMessagePool *p) {
+        if (!p)
+                return NULL;
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+        assert(p->n_ref > 0);
+        p->n_ref++;
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        return p;
+}
+
+BusMessagePool *bus_message_pool_unref(BusMessagePool *p) {
+        unsigned n_ref;
+
+        if (!p)
+                return NULL;
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+        assert(p->n_ref > 0);
+        n_ref = --p->n_ref;
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        if (n_ref == 0)
+                bus_message_pool_free(p);
+
+        return NULL;
+}
+
+static sd_bus_message *message_new_from_pool(sd_bus *bus) {
+        BusMessagePool *p;
+        sd_bus_message *m;
+
+        assert(bus);
+
+        p = bus->message_pool;
+
+        m = NULL;
+        if (p) {
+                assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+                m = p->messages;
+                if (m) {
+                        p->messages = m->pool_next;
+                        p->n_messages--;
+                        (void) __atomic_add_fetch(&p->statistics.n_messages_recycled, 1, __ATOMIC_RELAXED);
+                        if (m->free_header)
+                                (void) __atomic_add_fetch(&p->statistics.n_buffers_recycled, 1, __ATOMIC_RELAXED);
+                } else
+                        (void) __atomic_add_fetch(&p->statistics.n_messages_allocated, 1, __ATOMIC_RELAXED);
+
+                assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+        }
+
+        if (m) {
+                struct bus_header *header;
+                struct bus_container *containers;
+                size_t header_allocated, containers_allocated, body_spare_allocated;
+                void *body_spare;
+
+                /* Start from scratch, except for the buffers we kept */
+                header = m->free_header ? m->header : NULL;
+                header_allocated = m->header_allocated;
+                body_spare = m->body_spare;
+                body_spare_allocated = m->body_spare_allocated;
+                containers = m->containers;
+                containers_allocated = m->containers_allocated;
+
+                memzero(m, MESSAGE_ALLOCATION_SIZE);
+
+                if (header) {
+                        memzero(header, sizeof(struct bus_header));
+                        m->header = header;
+                        m->header_allocated = header_allocated;
+                        m->free_header = true;
+                }
+
+                m->body_spare = body_spare;
+                m->body_spare_allocated = body_spare_allocated;
+                m->containers = containers;
+                m->containers_allocated = containers_allocated;
+        } else {
+                m = malloc0(MESSAGE_ALLOCATION_SIZE);
+                if (!m)
+                        return NULL;
+        }
+
+        if (!m->header)
+                m->header = (struct bus_header*) ((uint8_t*) m + ALIGN(sizeof(struct sd_bus_message)));
+
+        m->pool = bus_message_pool_ref(p);
+        m->recyclable = true;
+
+        return m;
+}
+
 static sd_bus_message* message_free(sd_bus_message *m) {
+        BusMessagePool *p;
+        bool recycle;
+
         assert(m);
 
         message_reset_parts(m);
 
-        if (m->free_header)
+        /* Note that the pool is not bound to the bus connection, m->bus is unset already at this point. We
+         * might be on a different thread than the one using the connection, hence we look at the pool only
+         * once, with the lock taken, at the end. Until then keep the buffers if they are worth it. */
+        p = TAKE_PTR(m->pool);
+        recycle = p && m->recyclable;
+
+        if (m->free_header && !(recycle && m->header_allocated > 0 && m->header_allocated <= BUS_MESSAGE_POOL_BUFFER_MAX)) {
                 free(m->header);
+                m->free_header = false;
+        }
 
         /* Note that we don't unref m->bus here. That's already done by sd_bus_message_unref() as each user
          * reference to the bus message also is considered a reference to the bus connection itself. */
@@ -141,12 +295,35 @@ static sd_bus_message* message_free(sd_bus_message *m) {
         if (m->iovec != m->iovec_fixed)
                 free(m->iovec);
 
-        message_reset_containers(m);
-        assert(m->n_containers == 0);
+        while (m->n_containers > 0)
+                message_free_last_container(m);
         message_free_last_container(m);
 
         bus_creds_done(&m->creds);
-        return mfree(m);
+
+        if (recycle) {
+                assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+                recycle = p->n_messages < p->max_messages;
+                if (recycle) {
+                        m->pool_next = p->messages;
+                        p->messages = m;
+                        p->n_messages++;
+                }
+
+                assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+        }
+
+        if (!recycle) {
+                if (m->free_header)
+                        free(m->header);
+                free(m->body_spare);
+                free(m->containers);
+                free(m);
+        }
+
+        bus_message_pool_unref(p);
+        return NULL;
 }
 
 static void *message_extend_fields(sd_bus_message *m, size_t align, size_t sz, bool add_offset) {
@@ -169,20 +346,36 @@ static void *message_extend_fields(sd_bus_message *m, size_t align, size_t sz, b
         if (old_size == new_size)
                 return (uint8_t*) m->header + old_size;
 
-        if (m->free_header) {
-                np = realloc(m->header, ALIGN8(new_size));
-                if (!np)
-                        goto poison;
-        } else {
-                /* Initially, the header is allocated as part of
-                 * the sd_bus_message itself, let's replace it by
-                 * dynamic data */
+        if (m->free_header && ALIGN8(new_size) <= m->header_allocated)
+                np = m->header;
+        else {
+                size_t allocated;
 
-                np = malloc(ALIGN8(new_size));
-                if (!np)
-                        goto poison;
+                /* Leave some room, so that we don't have to reallocate for each field appended */
+                allocated = ALIGN8(new_size);
+                if (allocated < BUS_MESSAGE_POOL_BUFFER_MAX)
+                        allocated = MAX(allocated * 2, (size_t) 256U);
+
+                if (m->free_header) {
+                        np = realloc(m->header, allocated);
+                        if (!np)
+                                goto poison;
+                } else {
+                        /* Initially, the header is allocated as part of
+                         * the sd_bus_message itself, let's replace it by
+                         * dynamic data */
+
+                        np = malloc(allocated);
+                        if (!np)
+                                goto poison;
+
+                        memcpy(np, m->header, sizeof(struct bus_header));
+                }
 
-                memcpy(np, m->header, sizeof(struct bus_header));
+                m->header_allocated = allocated;
+
+                if (m->pool)
+                        (void) __atomic_add_fetch(&m->pool->statistics.n_buffers_allocated, 1, __ATOMIC_RELAXED);
         }
 
         /* Zero out padding */
@@ -592,13 +785,12 @@ _public_ int sd_bus_message_new(
         /* Creation of messages with _SD_BUS_MESSAGE_TYPE_INVALID is allowed. */
         assert_return(type < _SD_BUS_MESSAGE_TYPE_MAX, -EINVAL);
 
-        sd_bus_message *t = malloc0(ALIGN(sizeof(sd_bus_message)) + sizeof(struct bus_header));
+        sd_bus_message *t = message_new_from_pool(bus);
         if (!t)
                 return -ENOMEM;
 
         t->n_ref = 1;
         t->bus = sd_bus_ref(bus);
-        t->header = (struct bus_header*) ((uint8_t*) t + ALIGN(sizeof(struct sd_bus_message)));
         t->header->endian = BUS_NATIVE_ENDIAN;
         t->header->type = type;
         t->header->version = bus->message_version;
@@ -1258,11 +1450,23 @@ static int part_make_space(
         if (part->allocated == 0 || sz > part->allocated) {
                 size_t new_allocated;
 
-                new_allocated = sz > 0 ? 2 * sz : 64;
-                n = realloc(part->data, new_allocated);
-                if (!n) {
-                        m->poisoned = true;
-                        return -ENOMEM;
+                if (!part->data && m->body_spare && sz <= m->body_spare_allocated) {
+                        /* Reuse the buffer kept from the previous use of this message object */
+                        n = TAKE_PTR(m->body_spare);
+                        new_allocated = m->body_spare_allocated;
+                        m->body_spare_allocated = 0;
+
+                        (void) __atomic_add_fetch(&m->pool->statistics.n_buffers_recycled, 1, __ATOMIC_RELAXED);
+                } else {
+                        new_allocated = sz > 0 ? 2 * sz : 64;
+                        n = realloc(part->data, new_allocated);
+                        if (!n) {
+                                m->poisoned = true;
+                                return -ENOMEM;
+                        }
+
+                        if (m->pool)
+                                (void) __atomic_add_fetch(&m->pool->statistics.n_buffers_allocated, 1, __ATOMIC_RELAXED);
                 }
 
                 part->data = n;
@@ -5584,6 +5788,69 @@ int bus_message_get_blob(sd_bus_message *m, void **buffer, size_t *sz) {
         return 0;
 }
 
+int bus_message_read_body(sd_bus_message *m, size_t offset, size_t size, void *buffer) {
+        struct bus_body_part *part;
+        size_t i, begin = 0;
+        uint8_t *e = buffer;
+
+        assert(m);
+        assert(buffer || size == 0);
+
+        /* Copies the specified range of the body of the message into the buffer */
+
+        if (offset > m->body_size || size > m->body_size - offset)
+                return -EBADMSG;
+
+        MESSAGE_FOREACH_PART(part, i, m) {
+                size_t from, to;
+
+                if (begin >= offset + size)
+                        break;
+
+                if (begin + part->size > offset) {
+                        from = MAX(offset, begin) - begin;
+                        to = MIN(offset + size, begin + part->size) - begin;
+
+                        if (part->is_zero) {
+                                memzero(e, to - from);
+                                e += to - from;
+                        } else
+                                e = mempcpy(e, (uint8_t*) part->data + from, to - from);
+                }
+
+                begin += part->size;
+        }
+
+        assert((size_t) (e - (uint8_t*) buffer) == size);
+        return 0;
+}
+
+int bus_message_append_raw(sd_bus_message *m, size_t align, const void *p, size_t size) {
+        void *a;
+
+        assert(m);
+        assert(p || size == 0);
+
+        /* Appends data marshalled earlier verbatim, for example a series of dictionary entries copied from
+         * another message with bus_message_read_body(). The caller has to make sure the data matches the
+         * signature of the current container, and that its start was aligned to the specified alignment.
+         * Not supported for GVariant, where we'd have to know the offsets of the individual elements. */
+
+        if (m->sealed)
+                return -EPERM;
+        if (m->poisoned)
+                return -ESTALE;
+        if (BUS_MESSAGE_IS_GVARIANT(m))
+                return -EOPNOTSUPP;
+
+        a = message_extend_body(m, align, size, false, false);
+        if (!a)
+                return -ENOMEM;
+
+        memcpy_safe(a, p, size);
+        return 0;
+}
+
 int bus_message_read_strv_extend(sd_bus_message *m, char ***l) {
         const char *s;
         int r;
@@ -2,6 +2,7 @@
 #pragma once
 
 #include <byteswap.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <sys/socket.h>
 
@@ -47,6 +48,34 @@ struct bus_body_part {
         bool is_zero:1;
 };
 
+/* Message objects created locally, and the buffers for their header fields and body, are recycled through a
+ * pool per bus connection, as allocating them anew for each message sent shows up in the profiles of busy
+ * services. Each message allocated from the pool keeps a reference to it, so that it is kept around as long
+ * as the connection or any of its messages are. Messages may be freed on a different thread than the one
+ * they were created on, like for the memfd cache of the connection, hence the pool is protected by a mutex. */
+#define BUS_MESSAGE_POOL_MAX 32U
+#define BUS_MESSAGE_POOL_BUFFER_MAX (16U*1024U)
+
+typedef struct BusMessagePoolStatistics {
+        uint64_t n_messages_allocated;  /* message objects allocated from the heap */
+        uint64_t n_messages_recycled;   /* message objects taken from the pool */
+        uint64_t n_buffers_allocated;   /* header and body buffers (re)allocated from the heap */
+        uint64_t n_buffers_recycled;    /* header and body buffers taken from the pool */
+} BusMessagePoolStatistics;
+
+typedef struct BusMessagePool {
+        /* Protects the reference counter and the list of messages, the statistics are updated atomically */
+        pthread_mutex_t mutex;
+
+        unsigned n_ref;
+
+        /* Linked by their pool_next field */
+        sd_bus_message *messages;
+        unsigned n_messages, max_messages;
+
+        BusMessagePoolStatistics statistics;
+} BusMessagePool;
+
 struct sd_bus_message {
         /* Caveat: a message can be referenced in two different ways: the main (user-facing) way will also
          * pin the bus connection object the message is associated with. The secondary way ("queued") is used
@@ -85,10 +114,12 @@ struct sd_bus_message {
         bool free_fds:1;
         bool poisoned:1;
         bool sensitive:1;
+        bool recyclable:1;
 
         /* The first and last bytes of the message */
         struct bus_header *header;
         void *footer;
+        size_t header_allocated; /* if the header was allocated separately, with room to spare */
 
         /* How many bytes are accessible in the above pointers */
         size_t header_accessible;
@@ -130,6 +161,12 @@ struct sd_bus_message {
         unsigned n_header_offsets;
 
         uint64_t read_counter;
+
+        /* The pool the message was allocated from, and a body buffer kept from its previous use */
+        BusMessagePool *pool;
+        sd_bus_message *pool_next;
+        void *body_spare;
+        size_t body_spare_allocated;
 };
 
 static inline bool BUS_MESSAGE_NEED_BSWAP(sd_bus_message *m) {
@@ -177,6 +214,8 @@ static inline bool BUS_MESSAGE_IS_GVARIANT(sd_bus_message *m) {
 }
 
 int bus_message_get_blob(sd_bus_message *m, void **buffer, size_t *sz);
+int bus_message_read_body(sd_bus_message *m, size_t offset, size_t size, void *buffer);
+int bus_message_append_raw(sd_bus_message *m, size_t align, const void *p, size_t size);
 int bus_message_read_strv_extend(sd_bus_message *m, char ***l);
 
 int bus_message_from_header(
@@ -223,5 +262,9 @@ int bus_message_remarshal(sd_bus *bus, sd_bus_message **m);
 void bus_message_set_sender_driver(sd_bus *bus, sd_bus_message *m);
 void bus_message_set_sender_local(sd_bus *bus, sd_bus_message *m);
 
+BusMessagePool *bus_message_pool_new(unsigned max_messages);
+BusMessagePool *bus_message_pool_ref(BusMessagePool *p);
+BusMessagePool *bus_message_pool_unref(BusMessagePool *p);
+
 sd_bus_message* bus_message_ref_queued(sd_bus_message *m, sd_bus *bus);
 sd_bus_message* bus_message_unref_queued(sd_bus_message *m, sd_bus *bus);
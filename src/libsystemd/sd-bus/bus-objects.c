@@ -14,6 +14,25 @@
 #include "string-util.h"
 #include "strv.h"
 
+/* Upper limit for the total size of serialized properties we keep cached per connection */
+#define PROPERTY_CACHE_SIZE_MAX (8U*1024U*1024U)
+
+struct property_cache_range {
+        size_t begin, end;
+};
+
+struct property_cache {
+        void *userdata;
+        char *path;
+
+        /* The dictionary entries of the cacheable properties, in vtable order, each aligned to 8 bytes */
+        uint8_t *data;
+        size_t size;
+
+        struct property_cache_range *ranges;
+        size_t n_ranges;
+};
+
 static int node_vtable_get_userdata(
                 sd_bus *bus,
                 const char *path,
@@ -698,6 +717,170 @@ static int property_get_set_callbacks_run(
         return 1;
 }
 
+static struct property_cache *property_cache_free(struct property_cache *e) {
+        if (!e)
+                return NULL;
+
+        free(e->path);
+        free(e->data);
+        free(e->ranges);
+        return mfree(e);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(struct property_cache*, property_cache_free);
+
+static void property_cache_drop(sd_bus *bus, struct property_cache *e) {
+        assert(bus);
+
+        if (!e)
+                return;
+
+        assert(bus->property_cache_size >= e->size);
+        bus->property_cache_size -= e->size;
+
+        property_cache_free(e);
+}
+
+static const void *property_cache_key(struct node_vtable *c, const char *path, void *userdata) {
+        assert(c);
+
+        /* If there's a find() callback, the same object might be reachable via multiple paths, hence index
+         * by the object itself, so that all of them share one entry, which may be invalidated by any of
+         * them. */
+        return c->find ? userdata : path;
+}
+
+static bool vtable_property_is_cacheable(const sd_bus_vtable *v) {
+        assert(v);
+
+        /* Only constant properties are cached. Those that signal their changes are cheap to read, and
+         * caching them would require invalidation on every change, signalled or not. */
+        return FLAGS_SET(v->flags, SD_BUS_VTABLE_PROPERTY_CONST);
+}
+
+static bool node_vtable_use_property_cache(struct node_vtable *c, sd_bus_message *reply) {
+        assert(c);
+        assert(reply);
+
+        /* Only method replies contain all properties, and we keep sensitive data out of the cache */
+        return FLAGS_SET(c->vtable[0].flags, SD_BUS_VTABLE_PROPERTY_CACHE) &&
+                !FLAGS_SET(c->vtable[0].flags, SD_BUS_VTABLE_SENSITIVE) &&
+                reply->header->type == SD_BUS_MESSAGE_METHOD_RETURN &&
+                reply->header->endian == BUS_NATIVE_ENDIAN &&
+                !BUS_MESSAGE_IS_GVARIANT(reply);
+}
+
+static struct property_cache *node_vtable_get_property_cache(struct node_vtable *c, const char *path, void *userdata) {
+        assert(c);
+        assert(path);
+
+        return hashmap_get(c->property_cache, property_cache_key(c, path, userdata));
+}
+
+static int node_vtable_put_property_cache(
+                sd_bus *bus,
+                struct node_vtable *c,
+                const char *path,
+                void *userdata,
+                sd_bus_message *reply,
+                const struct property_cache_range *ranges,
+                size_t n_ranges) {
+
+        _cleanup_(property_cache_freep) struct property_cache *e = NULL;
+        size_t i, size = 0;
+        int r;
+
+        assert(bus);
+        assert(c);
+        assert(path);
+        assert(reply);
+        assert(ranges || n_ranges == 0);
+
+        if (n_ranges == 0)
+                return 0;
+
+        for (i = 0; i < n_ranges; i++)
+                size = ALIGN8(size) + ranges[i].end - ranges[i].begin;
+
+        if (bus->property_cache_size + size > PROPERTY_CACHE_SIZE_MAX)
+                return 0;
+
+        r = hashmap_ensure_allocated(&c->property_cache, c->find ? &trivial_hash_ops : &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        e = new0(struct property_cache, 1);
+        if (!e)
+                return -ENOMEM;
+
+        e->userdata = userdata;
+        e->path = strdup(path);
+        e->data = malloc0(size);
+        e->ranges = new(struct property_cache_range, n_ranges);
+        if (!e->path || !e->data || !e->ranges)
+                return -ENOMEM;
+
+        for (i = 0; i < n_ranges; i++) {
+                size_t begin = i > 0 ? ALIGN8(e->ranges[i-1].end) : 0;
+
+                e->ranges[i] = (struct property_cache_range) {
+                        .begin = begin,
+                        .end = begin + ranges[i].end - ranges[i].begin,
+                };
+
+                r = bus_message_read_body(reply, ranges[i].begin, ranges[i].end - ranges[i].begin, e->data + begin);
+                if (r < 0)
+                        return r;
+        }
+
+        e->n_ranges = n_ranges;
+        e->size = size;
+
+        property_cache_drop(bus, hashmap_remove(c->property_cache, property_cache_key(c, path, userdata)));
+
+        r = hashmap_put(c->property_cache, property_cache_key(c, e->path, e->userdata), e);
+        if (r < 0)
+                return r;
+
+        bus->property_cache_size += TAKE_PTR(e)->size;
+        return 1;
+}
+
+static void node_vtable_invalidate_property_cache(sd_bus *bus, struct node_vtable *c, const char *path, void *userdata) {
+        assert(bus);
+        assert(c);
+        assert(path);
+
+        property_cache_drop(bus, hashmap_remove(c->property_cache, property_cache_key(c, path, userdata)));
+}
+
+void bus_node_vtable_free_property_cache(sd_bus *bus, struct node_vtable *c) {
+        struct property_cache *e;
+
+        assert(bus);
+        assert(c);
+
+        while ((e = hashmap_steal_first(c->property_cache)))
+                property_cache_drop(bus, e);
+
+        c->property_cache = hashmap_free(c->property_cache);
+}
+
+static int property_cache_append(sd_bus_message *reply, const struct property_cache *e, size_t first, size_t last) {
+        assert(reply);
+        assert(e);
+        assert(first <= last);
+        assert(last <= e->n_ranges);
+
+        /* Copies the cached properties first…last-1 into the message in one go. They are stored aligned,
+         * including the padding between them, just like they'd be laid out in the message. */
+
+        if (first == last)
+                return 0;
+
+        return bus_message_append_raw(reply, 8, e->data + e->ranges[first].begin, e->ranges[last-1].end - e->ranges[first].begin);
+}
+
 static int vtable_append_one_property(
                 sd_bus *bus,
                 sd_bus_message *reply,
@@ -761,6 +944,10 @@ static int vtable_append_all_properties(
                 void *userdata,
                 sd_bus_error *error) {
 
+        _cleanup_free_ struct property_cache_range *ranges = NULL;
+        size_t n_ranges = 0, n_allocated = 0, first = 0, k = 0;
+        struct property_cache *cache = NULL;
+        bool populate = false;
         const sd_bus_vtable *v;
         int r;
 
@@ -772,6 +959,11 @@ static int vtable_append_all_properties(
         if (c->vtable[0].flags & SD_BUS_VTABLE_HIDDEN)
                 return 1;
 
+        if (node_vtable_use_property_cache(c, reply)) {
+                cache = node_vtable_get_property_cache(c, path, userdata);
+                populate = !cache && bus->property_cache_size < PROPERTY_CACHE_SIZE_MAX;
+        }
+
         v = c->vtable;
         for (v = bus_vtable_next(c->vtable, v); v->type != _SD_BUS_VTABLE_END; v = bus_vtable_next(c->vtable, v)) {
                 if (!IN_SET(v->type, _SD_BUS_VTABLE_PROPERTY, _SD_BUS_VTABLE_WRITABLE_PROPERTY))
@@ -792,6 +984,44 @@ static int vtable_append_all_properties(
                     FLAGS_SET(v->flags, SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION))
                         continue;
 
+                if (cache && vtable_property_is_cacheable(v)) {
+                        /* Collect a run of cached properties, and copy it once we reach one that is not */
+                        assert(k < cache->n_ranges);
+                        k++;
+                        continue;
+                }
+
+                if (cache) {
+                        r = property_cache_append(reply, cache, first, k);
+                        if (r < 0)
+                                return r;
+
+                        first = k;
+                }
+
+                if (populate && vtable_property_is_cacheable(v)) {
+                        size_t begin = reply->body_size;
+                        unsigned n_fds = reply->n_fds;
+
+                        r = vtable_append_one_property(bus, reply, path, c, v, userdata, error);
+                        if (r < 0)
+                                return r;
+                        if (bus->nodes_modified)
+                                return 0;
+
+                        /* File descriptors can't be replayed from the cache */
+                        if (reply->n_fds != n_fds || !GREEDY_REALLOC(ranges, n_allocated, n_ranges + 1))
+                                populate = false;
+                        else
+                                ranges[n_ranges++] = (struct property_cache_range) {
+                                        /* Dictionary entries are aligned to 8 bytes */
+                                        .begin = ALIGN8(begin),
+                                        .end = reply->body_size,
+                                };
+
+                        continue;
+                }
+
                 r = vtable_append_one_property(bus, reply, path, c, v, userdata, error);
                 if (r < 0)
                         return r;
@@ -799,6 +1029,18 @@ static int vtable_append_all_properties(
                         return 0;
         }
 
+        if (cache) {
+                assert(k == cache->n_ranges);
+
+                r = property_cache_append(reply, cache, first, k);
+                if (r < 0)
+                        return r;
+        }
+
+        if (populate)
+                /* The cache is an optimization only, hence don't fail if we can't populate it */
+                (void) node_vtable_put_property_cache(bus, c, path, userdata, reply, ranges, n_ranges);
+
         return 1;
 }
 
@@ -1877,7 +2119,7 @@ static int add_object_vtable_internal(
                             !names_are_valid(strempty(v->x.method.signature), &names, &nf) ||
                             !names_are_valid(strempty(v->x.method.result), &names, &nf) ||
                             !(v->x.method.handler || (isempty(v->x.method.signature) && isempty(v->x.method.result))) ||
-                            v->flags & (SD_BUS_VTABLE_PROPERTY_CONST|SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE|SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION)) {
+                            v->flags & (SD_BUS_VTABLE_PROPERTY_CONST|SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE|SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION|SD_BUS_VTABLE_PROPERTY_CACHE)) {
                                 r = -EINVAL;
                                 goto fail;
                         }
@@ -1922,7 +2164,7 @@ static int add_object_vtable_internal(
                         if (!member_name_is_valid(v->x.property.member) ||
                             !signature_is_single(v->x.property.signature, false) ||
                             !(v->x.property.get || bus_type_is_basic(v->x.property.signature[0]) || streq(v->x.property.signature, "as")) ||
-                            (v->flags & SD_BUS_VTABLE_METHOD_NO_REPLY) ||
+                            (v->flags & (SD_BUS_VTABLE_METHOD_NO_REPLY|SD_BUS_VTABLE_PROPERTY_CACHE)) ||
                             (!!(v->flags & SD_BUS_VTABLE_PROPERTY_CONST) + !!(v->flags & SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE) + !!(v->flags & SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION)) > 1 ||
                             ((v->flags & SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE) && (v->flags & SD_BUS_VTABLE_PROPERTY_EXPLICIT)) ||
                             (v->flags & SD_BUS_VTABLE_UNPRIVILEGED && v->type == _SD_BUS_VTABLE_PROPERTY)) {
@@ -1960,7 +2202,7 @@ static int add_object_vtable_internal(
                         if (!member_name_is_valid(v->x.signal.member) ||
                             !signature_is_valid(strempty(v->x.signal.signature), false) ||
                             !names_are_valid(strempty(v->x.signal.signature), &names, &nf) ||
-                            v->flags & SD_BUS_VTABLE_UNPRIVILEGED) {
+                            v->flags & (SD_BUS_VTABLE_UNPRIVILEGED|SD_BUS_VTABLE_PROPERTY_CACHE)) {
                                 r = -EINVAL;
                                 goto fail;
                         }
@@ -2351,6 +2593,109 @@ _public_ int sd_bus_emit_properties_changed(
         return sd_bus_emit_properties_changed_strv(bus, path, interface, names);
 }
 
+static int invalidate_properties_on_node(
+                sd_bus *bus,
+                const char *prefix,
+                const char *path,
+                const char *interface,
+                bool require_fallback) {
+
+        struct node_vtable *c;
+        struct node *n;
+        int r;
+
+        assert(bus);
+        assert(prefix);
+        assert(path);
+
+        n = hashmap_get(bus->nodes, prefix);
+        if (!n)
+                return 0;
+
+        LIST_FOREACH(vtables, c, n->vtables) {
+                _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+                void *u = NULL;
+
+                if (require_fallback && !c->is_fallback)
+                        continue;
+
+                if (interface && !streq(c->interface, interface))
+                        continue;
+
+                if (hashmap_isempty(c->property_cache))
+                        continue;
+
+                if (c->find) {
+                        r = node_vtable_get_userdata(bus, path, c, &u, &error);
+                        if (r < 0)
+                                return r;
+                        if (bus->nodes_modified)
+                                return 0;
+                        if (r == 0)
+                                continue;
+                }
+
+                node_vtable_invalidate_property_cache(bus, c, path, u);
+        }
+
+        return 0;
+}
+
+_public_ int sd_bus_invalidate_properties(
+                sd_bus *bus,
+                const char *path,
+                const char *interface) {
+
+        _cleanup_free_ char *prefix = NULL;
+        bool nodes_modified;
+        size_t pl;
+        int r = 0;
+
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+        assert_return(object_path_is_valid(path), -EINVAL);
+        assert_return(!interface || interface_name_is_valid(interface), -EINVAL);
+        assert_return(!bus_pid_changed(bus), -ECHILD);
+
+        /* Nothing cached, nothing to do */
+        if (bus->property_cache_size == 0)
+                return 0;
+
+        BUS_DONT_DESTROY(bus);
+
+        pl = strlen(path);
+        assert(pl <= BUS_PATH_SIZE_MAX);
+        prefix = new(char, pl + 1);
+        if (!prefix)
+                return -ENOMEM;
+
+        /* This is likely called from within object callbacks, hence don't lose track of modifications of the
+         * object tree made by the caller before. */
+        nodes_modified = bus->nodes_modified;
+
+        do {
+                bus->nodes_modified = false;
+
+                r = invalidate_properties_on_node(bus, path, path, interface, false);
+                if (r < 0)
+                        break;
+                if (bus->nodes_modified)
+                        continue;
+
+                OBJECT_PATH_FOREACH_PREFIX(prefix, path) {
+                        r = invalidate_properties_on_node(bus, prefix, path, interface, true);
+                        if (r < 0)
+                                break;
+                        if (bus->nodes_modified)
+                                break;
+                }
+
+        } while (r >= 0 && bus->nodes_modified);
+
+        bus->nodes_modified = bus->nodes_modified || nodes_modified;
+        return r;
+}
+
 static int object_added_append_all_prefix(
                 sd_bus *bus,
                 sd_bus_message *m,
@@ -2716,6 +3061,10 @@ _public_ int sd_bus_emit_object_removed(sd_bus *bus, const char *path) {
 
         BUS_DONT_DESTROY(bus);
 
+        r = sd_bus_invalidate_properties(bus, path, NULL);
+        if (r < 0)
+                return r;
+
         do {
                 bus->nodes_modified = false;
                 m = sd_bus_message_unref(m);
@@ -2945,6 +3294,7 @@ _public_ int sd_bus_emit_interfaces_added(sd_bus *bus, const char *path, const c
 _public_ int sd_bus_emit_interfaces_removed_strv(sd_bus *bus, const char *path, char **interfaces) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
         struct node *object_manager;
+        char **i;
         int r;
 
         assert_return(bus, -EINVAL);
@@ -2964,6 +3314,12 @@ _public_ int sd_bus_emit_interfaces_removed_strv(sd_bus *bus, const char *path,
         if (r == 0)
                 return -ESRCH;
 
+        STRV_FOREACH(i, interfaces) {
+                r = sd_bus_invalidate_properties(bus, path, *i);
+                if (r < 0)
+                        return r;
+        }
+
         r = sd_bus_message_new_signal(bus, &m, object_manager->path, "org.freedesktop.DBus.ObjectManager", "InterfacesRemoved");
         if (r < 0)
                 return r;
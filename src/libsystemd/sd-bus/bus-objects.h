@@ -8,6 +8,7 @@ const sd_bus_vtable* bus_vtable_next(const sd_bus_vtable *vtable, const sd_bus_v
 bool bus_vtable_has_names(const sd_bus_vtable *vtable);
 int bus_process_object(sd_bus *bus, sd_bus_message *m);
 void bus_node_gc(sd_bus *b, struct node *n);
+void bus_node_vtable_free_property_cache(sd_bus *bus, struct node_vtable *c);
 
 int introspect_path(
                 sd_bus *bus,
@@ -149,6 +149,7 @@ void bus_slot_disconnect(sd_bus_slot *slot, bool unref) {
                         }
                 }
 
+                bus_node_vtable_free_property_cache(slot->bus, &slot->node_vtable);
                 slot->node_vtable.interface = mfree(slot->node_vtable.interface);
 
                 if (slot->node_vtable.node) {
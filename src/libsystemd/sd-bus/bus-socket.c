@@ -26,10 +26,12 @@
 #include "signal-util.h"
 #include "stdio-util.h"
 #include "string-util.h"
+#include "unaligned.h"
 #include "user-util.h"
 #include "utf8.h"
 
 #define SNDBUF_SIZE (8*1024*1024)
+#define READ_AHEAD_SIZE (16U*1024U)
 
 static void iovec_advance(struct iovec iov[], unsigned *idx, size_t size) {
 
@@ -999,38 +1001,59 @@ int bus_socket_take_fd(sd_bus *b) {
         return bus_socket_start_auth(b);
 }
 
-int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
+int bus_socket_write_messages(sd_bus *bus, sd_bus_message **messages, size_t n_messages, size_t *idx) {
         struct iovec *iov;
+        sd_bus_message *m;
+        size_t i, l, n, n_iov = 0;
         ssize_t k;
-        size_t n;
         unsigned j;
         int r;
 
         assert(bus);
-        assert(m);
+        assert(messages);
+        assert(n_messages > 0);
         assert(idx);
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
+        m = messages[0];
+
         if (*idx >= BUS_MESSAGE_SIZE(m))
                 return 0;
 
-        r = bus_message_setup_iovec(m);
-        if (r < 0)
-                return r;
+        /* Write out as many of the messages as possible with a single call. File descriptors are attached
+         * to the first byte written, and the receiving side associates them with the message that starts
+         * there, hence a message that carries any always starts a new batch. */
+        for (n = 0; n < n_messages; n++) {
+                r = bus_message_setup_iovec(messages[n]);
+                if (r < 0) {
+                        if (n == 0)
+                                return r;
+                        break;
+                }
+
+                if (n > 0 && (messages[n]->n_fds > 0 || n_iov + messages[n]->n_iovec > IOV_MAX))
+                        break;
 
-        n = m->n_iovec * sizeof(struct iovec);
-        iov = newa(struct iovec, n);
-        memcpy_safe(iov, m->iovec, n);
+                n_iov += messages[n]->n_iovec;
+        }
+
+        iov = newa(struct iovec, n_iov);
+        for (i = 0, l = 0; i < n; i++) {
+                memcpy(iov + l, messages[i]->iovec, messages[i]->n_iovec * sizeof(struct iovec));
+                l += messages[i]->n_iovec;
+        }
 
         j = 0;
         iovec_advance(iov, &j, *idx);
 
+        bus->n_write_calls++;
+
         if (bus->prefer_writev)
-                k = writev(bus->output_fd, iov, m->n_iovec);
+                k = writev(bus->output_fd, iov + j, n_iov - j);
         else {
                 struct msghdr mh = {
-                        .msg_iov = iov,
-                        .msg_iovlen = m->n_iovec,
+                        .msg_iov = iov + j,
+                        .msg_iovlen = n_iov - j,
                 };
 
                 if (m->n_fds > 0 && *idx == 0) {
@@ -1048,7 +1071,7 @@ int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
                 k = sendmsg(bus->output_fd, &mh, MSG_DONTWAIT|MSG_NOSIGNAL);
                 if (k < 0 && errno == ENOTSOCK) {
                         bus->prefer_writev = true;
-                        k = writev(bus->output_fd, iov, m->n_iovec);
+                        k = writev(bus->output_fd, iov + j, n_iov - j);
                 }
         }
 
@@ -1059,16 +1082,17 @@ int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
         return 1;
 }
 
-static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
+static int bus_socket_read_message_need(sd_bus *bus, size_t offset, size_t *need) {
+        const uint8_t *p;
         uint32_t a, b;
-        uint8_t e;
         uint64_t sum;
 
         assert(bus);
+        assert(offset <= bus->rbuffer_size);
         assert(need);
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
-        if (bus->rbuffer_size < sizeof(struct bus_header)) {
+        if (bus->rbuffer_size - offset < sizeof(struct bus_header)) {
                 *need = sizeof(struct bus_header) + 8;
 
                 /* Minimum message size:
@@ -1090,16 +1114,15 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
                 return 0;
         }
 
-        a = ((const uint32_t*) bus->rbuffer)[1];
-        b = ((const uint32_t*) bus->rbuffer)[3];
+        /* Messages following others in the buffer are not necessarily aligned */
+        p = (const uint8_t*) bus->rbuffer + offset;
 
-        e = ((const uint8_t*) bus->rbuffer)[0];
-        if (e == BUS_LITTLE_ENDIAN) {
-                a = le32toh(a);
-                b = le32toh(b);
-        } else if (e == BUS_BIG_ENDIAN) {
-                a = be32toh(a);
-                b = be32toh(b);
+        if (p[0] == BUS_LITTLE_ENDIAN) {
+                a = unaligned_read_le32(p + 4);
+                b = unaligned_read_le32(p + 12);
+        } else if (p[0] == BUS_BIG_ENDIAN) {
+                a = unaligned_read_be32(p + 4);
+                b = unaligned_read_be32(p + 12);
         } else
                 return -EBADMSG;
 
@@ -1111,46 +1134,159 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
         return 0;
 }
 
-static int bus_socket_make_message(sd_bus *bus, size_t size) {
+static int bus_socket_peek_unix_fds(const uint8_t *p, size_t size, size_t *ret) {
+        uint32_t (*read32)(const void *u);
+        size_t i, end;
+
+        assert(p);
+        assert(size >= sizeof(struct bus_header));
+        assert(ret);
+
+        /* Determines the number of file descriptors a dbus1 message carries from its UNIX_FDS header
+         * field, without parsing the whole message. Only the field types the specification defines for
+         * header fields are understood, if we encounter anything else we return -EOPNOTSUPP. */
+
+        if (p[3] != 1)
+                return -EOPNOTSUPP;
+
+        read32 = p[0] == BUS_LITTLE_ENDIAN ? unaligned_read_le32 : unaligned_read_be32;
+
+        end = sizeof(struct bus_header) + read32(p + 12);
+        if (end > size)
+                return -EBADMSG;
+
+        for (i = sizeof(struct bus_header); i < end; ) {
+                uint8_t code;
+                uint32_t l;
+
+                i = ALIGN_TO(i, 8);
+                if (i + 4 > end)
+                        return -EBADMSG;
+
+                /* Field code, followed by the signature of the variant, which must be a single type */
+                code = p[i];
+                if (p[i+1] != 1 || p[i+3] != 0)
+                        return -EOPNOTSUPP;
+
+                switch (p[i+2]) {
+
+                case SD_BUS_TYPE_UINT32:
+                        i = ALIGN_TO(i + 4, 4);
+                        if (i + 4 > end)
+                                return -EBADMSG;
+
+                        if (code == BUS_MESSAGE_HEADER_UNIX_FDS) {
+                                *ret = read32(p + i);
+                                return 0;
+                        }
+
+                        i += 4;
+                        break;
+
+                case SD_BUS_TYPE_STRING:
+                case SD_BUS_TYPE_OBJECT_PATH:
+                        i = ALIGN_TO(i + 4, 4);
+                        if (i + 4 > end)
+                                return -EBADMSG;
+
+                        l = read32(p + i);
+                        if (l > end - i - 4)
+                                return -EBADMSG;
+
+                        i += 4 + l + 1;
+                        break;
+
+                case SD_BUS_TYPE_SIGNATURE:
+                        i += 4;
+                        if (i + 1 > end)
+                                return -EBADMSG;
+
+                        i += 1 + p[i] + 1;
+                        break;
+
+                default:
+                        return -EOPNOTSUPP;
+                }
+        }
+
+        *ret = 0;
+        return 0;
+}
+
+static int bus_socket_make_message(sd_bus *bus, size_t offset, size_t size) {
+        _cleanup_free_ int *fds = NULL;
         sd_bus_message *t = NULL;
+        size_t n_fds = 0;
         void *b;
         int r;
 
         assert(bus);
-        assert(bus->rbuffer_size >= size);
+        assert(bus->rbuffer_size >= offset + size);
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
         r = bus_rqueue_make_room(bus);
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size > size) {
-                b = memdup((const uint8_t*) bus->rbuffer + size,
-                           bus->rbuffer_size - size);
+        /* Pass the file descriptors received so far to the message they belong to. Since we read ahead
+         * the next messages may have been received together with this one, hence look at the header to
+         * figure out how many it takes, and leave the rest for the following messages. If the header
+         * can't be interpreted, pass all of them, and let the parser sort it out. */
+        if (bus->n_fds > 0) {
+                if (bus_socket_peek_unix_fds((const uint8_t*) bus->rbuffer + offset, size, &n_fds) < 0 ||
+                    n_fds > bus->n_fds)
+                        n_fds = bus->n_fds;
+
+                if (n_fds == bus->n_fds)
+                        fds = TAKE_PTR(bus->fds);
+                else if (n_fds > 0) {
+                        fds = newdup(int, bus->fds, n_fds);
+                        if (!fds)
+                                return -ENOMEM;
+                }
+        }
+
+        /* Hand the buffer over to the message if it contains exactly this one message, copy it out
+         * otherwise */
+        if (offset == 0 && size == bus->rbuffer_size)
+                b = bus->rbuffer;
+        else {
+                b = memdup((const uint8_t*) bus->rbuffer + offset, size);
                 if (!b)
                         return -ENOMEM;
-        } else
-                b = NULL;
+        }
 
         r = bus_message_from_malloc(bus,
-                                    bus->rbuffer, size,
-                                    bus->fds, bus->n_fds,
+                                    b, size,
+                                    fds, n_fds,
                                     NULL,
                                     &t);
         if (r == -EBADMSG) {
                 log_debug_errno(r, "Received invalid message from connection %s, dropping.", strna(bus->description));
-                free(bus->rbuffer); /* We want to drop current rbuffer and proceed with whatever remains in b */
-        } else if (r < 0) {
+                close_many(fds, n_fds);
                 free(b);
+        } else if (r < 0) {
+                if (b != bus->rbuffer)
+                        free(b);
+                if (!bus->fds) /* We took all of them, give them back */
+                        bus->fds = TAKE_PTR(fds);
                 return r;
-        }
+        } else
+                /* The message took possession of the fds, if there were any */
+                TAKE_PTR(fds);
 
-        /* rbuffer ownership was either transferred to t, or we got EBADMSG and dropped it. */
-        bus->rbuffer = b;
-        bus->rbuffer_size -= size;
+        if (b == bus->rbuffer) {
+                bus->rbuffer = NULL;
+                bus->rbuffer_size = 0;
+        }
 
-        bus->fds = NULL;
-        bus->n_fds = 0;
+        if (n_fds == bus->n_fds) {
+                bus->fds = NULL;
+                bus->n_fds = 0;
+        } else {
+                memmove(bus->fds, bus->fds + n_fds, sizeof(int) * (bus->n_fds - n_fds));
+                bus->n_fds -= n_fds;
+        }
 
         if (t) {
                 t->read_counter = ++bus->read_counter;
@@ -1161,11 +1297,60 @@ static int bus_socket_make_message(sd_bus *bus, size_t size) {
         return 1;
 }
 
+static int bus_socket_make_messages(sd_bus *bus) {
+        size_t offset = 0, need;
+        int r, ret = 0;
+
+        assert(bus);
+
+        /* Turns all complete messages in the read buffer into message objects, and moves whatever remains to
+         * the beginning of the buffer */
+
+        for (;;) {
+                r = bus_socket_read_message_need(bus, offset, &need);
+                if (r < 0)
+                        break;
+
+                if (bus->rbuffer_size - offset < need)
+                        break;
+
+                r = bus_socket_make_message(bus, offset, need);
+                if (r < 0)
+                        break;
+
+                ret = 1;
+
+                if (!bus->rbuffer) {
+                        /* The buffer has been passed on, it contained the last message */
+                        offset = 0;
+                        break;
+                }
+
+                offset += need;
+        }
+
+        if (offset > 0) {
+                memmove(bus->rbuffer, (uint8_t*) bus->rbuffer + offset, bus->rbuffer_size - offset);
+                bus->rbuffer_size -= offset;
+        }
+
+        /* File descriptors are received together with the beginning of the message they belong to. If
+         * there's nothing left in the buffer, nobody claims the remaining ones. */
+        if (bus->rbuffer_size == 0 && bus->n_fds > 0) {
+                log_debug("Received file descriptors not belonging to any message from connection %s, closing.", strna(bus->description));
+                close_many(bus->fds, bus->n_fds);
+                bus->fds = mfree(bus->fds);
+                bus->n_fds = 0;
+        }
+
+        return r < 0 ? r : ret;
+}
+
 int bus_socket_read_message(sd_bus *bus) {
         struct msghdr mh;
         struct iovec iov = {};
         ssize_t k;
-        size_t need;
+        size_t need, n;
         int r;
         void *b;
         CMSG_BUFFER_TYPE(CMSG_SPACE(sizeof(int) * BUS_FDS_MAX)) control;
@@ -1174,20 +1359,27 @@ int bus_socket_read_message(sd_bus *bus) {
         assert(bus);
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
-        r = bus_socket_read_message_need(bus, &need);
+        r = bus_socket_make_messages(bus);
+        if (r != 0)
+                return r;
+
+        r = bus_socket_read_message_need(bus, 0, &need);
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size >= need)
-                return bus_socket_make_message(bus, need);
+        /* Read ahead, so that a burst of small messages doesn't cost a call for each header and another for
+         * each body, but only one for all of them */
+        n = MAX(need, bus->rbuffer_size + READ_AHEAD_SIZE);
 
-        b = realloc(bus->rbuffer, need);
+        b = realloc(bus->rbuffer, n);
         if (!b)
                 return -ENOMEM;
 
         bus->rbuffer = b;
 
-        iov = IOVEC_MAKE((uint8_t *)bus->rbuffer + bus->rbuffer_size, need - bus->rbuffer_size);
+        iov = IOVEC_MAKE((uint8_t *)bus->rbuffer + bus->rbuffer_size, n - bus->rbuffer_size);
+
+        bus->n_read_calls++;
 
         if (bus->prefer_readv) {
                 k = readv(bus->input_fd, &iov, 1);
@@ -1222,32 +1414,39 @@ int bus_socket_read_message(sd_bus *bus) {
 
         bus->rbuffer_size += k;
 
+        /* Don't keep the unused part of the read-ahead buffer around, it might be passed on to a message */
+        if (bus->rbuffer_size < n) {
+                b = realloc(bus->rbuffer, bus->rbuffer_size);
+                if (b)
+                        bus->rbuffer = b;
+        }
+
         if (handle_cmsg) {
                 struct cmsghdr *cmsg;
 
                 CMSG_FOREACH(cmsg, &mh)
                         if (cmsg->cmsg_level == SOL_SOCKET &&
                             cmsg->cmsg_type == SCM_RIGHTS) {
-                                int n, *f, i;
+                                int n_received, *f, i;
 
-                                n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                                n_received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
 
                                 if (!bus->can_fds) {
                                         /* Whut? We received fds but this
                                          * isn't actually enabled? Close them,
                                          * and fail */
 
-                                        close_many((int*) CMSG_DATA(cmsg), n);
+                                        close_many((int*) CMSG_DATA(cmsg), n_received);
                                         return -EIO;
                                 }
 
-                                f = reallocarray(bus->fds, bus->n_fds + n, sizeof(int));
+                                f = reallocarray(bus->fds, bus->n_fds + n_received, sizeof(int));
                                 if (!f) {
-                                        close_many((int*) CMSG_DATA(cmsg), n);
+                                        close_many((int*) CMSG_DATA(cmsg), n_received);
                                         return -ENOMEM;
                                 }
 
-                                for (i = 0; i < n; i++)
+                                for (i = 0; i < n_received; i++)
                                         f[bus->n_fds++] = fd_move_above_stdio(((int*) CMSG_DATA(cmsg))[i]);
                                 bus->fds = f;
                         } else
@@ -1255,13 +1454,10 @@ int bus_socket_read_message(sd_bus *bus) {
                                           cmsg->cmsg_level, cmsg->cmsg_type);
         }
 
-        r = bus_socket_read_message_need(bus, &need);
+        r = bus_socket_make_messages(bus);
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size >= need)
-                return bus_socket_make_message(bus, need);
-
         return 1;
 }
 
@@ -221,6 +221,7 @@ static sd_bus* bus_free(sd_bus *b) {
         hashmap_free(b->nodes);
 
         bus_flush_memfd(b);
+        bus_message_pool_unref(b->message_pool);
 
         assert_se(pthread_mutex_destroy(&b->memfd_cache_mutex) == 0);
 
@@ -255,6 +256,12 @@ _public_ int sd_bus_new(sd_bus **ret) {
         if (!GREEDY_REALLOC(b->wqueue, b->wqueue_allocated, 1))
                 return -ENOMEM;
 
+        b->message_pool = bus_message_pool_new(BUS_MESSAGE_POOL_MAX);
+        if (!b->message_pool) {
+                free(b->wqueue);
+                return -ENOMEM;
+        }
+
         assert_se(pthread_mutex_init(&b->memfd_cache_mutex, NULL) == 0);
 
         *ret = TAKE_PTR(b);
@@ -1777,29 +1784,39 @@ int bus_seal_synthetic_message(sd_bus *b, sd_bus_message *m) {
         return sd_bus_message_seal(m, 0xFFFFFFFFULL, 0);
 }
 
-static int bus_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
+static int bus_write_messages(sd_bus *bus, sd_bus_message **messages, size_t n_messages, size_t *idx) {
+        size_t i, offset = 0, before;
         int r;
 
         assert(bus);
-        assert(m);
+        assert(messages);
+        assert(n_messages > 0);
 
-        r = bus_socket_write_message(bus, m, idx);
+        before = *idx;
+
+        r = bus_socket_write_messages(bus, messages, n_messages, idx);
         if (r <= 0)
                 return r;
 
-        if (*idx >= BUS_MESSAGE_SIZE(m))
-                log_debug("Sent message type=%s sender=%s destination=%s path=%s interface=%s member=%s cookie=%" PRIu64 " reply_cookie=%" PRIu64 " signature=%s error-name=%s error-message=%s",
-                          bus_message_type_to_string(m->header->type),
-                          strna(sd_bus_message_get_sender(m)),
-                          strna(sd_bus_message_get_destination(m)),
-                          strna(sd_bus_message_get_path(m)),
-                          strna(sd_bus_message_get_interface(m)),
-                          strna(sd_bus_message_get_member(m)),
-                          BUS_MESSAGE_COOKIE(m),
-                          m->reply_cookie,
-                          strna(m->root_container.signature),
-                          strna(m->error.name),
-                          strna(m->error.message));
+        for (i = 0; i < n_messages && offset < *idx; i++) {
+                sd_bus_message *m = messages[i];
+
+                offset += BUS_MESSAGE_SIZE(m);
+
+                if (offset > before && offset <= *idx)
+                        log_debug("Sent message type=%s sender=%s destination=%s path=%s interface=%s member=%s cookie=%" PRIu64 " reply_cookie=%" PRIu64 " signature=%s error-name=%s error-message=%s",
+                                  bus_message_type_to_string(m->header->type),
+                                  strna(sd_bus_message_get_sender(m)),
+                                  strna(sd_bus_message_get_destination(m)),
+                                  strna(sd_bus_message_get_path(m)),
+                                  strna(sd_bus_message_get_interface(m)),
+                                  strna(sd_bus_message_get_member(m)),
+                                  BUS_MESSAGE_COOKIE(m),
+                                  m->reply_cookie,
+                                  strna(m->root_container.signature),
+                                  strna(m->error.name),
+                                  strna(m->error.message));
+        }
 
         return r;
 }
@@ -1811,28 +1828,25 @@ static int dispatch_wqueue(sd_bus *bus) {
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
         while (bus->wqueue_size > 0) {
+                size_t n = 0;
 
-                r = bus_write_message(bus, bus->wqueue[0], &bus->windex);
+                r = bus_write_messages(bus, bus->wqueue, bus->wqueue_size, &bus->windex);
                 if (r < 0)
                         return r;
                 else if (r == 0)
                         /* Didn't do anything this time */
                         return ret;
-                else if (bus->windex >= BUS_MESSAGE_SIZE(bus->wqueue[0])) {
-                        /* Fully written. Let's drop the entry from
-                         * the queue.
-                         *
-                         * This isn't particularly optimized, but
-                         * well, this is supposed to be our worst-case
-                         * buffer only, and the socket buffer is
-                         * supposed to be our primary buffer, and if
-                         * it got full, then all bets are off
-                         * anyway. */
-
-                        bus->wqueue_size--;
-                        bus_message_unref_queued(bus->wqueue[0], bus);
-                        memmove(bus->wqueue, bus->wqueue + 1, sizeof(sd_bus_message*) * bus->wqueue_size);
-                        bus->windex = 0;
+
+                /* Drop all fully written entries from the queue. */
+                while (n < bus->wqueue_size && bus->windex >= BUS_MESSAGE_SIZE(bus->wqueue[n])) {
+                        bus->windex -= BUS_MESSAGE_SIZE(bus->wqueue[n]);
+                        bus_message_unref_queued(bus->wqueue[n], bus);
+                        n++;
+                }
+
+                if (n > 0) {
+                        bus->wqueue_size -= n;
+                        memmove(bus->wqueue, bus->wqueue + n, sizeof(sd_bus_message*) * bus->wqueue_size);
 
                         ret = 1;
                 }
@@ -1939,10 +1953,12 @@ _public_ int sd_bus_send(sd_bus *bus, sd_bus_message *_m, uint64_t *cookie) {
         if (m->dont_send)
                 goto finish;
 
-        if (IN_SET(bus->state, BUS_RUNNING, BUS_HELLO) && bus->wqueue_size <= 0) {
+        /* If requested, don't write the message right-away, but leave that to the event loop, which writes
+         * out everything queued up by then at once before it goes to sleep again. */
+        if (IN_SET(bus->state, BUS_RUNNING, BUS_HELLO) && bus->wqueue_size <= 0 && !(bus->batch_send && bus->event)) {
                 size_t idx = 0;
 
-                r = bus_write_message(bus, m, &idx);
+                r = bus_write_messages(bus, &m, 1, &idx);
                 if (r < 0) {
                         if (ERRNO_IS_DISCONNECT(r)) {
                                 bus_enter_closing(bus);
@@ -2189,6 +2205,20 @@ _public_ int sd_bus_call(
         if (r < 0)
                 goto fail;
 
+        /* Don't wait for the event loop to write out the queue if batching is enabled, we are going to
+         * block anyway */
+        if (bus->batch_send && bus->wqueue_size > 0) {
+                r = dispatch_wqueue(bus);
+                if (r < 0) {
+                        if (ERRNO_IS_DISCONNECT(r)) {
+                                bus_enter_closing(bus);
+                                r = -ECONNRESET;
+                        }
+
+                        goto fail;
+                }
+        }
+
         timeout = calc_elapse(bus, m->timeout);
 
         for (;;) {
@@ -3443,6 +3473,13 @@ static int prepare_callback(sd_event_source *s, void *userdata) {
         assert(s);
         assert(bus);
 
+        /* Write out whatever has been queued up during this event loop iteration */
+        if (bus->batch_send && bus->wqueue_size > 0 && IN_SET(bus->state, BUS_RUNNING, BUS_HELLO)) {
+                r = dispatch_wqueue(bus);
+                if (r < 0)
+                        goto fail;
+        }
+
         e = sd_bus_get_events(bus);
         if (e < 0) {
                 r = e;
@@ -4217,6 +4254,40 @@ _public_ int sd_bus_get_close_on_exit(sd_bus *bus) {
         return bus->close_on_exit;
 }
 
+_public_ int sd_bus_set_batch_send(sd_bus *bus, int b) {
+        int r;
+
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+        assert_return(!bus_pid_changed(bus), -ECHILD);
+
+        if (bus->batch_send && !b && bus->wqueue_size > 0 && IN_SET(bus->state, BUS_RUNNING, BUS_HELLO)) {
+                /* Write out whatever is queued already, as far as that's possible without blocking */
+                bus->batch_send = false;
+
+                r = dispatch_wqueue(bus);
+                if (r < 0) {
+                        if (ERRNO_IS_DISCONNECT(r)) {
+                                bus_enter_closing(bus);
+                                return -ECONNRESET;
+                        }
+
+                        return r;
+                }
+        }
+
+        bus->batch_send = b;
+        return 0;
+}
+
+_public_ int sd_bus_get_batch_send(sd_bus *bus) {
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+        assert_return(!bus_pid_changed(bus), -ECHILD);
+
+        return bus->batch_send;
+}
+
 _public_ int sd_bus_enqueue_for_read(sd_bus *bus, sd_bus_message *m) {
         int r;
 
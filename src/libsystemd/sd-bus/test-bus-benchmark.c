@@ -4,10 +4,12 @@
 #include <unistd.h>
 
 #include "sd-bus.h"
+#include "sd-event.h"
 
 #include "alloc-util.h"
 #include "bus-internal.h"
 #include "bus-kernel.h"
+#include "bus-message.h"
 #include "bus-util.h"
 #include "def.h"
 #include "fd-util.h"
@@ -19,6 +21,29 @@
 
 static usec_t arg_loop_usec = 100 * USEC_PER_MSEC;
 
+/* The pool statistics only cover what sd-bus knows about. Count the actual calls into the allocator too, by
+ * wrapping glibc's implementation. */
+static uint64_t n_heap_allocations = 0;
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size) {
+        n_heap_allocations++;
+        return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+        n_heap_allocations++;
+        return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size) {
+        n_heap_allocations++;
+        return __libc_realloc(p, size);
+}
+
 typedef enum Type {
         TYPE_LEGACY,
         TYPE_DIRECT,
@@ -206,10 +231,160 @@ static void client_chart(Type type, const char *address, const char *server_name
         sd_bus_unref(b);
 }
 
+static void emit_properties_changed(sd_bus *b, uint64_t cookie, bool send) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+
+        assert_se(sd_bus_message_new_signal(b, &m, "/org/freedesktop/systemd1/unit/foo_2eservice",
+                                            "org.freedesktop.DBus.Properties", "PropertiesChanged") >= 0);
+        assert_se(sd_bus_message_append(m, "sa{sv}as", "org.freedesktop.systemd1.Unit",
+                                        2, "ActiveState", "s", "active", "SubState", "s", "running",
+                                        0) >= 0);
+        if (send)
+                assert_se(sd_bus_send(b, m, NULL) >= 0);
+        else
+                assert_se(sd_bus_message_seal(m, cookie, 0) >= 0);
+}
+
+static void pool_benchmark(void) {
+        _cleanup_close_pair_ int pair[2] = { -1, -1 };
+        unsigned max_messages[] = { 0, BUS_MESSAGE_POOL_MAX };
+        uint64_t cookie = 0;
+        sd_bus *b;
+        size_t i;
+
+        /* Build messages the way PID 1 does for each unit state change, without sending them anywhere,
+         * once with and once without recycling them */
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) >= 0);
+
+        assert_se(sd_bus_new(&b) >= 0);
+        assert_se(sd_bus_set_fd(b, pair[0], pair[0]) >= 0);
+        pair[0] = -1;
+        assert_se(sd_bus_start(b) >= 0);
+
+        printf("POOL\tMSG/S\tALLOC/MSG\tRECYCLED/MSG\tMALLOC/MSG\n");
+
+        for (i = 0; i < ELEMENTSOF(max_messages); i++) {
+                BusMessagePoolStatistics before, after;
+                uint64_t heap_before;
+                unsigned n;
+                usec_t t;
+
+                b->message_pool->max_messages = max_messages[i];
+
+                /* Warm up */
+                emit_properties_changed(b, ++cookie, false);
+                before = b->message_pool->statistics;
+                heap_before = n_heap_allocations;
+
+                t = now(CLOCK_MONOTONIC);
+                for (n = 1;; n++) {
+                        emit_properties_changed(b, ++cookie, false);
+                        if (now(CLOCK_MONOTONIC) >= t + arg_loop_usec)
+                                break;
+                }
+
+                after = b->message_pool->statistics;
+
+                printf("%u\t%u\t%.2f\t\t%.2f\t\t%.2f\n",
+                       max_messages[i],
+                       (unsigned) ((n * USEC_PER_SEC) / arg_loop_usec),
+                       (double) (after.n_messages_allocated - before.n_messages_allocated +
+                                 after.n_buffers_allocated - before.n_buffers_allocated) / n,
+                       (double) (after.n_messages_recycled - before.n_messages_recycled +
+                                 after.n_buffers_recycled - before.n_buffers_recycled) / n,
+                       (double) (n_heap_allocations - heap_before) / n);
+        }
+
+        sd_bus_unref(b);
+}
+
+static void batch_benchmark(void) {
+        _cleanup_close_pair_ int pair[2] = { -1, -1 };
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        bool batch_send[] = { false, true };
+        sd_bus *a, *b;
+        size_t i;
+
+        /* Emit bursts of signals the way PID 1 does when a bunch of jobs finish, from an event loop, and
+         * count the system calls needed on both ends of the connection, once with and once without
+         * batching */
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) >= 0);
+
+        assert_se(sd_bus_new(&a) >= 0);
+        assert_se(sd_bus_set_fd(a, pair[0], pair[0]) >= 0);
+        pair[0] = -1;
+        assert_se(sd_bus_set_server(a, true, SD_ID128_NULL) >= 0);
+        assert_se(sd_bus_start(a) >= 0);
+
+        assert_se(sd_bus_new(&b) >= 0);
+        assert_se(sd_bus_set_fd(b, pair[1], pair[1]) >= 0);
+        pair[1] = -1;
+        assert_se(sd_bus_start(b) >= 0);
+
+        while (sd_bus_is_ready(a) <= 0 || sd_bus_is_ready(b) <= 0) {
+                assert_se(sd_bus_process(a, NULL) >= 0);
+                assert_se(sd_bus_process(b, NULL) >= 0);
+        }
+
+        assert_se(sd_event_default(&e) >= 0);
+        assert_se(sd_bus_attach_event(a, e, SD_EVENT_PRIORITY_NORMAL) >= 0);
+
+        printf("BATCH\tMSG/S\tWRITES/MSG\tREADS/MSG\n");
+
+        for (i = 0; i < ELEMENTSOF(batch_send); i++) {
+                uint64_t n_write_calls, n_read_calls;
+                unsigned n = 0;
+                usec_t t;
+
+                assert_se(sd_bus_set_batch_send(a, batch_send[i]) >= 0);
+
+                n_write_calls = a->n_write_calls;
+                n_read_calls = b->n_read_calls;
+
+                t = now(CLOCK_MONOTONIC);
+                for (;;) {
+                        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+                        unsigned j, received = 0;
+
+                        for (j = 0; j < 32; j++) {
+                                emit_properties_changed(a, 0, true);
+                                n++;
+                        }
+
+                        assert_se(sd_event_run(e, 0) >= 0);
+
+                        while (received < j) {
+                                assert_se(sd_bus_process(b, &m) >= 0);
+                                if (m) {
+                                        received++;
+                                        m = sd_bus_message_unref(m);
+                                }
+                        }
+
+                        if (now(CLOCK_MONOTONIC) >= t + arg_loop_usec)
+                                break;
+                }
+
+                printf("%s\t%u\t%.3f\t\t%.3f\n",
+                       yes_no(batch_send[i]),
+                       (unsigned) ((n * USEC_PER_SEC) / arg_loop_usec),
+                       (double) (a->n_write_calls - n_write_calls) / n,
+                       (double) (b->n_read_calls - n_read_calls) / n);
+        }
+
+        assert_se(sd_bus_detach_event(a) >= 0);
+        sd_bus_unref(a);
+        sd_bus_unref(b);
+}
+
 int main(int argc, char *argv[]) {
         enum {
                 MODE_BISECT,
                 MODE_CHART,
+                MODE_POOL,
+                MODE_BATCH,
         } mode = MODE_BISECT;
         Type type = TYPE_LEGACY;
         int i, pair[2] = { -1, -1 };
@@ -226,6 +401,12 @@ int main(int argc, char *argv[]) {
                 if (streq(argv[i], "chart")) {
                         mode = MODE_CHART;
                         continue;
+                } else if (streq(argv[i], "pool")) {
+                        mode = MODE_POOL;
+                        continue;
+                } else if (streq(argv[i], "batch")) {
+                        mode = MODE_BATCH;
+                        continue;
                 } else if (streq(argv[i], "legacy")) {
                         type = TYPE_LEGACY;
                         continue;
@@ -239,6 +420,16 @@ int main(int argc, char *argv[]) {
 
         assert_se(arg_loop_usec > 0);
 
+        if (mode == MODE_POOL) {
+                pool_benchmark();
+                return 0;
+        }
+
+        if (mode == MODE_BATCH) {
+                batch_benchmark();
+                return 0;
+        }
+
         if (type == TYPE_LEGACY) {
                 const char *e;
 
@@ -301,6 +492,10 @@ int main(int argc, char *argv[]) {
                 case MODE_CHART:
                         client_chart(type, address, server_name, pair[1]);
                         break;
+
+                case MODE_POOL:
+                case MODE_BATCH:
+                        assert_not_reached("Unexpected mode");
                 }
 
                 _exit(EXIT_SUCCESS);
@@ -15,6 +15,7 @@
 
 #include "alloc-util.h"
 #include "bus-dump.h"
+#include "bus-internal.h"
 #include "bus-label.h"
 #include "bus-message.h"
 #include "bus-util.h"
@@ -105,6 +106,59 @@ static void test_bus_label_escape(void) {
         test_bus_label_escape_one(":1", "_3a1");
 }
 
+static void test_bus_message_pool(void) {
+        _cleanup_close_pair_ int pair[2] = { -1, -1 };
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        BusMessagePoolStatistics st;
+        sd_bus_message *old;
+        sd_bus *bus;
+        const char *x;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) >= 0);
+        assert_se(sd_bus_new(&bus) >= 0);
+        assert_se(sd_bus_set_fd(bus, pair[0], pair[0]) >= 0);
+        pair[0] = -1;
+        assert_se(sd_bus_start(bus) >= 0);
+
+        assert_se(sd_bus_message_new_signal(bus, &m, "/foo/bar", "foo.bar", "Waldo") >= 0);
+        assert_se(sd_bus_message_append(m, "sas", "a string", 2, "one", "two") >= 0);
+        assert_se(sd_bus_message_seal(m, 1, 0) >= 0);
+
+        st = bus->message_pool->statistics;
+        assert_se(st.n_messages_allocated == 1);
+        assert_se(st.n_messages_recycled == 0);
+
+        /* The object and its buffers are reused for the next message, which must not see any of the old
+         * contents */
+        old = m;
+        m = sd_bus_message_unref(m);
+        assert_se(bus->message_pool->n_messages == 1);
+
+        assert_se(sd_bus_message_new_method_call(bus, &m, "foo.bar", "/quux", "foo.quux", "Piep") >= 0);
+        assert_se(m == old);
+        assert_se(bus->message_pool->n_messages == 0);
+        assert_se(bus->message_pool->statistics.n_messages_recycled == 1);
+        assert_se(bus->message_pool->statistics.n_buffers_recycled == 1);
+
+        assert_se(sd_bus_message_is_method_call(m, "foo.quux", "Piep") > 0);
+        assert_se(streq(sd_bus_message_get_path(m), "/quux"));
+        assert_se(streq(sd_bus_message_get_destination(m), "foo.bar"));
+        assert_se(streq(sd_bus_message_get_signature(m, true), ""));
+
+        assert_se(sd_bus_message_append(m, "s", "other") >= 0);
+        assert_se(sd_bus_message_seal(m, 2, 0) >= 0);
+        assert_se(bus->message_pool->statistics.n_buffers_recycled == 2);
+        assert_se(streq(sd_bus_message_get_signature(m, true), "s"));
+        assert_se(sd_bus_message_read(m, "s", &x) > 0);
+        assert_se(streq(x, "other"));
+
+        /* The message pins the connection, and the connection the pool, hence dropping the message frees
+         * everything, including the message itself, which goes back into the pool first */
+        sd_bus_unref(bus);
+}
+
 int main(int argc, char *argv[]) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *copy = NULL;
         int r, boolean;
@@ -124,6 +178,8 @@ int main(int argc, char *argv[]) {
 
         test_setup_logging(LOG_INFO);
 
+        test_bus_message_pool();
+
         r = sd_bus_default_user(&bus);
         if (r < 0)
                 r = sd_bus_default_system(&bus);
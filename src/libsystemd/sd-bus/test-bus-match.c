@@ -7,7 +7,10 @@
 #include "log.h"
 #include "macro.h"
 #include "memory-util.h"
+#include "set.h"
+#include "stdio-util.h"
 #include "tests.h"
+#include "time-util.h"
 
 static bool mask[32];
 
@@ -68,6 +71,121 @@ static void test_match_scope(const char *match, enum bus_match_scope scope) {
         bus_match_parse_free(components, n_components);
 }
 
+#define N_BENCHMARK_RULES 10000U
+#define N_BENCHMARK_ITERATIONS 100000U
+
+static int benchmark_filter(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        unsigned *c = userdata;
+
+        (*c)++;
+        return 0;
+}
+
+static void benchmark_run(struct bus_match_node *root, sd_bus_message *m, unsigned n_rules, const char *name, unsigned *count, unsigned expected) {
+        unsigned i;
+        usec_t t;
+
+        *count = 0;
+
+        t = now(CLOCK_MONOTONIC);
+        for (i = 0; i < N_BENCHMARK_ITERATIONS; i++)
+                assert_se(bus_match_run(NULL, root, m) == 0);
+        t = now(CLOCK_MONOTONIC) - t;
+
+        log_info("%u rules, %s: %llu messages/s", n_rules, name,
+                 (unsigned long long) (N_BENCHMARK_ITERATIONS * USEC_PER_SEC / MAX(t, 1U)));
+
+        assert_se(*count == N_BENCHMARK_ITERATIONS * expected);
+}
+
+static void benchmark_rules(sd_bus *bus, unsigned n_rules) {
+        struct bus_match_node root = {
+                .type = BUS_MATCH_ROOT,
+        };
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *owner_changed = NULL, *properties_changed = NULL;
+        _cleanup_free_ sd_bus_slot *slots = NULL;
+        unsigned i, count = 0;
+
+        /* Set up the rules like sd_bus_track does for each tracked peer, and in addition a rule per unit
+         * object like the clients of PID 1 do */
+        assert_se(slots = new0(sd_bus_slot, 2 * n_rules));
+
+        for (i = 0; i < n_rules; i++) {
+                struct bus_match_component *components = NULL;
+                unsigned n_components = 0;
+                char match[256];
+
+                xsprintf(match,
+                         "type='signal',sender='org.freedesktop.DBus',path='/org/freedesktop/DBus',"
+                         "interface='org.freedesktop.DBus',member='NameOwnerChanged',arg0=':1.%u'", i);
+                assert_se(bus_match_parse(match, &components, &n_components) >= 0);
+                slots[i].userdata = &count;
+                slots[i].match_callback.callback = benchmark_filter;
+                assert_se(bus_match_add(&root, components, n_components, &slots[i].match_callback) >= 0);
+                bus_match_parse_free(components, n_components);
+
+                xsprintf(match,
+                         "type='signal',sender='org.freedesktop.systemd1',path='/org/freedesktop/systemd1/unit/u%u',"
+                         "interface='org.freedesktop.DBus.Properties',member='PropertiesChanged'", i);
+                assert_se(bus_match_parse(match, &components, &n_components) >= 0);
+                slots[n_rules + i].userdata = &count;
+                slots[n_rules + i].match_callback.callback = benchmark_filter;
+                assert_se(bus_match_add(&root, components, n_components, &slots[n_rules + i].match_callback) >= 0);
+                bus_match_parse_free(components, n_components);
+        }
+
+        assert_se(sd_bus_message_new_signal(bus, &owner_changed, "/org/freedesktop/DBus", "org.freedesktop.DBus", "NameOwnerChanged") >= 0);
+        assert_se(sd_bus_message_append(owner_changed, "sss", ":1.0", ":1.0", "") >= 0);
+        assert_se(sd_bus_message_seal(owner_changed, 1, 0) >= 0);
+        owner_changed->sender = "org.freedesktop.DBus";
+
+        assert_se(sd_bus_message_new_signal(bus, &properties_changed, "/org/freedesktop/systemd1/unit/foo", "org.freedesktop.DBus.Properties", "PropertiesChanged") >= 0);
+        assert_se(sd_bus_message_append(properties_changed, "sa{sv}as", "org.freedesktop.systemd1.Unit", 0, 0) >= 0);
+        assert_se(sd_bus_message_seal(properties_changed, 2, 0) >= 0);
+        properties_changed->sender = "org.freedesktop.systemd1";
+
+        benchmark_run(&root, owner_changed, 2 * n_rules, "matching NameOwnerChanged", &count, 1);
+        benchmark_run(&root, properties_changed, 2 * n_rules, "unmatched PropertiesChanged", &count, 0);
+
+        for (i = 0; i < 2 * n_rules; i++)
+                assert_se(bus_match_remove(&root, &slots[i].match_callback) > 0);
+
+        assert_se(!root.child);
+        bus_match_free(&root);
+}
+
+static void benchmark_lookup(unsigned n_values) {
+        _cleanup_set_free_free_ Set *s = NULL;
+        unsigned i;
+        usec_t t;
+
+        for (i = 0; i < n_values; i++) {
+                char *p;
+
+                assert_se(asprintf(&p, "/org/freedesktop/systemd1/unit/u%u", i) >= 0);
+                assert_se(set_ensure_consume(&s, &string_hash_ops, p) > 0);
+        }
+
+        t = now(CLOCK_MONOTONIC);
+        for (i = 0; i < N_BENCHMARK_ITERATIONS; i++)
+                assert_se(!set_contains(s, "/org/freedesktop/systemd1/unit/foo"));
+        t = now(CLOCK_MONOTONIC) - t;
+
+        log_info("%u values, unmatched path lookup: %llu lookups/s", n_values,
+                 (unsigned long long) (N_BENCHMARK_ITERATIONS * USEC_PER_SEC / MAX(t, 1U)));
+}
+
+static void test_match_benchmark(sd_bus *bus) {
+        log_info("/* %s */", __func__);
+
+        /* With only the rules that are looked at anyway, dispatching costs what it would with an index that
+         * leads straight to the matching rules, except that such an index still has to look up the value
+         * that tells the many rules apart. Compare that to the cost with many rules. */
+        benchmark_rules(bus, 1);
+        benchmark_rules(bus, N_BENCHMARK_RULES);
+        benchmark_lookup(N_BENCHMARK_RULES);
+}
+
 int main(int argc, char *argv[]) {
         struct bus_match_node root = {
                 .type = BUS_MATCH_ROOT,
@@ -144,5 +262,7 @@ int main(int argc, char *argv[]) {
         test_match_scope("member='gurke',path='/org/freedesktop/DBus/Local'", BUS_MATCH_LOCAL);
         test_match_scope("arg2='piep',sender='org.freedesktop.DBus',member='waldo'", BUS_MATCH_DRIVER);
 
+        test_match_benchmark(bus);
+
         return 0;
 }
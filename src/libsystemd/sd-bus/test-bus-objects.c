@@ -13,6 +13,8 @@
 #include "log.h"
 #include "macro.h"
 #include "strv.h"
+#include "tests.h"
+#include "time-util.h"
 #include "util.h"
 
 struct context {
@@ -21,6 +23,9 @@ struct context {
         char *something;
         char *automatic_string_property;
         uint32_t automatic_integer_property;
+        uint32_t cached_counter;
+        uint32_t n_live_calls;
+        uint32_t n_const_calls;
 };
 
 static int something_handler(sd_bus_message *m, void *userdata, sd_bus_error *error) {
@@ -177,6 +182,48 @@ static int emit_object_removed(sd_bus_message *m, void *userdata, sd_bus_error *
         return 1;
 }
 
+static int live_handler(sd_bus *bus, const char *path, const char *interface, const char *property, sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+        struct context *c = userdata;
+
+        return sd_bus_message_append(reply, "u", ++c->n_live_calls);
+}
+
+static int const_handler(sd_bus *bus, const char *path, const char *interface, const char *property, sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+        struct context *c = userdata;
+
+        return sd_bus_message_append(reply, "u", ++c->n_const_calls);
+}
+
+static int increment_handler(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        struct context *c = userdata;
+
+        c->cached_counter++;
+
+        return sd_bus_reply_method_return(m, NULL);
+}
+
+static int invalidate_handler(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        assert_se(sd_bus_invalidate_properties(sd_bus_message_get_bus(m), m->path, NULL) >= 0);
+
+        return sd_bus_reply_method_return(m, NULL);
+}
+
+static int cache_alias_find(sd_bus *bus, const char *path, const char *interface, void *userdata, void **found, sd_bus_error *error) {
+        /* All paths below /alias lead to the same object */
+        *found = userdata;
+        return 1;
+}
+
+static int bench_strv_get(sd_bus *bus, const char *path, const char *interface, const char *property, sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+        return sd_bus_message_append(reply, "as", 8,
+                                     "basic.target", "sysinit.target", "system.slice", "dbus.socket",
+                                     "network.target", "local-fs.target", "shutdown.target", "-.mount");
+}
+
+static int bench_string_get(sd_bus *bus, const char *path, const char *interface, const char *property, sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+        return sd_bus_message_append(reply, "s", "/usr/lib/systemd/system/foo.service");
+}
+
 static const sd_bus_vtable vtable[] = {
         SD_BUS_VTABLE_START(0),
         SD_BUS_METHOD("AlterSomething", "s", "s", something_handler, 0),
@@ -204,6 +251,41 @@ static const sd_bus_vtable vtable2[] = {
         SD_BUS_VTABLE_END
 };
 
+static const sd_bus_vtable cached_vtable[] = {
+        SD_BUS_VTABLE_START(SD_BUS_VTABLE_PROPERTY_CACHE),
+        SD_BUS_METHOD("Increment", NULL, NULL, increment_handler, 0),
+        SD_BUS_METHOD("Invalidate", NULL, NULL, invalidate_handler, 0),
+        SD_BUS_PROPERTY("Counter", "u", NULL, offsetof(struct context, cached_counter), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("Live", "u", live_handler, 0, 0),
+        SD_BUS_PROPERTY("Constant", "s", NULL, offsetof(struct context, automatic_string_property), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("ConstantCounter", "u", NULL, offsetof(struct context, cached_counter), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("ConstantCalls", "u", const_handler, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_VTABLE_END
+};
+
+/* Roughly shaped like a unit object: mostly constant dependency lists and settings, and some state */
+#define BENCH_PROPERTIES(x)                                                                                     \
+        SD_BUS_PROPERTY("List" #x, "as", bench_strv_get, 0, SD_BUS_VTABLE_PROPERTY_CONST),                     \
+        SD_BUS_PROPERTY("Setting" #x, "s", bench_string_get, 0, SD_BUS_VTABLE_PROPERTY_CONST),                 \
+        SD_BUS_PROPERTY("State" #x, "s", bench_string_get, 0, SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE)
+
+#define BENCH_PROPERTIES8(x)                                                                                    \
+        BENCH_PROPERTIES(x##0), BENCH_PROPERTIES(x##1), BENCH_PROPERTIES(x##2), BENCH_PROPERTIES(x##3),         \
+        BENCH_PROPERTIES(x##4), BENCH_PROPERTIES(x##5), BENCH_PROPERTIES(x##6), BENCH_PROPERTIES(x##7)
+
+#define BENCH_VTABLE(flags)                                                                                     \
+        SD_BUS_VTABLE_START(flags),                                                                             \
+        BENCH_PROPERTIES8(A), BENCH_PROPERTIES8(B), BENCH_PROPERTIES8(C), BENCH_PROPERTIES8(D),                 \
+        SD_BUS_VTABLE_END
+
+static const sd_bus_vtable bench_vtable[] = {
+        BENCH_VTABLE(0)
+};
+
+static const sd_bus_vtable bench_cached_vtable[] = {
+        BENCH_VTABLE(SD_BUS_VTABLE_PROPERTY_CACHE)
+};
+
 static int enumerator_callback(sd_bus *bus, const char *path, void *userdata, char ***nodes, sd_bus_error *error) {
 
         if (object_path_startswith("/value", path))
@@ -241,6 +323,10 @@ static void *server(void *p) {
         assert_se(sd_bus_add_node_enumerator(bus, NULL, "/value/a", enumerator2_callback, NULL) >= 0);
         assert_se(sd_bus_add_object_manager(bus, NULL, "/value") >= 0);
         assert_se(sd_bus_add_object_manager(bus, NULL, "/value/a") >= 0);
+        assert_se(sd_bus_add_object_vtable(bus, NULL, "/cache", "org.freedesktop.systemd.CacheTest", cached_vtable, c) >= 0);
+        assert_se(sd_bus_add_fallback_vtable(bus, NULL, "/alias", "org.freedesktop.systemd.CacheTest", cached_vtable, cache_alias_find, c) >= 0);
+        assert_se(sd_bus_add_object_vtable(bus, NULL, "/bench/uncached", "org.freedesktop.systemd.Bench", bench_vtable, NULL) >= 0);
+        assert_se(sd_bus_add_object_vtable(bus, NULL, "/bench/cached", "org.freedesktop.systemd.Bench", bench_cached_vtable, NULL) >= 0);
 
         assert_se(sd_bus_start(bus) >= 0);
 
@@ -277,6 +363,67 @@ fail:
         return INT_TO_PTR(r);
 }
 
+static void check_cached_properties(sd_bus *bus, const char *path, uint32_t counter, uint32_t constant_counter, uint32_t live, uint32_t constant_calls) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        const char *name, *s;
+        uint32_t u;
+
+        assert_se(sd_bus_call_method(bus, "org.freedesktop.systemd.test", path, "org.freedesktop.DBus.Properties", "GetAll", NULL, &reply, "s", "org.freedesktop.systemd.CacheTest") >= 0);
+
+        /* Cached and uncached properties must be returned in vtable order */
+        assert_se(sd_bus_message_enter_container(reply, 'a', "{sv}") > 0);
+
+        assert_se(sd_bus_message_read(reply, "{sv}", &name, "u", &u) > 0);
+        assert_se(streq(name, "Counter"));
+        assert_se(u == counter);
+
+        assert_se(sd_bus_message_read(reply, "{sv}", &name, "u", &u) > 0);
+        assert_se(streq(name, "Live"));
+        assert_se(u == live);
+
+        assert_se(sd_bus_message_read(reply, "{sv}", &name, "s", &s) > 0);
+        assert_se(streq(name, "Constant"));
+        assert_se(streq(s, "Du Dödel, Du!"));
+
+        assert_se(sd_bus_message_read(reply, "{sv}", &name, "u", &u) > 0);
+        assert_se(streq(name, "ConstantCounter"));
+        assert_se(u == constant_counter);
+
+        assert_se(sd_bus_message_read(reply, "{sv}", &name, "u", &u) > 0);
+        assert_se(streq(name, "ConstantCalls"));
+        assert_se(u == constant_calls);
+
+        assert_se(sd_bus_message_exit_container(reply) > 0);
+        assert_se(sd_bus_message_at_end(reply, true) > 0);
+}
+
+static usec_t bench_get_all(sd_bus *bus, const char *path, unsigned n) {
+        usec_t t;
+        unsigned i;
+
+        t = now(CLOCK_MONOTONIC);
+
+        for (i = 0; i < n; i++)
+                assert_se(sd_bus_call_method(bus, "org.freedesktop.systemd.test", path, "org.freedesktop.DBus.Properties", "GetAll", NULL, NULL, "s", "org.freedesktop.systemd.Bench") >= 0);
+
+        return now(CLOCK_MONOTONIC) - t;
+}
+
+static void test_get_all_performance(sd_bus *bus) {
+        char a[FORMAT_TIMESPAN_MAX], b[FORMAT_TIMESPAN_MAX];
+        unsigned n = slow_tests_enabled() ? 10000 : 1000;
+        usec_t uncached, cached;
+
+        /* Populate the cache first */
+        (void) bench_get_all(bus, "/bench/cached", 1);
+
+        uncached = bench_get_all(bus, "/bench/uncached", n);
+        cached = bench_get_all(bus, "/bench/cached", n);
+
+        log_info("%u GetAll calls with 96 properties: %s uncached, %s cached",
+                 n, format_timespan(a, sizeof(a), uncached, USEC_PER_MSEC), format_timespan(b, sizeof(b), cached, USEC_PER_MSEC));
+}
+
 static int client(struct context *c) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_(sd_bus_unrefp) sd_bus *bus = NULL;
@@ -494,6 +641,27 @@ static int client(struct context *c) {
         sd_bus_message_unref(reply);
         reply = NULL;
 
+        check_cached_properties(bus, "/cache", 0, 0, 1, 1);
+
+        /* Changes of constant properties are not seen until invalidated, other properties are always
+         * current */
+        assert_se(sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/cache", "org.freedesktop.systemd.CacheTest", "Increment", NULL, NULL, NULL) >= 0);
+        check_cached_properties(bus, "/cache", 1, 0, 2, 1);
+
+        assert_se(sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/cache", "org.freedesktop.systemd.CacheTest", "Invalidate", NULL, NULL, NULL) >= 0);
+        check_cached_properties(bus, "/cache", 1, 1, 3, 2);
+
+        /* Paths leading to the same object share the cache */
+        check_cached_properties(bus, "/alias/a", 1, 1, 4, 3);
+        check_cached_properties(bus, "/alias/b", 1, 1, 5, 3);
+
+        assert_se(sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/alias/b", "org.freedesktop.systemd.CacheTest", "Increment", NULL, NULL, NULL) >= 0);
+        assert_se(sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/alias/b", "org.freedesktop.systemd.CacheTest", "Invalidate", NULL, NULL, NULL) >= 0);
+        check_cached_properties(bus, "/alias/a", 2, 2, 6, 4);
+        check_cached_properties(bus, "/cache", 2, 1, 7, 2);
+
+        test_get_all_performance(bus);
+
         r = sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/foo", "org.freedesktop.systemd.test", "Exit", &error, NULL, "");
         assert_se(r >= 0);
 
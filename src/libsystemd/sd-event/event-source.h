@@ -7,10 +7,13 @@
 
 #include "sd-event.h"
 
+#include "event-work.h"
 #include "fs-util.h"
 #include "hashmap.h"
 #include "list.h"
 #include "prioq.h"
+#include "ratelimit.h"
+#include "timer-wheel.h"
 
 typedef enum EventSourceType {
         SOURCE_IO,
@@ -26,6 +29,7 @@ typedef enum EventSourceType {
         SOURCE_EXIT,
         SOURCE_WATCHDOG,
         SOURCE_INOTIFY,
+        SOURCE_WORK,
         _SOURCE_EVENT_SOURCE_TYPE_MAX,
         _SOURCE_EVENT_SOURCE_TYPE_INVALID = -1
 } EventSourceType;
@@ -38,6 +42,7 @@ typedef enum WakeupType {
         WAKEUP_CLOCK_DATA,
         WAKEUP_SIGNAL_DATA,
         WAKEUP_INOTIFY_DATA,
+        WAKEUP_WORK_DATA,
         _WAKEUP_TYPE_MAX,
         _WAKEUP_TYPE_INVALID = -1,
 } WakeupType;
@@ -60,15 +65,29 @@ struct sd_event_source {
         bool pending:1;
         bool dispatching:1;
         bool floating:1;
+        bool ratelimited:1;
+        bool timer_wheel:1; /* timer event source kept in the timer wheel, rather than the prioqs */
 
         int64_t priority;
         unsigned pending_index;
         unsigned prepare_index;
         uint64_t pending_iteration;
         uint64_t prepare_iteration;
+        uint64_t dispatch_iteration;
 
         sd_event_destroy_t destroy_callback;
 
+        /* Accounting of how long the callback takes, and how long the source waits to be dispatched */
+        sd_event_source_statistics statistics;
+        usec_t pending_since;
+
+        /* Sources that are dispatched more often than the rate limit allows are taken offline until the end
+         * of the interval. Meanwhile they are queued in the CLOCK_MONOTONIC prioqs like a timer event source
+         * would be, hence the indexes into the two time prioqs are kept here for all types. */
+        RateLimit rate_limit;
+        unsigned earliest_index;
+        unsigned latest_index;
+
         LIST_FIELDS(sd_event_source, sources);
 
         union {
@@ -83,8 +102,7 @@ struct sd_event_source {
                 struct {
                         sd_event_time_handler_t callback;
                         usec_t next, accuracy;
-                        unsigned earliest_index;
-                        unsigned latest_index;
+                        TimerWheelEntry wheel_entry;
                 } time;
                 struct {
                         sd_event_signal_handler_t callback;
@@ -119,6 +137,11 @@ struct sd_event_source {
                         struct inode_data *inode_data;
                         LIST_FIELDS(sd_event_source, by_inode_data);
                 } inotify;
+                struct {
+                        sd_event_work_done_handler_t callback;
+                        EventWorkItem *item; /* NULL once finished */
+                        int result;
+                } work;
         };
 };
 
@@ -135,6 +158,10 @@ struct clock_data {
 
         Prioq *earliest;
         Prioq *latest;
+
+        /* Timers with a coarse accuracy don't need to be ordered exactly, they are kept in a timer wheel
+         * instead, which is cheaper to maintain for large numbers of timers */
+        TimerWheel *wheel;
         usec_t next;
 
         bool needs_rearm:1;
@@ -210,3 +237,10 @@ struct inotify_data {
          * to make it efficient to figure out what inotify objects to process data on next. */
         LIST_FIELDS(struct inotify_data, buffered);
 };
+
+/* The thread pool work sources are run on, together with its eventfd, which is signalled when work finished */
+struct work_data {
+        WakeupType wakeup;
+
+        EventWorkPool *pool;
+};
@@ -0,0 +1,617 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <endian.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+#include "alloc-util.h"
+#include "event-uring.h"
+#include "fd-util.h"
+#include "list.h"
+#include "log.h"
+#include "memory-util.h"
+#include "missing_syscall.h"
+
+#if HAVE_IO_URING
+
+#include <linux/time_types.h>
+
+#include "missing_io_uring.h"
+
+/* The size of the submission queue, i.e. how many requests we batch before we have to submit them. The
+ * completion queue is twice as large, and the kernel keeps completions that don't fit in there on a backlog,
+ * hence there's no limit on the number of fds we may watch. */
+#define URING_ENTRIES 256U
+
+/* The user_data of requests whose completion we don't care about, i.e. of the removal of poll requests. The
+ * user_data of poll requests is never zero, as their generation counter starts at one. */
+#define URING_USER_DATA_IGNORE UINT64_C(0)
+
+typedef struct UringPoll UringPoll;
+
+struct UringPoll {
+        int fd;
+        uint32_t events;
+        void *data;
+
+        /* Changed whenever the poll request is replaced, so that we recognize completions of the old one */
+        uint32_t generation;
+
+        bool armed:1;
+        bool queued:1;
+        LIST_FIELDS(UringPoll, to_arm);
+};
+
+struct EventUring {
+        int fd;
+
+        void *ring;
+        size_t ring_size;
+        struct io_uring_sqe *sqes;
+        size_t sqes_size;
+
+        unsigned *sq_head, *sq_tail, *sq_array;
+        unsigned sq_mask, sq_entries, sq_tail_local;
+        unsigned n_queued;
+
+        unsigned *cq_head, *cq_tail;
+        unsigned cq_mask;
+        struct io_uring_cqe *cqes;
+
+        UringPoll **polls; /* indexed by fd */
+        size_t n_polls_allocated;
+        uint32_t generation;
+
+        /* Polls that need a (new) poll request, because they were just added, modified, or their previous
+         * request completed. That's what makes them level-triggered: a poll request that is submitted for an
+         * fd that is still ready completes right away. */
+        LIST_HEAD(UringPoll, to_arm);
+};
+
+static uint64_t uring_poll_user_data(const UringPoll *p) {
+        return (uint64_t) p->generation << 32 | (uint32_t) p->fd;
+}
+
+static uint32_t uring_next_generation(EventUring *u) {
+        assert(u);
+
+        if (++u->generation == 0)
+                u->generation++;
+
+        return u->generation;
+}
+
+static uint32_t uring_poll_events(uint32_t events) {
+        /* Only pass the actual event mask, the oneshot and edge-triggered flags are implemented by us. The
+         * kernel expects the two 16bit halves swapped on big endian machines, for compatibility with the
+         * original 16bit field. */
+        events &= ~(EPOLLET|EPOLLONESHOT);
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+        return events << 16 | events >> 16;
+#else
+        return events;
+#endif
+}
+
+static int uring_enter(EventUring *u, unsigned min_complete, unsigned flags, const struct io_uring_getevents_arg *arg) {
+        int r;
+
+        assert(u);
+
+        /* Pairs with the kernel's acquire of the tail, so that the entries are visible before the tail is */
+        __atomic_store_n(u->sq_tail, u->sq_tail_local, __ATOMIC_RELEASE);
+
+        r = io_uring_enter(u->fd, u->n_queued, min_complete,
+                           flags | (arg ? IORING_ENTER_EXT_ARG : 0),
+                           arg, arg ? sizeof(*arg) : 0);
+        if (r < 0)
+                return -errno;
+
+        /* Requests that failed are consumed too, they complete with an error */
+        u->n_queued -= MIN((unsigned) r, u->n_queued);
+        return r;
+}
+
+static void uring_drop_completions(EventUring *u);
+
+static int uring_submit(EventUring *u) {
+        unsigned n;
+        int r;
+
+        assert(u);
+
+        for (n = 0; u->n_queued > 0; n++) {
+                r = uring_enter(u, 0, 0, NULL);
+                if (r == -EBUSY && n == 0) {
+                        /* Older kernels refuse to take new requests while completions are backlogged, make
+                         * room. */
+                        uring_drop_completions(u);
+                        continue;
+                }
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        return -EAGAIN;
+        }
+
+        return 0;
+}
+
+static int uring_get_sqe(EventUring *u, struct io_uring_sqe **ret) {
+        struct io_uring_sqe *sqe;
+        int r;
+
+        assert(u);
+        assert(ret);
+
+        if (u->n_queued >= u->sq_entries) {
+                r = uring_submit(u);
+                if (r < 0)
+                        return r;
+        }
+
+        sqe = &u->sqes[u->sq_tail_local & u->sq_mask];
+        zero(*sqe);
+
+        u->sq_tail_local++;
+        u->n_queued++;
+
+        *ret = sqe;
+        return 0;
+}
+
+static int uring_queue_poll_remove(EventUring *u, UringPoll *p) {
+        struct io_uring_sqe *sqe;
+        int r;
+
+        assert(u);
+        assert(p);
+        assert(p->armed);
+
+        r = uring_get_sqe(u, &sqe);
+        if (r < 0)
+                return r;
+
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = uring_poll_user_data(p);
+        sqe->user_data = URING_USER_DATA_IGNORE;
+
+        p->armed = false;
+        return 0;
+}
+
+static void uring_queue_arm(EventUring *u, UringPoll *p) {
+        assert(u);
+        assert(p);
+
+        if (p->queued)
+                return;
+
+        LIST_PREPEND(to_arm, u->to_arm, p);
+        p->queued = true;
+}
+
+static int uring_arm(EventUring *u) {
+        UringPoll *p;
+        int r;
+
+        assert(u);
+
+        while ((p = u->to_arm)) {
+                struct io_uring_sqe *sqe;
+
+                r = uring_get_sqe(u, &sqe);
+                if (r < 0)
+                        return r;
+
+                sqe->opcode = IORING_OP_POLL_ADD;
+                sqe->fd = p->fd;
+                sqe->poll32_events = uring_poll_events(p->events);
+                sqe->user_data = uring_poll_user_data(p);
+
+                /* Edge-triggered polls stay armed and complete once for each wake-up, like epoll would
+                 * report them. Everything else gets a fresh one-shot request each time. */
+                if ((p->events & (EPOLLET|EPOLLONESHOT)) == EPOLLET)
+                        sqe->len = IORING_POLL_ADD_MULTI;
+
+                LIST_REMOVE(to_arm, u->to_arm, p);
+                p->queued = false;
+                p->armed = true;
+        }
+
+        return 0;
+}
+
+static UringPoll *uring_find_poll(EventUring *u, uint64_t user_data) {
+        UringPoll *p;
+        int fd;
+
+        assert(u);
+
+        fd = (int) (uint32_t) user_data;
+        if (fd < 0 || (size_t) fd >= u->n_polls_allocated)
+                return NULL;
+
+        p = u->polls[fd];
+        if (!p || uring_poll_user_data(p) != user_data)
+                return NULL;
+
+        return p;
+}
+
+static bool uring_complete(EventUring *u, const struct io_uring_cqe *cqe, struct epoll_event *ret) {
+        UringPoll *p;
+
+        assert(u);
+        assert(cqe);
+
+        if (cqe->user_data == URING_USER_DATA_IGNORE)
+                return false;
+
+        /* A stale completion of a poll request that was removed or replaced in the meantime */
+        p = uring_find_poll(u, cqe->user_data);
+        if (!p)
+                return false;
+
+        if (!FLAGS_SET(cqe->flags, IORING_CQE_F_MORE)) {
+                p->armed = false;
+
+                /* Like EPOLLONESHOT: disabled until the next event_uring_mod() */
+                if (!FLAGS_SET(p->events, EPOLLONESHOT))
+                        uring_queue_arm(u, p);
+        }
+
+        if (cqe->res == -ECANCELED || cqe->res == 0)
+                return false;
+
+        if (ret)
+                *ret = (struct epoll_event) {
+                        .events = cqe->res < 0 ? EPOLLERR : (uint32_t) cqe->res,
+                        .data.ptr = p->data,
+                };
+
+        return true;
+}
+
+static void uring_drop_completions(EventUring *u) {
+        unsigned head, tail;
+
+        assert(u);
+
+        /* Throw away all completions we have right now. The fds are polled again, and are reported on the
+         * next wait if they are still ready. Only an edge-triggered fd may miss a wake-up this way, but we
+         * only get here on old kernels, if we fell behind by more than the backlog. */
+
+        head = *u->cq_head;
+        tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; head++)
+                (void) uring_complete(u, &u->cqes[head & u->cq_mask], NULL);
+
+        __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static int uring_probe_multishot(EventUring *u) {
+        _cleanup_close_ int fd = -1;
+        struct io_uring_sqe *sqe;
+        unsigned head, tail;
+        int r, res = 0;
+
+        assert(u);
+
+        /* Multishot poll requests were added later than everything else we need. Since there's no feature
+         * flag for them, try one: arm it on an eventfd that never gets ready and remove it again right away. If
+         * they're supported, the request completes with ECANCELED, otherwise with EINVAL. */
+
+        fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+        if (fd < 0)
+                return -errno;
+
+        r = uring_get_sqe(u, &sqe);
+        if (r < 0)
+                return r;
+
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = uring_poll_events(EPOLLIN);
+        sqe->len = IORING_POLL_ADD_MULTI;
+        sqe->user_data = UINT64_C(1);
+
+        r = uring_get_sqe(u, &sqe);
+        if (r < 0)
+                return r;
+
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = UINT64_C(1);
+        sqe->user_data = URING_USER_DATA_IGNORE;
+
+        r = uring_enter(u, 2, IORING_ENTER_GETEVENTS, NULL);
+        if (r < 0)
+                return r;
+
+        head = *u->cq_head;
+        tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+                if (u->cqes[head & u->cq_mask].user_data == UINT64_C(1))
+                        res = u->cqes[head & u->cq_mask].res;
+        __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+
+        return res == -ECANCELED ? 0 : -EOPNOTSUPP;
+}
+
+int event_uring_new(EventUring **ret) {
+        _cleanup_(event_uring_freep) EventUring *u = NULL;
+        struct io_uring_params params = {};
+        unsigned i;
+        int r;
+
+        assert(ret);
+
+        u = new(EventUring, 1);
+        if (!u)
+                return -ENOMEM;
+
+        *u = (EventUring) {
+                .fd = -1,
+                .ring = MAP_FAILED,
+                .sqes = MAP_FAILED,
+        };
+
+        u->fd = io_uring_setup(URING_ENTRIES, &params);
+        if (u->fd < 0)
+                return -errno;
+
+        u->fd = fd_move_above_stdio(u->fd);
+
+        /* We want to map both rings at once, have completions queued up instead of dropped if they're too
+         * many, and pass the timeout directly when waiting. The latter is the youngest of these, from 5.11. */
+        if (!FLAGS_SET(params.features, IORING_FEAT_SINGLE_MMAP|IORING_FEAT_NODROP|IORING_FEAT_EXT_ARG))
+                return log_debug_errno(SYNTHETIC_ERRNO(EOPNOTSUPP),
+                                       "Kernel's io_uring lacks features we need.");
+
+        u->ring_size = MAX(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                           params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+        u->ring = mmap(NULL, u->ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+        if (u->ring == MAP_FAILED)
+                return -errno;
+
+        u->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        u->sqes = mmap(NULL, u->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQES);
+        if (u->sqes == MAP_FAILED)
+                return -errno;
+
+        u->sq_head = (unsigned*) ((uint8_t*) u->ring + params.sq_off.head);
+        u->sq_tail = (unsigned*) ((uint8_t*) u->ring + params.sq_off.tail);
+        u->sq_array = (unsigned*) ((uint8_t*) u->ring + params.sq_off.array);
+        u->sq_mask = *(unsigned*) ((uint8_t*) u->ring + params.sq_off.ring_mask);
+        u->sq_entries = params.sq_entries;
+        u->sq_tail_local = *u->sq_tail;
+
+        u->cq_head = (unsigned*) ((uint8_t*) u->ring + params.cq_off.head);
+        u->cq_tail = (unsigned*) ((uint8_t*) u->ring + params.cq_off.tail);
+        u->cq_mask = *(unsigned*) ((uint8_t*) u->ring + params.cq_off.ring_mask);
+        u->cqes = (struct io_uring_cqe*) ((uint8_t*) u->ring + params.cq_off.cqes);
+
+        /* We always fill the submission queue in order, hence its index array never changes */
+        for (i = 0; i < u->sq_entries; i++)
+                u->sq_array[i] = i;
+
+        r = uring_probe_multishot(u);
+        if (r < 0)
+                return log_debug_errno(r, "Kernel's io_uring does not support multishot poll requests: %m");
+
+        *ret = TAKE_PTR(u);
+        return 0;
+}
+
+EventUring *event_uring_free(EventUring *u) {
+        size_t i;
+
+        if (!u)
+                return NULL;
+
+        /* Closing the ring cancels all requests still in flight */
+        safe_close(u->fd);
+
+        if (u->ring != MAP_FAILED)
+                (void) munmap(u->ring, u->ring_size);
+        if (u->sqes != MAP_FAILED)
+                (void) munmap(u->sqes, u->sqes_size);
+
+        for (i = 0; i < u->n_polls_allocated; i++)
+                free(u->polls[i]);
+        free(u->polls);
+
+        return mfree(u);
+}
+
+int event_uring_get_fd(EventUring *u) {
+        assert(u);
+
+        return u->fd;
+}
+
+int event_uring_add(EventUring *u, int fd, uint32_t events, void *data) {
+        UringPoll *p;
+
+        assert(u);
+        assert(fd >= 0);
+
+        if ((size_t) fd < u->n_polls_allocated && u->polls[fd])
+                return -EEXIST;
+
+        if (!GREEDY_REALLOC0(u->polls, u->n_polls_allocated, fd + 1))
+                return -ENOMEM;
+
+        p = new(UringPoll, 1);
+        if (!p)
+                return -ENOMEM;
+
+        *p = (UringPoll) {
+                .fd = fd,
+                .events = events,
+                .data = data,
+                .generation = uring_next_generation(u),
+        };
+
+        u->polls[fd] = p;
+        uring_queue_arm(u, p);
+
+        return 0;
+}
+
+int event_uring_mod(EventUring *u, int fd, uint32_t events, void *data) {
+        UringPoll *p;
+        int r;
+
+        assert(u);
+        assert(fd >= 0);
+
+        if ((size_t) fd >= u->n_polls_allocated || !u->polls[fd])
+                return -ENOENT;
+
+        p = u->polls[fd];
+
+        /* Replace the request that's in flight. Until the removal is submitted, it might still complete,
+         * that's recognized by the old generation and ignored. */
+        if (p->armed) {
+                r = uring_queue_poll_remove(u, p);
+                if (r < 0)
+                        return r;
+        }
+
+        p->events = events;
+        p->data = data;
+        p->generation = uring_next_generation(u);
+        uring_queue_arm(u, p);
+
+        return 0;
+}
+
+int event_uring_del(EventUring *u, int fd) {
+        UringPoll *p;
+        int r = 0;
+
+        assert(u);
+        assert(fd >= 0);
+
+        if ((size_t) fd >= u->n_polls_allocated || !u->polls[fd])
+                return -ENOENT;
+
+        p = u->polls[fd];
+
+        /* A poll request pins the file it polls. Submit the removal right away, so that the file is released
+         * when the caller closes the fd, exactly like with epoll. */
+        if (p->armed) {
+                r = uring_queue_poll_remove(u, p);
+                if (r >= 0)
+                        r = uring_submit(u);
+        }
+
+        if (p->queued)
+                LIST_REMOVE(to_arm, u->to_arm, p);
+
+        u->polls[fd] = mfree(p);
+        return r;
+}
+
+int event_uring_submit(EventUring *u) {
+        int r;
+
+        assert(u);
+
+        r = uring_arm(u);
+        if (r < 0)
+                return r;
+
+        return uring_submit(u);
+}
+
+int event_uring_wait(EventUring *u, struct epoll_event *events, size_t n_events, usec_t timeout) {
+        unsigned head, tail;
+        size_t m = 0;
+        int r;
+
+        assert(u);
+        assert(events);
+        assert(n_events > 0);
+
+        r = uring_arm(u);
+        if (r < 0)
+                return r;
+
+        /* Submit everything we queued up, and wait for completions with the same call, unless there are
+         * some already */
+        if (*u->cq_head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+                struct __kernel_timespec ts;
+                struct io_uring_getevents_arg arg = {};
+
+                if (timeout != USEC_INFINITY) {
+                        ts = (struct __kernel_timespec) {
+                                .tv_sec = timeout / USEC_PER_SEC,
+                                .tv_nsec = (timeout % USEC_PER_SEC) * NSEC_PER_USEC,
+                        };
+                        arg.ts = (uint64_t) (uintptr_t) &ts;
+                }
+
+                r = uring_enter(u, timeout == 0 ? 0 : 1, IORING_ENTER_GETEVENTS, &arg);
+                if (r < 0 && !IN_SET(r, -ETIME, -EBUSY))
+                        return r;
+        } else if (u->n_queued > 0) {
+                r = uring_enter(u, 0, 0, NULL);
+                if (r < 0 && r != -EBUSY)
+                        return r;
+        }
+
+        head = *u->cq_head;
+        tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail && m < n_events; head++)
+                if (uring_complete(u, &u->cqes[head & u->cq_mask], events + m))
+                        m++;
+
+        __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+
+        return (int) m;
+}
+
+#else
+
+int event_uring_new(EventUring **ret) {
+        return -EOPNOTSUPP;
+}
+
+EventUring *event_uring_free(EventUring *u) {
+        assert(!u);
+        return NULL;
+}
+
+int event_uring_get_fd(EventUring *u) {
+        assert_not_reached("io_uring support not compiled in");
+}
+
+int event_uring_add(EventUring *u, int fd, uint32_t events, void *data) {
+        assert_not_reached("io_uring support not compiled in");
+}
+
+int event_uring_mod(EventUring *u, int fd, uint32_t events, void *data) {
+        assert_not_reached("io_uring support not compiled in");
+}
+
+int event_uring_del(EventUring *u, int fd) {
+        assert_not_reached("io_uring support not compiled in");
+}
+
+int event_uring_submit(EventUring *u) {
+        assert_not_reached("io_uring support not compiled in");
+}
+
+int event_uring_wait(EventUring *u, struct epoll_event *events, size_t n_events, usec_t timeout) {
+        assert_not_reached("io_uring support not compiled in");
+}
+
+#endif
@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <inttypes.h>
+#include <sys/epoll.h>
+
+#include "macro.h"
+#include "time-util.h"
+
+/* An io_uring based replacement for the epoll instance of an event loop. Each registered fd is watched with a
+ * poll request, these are submitted in batches, together with waiting for completions. The calls mirror
+ * epoll_ctl() and epoll_wait(), and report readiness the same way, including level-triggered semantics. */
+
+typedef struct EventUring EventUring;
+
+int event_uring_new(EventUring **ret);
+EventUring *event_uring_free(EventUring *u);
+DEFINE_TRIVIAL_CLEANUP_FUNC(EventUring*, event_uring_free);
+
+int event_uring_get_fd(EventUring *u);
+
+int event_uring_add(EventUring *u, int fd, uint32_t events, void *data);
+int event_uring_mod(EventUring *u, int fd, uint32_t events, void *data);
+int event_uring_del(EventUring *u, int fd);
+
+int event_uring_submit(EventUring *u);
+int event_uring_wait(EventUring *u, struct epoll_event *events, size_t n_events, usec_t timeout);
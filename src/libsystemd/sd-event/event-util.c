@@ -2,10 +2,13 @@
 
 #include <errno.h>
 
+#include "alloc-util.h"
 #include "event-source.h"
 #include "event-util.h"
 #include "log.h"
+#include "sort-util.h"
 #include "string-util.h"
+#include "time-util.h"
 
 int event_reset_time(
                 sd_event *e,
@@ -97,3 +100,54 @@ int event_source_is_enabled(sd_event_source *s) {
 
         return sd_event_source_get_enabled(s, NULL);
 }
+
+static int event_source_dispatch_compare(sd_event_source * const *a, sd_event_source * const *b) {
+        /* The ones that took the most time first */
+        return CMP((*b)->statistics.dispatch_usec, (*a)->statistics.dispatch_usec);
+}
+
+int event_dump_sources(sd_event *e, FILE *f, const char *prefix) {
+        _cleanup_free_ sd_event_source **sources = NULL;
+        size_t n = 0, allocated = 0, i;
+        sd_event_source *s;
+
+        assert(e);
+        assert(f);
+
+        EVENT_FOREACH_SOURCE(s, e) {
+                if (!GREEDY_REALLOC(sources, allocated, n + 1))
+                        return -ENOMEM;
+
+                sources[n++] = s;
+        }
+
+        typesafe_qsort(sources, n, event_source_dispatch_compare);
+
+        prefix = strempty(prefix);
+
+        for (i = 0; i < n; i++) {
+                char a[FORMAT_TIMESPAN_MAX], b[FORMAT_TIMESPAN_MAX], c[FORMAT_TIMESPAN_MAX], d[FORMAT_TIMESPAN_MAX];
+                const sd_event_source_statistics *st = &sources[i]->statistics;
+
+                s = sources[i];
+
+                fprintf(f,
+                        "%s-> Event Source %s:\n"
+                        "%s\tType: %s\n"
+                        "%s\tPriority: %" PRIi64 "\n"
+                        "%s\tEnabled: %s%s\n"
+                        "%s\tDispatched: %" PRIu64 "\n"
+                        "%s\tDispatch Time: %s (max %s)\n"
+                        "%s\tPending Time: %s (max %s)\n",
+                        prefix, strna(s->description),
+                        prefix, strna(event_source_type_name(s)),
+                        prefix, s->priority,
+                        prefix, s->enabled == SD_EVENT_OFF ? "off" : s->enabled == SD_EVENT_ONESHOT ? "oneshot" : "on",
+                        s->ratelimited ? " (rate limited)" : "",
+                        prefix, st->n_dispatched,
+                        prefix, format_timespan(a, sizeof a, st->dispatch_usec, 1), format_timespan(b, sizeof b, st->dispatch_max_usec, 1),
+                        prefix, format_timespan(c, sizeof c, st->pending_usec, 1), format_timespan(d, sizeof d, st->pending_max_usec, 1));
+        }
+
+        return 0;
+}
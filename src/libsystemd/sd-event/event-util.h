@@ -2,6 +2,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdio.h>
 
 #include "sd-event.h"
 
@@ -11,3 +12,12 @@ int event_reset_time(sd_event *e, sd_event_source **s,
                      int64_t priority, const char *description, bool force_reset);
 int event_source_disable(sd_event_source *s);
 int event_source_is_enabled(sd_event_source *s);
+
+/* Introspection of all event sources of an event loop, implemented in sd-event.c */
+sd_event_source *event_source_next(sd_event *e, sd_event_source *s);
+const char *event_source_type_name(sd_event_source *s);
+
+#define EVENT_FOREACH_SOURCE(s, e) \
+        for ((s) = event_source_next((e), NULL); (s); (s) = event_source_next((e), (s)))
+
+int event_dump_sources(sd_event *e, FILE *f, const char *prefix);
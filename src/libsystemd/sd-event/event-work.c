@@ -0,0 +1,289 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+
+#include "alloc-util.h"
+#include "event-work.h"
+#include "fd-util.h"
+#include "process-util.h"
+
+#define WORKERS_MAX 8U
+
+struct EventWorkPool {
+        int fd;
+        pid_t original_pid;
+
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+
+        /* New items are prepended, workers take them from the tail */
+        LIST_HEAD(EventWorkItem, queue);
+        EventWorkItem *queue_tail;
+        unsigned n_queued;
+        LIST_HEAD(EventWorkItem, done);
+
+        pthread_t workers[WORKERS_MAX];
+        unsigned n_workers;
+        unsigned n_idle;
+        bool dead;
+};
+
+int event_work_pool_new(EventWorkPool **ret) {
+        _cleanup_free_ EventWorkPool *p = NULL;
+        int r;
+
+        assert(ret);
+
+        p = new(EventWorkPool, 1);
+        if (!p)
+                return -ENOMEM;
+
+        *p = (EventWorkPool) {
+                .fd = -1,
+                .original_pid = getpid_cached(),
+        };
+
+        r = pthread_mutex_init(&p->mutex, NULL);
+        if (r > 0)
+                return -r;
+
+        r = pthread_cond_init(&p->cond, NULL);
+        if (r > 0) {
+                assert_se(pthread_mutex_destroy(&p->mutex) == 0);
+                return -r;
+        }
+
+        p->fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+        if (p->fd < 0) {
+                r = -errno;
+                assert_se(pthread_cond_destroy(&p->cond) == 0);
+                assert_se(pthread_mutex_destroy(&p->mutex) == 0);
+                return r;
+        }
+
+        p->fd = fd_move_above_stdio(p->fd);
+
+        *ret = TAKE_PTR(p);
+        return 0;
+}
+
+static bool pool_pid_changed(EventWorkPool *p) {
+        assert(p);
+
+        /* The worker threads don't survive fork(), and the mutex might have been held by one of them */
+        return p->original_pid != getpid_cached();
+}
+
+EventWorkPool *event_work_pool_free(EventWorkPool *p) {
+        EventWorkItem *i;
+        unsigned k;
+
+        if (!p)
+                return NULL;
+
+        /* In a forked off child there's nobody to join, and the lists might be in the middle of being
+         * changed. Just close our copy of the fd, and leave the rest to the parent. */
+        if (pool_pid_changed(p)) {
+                safe_close(p->fd);
+                return mfree(p);
+        }
+
+        /* Work that is running already can't be interrupted, wait for it */
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+        p->dead = true;
+        assert_se(pthread_cond_broadcast(&p->cond) == 0);
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        for (k = 0; k < p->n_workers; k++)
+                (void) pthread_join(p->workers[k], NULL);
+
+        /* Whatever is left has been abandoned by its owner */
+        while ((i = p->queue)) {
+                LIST_REMOVE(items, p->queue, i);
+                free(i);
+        }
+
+        while ((i = p->done)) {
+                LIST_REMOVE(items, p->done, i);
+                free(i);
+        }
+
+        safe_close(p->fd);
+        assert_se(pthread_cond_destroy(&p->cond) == 0);
+        assert_se(pthread_mutex_destroy(&p->mutex) == 0);
+
+        return mfree(p);
+}
+
+int event_work_pool_get_fd(EventWorkPool *p) {
+        assert(p);
+
+        return p->fd;
+}
+
+int event_work_pool_flush(EventWorkPool *p) {
+        eventfd_t x;
+
+        assert(p);
+
+        if (eventfd_read(p->fd, &x) < 0 && errno != EAGAIN)
+                return -errno;
+
+        return 0;
+}
+
+static void* work_thread(void *userdata) {
+        EventWorkPool *p = userdata;
+
+        (void) pthread_setname_np(pthread_self(), "sd-event-work");
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        for (;;) {
+                EventWorkItem *i;
+                int r;
+
+                if (p->dead)
+                        break;
+
+                i = p->queue_tail;
+                if (!i) {
+                        p->n_idle++;
+                        assert_se(pthread_cond_wait(&p->cond, &p->mutex) == 0);
+                        p->n_idle--;
+                        continue;
+                }
+
+                p->queue_tail = i->items_prev;
+                LIST_REMOVE(items, p->queue, i);
+                p->n_queued--;
+                i->state = EVENT_WORK_RUNNING;
+
+                assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+                r = i->work(i->userdata);
+                assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+                i->result = r;
+                i->state = EVENT_WORK_DONE;
+                LIST_PREPEND(items, p->done, i);
+
+                (void) eventfd_write(p->fd, 1);
+        }
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+        return NULL;
+}
+
+static int start_worker(EventWorkPool *p) {
+        sigset_t ss, saved_ss;
+        int r, k;
+
+        assert(p);
+
+        if (p->n_workers >= WORKERS_MAX)
+                return 0;
+
+        assert_se(sigfillset(&ss) >= 0);
+
+        /* No signals in the worker threads please, they are all handled by the event loop */
+        r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+        if (r > 0)
+                return -r;
+
+        r = pthread_create(&p->workers[p->n_workers], NULL, work_thread, p);
+        if (r > 0)
+                r = -r;
+        else
+                p->n_workers++;
+
+        k = pthread_sigmask(SIG_SETMASK, &saved_ss, NULL);
+        if (k > 0 && r >= 0)
+                r = -k;
+
+        return r;
+}
+
+int event_work_pool_submit(EventWorkPool *p, EventWorkItem *i) {
+        int r = 0;
+
+        assert(p);
+        assert(i);
+        assert(i->work);
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        /* Start another worker if the idle ones all have something to do already. If that fails, queue the
+         * item anyway, unless there's nobody to run it. */
+        if (p->n_queued >= p->n_idle) {
+                r = start_worker(p);
+                if (r < 0 && p->n_workers > 0)
+                        r = 0;
+        }
+
+        if (r >= 0) {
+                i->state = EVENT_WORK_QUEUED;
+                LIST_PREPEND(items, p->queue, i);
+                if (!p->queue_tail)
+                        p->queue_tail = i;
+                p->n_queued++;
+
+                assert_se(pthread_cond_signal(&p->cond) == 0);
+        }
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+        return r;
+}
+
+bool event_work_pool_cancel(EventWorkPool *p, EventWorkItem *i) {
+        bool cancelled = true;
+
+        assert(p);
+        assert(i);
+
+        /* Returns true if the item has been taken out of the pool, and false if it's running right now, in
+         * which case it will show up on the list of finished items later. In a forked off child, nothing
+         * will, but the item can't be taken out safely either, hence leave it be. */
+
+        if (pool_pid_changed(p))
+                return false;
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        switch (i->state) {
+
+        case EVENT_WORK_QUEUED:
+                if (p->queue_tail == i)
+                        p->queue_tail = i->items_prev;
+                LIST_REMOVE(items, p->queue, i);
+                p->n_queued--;
+                break;
+
+        case EVENT_WORK_DONE:
+                LIST_REMOVE(items, p->done, i);
+                break;
+
+        default:
+                cancelled = false;
+        }
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+        return cancelled;
+}
+
+EventWorkItem *event_work_pool_pop_done(EventWorkPool *p) {
+        EventWorkItem *i;
+
+        assert(p);
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        i = p->done;
+        if (i)
+                LIST_REMOVE(items, p->done, i);
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+        return i;
+}
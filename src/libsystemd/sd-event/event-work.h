@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stdbool.h>
+
+#include "list.h"
+#include "macro.h"
+
+/* A pool of threads running blocking function calls on behalf of an event loop. Work items are queued by the
+ * event loop thread, and once run, collected on a list of finished items, and an eventfd is signalled, which
+ * the event loop watches. Threads are started on demand, up to a fixed maximum. */
+
+typedef struct EventWorkPool EventWorkPool;
+typedef struct EventWorkItem EventWorkItem;
+
+typedef enum EventWorkState {
+        EVENT_WORK_QUEUED,
+        EVENT_WORK_RUNNING,
+        EVENT_WORK_DONE,
+        _EVENT_WORK_STATE_MAX,
+        _EVENT_WORK_STATE_INVALID = -1,
+} EventWorkState;
+
+struct EventWorkItem {
+        int (*work)(void *userdata);
+        void *userdata;
+        int result;
+
+        /* Protected by the pool's mutex */
+        EventWorkState state;
+        LIST_FIELDS(EventWorkItem, items);
+
+        /* Only ever accessed from the event loop thread */
+        void *owner;
+};
+
+int event_work_pool_new(EventWorkPool **ret);
+EventWorkPool *event_work_pool_free(EventWorkPool *p);
+DEFINE_TRIVIAL_CLEANUP_FUNC(EventWorkPool*, event_work_pool_free);
+
+int event_work_pool_get_fd(EventWorkPool *p);
+int event_work_pool_flush(EventWorkPool *p);
+
+int event_work_pool_submit(EventWorkPool *p, EventWorkItem *i);
+bool event_work_pool_cancel(EventWorkPool *p, EventWorkItem *i);
+EventWorkItem *event_work_pool_pop_done(EventWorkPool *p);
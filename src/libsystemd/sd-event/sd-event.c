@@ -11,6 +11,7 @@
 #include "alloc-util.h"
 #include "env-util.h"
 #include "event-source.h"
+#include "event-uring.h"
 #include "fd-util.h"
 #include "fs-util.h"
 #include "hashmap.h"
@@ -51,18 +52,24 @@ static const char* const event_source_type_table[_SOURCE_EVENT_SOURCE_TYPE_MAX]
         [SOURCE_EXIT] = "exit",
         [SOURCE_WATCHDOG] = "watchdog",
         [SOURCE_INOTIFY] = "inotify",
+        [SOURCE_WORK] = "work",
 };
 
 DEFINE_PRIVATE_STRING_TABLE_LOOKUP_TO_STRING(event_source_type, int);
 
 #define EVENT_SOURCE_IS_TIME(t) IN_SET((t), SOURCE_TIME_REALTIME, SOURCE_TIME_BOOTTIME, SOURCE_TIME_MONOTONIC, SOURCE_TIME_REALTIME_ALARM, SOURCE_TIME_BOOTTIME_ALARM)
 
+#define EVENT_SOURCE_CAN_RATE_LIMIT(t) IN_SET((t), SOURCE_IO, SOURCE_TIME_REALTIME, SOURCE_TIME_BOOTTIME, SOURCE_TIME_MONOTONIC, SOURCE_TIME_REALTIME_ALARM, SOURCE_TIME_BOOTTIME_ALARM, SOURCE_SIGNAL, SOURCE_DEFER, SOURCE_INOTIFY)
+
 struct sd_event {
         unsigned n_ref;
 
         int epoll_fd;
         int watchdog_fd;
 
+        /* If set, fds are watched with this io_uring instead of epoll_fd */
+        EventUring *uring;
+
         Prioq *pending;
         Prioq *prepare;
 
@@ -95,6 +102,9 @@ struct sd_event {
         /* A list of inotify objects that already have events buffered which aren't processed yet */
         LIST_HEAD(struct inotify_data, inotify_data_buffered);
 
+        /* Allocated on first use by sd_event_add_work() */
+        struct work_data work;
+
         pid_t original_pid;
 
         uint64_t iteration;
@@ -105,6 +115,7 @@ struct sd_event {
         bool need_process_child:1;
         bool watchdog:1;
         bool profile_delays:1;
+        bool fd_exported:1;
 
         int exit_code;
 
@@ -117,6 +128,11 @@ struct sd_event {
 
         struct epoll_event *event_queue;
         size_t event_queue_allocated;
+        size_t event_queue_max; /* 0 for sizing it after the number of sources */
+
+        /* The number of pending sources sd_event_dispatch() may dispatch before the loop is prepared and
+         * polled again */
+        unsigned dispatch_budget;
 
         LIST_HEAD(sd_event_source, sources);
 
@@ -133,6 +149,42 @@ static sd_event *event_resolve(sd_event *e) {
         return e == SD_EVENT_DEFAULT ? default_event : e;
 }
 
+static bool event_source_is_online(const sd_event_source *s) {
+        assert(s);
+        return s->enabled != SD_EVENT_OFF && !s->ratelimited;
+}
+
+static bool event_source_is_offline(const sd_event_source *s) {
+        assert(s);
+        return s->enabled == SD_EVENT_OFF || s->ratelimited;
+}
+
+static int event_poll_ctl(sd_event *e, int op, int fd, struct epoll_event *ev) {
+        assert(e);
+        assert(fd >= 0);
+
+        if (e->uring)
+                switch (op) {
+
+                case EPOLL_CTL_ADD:
+                        return event_uring_add(e->uring, fd, ev->events, ev->data.ptr);
+
+                case EPOLL_CTL_MOD:
+                        return event_uring_mod(e->uring, fd, ev->events, ev->data.ptr);
+
+                case EPOLL_CTL_DEL:
+                        return event_uring_del(e->uring, fd);
+
+                default:
+                        assert_not_reached("Unknown poll operation");
+                }
+
+        if (epoll_ctl(e->epoll_fd, op, fd, ev) < 0)
+                return -errno;
+
+        return 0;
+}
+
 static int pending_prioq_compare(const void *a, const void *b) {
         const sd_event_source *x = a, *y = b;
         int r;
@@ -140,11 +192,10 @@ static int pending_prioq_compare(const void *a, const void *b) {
         assert(x->pending);
         assert(y->pending);
 
-        /* Enabled ones first */
-        if (x->enabled != SD_EVENT_OFF && y->enabled == SD_EVENT_OFF)
-                return -1;
-        if (x->enabled == SD_EVENT_OFF && y->enabled != SD_EVENT_OFF)
-                return 1;
+        /* Enabled ones first, sources that are rate limited right now count as disabled */
+        r = CMP(event_source_is_offline(x), event_source_is_offline(y));
+        if (r != 0)
+                return r;
 
         /* Lower priority values first */
         r = CMP(x->priority, y->priority);
@@ -162,11 +213,10 @@ static int prepare_prioq_compare(const void *a, const void *b) {
         assert(x->prepare);
         assert(y->prepare);
 
-        /* Enabled ones first */
-        if (x->enabled != SD_EVENT_OFF && y->enabled == SD_EVENT_OFF)
-                return -1;
-        if (x->enabled == SD_EVENT_OFF && y->enabled != SD_EVENT_OFF)
-                return 1;
+        /* Enabled ones first, sources that are rate limited right now count as disabled */
+        r = CMP(event_source_is_offline(x), event_source_is_offline(y));
+        if (r != 0)
+                return r;
 
         /* Move most recently prepared ones last, so that we can stop
          * preparing as soon as we hit one that has already been
@@ -179,52 +229,64 @@ static int prepare_prioq_compare(const void *a, const void *b) {
         return CMP(x->priority, y->priority);
 }
 
-static int earliest_time_prioq_compare(const void *a, const void *b) {
-        const sd_event_source *x = a, *y = b;
+static usec_t time_event_source_next(const sd_event_source *s) {
+        assert(s);
 
-        assert(EVENT_SOURCE_IS_TIME(x->type));
-        assert(x->type == y->type);
+        /* Rate limited sources elapse when the rate limit interval ends, timer sources at their time */
 
-        /* Enabled ones first */
-        if (x->enabled != SD_EVENT_OFF && y->enabled == SD_EVENT_OFF)
-                return -1;
-        if (x->enabled == SD_EVENT_OFF && y->enabled != SD_EVENT_OFF)
-                return 1;
+        if (s->ratelimited)
+                return usec_add(s->rate_limit.begin, s->rate_limit.interval);
 
-        /* Move the pending ones to the end */
-        if (!x->pending && y->pending)
-                return -1;
-        if (x->pending && !y->pending)
-                return 1;
+        if (EVENT_SOURCE_IS_TIME(s->type))
+                return s->time.next;
 
-        /* Order by time */
-        return CMP(x->time.next, y->time.next);
+        return USEC_INFINITY;
 }
 
 static usec_t time_event_source_latest(const sd_event_source *s) {
-        return usec_add(s->time.next, s->time.accuracy);
+        assert(s);
+
+        if (s->ratelimited) /* No accuracy for the end of the rate limit interval */
+                return usec_add(s->rate_limit.begin, s->rate_limit.interval);
+
+        if (EVENT_SOURCE_IS_TIME(s->type))
+                return usec_add(s->time.next, s->time.accuracy);
+
+        return USEC_INFINITY;
 }
 
-static int latest_time_prioq_compare(const void *a, const void *b) {
-        const sd_event_source *x = a, *y = b;
+static bool event_source_timer_candidate(const sd_event_source *s) {
+        assert(s);
 
-        assert(EVENT_SOURCE_IS_TIME(x->type));
-        assert(x->type == y->type);
+        /* Returns true for sources that are worth waking up for: timers that aren't pending yet, and sources
+         * that are rate limited, whose interval might end */
+        return !s->pending || s->ratelimited;
+}
+
+static int time_prioq_compare(const void *a, const void *b, usec_t (*time_func)(const sd_event_source *s)) {
+        const sd_event_source *x = a, *y = b;
+        int r;
 
         /* Enabled ones first */
-        if (x->enabled != SD_EVENT_OFF && y->enabled == SD_EVENT_OFF)
-                return -1;
-        if (x->enabled == SD_EVENT_OFF && y->enabled != SD_EVENT_OFF)
-                return 1;
+        r = CMP(x->enabled == SD_EVENT_OFF, y->enabled == SD_EVENT_OFF);
+        if (r != 0)
+                return r;
 
         /* Move the pending ones to the end */
-        if (!x->pending && y->pending)
-                return -1;
-        if (x->pending && !y->pending)
-                return 1;
+        r = CMP(!event_source_timer_candidate(x), !event_source_timer_candidate(y));
+        if (r != 0)
+                return r;
 
         /* Order by time */
-        return CMP(time_event_source_latest(x), time_event_source_latest(y));
+        return CMP(time_func(x), time_func(y));
+}
+
+static int earliest_time_prioq_compare(const void *a, const void *b) {
+        return time_prioq_compare(a, b, time_event_source_next);
+}
+
+static int latest_time_prioq_compare(const void *a, const void *b) {
+        return time_prioq_compare(a, b, time_event_source_latest);
 }
 
 static int exit_prioq_compare(const void *a, const void *b) {
@@ -250,6 +312,7 @@ static void free_clock_data(struct clock_data *d) {
         safe_close(d->fd);
         prioq_free(d->earliest);
         prioq_free(d->latest);
+        timer_wheel_free(d->wheel);
 }
 
 static sd_event *event_free(sd_event *e) {
@@ -269,8 +332,12 @@ static sd_event *event_free(sd_event *e) {
                 *(e->default_event_ptr) = NULL;
 
         safe_close(e->epoll_fd);
+        event_uring_free(e->uring);
         safe_close(e->watchdog_fd);
 
+        /* Waits for work that is still running, whose sources are gone already */
+        event_work_pool_free(e->work.pool);
+
         free_clock_data(&e->realtime);
         free_clock_data(&e->boottime);
         free_clock_data(&e->monotonic);
@@ -323,21 +390,34 @@ _public_ int sd_event_new(sd_event** ret) {
                 .boottime_alarm.wakeup = WAKEUP_CLOCK_DATA,
                 .boottime_alarm.fd = -1,
                 .boottime_alarm.next = USEC_INFINITY,
+                .work.wakeup = WAKEUP_WORK_DATA,
                 .perturb = USEC_INFINITY,
                 .original_pid = getpid_cached(),
+                .dispatch_budget = 1,
         };
 
         r = prioq_ensure_allocated(&e->pending, pending_prioq_compare);
         if (r < 0)
                 goto fail;
 
-        e->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
-        if (e->epoll_fd < 0) {
-                r = -errno;
-                goto fail;
+        /* io_uring saves the epoll_ctl() calls, as it submits the changes to the set of watched fds together
+         * with the wait for the next event. Use it if asked to, and fall back to epoll if it is not
+         * available, whatever the reason. */
+        if (getenv_bool_secure("SD_EVENT_IO_URING") > 0) {
+                r = event_uring_new(&e->uring);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to set up io_uring, using epoll instead: %m");
         }
 
-        e->epoll_fd = fd_move_above_stdio(e->epoll_fd);
+        if (!e->uring) {
+                e->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+                if (e->epoll_fd < 0) {
+                        r = -errno;
+                        goto fail;
+                }
+
+                e->epoll_fd = fd_move_above_stdio(e->epoll_fd);
+        }
 
         if (secure_getenv("SD_EVENT_PROFILE_DELAYS")) {
                 log_debug("Event loop profiling enabled. Logarithmic histogram of event loop iterations in the range 2^0 ... 2^63 us will be logged every 5s.");
@@ -370,6 +450,8 @@ static bool event_pid_changed(sd_event *e) {
 }
 
 static void source_io_unregister(sd_event_source *s) {
+        int r;
+
         assert(s);
         assert(s->type == SOURCE_IO);
 
@@ -379,8 +461,9 @@ static void source_io_unregister(sd_event_source *s) {
         if (!s->io.registered)
                 return;
 
-        if (epoll_ctl(s->event->epoll_fd, EPOLL_CTL_DEL, s->io.fd, NULL) < 0)
-                log_debug_errno(errno, "Failed to remove source %s (type %s) from epoll: %m",
+        r = event_poll_ctl(s->event, EPOLL_CTL_DEL, s->io.fd, NULL);
+        if (r < 0)
+                log_debug_errno(r, "Failed to remove source %s (type %s) from epoll: %m",
                                 strna(s->description), event_source_type_to_string(s->type));
 
         s->io.registered = false;
@@ -401,12 +484,12 @@ static int source_io_register(
         };
         int r;
 
-        r = epoll_ctl(s->event->epoll_fd,
-                      s->io.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
-                      s->io.fd,
-                      &ev);
+        r = event_poll_ctl(s->event,
+                           s->io.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                           s->io.fd,
+                           &ev);
         if (r < 0)
-                return -errno;
+                return r;
 
         s->io.registered = true;
 
@@ -414,6 +497,8 @@ static int source_io_register(
 }
 
 static void source_child_pidfd_unregister(sd_event_source *s) {
+        int r;
+
         assert(s);
         assert(s->type == SOURCE_CHILD);
 
@@ -423,10 +508,12 @@ static void source_child_pidfd_unregister(sd_event_source *s) {
         if (!s->child.registered)
                 return;
 
-        if (EVENT_SOURCE_WATCH_PIDFD(s))
-                if (epoll_ctl(s->event->epoll_fd, EPOLL_CTL_DEL, s->child.pidfd, NULL) < 0)
-                        log_debug_errno(errno, "Failed to remove source %s (type %s) from epoll: %m",
+        if (EVENT_SOURCE_WATCH_PIDFD(s)) {
+                r = event_poll_ctl(s->event, EPOLL_CTL_DEL, s->child.pidfd, NULL);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to remove source %s (type %s) from epoll: %m",
                                         strna(s->description), event_source_type_to_string(s->type));
+        }
 
         s->child.registered = false;
 }
@@ -444,12 +531,9 @@ static int source_child_pidfd_register(sd_event_source *s, int enabled) {
                         .data.ptr = s,
                 };
 
-                if (s->child.registered)
-                        r = epoll_ctl(s->event->epoll_fd, EPOLL_CTL_MOD, s->child.pidfd, &ev);
-                else
-                        r = epoll_ctl(s->event->epoll_fd, EPOLL_CTL_ADD, s->child.pidfd, &ev);
+                r = event_poll_ctl(s->event, s->child.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, s->child.pidfd, &ev);
                 if (r < 0)
-                        return -errno;
+                        return r;
         }
 
         s->child.registered = true;
@@ -536,6 +620,11 @@ static void event_free_signal_data(sd_event *e, struct signal_data *d) {
                 return;
 
         hashmap_remove(e->signal_data, &d->priority);
+
+        /* With epoll closing the fd would suffice, but io_uring keeps it open while it's watched */
+        if (d->fd >= 0)
+                (void) event_poll_ctl(e, EPOLL_CTL_DEL, d->fd, NULL);
+
         safe_close(d->fd);
         free(d);
 }
@@ -616,11 +705,9 @@ static int event_make_signal_data(
                 .data.ptr = d,
         };
 
-        r = epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, d->fd, &ev);
-        if (r < 0)  {
-                r = -errno;
+        r = event_poll_ctl(e, EPOLL_CTL_ADD, d->fd, &ev);
+        if (r < 0)
                 goto fail;
-        }
 
         if (ret)
                 *ret = d;
@@ -674,7 +761,7 @@ static void event_gc_signal_data(sd_event *e, const int64_t *priority, int sig)
 
         if (e->signal_sources &&
             e->signal_sources[sig] &&
-            e->signal_sources[sig]->enabled != SD_EVENT_OFF)
+            event_source_is_online(e->signal_sources[sig]))
                 return;
 
         /*
@@ -704,6 +791,110 @@ static void event_gc_signal_data(sd_event *e, const int64_t *priority, int sig)
                 event_unmask_signal_data(e, d, sig);
 }
 
+static void event_source_pp_prioq_reshuffle(sd_event_source *s) {
+        assert(s);
+
+        /* Reshuffles the pending + prepare prioqs. Called whenever the dispatch order changes, i.e. when
+         * they are enabled/disabled or marked pending and such. */
+
+        if (s->pending)
+                prioq_reshuffle(s->event->pending, s, &s->pending_index);
+
+        if (s->prepare)
+                prioq_reshuffle(s->event->prepare, s, &s->prepare_index);
+}
+
+static bool event_source_want_timer_wheel(const sd_event_source *s) {
+        assert(s);
+
+        /* Timers that may be dispatched at least the default accuracy late don't need to be ordered
+         * precisely, they go into the timer wheel. Rate limited sources always go into the prioqs. */
+        return EVENT_SOURCE_IS_TIME(s->type) && !s->ratelimited && s->time.accuracy >= DEFAULT_ACCURACY_USEC;
+}
+
+static void event_source_time_wheel_update(sd_event_source *s, struct clock_data *d) {
+        assert(s);
+        assert(s->timer_wheel);
+        assert(d);
+
+        /* Only timers that are worth waking up for are kept in the wheel, see event_source_timer_candidate() */
+        timer_wheel_remove(d->wheel, &s->time.wheel_entry);
+
+        if (s->enabled != SD_EVENT_OFF && !s->pending && s->time.next != USEC_INFINITY)
+                timer_wheel_add(d->wheel, &s->time.wheel_entry, s->time.next, time_event_source_latest(s));
+}
+
+static void event_source_time_prioq_reshuffle(sd_event_source *s) {
+        struct clock_data *d;
+
+        assert(s);
+
+        /* Called whenever the time at which the source elapses changed, or whether it is a candidate for
+         * that at all. Rate limited sources are queued for CLOCK_MONOTONIC, regardless of their type. */
+
+        if (s->ratelimited)
+                d = &s->event->monotonic;
+        else {
+                assert(EVENT_SOURCE_IS_TIME(s->type));
+                assert_se(d = event_get_clock_data(s->event, s->type));
+        }
+
+        if (s->timer_wheel) {
+                event_source_time_wheel_update(s, d);
+                d->needs_rearm = true;
+                return;
+        }
+
+        prioq_reshuffle(d->earliest, s, &s->earliest_index);
+        prioq_reshuffle(d->latest, s, &s->latest_index);
+        d->needs_rearm = true;
+}
+
+static void event_source_time_prioq_remove(sd_event_source *s, struct clock_data *d) {
+        assert(s);
+        assert(d);
+
+        if (s->timer_wheel) {
+                timer_wheel_remove(d->wheel, &s->time.wheel_entry);
+                s->timer_wheel = false;
+        } else {
+                prioq_remove(d->earliest, s, &s->earliest_index);
+                prioq_remove(d->latest, s, &s->latest_index);
+                s->earliest_index = s->latest_index = PRIOQ_IDX_NULL;
+        }
+
+        d->needs_rearm = true;
+}
+
+static int event_source_time_prioq_put(sd_event_source *s, struct clock_data *d) {
+        int r;
+
+        assert(s);
+        assert(d);
+
+        /* Adding to the timer wheel doesn't allocate, and can't fail */
+        if (event_source_want_timer_wheel(s)) {
+                s->timer_wheel = true;
+                event_source_time_wheel_update(s, d);
+                d->needs_rearm = true;
+                return 0;
+        }
+
+        r = prioq_put(d->earliest, s, &s->earliest_index);
+        if (r < 0)
+                return r;
+
+        r = prioq_put(d->latest, s, &s->latest_index);
+        if (r < 0) {
+                assert_se(prioq_remove(d->earliest, s, &s->earliest_index) > 0);
+                s->earliest_index = PRIOQ_IDX_NULL;
+                return r;
+        }
+
+        d->needs_rearm = true;
+        return 0;
+}
+
 static void source_disconnect(sd_event_source *s) {
         sd_event *event;
 
@@ -726,17 +917,11 @@ static void source_disconnect(sd_event_source *s) {
         case SOURCE_TIME_BOOTTIME:
         case SOURCE_TIME_MONOTONIC:
         case SOURCE_TIME_REALTIME_ALARM:
-        case SOURCE_TIME_BOOTTIME_ALARM: {
-                struct clock_data *d;
-
-                d = event_get_clock_data(s->event, s->type);
-                assert(d);
-
-                prioq_remove(d->earliest, s, &s->time.earliest_index);
-                prioq_remove(d->latest, s, &s->time.latest_index);
-                d->needs_rearm = true;
+        case SOURCE_TIME_BOOTTIME_ALARM:
+                /* Rate limited timer sources are queued for CLOCK_MONOTONIC instead, see below */
+                if (!s->ratelimited)
+                        event_source_time_prioq_remove(s, event_get_clock_data(s->event, s->type));
                 break;
-        }
 
         case SOURCE_SIGNAL:
                 if (s->signal.sig > 0) {
@@ -813,6 +998,20 @@ static void source_disconnect(sd_event_source *s) {
                 break;
         }
 
+        case SOURCE_WORK:
+                if (s->work.item) {
+                        /* If the work is running right now, leave the item to the pool, it's freed when
+                         * collected */
+                        if (event_work_pool_cancel(s->event->work.pool, s->work.item))
+                                free(s->work.item);
+                        else
+                                s->work.item->owner = NULL;
+
+                        s->work.item = NULL;
+                }
+
+                break;
+
         default:
                 assert_not_reached("Wut? I shouldn't exist.");
         }
@@ -823,6 +1022,9 @@ static void source_disconnect(sd_event_source *s) {
         if (s->prepare)
                 prioq_remove(s->event->prepare, s, &s->prepare_index);
 
+        if (s->ratelimited)
+                event_source_time_prioq_remove(s, &s->event->monotonic);
+
         event = TAKE_PTR(s->event);
         LIST_REMOVE(sources, event->sources, s);
         event->n_sources--;
@@ -901,6 +1103,7 @@ static int source_set_pending(sd_event_source *s, bool b) {
 
         if (b) {
                 s->pending_iteration = s->event->iteration;
+                s->pending_since = now(CLOCK_MONOTONIC);
 
                 r = prioq_put(s->event->pending, s, &s->pending_index);
                 if (r < 0) {
@@ -910,16 +1113,8 @@ static int source_set_pending(sd_event_source *s, bool b) {
         } else
                 assert_se(prioq_remove(s->event->pending, s, &s->pending_index));
 
-        if (EVENT_SOURCE_IS_TIME(s->type)) {
-                struct clock_data *d;
-
-                d = event_get_clock_data(s->event, s->type);
-                assert(d);
-
-                prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                prioq_reshuffle(d->latest, s, &s->time.latest_index);
-                d->needs_rearm = true;
-        }
+        if (EVENT_SOURCE_IS_TIME(s->type))
+                event_source_time_prioq_reshuffle(s);
 
         if (s->type == SOURCE_SIGNAL && !b) {
                 struct signal_data *d;
@@ -961,6 +1156,8 @@ static sd_event_source *source_new(sd_event *e, bool floating, EventSourceType t
                 .type = type,
                 .pending_index = PRIOQ_IDX_NULL,
                 .prepare_index = PRIOQ_IDX_NULL,
+                .earliest_index = PRIOQ_IDX_NULL,
+                .latest_index = PRIOQ_IDX_NULL,
         };
 
         if (!floating)
@@ -1057,14 +1254,37 @@ static int event_setup_timer_fd(
                 .data.ptr = d,
         };
 
-        r = epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        r = event_poll_ctl(e, EPOLL_CTL_ADD, fd, &ev);
         if (r < 0)
-                return -errno;
+                return r;
 
         d->fd = TAKE_FD(fd);
         return 0;
 }
 
+static int setup_clock_data(sd_event *e, struct clock_data *d, clockid_t clock) {
+        int r;
+
+        assert(e);
+        assert(d);
+
+        r = prioq_ensure_allocated(&d->earliest, earliest_time_prioq_compare);
+        if (r < 0)
+                return r;
+
+        r = prioq_ensure_allocated(&d->latest, latest_time_prioq_compare);
+        if (r < 0)
+                return r;
+
+        if (!d->wheel) {
+                d->wheel = timer_wheel_new(DEFAULT_ACCURACY_USEC);
+                if (!d->wheel)
+                        return -ENOMEM;
+        }
+
+        return event_setup_timer_fd(e, d, clock);
+}
+
 static int time_exit_callback(sd_event_source *s, uint64_t usec, void *userdata) {
         assert(s);
 
@@ -1104,20 +1324,10 @@ _public_ int sd_event_add_time(
         d = event_get_clock_data(e, type);
         assert(d);
 
-        r = prioq_ensure_allocated(&d->earliest, earliest_time_prioq_compare);
+        r = setup_clock_data(e, d, clock);
         if (r < 0)
                 return r;
 
-        r = prioq_ensure_allocated(&d->latest, latest_time_prioq_compare);
-        if (r < 0)
-                return r;
-
-        if (d->fd < 0) {
-                r = event_setup_timer_fd(e, d, clock);
-                if (r < 0)
-                        return r;
-        }
-
         s = source_new(e, !ret, type);
         if (!s)
                 return -ENOMEM;
@@ -1125,17 +1335,10 @@ _public_ int sd_event_add_time(
         s->time.next = usec;
         s->time.accuracy = accuracy == 0 ? DEFAULT_ACCURACY_USEC : accuracy;
         s->time.callback = callback;
-        s->time.earliest_index = s->time.latest_index = PRIOQ_IDX_NULL;
         s->userdata = userdata;
         s->enabled = SD_EVENT_ONESHOT;
 
-        d->needs_rearm = true;
-
-        r = prioq_put(d->earliest, s, &s->time.earliest_index);
-        if (r < 0)
-                return r;
-
-        r = prioq_put(d->latest, s, &s->time.latest_index);
+        r = event_source_time_prioq_put(s, d);
         if (r < 0)
                 return r;
 
@@ -1509,7 +1712,89 @@ _public_ int sd_event_add_exit(
         return 0;
 }
 
+static int event_make_work_data(sd_event *e) {
+        _cleanup_(event_work_pool_freep) EventWorkPool *pool = NULL;
+        struct epoll_event ev;
+        int r;
+
+        assert(e);
+
+        if (e->work.pool)
+                return 0;
+
+        r = event_work_pool_new(&pool);
+        if (r < 0)
+                return r;
+
+        ev = (struct epoll_event) {
+                .events = EPOLLIN,
+                .data.ptr = &e->work,
+        };
+
+        r = event_poll_ctl(e, EPOLL_CTL_ADD, event_work_pool_get_fd(pool), &ev);
+        if (r < 0)
+                return r;
+
+        e->work.pool = TAKE_PTR(pool);
+        return 0;
+}
+
+_public_ int sd_event_add_work(
+                sd_event *e,
+                sd_event_source **ret,
+                sd_event_work_handler_t work,
+                sd_event_work_done_handler_t callback,
+                void *userdata) {
+
+        _cleanup_(source_freep) sd_event_source *s = NULL;
+        _cleanup_free_ EventWorkItem *item = NULL;
+        int r;
+
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(work, -EINVAL);
+        assert_return(callback, -EINVAL);
+        assert_return(e->state != SD_EVENT_FINISHED, -ESTALE);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        r = event_make_work_data(e);
+        if (r < 0)
+                return r;
+
+        s = source_new(e, !ret, SOURCE_WORK);
+        if (!s)
+                return -ENOMEM;
+
+        item = new(EventWorkItem, 1);
+        if (!item)
+                return -ENOMEM;
+
+        *item = (EventWorkItem) {
+                .work = work,
+                .userdata = userdata,
+                .owner = s,
+        };
+
+        s->work.callback = callback;
+        s->userdata = userdata;
+        s->enabled = SD_EVENT_ONESHOT;
+
+        r = event_work_pool_submit(e->work.pool, item);
+        if (r < 0)
+                return r;
+
+        s->work.item = TAKE_PTR(item);
+
+        if (ret)
+                *ret = s;
+        TAKE_PTR(s);
+
+        return 0;
+}
+
 static void event_free_inotify_data(sd_event *e, struct inotify_data *d) {
+        int r;
+
         assert(e);
 
         if (!d)
@@ -1527,8 +1812,9 @@ static void event_free_inotify_data(sd_event *e, struct inotify_data *d) {
         assert_se(hashmap_remove(e->inotify_data, &d->priority) == d);
 
         if (d->fd >= 0) {
-                if (epoll_ctl(e->epoll_fd, EPOLL_CTL_DEL, d->fd, NULL) < 0)
-                        log_debug_errno(errno, "Failed to remove inotify fd from epoll, ignoring: %m");
+                r = event_poll_ctl(e, EPOLL_CTL_DEL, d->fd, NULL);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to remove inotify fd from epoll, ignoring: %m");
 
                 safe_close(d->fd);
         }
@@ -1585,8 +1871,8 @@ static int event_make_inotify_data(
                 .data.ptr = d,
         };
 
-        if (epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, d->fd, &ev) < 0) {
-                r = -errno;
+        r = event_poll_ctl(e, EPOLL_CTL_ADD, d->fd, &ev);
+        if (r < 0) {
                 d->fd = safe_close(d->fd); /* let's close this ourselves, as event_free_inotify_data() would otherwise
                                             * remove the fd from the epoll first, which we don't want as we couldn't
                                             * add it in the first place. */
@@ -1961,7 +2247,7 @@ _public_ int sd_event_source_set_io_fd(sd_event_source *s, int fd) {
         if (s->io.fd == fd)
                 return 0;
 
-        if (s->enabled == SD_EVENT_OFF) {
+        if (event_source_is_offline(s)) {
                 s->io.fd = fd;
                 s->io.registered = false;
         } else {
@@ -1980,7 +2266,7 @@ _public_ int sd_event_source_set_io_fd(sd_event_source *s, int fd) {
                         return r;
                 }
 
-                (void) epoll_ctl(s->event->epoll_fd, EPOLL_CTL_DEL, saved_fd, NULL);
+                (void) event_poll_ctl(s->event, EPOLL_CTL_DEL, saved_fd, NULL);
         }
 
         return 0;
@@ -2028,7 +2314,7 @@ _public_ int sd_event_source_set_io_events(sd_event_source *s, uint32_t events)
         if (r < 0)
                 return r;
 
-        if (s->enabled != SD_EVENT_OFF) {
+        if (event_source_is_online(s)) {
                 r = source_io_register(s, s->enabled, events);
                 if (r < 0)
                         return r;
@@ -2131,7 +2417,7 @@ _public_ int sd_event_source_set_priority(sd_event_source *s, int64_t priority)
 
                 event_gc_inode_data(s->event, old_inode_data);
 
-        } else if (s->type == SOURCE_SIGNAL && s->enabled != SD_EVENT_OFF) {
+        } else if (s->type == SOURCE_SIGNAL && event_source_is_online(s)) {
                 struct signal_data *old, *d;
 
                 /* Move us from the signalfd belonging to the old
@@ -2151,11 +2437,7 @@ _public_ int sd_event_source_set_priority(sd_event_source *s, int64_t priority)
         } else
                 s->priority = priority;
 
-        if (s->pending)
-                prioq_reshuffle(s->event->pending, s, &s->pending_index);
-
-        if (s->prepare)
-                prioq_reshuffle(s->event->prepare, s, &s->prepare_index);
+        event_source_pp_prioq_reshuffle(s);
 
         if (s->type == SOURCE_EXIT)
                 prioq_reshuffle(s->event->exit, s, &s->exit.prioq_index);
@@ -2181,190 +2463,302 @@ _public_ int sd_event_source_get_enabled(sd_event_source *s, int *m) {
         return s->enabled != SD_EVENT_OFF;
 }
 
-_public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
+static int event_source_offline(
+                sd_event_source *s,
+                int enabled,
+                bool ratelimited) {
+
+        bool was_offline;
         int r;
 
-        assert_return(s, -EINVAL);
-        assert_return(IN_SET(m, SD_EVENT_OFF, SD_EVENT_ON, SD_EVENT_ONESHOT), -EINVAL);
-        assert_return(!event_pid_changed(s->event), -ECHILD);
+        assert(s);
+        assert(enabled == SD_EVENT_OFF || ratelimited);
 
-        /* If we are dead anyway, we are fine with turning off
-         * sources, but everything else needs to fail. */
-        if (s->event->state == SD_EVENT_FINISHED)
-                return m == SD_EVENT_OFF ? 0 : -ESTALE;
+        /* Unset the pending flag when this event source is disabled */
+        if (s->enabled != SD_EVENT_OFF &&
+            enabled == SD_EVENT_OFF &&
+            !IN_SET(s->type, SOURCE_DEFER, SOURCE_EXIT, SOURCE_WORK)) {
+                r = source_set_pending(s, false);
+                if (r < 0)
+                        return r;
+        }
 
-        if (s->enabled == m)
+        was_offline = event_source_is_offline(s);
+        s->enabled = enabled;
+        s->ratelimited = ratelimited;
+
+        switch (s->type) {
+
+        case SOURCE_IO:
+                source_io_unregister(s);
+                break;
+
+        case SOURCE_TIME_REALTIME:
+        case SOURCE_TIME_BOOTTIME:
+        case SOURCE_TIME_MONOTONIC:
+        case SOURCE_TIME_REALTIME_ALARM:
+        case SOURCE_TIME_BOOTTIME_ALARM:
+                event_source_time_prioq_reshuffle(s);
+                break;
+
+        case SOURCE_SIGNAL:
+                event_gc_signal_data(s->event, &s->priority, s->signal.sig);
+                break;
+
+        case SOURCE_CHILD:
+                if (!was_offline) {
+                        assert(s->event->n_enabled_child_sources > 0);
+                        s->event->n_enabled_child_sources--;
+                }
+
+                if (EVENT_SOURCE_WATCH_PIDFD(s))
+                        source_child_pidfd_unregister(s);
+                else
+                        event_gc_signal_data(s->event, &s->priority, SIGCHLD);
+                break;
+
+        case SOURCE_EXIT:
+                prioq_reshuffle(s->event->exit, s, &s->exit.prioq_index);
+                break;
+
+        case SOURCE_DEFER:
+        case SOURCE_POST:
+        case SOURCE_INOTIFY:
+        case SOURCE_WORK:
+                break;
+
+        default:
+                assert_not_reached("Wut? I shouldn't exist.");
+        }
+
+        return 0;
+}
+
+static int event_source_online(
+                sd_event_source *s,
+                int enabled,
+                bool ratelimited) {
+
+        bool was_online;
+        int r;
+
+        assert(s);
+        assert(enabled != SD_EVENT_OFF || !ratelimited);
+
+        /* Unset the pending flag when this event source is enabled */
+        if (s->enabled == SD_EVENT_OFF &&
+            enabled != SD_EVENT_OFF &&
+            !IN_SET(s->type, SOURCE_DEFER, SOURCE_EXIT, SOURCE_WORK)) {
+                r = source_set_pending(s, false);
+                if (r < 0)
+                        return r;
+        }
+
+        /* Are we really ready for onlining? If not, just update the state */
+        if (enabled == SD_EVENT_OFF || ratelimited) {
+                s->enabled = enabled;
+                s->ratelimited = ratelimited;
                 return 0;
+        }
 
-        if (m == SD_EVENT_OFF) {
+        was_online = event_source_is_online(s);
+
+        switch (s->type) {
 
-                /* Unset the pending flag when this event source is disabled */
-                if (!IN_SET(s->type, SOURCE_DEFER, SOURCE_EXIT)) {
-                        r = source_set_pending(s, false);
+        case SOURCE_IO:
+                r = source_io_register(s, enabled, s->io.events);
+                if (r < 0)
+                        return r;
+                break;
+
+        case SOURCE_SIGNAL:
+                r = event_make_signal_data(s->event, s->signal.sig, NULL);
+                if (r < 0) {
+                        event_gc_signal_data(s->event, &s->priority, s->signal.sig);
+                        return r;
+                }
+
+                break;
+
+        case SOURCE_CHILD:
+                if (EVENT_SOURCE_WATCH_PIDFD(s)) {
+                        /* yes, we have pidfd */
+
+                        r = source_child_pidfd_register(s, enabled);
                         if (r < 0)
                                 return r;
+                } else {
+                        /* no pidfd, or something other to watch for than WEXITED */
+
+                        r = event_make_signal_data(s->event, SIGCHLD, NULL);
+                        if (r < 0) {
+                                event_gc_signal_data(s->event, &s->priority, SIGCHLD);
+                                return r;
+                        }
                 }
 
-                switch (s->type) {
+                if (!was_online)
+                        s->event->n_enabled_child_sources++;
+                break;
 
-                case SOURCE_IO:
-                        source_io_unregister(s);
-                        s->enabled = m;
-                        break;
+        case SOURCE_TIME_REALTIME:
+        case SOURCE_TIME_BOOTTIME:
+        case SOURCE_TIME_MONOTONIC:
+        case SOURCE_TIME_REALTIME_ALARM:
+        case SOURCE_TIME_BOOTTIME_ALARM:
+        case SOURCE_EXIT:
+        case SOURCE_DEFER:
+        case SOURCE_POST:
+        case SOURCE_INOTIFY:
+        case SOURCE_WORK:
+                break;
 
-                case SOURCE_TIME_REALTIME:
-                case SOURCE_TIME_BOOTTIME:
-                case SOURCE_TIME_MONOTONIC:
-                case SOURCE_TIME_REALTIME_ALARM:
-                case SOURCE_TIME_BOOTTIME_ALARM: {
-                        struct clock_data *d;
+        default:
+                assert_not_reached("Wut? I shouldn't exist.");
+        }
 
-                        s->enabled = m;
-                        d = event_get_clock_data(s->event, s->type);
-                        assert(d);
+        s->enabled = enabled;
+        s->ratelimited = ratelimited;
 
-                        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-                        d->needs_rearm = true;
-                        break;
-                }
+        /* Non-failing operations below */
+        switch (s->type) {
 
-                case SOURCE_SIGNAL:
-                        s->enabled = m;
+        case SOURCE_TIME_REALTIME:
+        case SOURCE_TIME_BOOTTIME:
+        case SOURCE_TIME_MONOTONIC:
+        case SOURCE_TIME_REALTIME_ALARM:
+        case SOURCE_TIME_BOOTTIME_ALARM:
+                event_source_time_prioq_reshuffle(s);
+                break;
 
-                        event_gc_signal_data(s->event, &s->priority, s->signal.sig);
-                        break;
+        case SOURCE_EXIT:
+                prioq_reshuffle(s->event->exit, s, &s->exit.prioq_index);
+                break;
 
-                case SOURCE_CHILD:
-                        s->enabled = m;
+        default:
+                break;
+        }
 
-                        assert(s->event->n_enabled_child_sources > 0);
-                        s->event->n_enabled_child_sources--;
+        return 0;
+}
 
-                        if (EVENT_SOURCE_WATCH_PIDFD(s))
-                                source_child_pidfd_unregister(s);
-                        else
-                                event_gc_signal_data(s->event, &s->priority, SIGCHLD);
+_public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
+        int r;
 
-                        break;
+        assert_return(s, -EINVAL);
+        assert_return(IN_SET(m, SD_EVENT_OFF, SD_EVENT_ON, SD_EVENT_ONESHOT), -EINVAL);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
 
-                case SOURCE_EXIT:
-                        s->enabled = m;
-                        prioq_reshuffle(s->event->exit, s, &s->exit.prioq_index);
-                        break;
+        /* If we are dead anyway, we are fine with turning off
+         * sources, but everything else needs to fail. */
+        if (s->event->state == SD_EVENT_FINISHED)
+                return m == SD_EVENT_OFF ? 0 : -ESTALE;
 
-                case SOURCE_DEFER:
-                case SOURCE_POST:
-                case SOURCE_INOTIFY:
-                        s->enabled = m;
-                        break;
+        if (s->enabled == m)
+                return 0;
 
-                default:
-                        assert_not_reached("Wut? I shouldn't exist.");
-                }
+        /* A rate limited source stays offline until the end of the interval, whatever it is set to */
+        if (m == SD_EVENT_OFF)
+                r = event_source_offline(s, m, s->ratelimited);
+        else
+                r = event_source_online(s, m, s->ratelimited);
+        if (r < 0)
+                return r;
 
-        } else {
+        /* Rate limited sources of any type are queued for CLOCK_MONOTONIC, and that queue orders by the
+         * enabled state too, hence update their place in it */
+        if (s->ratelimited)
+                event_source_time_prioq_reshuffle(s);
 
-                /* Unset the pending flag when this event source is enabled */
-                if (s->enabled == SD_EVENT_OFF && !IN_SET(s->type, SOURCE_DEFER, SOURCE_EXIT)) {
-                        r = source_set_pending(s, false);
-                        if (r < 0)
-                                return r;
-                }
+        event_source_pp_prioq_reshuffle(s);
+        return 0;
+}
 
-                switch (s->type) {
+static int event_source_enter_ratelimited(sd_event_source *s) {
+        int r;
 
-                case SOURCE_IO:
-                        r = source_io_register(s, m, s->io.events);
-                        if (r < 0)
-                                return r;
+        assert(s);
 
-                        s->enabled = m;
-                        break;
+        /* When an event source becomes rate limited, we queue it for CLOCK_MONOTONIC, with the end of the
+         * rate limit interval, much as if it was a timer event source. */
 
-                case SOURCE_TIME_REALTIME:
-                case SOURCE_TIME_BOOTTIME:
-                case SOURCE_TIME_MONOTONIC:
-                case SOURCE_TIME_REALTIME_ALARM:
-                case SOURCE_TIME_BOOTTIME_ALARM: {
-                        struct clock_data *d;
+        if (s->ratelimited)
+                return 0;
 
-                        s->enabled = m;
-                        d = event_get_clock_data(s->event, s->type);
-                        assert(d);
+        r = setup_clock_data(s->event, &s->event->monotonic, CLOCK_MONOTONIC);
+        if (r < 0)
+                return r;
 
-                        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-                        d->needs_rearm = true;
-                        break;
-                }
+        /* Timer event sources use their indexes for the prioqs of their own clock, take them out of those
+         * first. Mark the source rate limited before queuing it again, so that it is ordered by the end of
+         * the interval, and is never put into the timer wheel. */
+        if (EVENT_SOURCE_IS_TIME(s->type))
+                event_source_time_prioq_remove(s, event_get_clock_data(s->event, s->type));
 
-                case SOURCE_SIGNAL:
+        s->ratelimited = true;
 
-                        s->enabled = m;
+        r = event_source_time_prioq_put(s, &s->event->monotonic);
+        if (r < 0)
+                goto fail;
 
-                        r = event_make_signal_data(s->event, s->signal.sig, NULL);
-                        if (r < 0) {
-                                s->enabled = SD_EVENT_OFF;
-                                event_gc_signal_data(s->event, &s->priority, s->signal.sig);
-                                return r;
-                        }
+        r = event_source_offline(s, s->enabled, true);
+        if (r < 0) {
+                event_source_time_prioq_remove(s, &s->event->monotonic);
+                goto fail;
+        }
 
-                        break;
+        event_source_pp_prioq_reshuffle(s);
 
-                case SOURCE_CHILD:
+        log_debug("Event source %s (type %s) entered rate limit state.",
+                  strna(s->description), event_source_type_to_string(s->type));
+        return 0;
 
-                        if (s->enabled == SD_EVENT_OFF)
-                                s->event->n_enabled_child_sources++;
+fail:
+        /* Put timer event sources back where they were, this can't fail, the prioqs have the space */
+        s->ratelimited = false;
+        if (EVENT_SOURCE_IS_TIME(s->type))
+                assert_se(event_source_time_prioq_put(s, event_get_clock_data(s->event, s->type)) >= 0);
 
-                        s->enabled = m;
+        return r;
+}
 
-                        if (EVENT_SOURCE_WATCH_PIDFD(s)) {
-                                /* yes, we have pidfd */
+static int event_source_leave_ratelimit(sd_event_source *s) {
+        int r;
 
-                                r = source_child_pidfd_register(s, s->enabled);
-                                if (r < 0) {
-                                        s->enabled = SD_EVENT_OFF;
-                                        s->event->n_enabled_child_sources--;
-                                        return r;
-                                }
-                        } else {
-                                /* no pidfd, or something other to watch for than WEXITED */
+        assert(s);
 
-                                r = event_make_signal_data(s->event, SIGCHLD, NULL);
-                                if (r < 0) {
-                                        s->enabled = SD_EVENT_OFF;
-                                        s->event->n_enabled_child_sources--;
-                                        event_gc_signal_data(s->event, &s->priority, SIGCHLD);
-                                        return r;
-                                }
-                        }
+        if (!s->ratelimited)
+                return 0;
 
-                        break;
+        event_source_time_prioq_remove(s, &s->event->monotonic);
+        s->ratelimited = false;
 
-                case SOURCE_EXIT:
-                        s->enabled = m;
-                        prioq_reshuffle(s->event->exit, s, &s->exit.prioq_index);
-                        break;
+        if (EVENT_SOURCE_IS_TIME(s->type)) {
+                r = event_source_time_prioq_put(s, event_get_clock_data(s->event, s->type));
+                if (r < 0)
+                        goto fail;
+        }
 
-                case SOURCE_DEFER:
-                case SOURCE_POST:
-                case SOURCE_INOTIFY:
-                        s->enabled = m;
-                        break;
+        r = event_source_online(s, s->enabled, false);
+        if (r < 0) {
+                if (EVENT_SOURCE_IS_TIME(s->type))
+                        event_source_time_prioq_remove(s, event_get_clock_data(s->event, s->type));
 
-                default:
-                        assert_not_reached("Wut? I shouldn't exist.");
-                }
+                goto fail;
         }
 
-        if (s->pending)
-                prioq_reshuffle(s->event->pending, s, &s->pending_index);
-
-        if (s->prepare)
-                prioq_reshuffle(s->event->prepare, s, &s->prepare_index);
+        event_source_pp_prioq_reshuffle(s);
+        ratelimit_reset(&s->rate_limit);
 
+        log_debug("Event source %s (type %s) left rate limit state.",
+                  strna(s->description), event_source_type_to_string(s->type));
         return 0;
+
+fail:
+        /* If we can't take the source online again, leave it rate limited, and hence offline, for good */
+        s->ratelimited = true;
+        assert_se(event_source_time_prioq_put(s, &s->event->monotonic) >= 0);
+        return r;
 }
 
 _public_ int sd_event_source_get_time(sd_event_source *s, uint64_t *usec) {
@@ -2378,7 +2772,6 @@ _public_ int sd_event_source_get_time(sd_event_source *s, uint64_t *usec) {
 }
 
 _public_ int sd_event_source_set_time(sd_event_source *s, uint64_t usec) {
-        struct clock_data *d;
         int r;
 
         assert_return(s, -EINVAL);
@@ -2392,13 +2785,7 @@ _public_ int sd_event_source_set_time(sd_event_source *s, uint64_t usec) {
 
         s->time.next = usec;
 
-        d = event_get_clock_data(s->event, s->type);
-        assert(d);
-
-        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-        d->needs_rearm = true;
-
+        event_source_time_prioq_reshuffle(s);
         return 0;
 }
 
@@ -2413,7 +2800,7 @@ _public_ int sd_event_source_get_time_accuracy(sd_event_source *s, uint64_t *use
 }
 
 _public_ int sd_event_source_set_time_accuracy(sd_event_source *s, uint64_t usec) {
-        struct clock_data *d;
+        usec_t old;
         int r;
 
         assert_return(s, -EINVAL);
@@ -2429,14 +2816,29 @@ _public_ int sd_event_source_set_time_accuracy(sd_event_source *s, uint64_t usec
         if (usec == 0)
                 usec = DEFAULT_ACCURACY_USEC;
 
+        old = s->time.accuracy;
         s->time.accuracy = usec;
 
-        d = event_get_clock_data(s->event, s->type);
-        assert(d);
+        if (!s->ratelimited && event_source_want_timer_wheel(s) != s->timer_wheel) {
+                struct clock_data *d;
 
-        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-        d->needs_rearm = true;
+                /* Move between the timer wheel and the prioqs */
+                assert_se(d = event_get_clock_data(s->event, s->type));
+
+                event_source_time_prioq_remove(s, d);
+
+                r = event_source_time_prioq_put(s, d);
+                if (r < 0) {
+                        /* Only moving into the prioqs may fail, go back to the timer wheel */
+                        s->time.accuracy = old;
+                        assert_se(event_source_time_prioq_put(s, d) >= 0);
+                        return r;
+                }
 
+                return 0;
+        }
+
+        event_source_time_prioq_reshuffle(s);
         return 0;
 }
 
@@ -2696,8 +3098,8 @@ static int event_arm_timer(
                 struct clock_data *d) {
 
         struct itimerspec its = {};
-        sd_event_source *a, *b;
-        usec_t t;
+        usec_t a = USEC_INFINITY, b = USEC_INFINITY, wa, wb, t;
+        sd_event_source *s;
         int r;
 
         assert(e);
@@ -2708,8 +3110,23 @@ static int event_arm_timer(
         else
                 d->needs_rearm = false;
 
-        a = prioq_peek(d->earliest);
-        if (!a || a->enabled == SD_EVENT_OFF || a->time.next == USEC_INFINITY) {
+        s = prioq_peek(d->earliest);
+        if (s && s->enabled != SD_EVENT_OFF && time_event_source_next(s) != USEC_INFINITY) {
+                a = time_event_source_next(s);
+
+                s = prioq_peek(d->latest);
+                assert_se(s && s->enabled != SD_EVENT_OFF);
+                b = time_event_source_latest(s);
+        }
+
+        /* The wheel doesn't know the latest time exactly, but a bound that still leaves room for
+         * coalescing, see timer-wheel.c */
+        if (d->wheel && timer_wheel_peek(d->wheel, &wa, &wb)) {
+                a = MIN(a, wa);
+                b = MIN(b, wb);
+        }
+
+        if (a == USEC_INFINITY) {
 
                 if (d->fd < 0)
                         return 0;
@@ -2726,10 +3143,7 @@ static int event_arm_timer(
                 return 0;
         }
 
-        b = prioq_peek(d->latest);
-        assert_se(b && b->enabled != SD_EVENT_OFF);
-
-        t = sleep_between(e, a->time.next, time_event_source_latest(b));
+        t = sleep_between(e, a, b);
         if (d->next == t)
                 return 0;
 
@@ -2808,19 +3222,43 @@ static int process_timer(
 
         for (;;) {
                 s = prioq_peek(d->earliest);
-                if (!s ||
-                    s->time.next > n ||
-                    s->enabled == SD_EVENT_OFF ||
-                    s->pending)
+                if (!s || time_event_source_next(s) > n)
+                        break;
+
+                if (s->ratelimited) {
+                        /* The rate limit interval of this source ended, take it online again */
+                        r = event_source_leave_ratelimit(s);
+                        if (r < 0)
+                                return r;
+
+                        continue;
+                }
+
+                if (s->enabled == SD_EVENT_OFF || s->pending)
                         break;
 
                 r = source_set_pending(s, true);
                 if (r < 0)
                         return r;
 
-                prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                prioq_reshuffle(d->latest, s, &s->time.latest_index);
-                d->needs_rearm = true;
+                event_source_time_prioq_reshuffle(s);
+        }
+
+        while (d->wheel) {
+                TimerWheelEntry *entry;
+
+                entry = timer_wheel_pop(d->wheel, n);
+                if (!entry)
+                        break;
+
+                s = container_of(entry, sd_event_source, time.wheel_entry);
+
+                r = source_set_pending(s, true);
+                if (r < 0) {
+                        /* Put it back into the wheel */
+                        event_source_time_prioq_reshuffle(s);
+                        return r;
+                }
         }
 
         return 0;
@@ -3142,8 +3580,72 @@ static int process_inotify(sd_event *e) {
         return done;
 }
 
+static int process_work(sd_event *e, struct work_data *d, uint32_t events) {
+        EventWorkItem *i;
+        int r;
+
+        assert(e);
+        assert(d);
+        assert(d->pool);
+        assert_return(events == EPOLLIN, -EIO);
+
+        /* Reset the eventfd first, so that work finishing while we collect results wakes us up again */
+        r = event_work_pool_flush(d->pool);
+        if (r < 0)
+                return r;
+
+        while ((i = event_work_pool_pop_done(d->pool))) {
+                sd_event_source *s = i->owner;
+
+                if (s) {
+                        assert(s->type == SOURCE_WORK);
+                        assert(s->work.item == i);
+
+                        s->work.result = i->result;
+                        s->work.item = NULL;
+                }
+
+                free(i);
+
+                /* Its source has been freed while the work was running */
+                if (!s)
+                        continue;
+
+                r = source_set_pending(s, true);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static void source_account_pending(sd_event_source *s, usec_t n) {
+        usec_t d;
+
+        assert(s);
+
+        if (s->pending_since == 0 || n <= s->pending_since)
+                return;
+
+        d = n - s->pending_since;
+        s->statistics.pending_usec += d;
+        s->statistics.pending_max_usec = MAX(s->statistics.pending_max_usec, d);
+}
+
+static void source_account_dispatch(sd_event_source *s, usec_t begin, usec_t end) {
+        usec_t d;
+
+        assert(s);
+
+        d = LESS_BY(end, begin);
+        s->statistics.n_dispatched++;
+        s->statistics.dispatch_usec += d;
+        s->statistics.dispatch_max_usec = MAX(s->statistics.dispatch_max_usec, d);
+}
+
 static int source_dispatch(sd_event_source *s) {
         EventSourceType saved_type;
+        usec_t begin, end;
         int r = 0;
 
         assert(s);
@@ -3153,6 +3655,20 @@ static int source_dispatch(sd_event_source *s) {
          * the event. */
         saved_type = s->type;
 
+        /* Check if we hit the rate limit for this event source, and if so take it offline until the interval
+         * is over. It stays pending, so that nothing is lost, and is dispatched once it's back online. */
+        if (EVENT_SOURCE_CAN_RATE_LIMIT(s->type)) {
+                assert(!s->ratelimited);
+
+                if (!ratelimit_below(&s->rate_limit)) {
+                        r = event_source_enter_ratelimited(s);
+                        if (r < 0)
+                                return r;
+
+                        return 1;
+                }
+        }
+
         if (!IN_SET(s->type, SOURCE_DEFER, SOURCE_EXIT)) {
                 r = source_set_pending(s, false);
                 if (r < 0)
@@ -3167,7 +3683,7 @@ static int source_dispatch(sd_event_source *s) {
                  * post sources as pending */
 
                 SET_FOREACH(z, s->event->post_sources, i) {
-                        if (z->enabled == SD_EVENT_OFF)
+                        if (event_source_is_offline(z))
                                 continue;
 
                         r = source_set_pending(z, true);
@@ -3182,6 +3698,9 @@ static int source_dispatch(sd_event_source *s) {
                         return r;
         }
 
+        begin = now(CLOCK_MONOTONIC);
+        source_account_pending(s, begin);
+
         s->dispatching = true;
 
         switch (s->type) {
@@ -3252,6 +3771,10 @@ static int source_dispatch(sd_event_source *s) {
                 break;
         }
 
+        case SOURCE_WORK:
+                r = s->work.callback(s, s->work.result, s->userdata);
+                break;
+
         case SOURCE_WATCHDOG:
         case _SOURCE_EVENT_SOURCE_TYPE_MAX:
         case _SOURCE_EVENT_SOURCE_TYPE_INVALID:
@@ -3260,6 +3783,13 @@ static int source_dispatch(sd_event_source *s) {
 
         s->dispatching = false;
 
+        end = now(CLOCK_MONOTONIC);
+        source_account_dispatch(s, begin, end);
+
+        /* Defer sources stay pending, their next wait starts now */
+        if (saved_type == SOURCE_DEFER && s->pending)
+                s->pending_since = end;
+
         if (r < 0)
                 log_debug_errno(r, "Event source %s (type %s) returned error, disabling: %m",
                                 strna(s->description), event_source_type_to_string(saved_type));
@@ -3281,7 +3811,7 @@ static int event_prepare(sd_event *e) {
                 sd_event_source *s;
 
                 s = prioq_peek(e->prepare);
-                if (!s || s->prepare_iteration == e->iteration || s->enabled == SD_EVENT_OFF)
+                if (!s || s->prepare_iteration == e->iteration || event_source_is_offline(s))
                         break;
 
                 s->prepare_iteration = e->iteration;
@@ -3338,7 +3868,7 @@ static sd_event_source* event_next_pending(sd_event *e) {
         if (!p)
                 return NULL;
 
-        if (p->enabled == SD_EVENT_OFF)
+        if (event_source_is_offline(p))
                 return NULL;
 
         return p;
@@ -3455,6 +3985,12 @@ _public_ int sd_event_prepare(sd_event *e) {
         if (event_next_pending(e) || e->need_process_child)
                 goto pending;
 
+        if (e->uring && e->fd_exported) {
+                r = event_uring_submit(e->uring);
+                if (r < 0)
+                        return r;
+        }
+
         e->state = SD_EVENT_ARMED;
 
         return 0;
@@ -3483,7 +4019,7 @@ _public_ int sd_event_wait(sd_event *e, uint64_t timeout) {
                 return 1;
         }
 
-        event_queue_max = MAX(e->n_sources, 1u);
+        event_queue_max = e->event_queue_max > 0 ? e->event_queue_max : MAX(e->n_sources, 1u);
         if (!GREEDY_REALLOC(e->event_queue, e->event_queue_allocated, event_queue_max))
                 return -ENOMEM;
 
@@ -3491,15 +4027,21 @@ _public_ int sd_event_wait(sd_event *e, uint64_t timeout) {
         if (e->inotify_data_buffered)
                 timeout = 0;
 
-        m = epoll_wait(e->epoll_fd, e->event_queue, event_queue_max,
-                       timeout == (uint64_t) -1 ? -1 : (int) DIV_ROUND_UP(timeout, USEC_PER_MSEC));
+        if (e->uring)
+                m = event_uring_wait(e->uring, e->event_queue, event_queue_max, timeout);
+        else {
+                m = epoll_wait(e->epoll_fd, e->event_queue, event_queue_max,
+                               timeout == (uint64_t) -1 ? -1 : (int) DIV_ROUND_UP(timeout, USEC_PER_MSEC));
+                if (m < 0)
+                        m = -errno;
+        }
         if (m < 0) {
-                if (errno == EINTR) {
+                if (m == -EINTR) {
                         e->state = SD_EVENT_PENDING;
                         return 1;
                 }
 
-                r = -errno;
+                r = m;
                 goto finish;
         }
 
@@ -3553,6 +4095,10 @@ _public_ int sd_event_wait(sd_event *e, uint64_t timeout) {
                                 r = event_inotify_data_read(e, e->event_queue[i].data.ptr, e->event_queue[i].events);
                                 break;
 
+                        case WAKEUP_WORK_DATA:
+                                r = process_work(e, e->event_queue[i].data.ptr, e->event_queue[i].events);
+                                break;
+
                         default:
                                 assert_not_reached("Invalid wake-up pointer");
                         }
@@ -3610,8 +4156,10 @@ finish:
 }
 
 _public_ int sd_event_dispatch(sd_event *e) {
+        _cleanup_(sd_event_unrefp) sd_event *ref = NULL;
         sd_event_source *p;
-        int r;
+        unsigned n;
+        int r = 1;
 
         assert_return(e, -EINVAL);
         assert_return(e = event_resolve(e), -ENOPKG);
@@ -3622,20 +4170,28 @@ _public_ int sd_event_dispatch(sd_event *e) {
         if (e->exit_requested)
                 return dispatch_exit(e);
 
-        p = event_next_pending(e);
-        if (p) {
-                _cleanup_(sd_event_unrefp) sd_event *ref = NULL;
+        ref = sd_event_ref(e);
+        e->state = SD_EVENT_RUNNING;
+
+        /* Dispatch pending sources in order of priority, up to the budget. Preparing the next iteration
+         * means running all prepare callbacks, rearming the timers and a call to epoll_wait() that returns
+         * every ready fd again, hence with many busy sources it is much cheaper to work through more than
+         * one of the sources we already know about per iteration. Defer sources stay pending after being
+         * dispatched, stop when we'd get to one a second time, so that they don't starve the rest. */
+        for (n = 0; n < e->dispatch_budget; n++) {
+                p = event_next_pending(e);
+                if (!p || p->dispatch_iteration == e->iteration)
+                        break;
+
+                p->dispatch_iteration = e->iteration;
 
-                ref = sd_event_ref(e);
-                e->state = SD_EVENT_RUNNING;
                 r = source_dispatch(p);
-                e->state = SD_EVENT_INITIAL;
-                return r;
+                if (r < 0 || e->exit_requested)
+                        break;
         }
 
         e->state = SD_EVENT_INITIAL;
-
-        return 1;
+        return r;
 }
 
 static void event_log_delays(sd_event *e) {
@@ -3722,6 +4278,13 @@ _public_ int sd_event_get_fd(sd_event *e) {
         assert_return(e = event_resolve(e), -ENOPKG);
         assert_return(!event_pid_changed(e), -ECHILD);
 
+        if (e->uring) {
+                /* The io_uring becomes readable once a poll request completed, hence from now on submit them
+                 * already when preparing, for whoever polls it */
+                e->fd_exported = true;
+                return event_uring_get_fd(e->uring);
+        }
+
         return e->epoll_fd;
 }
 
@@ -3854,15 +4417,13 @@ _public_ int sd_event_set_watchdog(sd_event *e, int b) {
                         .data.ptr = INT_TO_PTR(SOURCE_WATCHDOG),
                 };
 
-                r = epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, e->watchdog_fd, &ev);
-                if (r < 0) {
-                        r = -errno;
+                r = event_poll_ctl(e, EPOLL_CTL_ADD, e->watchdog_fd, &ev);
+                if (r < 0)
                         goto fail;
-                }
 
         } else {
                 if (e->watchdog_fd >= 0) {
-                        (void) epoll_ctl(e->epoll_fd, EPOLL_CTL_DEL, e->watchdog_fd, NULL);
+                        (void) event_poll_ctl(e, EPOLL_CTL_DEL, e->watchdog_fd, NULL);
                         e->watchdog_fd = safe_close(e->watchdog_fd);
                 }
         }
@@ -3892,6 +4453,49 @@ _public_ int sd_event_get_iteration(sd_event *e, uint64_t *ret) {
         return 0;
 }
 
+_public_ int sd_event_set_dispatch_budget(sd_event *e, unsigned budget) {
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(budget > 0, -EINVAL);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        e->dispatch_budget = budget;
+        return 0;
+}
+
+_public_ int sd_event_get_dispatch_budget(sd_event *e, unsigned *ret) {
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(ret, -EINVAL);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        *ret = e->dispatch_budget;
+        return 0;
+}
+
+_public_ int sd_event_set_event_queue_max(sd_event *e, size_t n) {
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(n <= INT_MAX, -ERANGE);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        /* epoll_wait() hands out ready fds round-robin, hence a buffer smaller than the number of sources
+         * doesn't starve any of them, it just takes more than one iteration to get to all of them */
+
+        e->event_queue_max = n;
+        return 0;
+}
+
+_public_ int sd_event_get_event_queue_max(sd_event *e, size_t *ret) {
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(ret, -EINVAL);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        *ret = e->event_queue_max > 0 ? e->event_queue_max : MAX(e->n_sources, 1u);
+        return 0;
+}
+
 _public_ int sd_event_source_set_destroy_callback(sd_event_source *s, sd_event_destroy_t callback) {
         assert_return(s, -EINVAL);
 
@@ -3935,3 +4539,75 @@ _public_ int sd_event_source_set_floating(sd_event_source *s, int b) {
 
         return 1;
 }
+
+_public_ int sd_event_source_set_ratelimit(sd_event_source *s, uint64_t interval, unsigned burst) {
+        int r;
+
+        assert_return(s, -EINVAL);
+        assert_return(EVENT_SOURCE_CAN_RATE_LIMIT(s->type), -EDOM);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        /* Start afresh, and take the source online again if it is rate limited right now */
+        r = event_source_leave_ratelimit(s);
+        if (r < 0)
+                return r;
+
+        s->rate_limit = (RateLimit) { interval, burst };
+        return 0;
+}
+
+_public_ int sd_event_source_get_ratelimit(sd_event_source *s, uint64_t *ret_interval, unsigned *ret_burst) {
+        assert_return(s, -EINVAL);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        /* Unlike setting it, querying the rate limit of a source that can't have one is not a programming
+         * error, hence no assert_return() for that */
+        if (!EVENT_SOURCE_CAN_RATE_LIMIT(s->type))
+                return -EDOM;
+
+        if (!ratelimit_configured(&s->rate_limit))
+                return -ENOEXEC;
+
+        if (ret_interval)
+                *ret_interval = s->rate_limit.interval;
+        if (ret_burst)
+                *ret_burst = s->rate_limit.burst;
+
+        return 0;
+}
+
+_public_ int sd_event_source_get_statistics(sd_event_source *s, sd_event_source_statistics *ret, size_t size) {
+        assert_return(s, -EINVAL);
+        assert_return(ret, -EINVAL);
+        assert_return(size >= offsetof(sd_event_source_statistics, pending_max_usec) + sizeof(uint64_t), -EINVAL);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        /* The caller passes the size of the structure it was built with, so that fields may be appended
+         * later on. Fields the caller doesn't know about are left out, ones we don't know about are
+         * zeroed. The last field of the first version is the minimum. */
+        memcpy(ret, &s->statistics, MIN(size, sizeof(s->statistics)));
+        if (size > sizeof(s->statistics))
+                memzero((uint8_t*) ret + sizeof(s->statistics), size - sizeof(s->statistics));
+
+        return 0;
+}
+
+_public_ int sd_event_source_is_ratelimited(sd_event_source *s) {
+        assert_return(s, -EINVAL);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        return s->ratelimited;
+}
+
+sd_event_source *event_source_next(sd_event *e, sd_event_source *s) {
+        assert(e);
+
+        /* Iterates through all event sources attached to the event loop, starting with s == NULL */
+        return s ? s->sources_next : e->sources;
+}
+
+const char *event_source_type_name(sd_event_source *s) {
+        assert(s);
+
+        return event_source_type_to_string(s->type);
+}
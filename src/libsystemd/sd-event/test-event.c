@@ -1,11 +1,14 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <sys/eventfd.h>
 #include <sys/wait.h>
 
 #include "sd-event.h"
 
 #include "alloc-util.h"
+#include "event-util.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "fs-util.h"
 #include "log.h"
 #include "macro.h"
@@ -13,6 +16,7 @@
 #include "parse-util.h"
 #include "path-util.h"
 #include "process-util.h"
+#include "rlimit-util.h"
 #include "rm-rf.h"
 #include "signal-util.h"
 #include "stdio-util.h"
@@ -339,6 +343,9 @@ static void test_rtqueue(void) {
         sd_event_source *u = NULL, *v = NULL, *s = NULL;
         sd_event *e = NULL;
 
+        n_rtqueue = 0;
+        last_rtqueue_sigval = 0;
+
         assert_se(sd_event_default(&e) >= 0);
 
         assert_se(sigprocmask_many(SIG_BLOCK, NULL, SIGRTMIN+2, SIGRTMIN+3, SIGUSR2, -1) >= 0);
@@ -590,9 +597,627 @@ static void test_pidfd(void) {
         sd_event_unref(e);
 }
 
-int main(int argc, char *argv[]) {
-        test_setup_logging(LOG_INFO);
+static int ratelimit_io_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        unsigned *c = userdata;
+
+        /* Leave the pipe readable, so that we are called again right away */
+        (*c)++;
+        return 0;
+}
+
+static int ratelimit_time_handler(sd_event_source *s, uint64_t usec, void *userdata) {
+        unsigned *c = userdata;
+
+        /* Rearm for right away */
+        assert_se(sd_event_source_set_time(s, usec) >= 0);
+        assert_se(sd_event_source_set_enabled(s, SD_EVENT_ON) >= 0);
+
+        (*c)++;
+        return 0;
+}
+
+static void test_ratelimit(void) {
+        _cleanup_close_pair_ int p[2] = { -1, -1 };
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        sd_event_source *s = NULL, *t = NULL;
+        uint64_t interval;
+        unsigned count, burst, i;
+        usec_t t0, t1;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(pipe2(p, O_CLOEXEC|O_NONBLOCK) >= 0);
+
+        assert_se(sd_event_add_io(e, &s, p[0], EPOLLIN, ratelimit_io_handler, &count) >= 0);
+        assert_se(sd_event_source_set_description(s, "test-ratelimit-io") >= 0);
+        assert_se(sd_event_source_get_ratelimit(s, NULL, NULL) == -ENOEXEC);
+        assert_se(sd_event_source_set_ratelimit(s, USEC_PER_HOUR, 5) >= 0);
+        assert_se(sd_event_source_get_ratelimit(s, &interval, &burst) >= 0);
+        assert_se(interval == USEC_PER_HOUR && burst == 5);
+
+        assert_se(write(p[1], "1", 1) == 1);
+
+        /* The interval is long enough for all of the following to happen within it. Up to the burst, the
+         * source is never throttled. The interval begins with the first dispatch. */
+        count = 0;
+        t0 = now(CLOCK_MONOTONIC);
+        for (i = 0; i < 5; i++)
+                assert_se(sd_event_run(e, (uint64_t) -1) > 0);
+        t1 = now(CLOCK_MONOTONIC);
+        assert_se(count == 5);
+        assert_se(sd_event_source_is_ratelimited(s) == 0);
+
+        /* The sixth dispatch throttles it, and nothing happens until the interval is over */
+        assert_se(sd_event_run(e, (uint64_t) -1) > 0);
+        assert_se(count == 5);
+        assert_se(sd_event_source_is_ratelimited(s) > 0);
+        assert_se(sd_event_run(e, 0) == 0);
+
+        /* Add a timer that elapses just before the interval ends, but may be dispatched after that, so
+         * that the earliest and latest queues of CLOCK_MONOTONIC disagree on which source comes first */
+        assert_se(t1 - t0 < 100 * USEC_PER_MSEC);
+        assert_se(sd_event_add_time(e, &t, CLOCK_MONOTONIC, t0 + USEC_PER_HOUR - 1, t1 - t0 + 2,
+                                    ratelimit_time_handler, &count) >= 0);
+
+        /* Turning the source off and on again while it is throttled must keep the queues in order */
+        for (i = 0; i < 3; i++) {
+                assert_se(sd_event_source_set_enabled(s, SD_EVENT_OFF) >= 0);
+                assert_se(sd_event_run(e, 0) == 0);
+                assert_se(sd_event_source_is_ratelimited(s) > 0);
+
+                assert_se(sd_event_source_set_enabled(s, SD_EVENT_ON) >= 0);
+                assert_se(sd_event_run(e, 0) == 0);
+                assert_se(sd_event_source_is_ratelimited(s) > 0);
+        }
+        assert_se(count == 5);
+
+        t = sd_event_source_unref(t);
+
+        /* Setting the rate limit again starts afresh, and takes the source online right away */
+        assert_se(sd_event_source_set_ratelimit(s, USEC_PER_HOUR, 5) >= 0);
+        assert_se(sd_event_source_is_ratelimited(s) == 0);
+        assert_se(sd_event_run(e, (uint64_t) -1) > 0);
+        assert_se(count == 6);
+
+        /* With a short interval, the source is dispatched again once it is over. However long the dispatches
+         * take, the source is throttled eventually, and stays quiet until then. */
+        assert_se(sd_event_source_set_ratelimit(s, 100 * USEC_PER_MSEC, 5) >= 0);
+        while (sd_event_source_is_ratelimited(s) == 0)
+                assert_se(sd_event_run(e, (uint64_t) -1) > 0);
+        count = 0;
+        assert_se(sd_event_run(e, 0) == 0);
+        assert_se(count == 0);
+        assert_se(sd_event_run(e, (uint64_t) -1) > 0);
+        assert_se(count == 1);
+        assert_se(sd_event_source_is_ratelimited(s) == 0);
+
+        s = sd_event_source_unref(s);
+
+        /* Same for timer event sources, exact ones and ones kept in the timer wheel */
+        assert_se(sd_event_add_time(e, &s, CLOCK_MONOTONIC, 0, 1, ratelimit_time_handler, &count) >= 0);
+
+        for (unsigned j = 0; j < 2; j++) {
+                assert_se(sd_event_source_set_time_accuracy(s, j ? 0 : 1) >= 0);
+                assert_se(sd_event_source_set_ratelimit(s, USEC_PER_HOUR, 5) >= 0);
+
+                count = 0;
+                for (i = 0; i < 6; i++)
+                        assert_se(sd_event_run(e, (uint64_t) -1) > 0);
+                assert_se(count == 5);
+                assert_se(sd_event_source_is_ratelimited(s) > 0);
+                assert_se(sd_event_run(e, 0) == 0);
+
+                assert_se(sd_event_source_set_enabled(s, SD_EVENT_OFF) >= 0);
+                assert_se(sd_event_run(e, 0) == 0);
+                assert_se(sd_event_source_set_enabled(s, SD_EVENT_ON) >= 0);
+                assert_se(sd_event_run(e, 0) == 0);
+                assert_se(count == 5);
+
+                assert_se(sd_event_source_set_ratelimit(s, 100 * USEC_PER_MSEC, 5) >= 0);
+                while (sd_event_source_is_ratelimited(s) == 0)
+                        assert_se(sd_event_run(e, (uint64_t) -1) > 0);
+                count = 0;
+                assert_se(sd_event_run(e, 0) == 0);
+                assert_se(count == 0);
+                assert_se(sd_event_run(e, (uint64_t) -1) > 0);
+                assert_se(count == 1);
+                assert_se(sd_event_source_is_ratelimited(s) == 0);
+        }
+
+        /* A burst of zero turns rate limiting off */
+        assert_se(sd_event_source_set_ratelimit(s, 100 * USEC_PER_MSEC, 0) >= 0);
+        assert_se(sd_event_source_get_ratelimit(s, NULL, NULL) == -ENOEXEC);
+
+        s = sd_event_source_unref(s);
+
+        /* Sources that can't be throttled */
+        assert_se(sd_event_add_exit(e, &s, exit_handler, INT_TO_PTR('r')) >= 0);
+        assert_se(sd_event_source_set_ratelimit(s, 100 * USEC_PER_MSEC, 5) == -EDOM);
+        assert_se(sd_event_source_get_ratelimit(s, NULL, NULL) == -EDOM);
+        assert_se(sd_event_source_is_ratelimited(s) == 0);
+        s = sd_event_source_unref(s);
+}
+
+static int statistics_handler(sd_event_source *s, void *userdata) {
+        usec_t *sleep_usec = userdata;
+
+        assert_se(usleep(*sleep_usec) >= 0);
+        return sd_event_source_set_enabled(s, SD_EVENT_OFF);
+}
+
+static void test_statistics(void) {
+        _cleanup_(sd_event_source_unrefp) sd_event_source *slow = NULL, *fast = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        _cleanup_free_ char *dump = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        usec_t slow_usec = 20 * USEC_PER_MSEC, fast_usec = 0;
+        sd_event_source_statistics st;
+        struct {
+                sd_event_source_statistics st;
+                uint64_t later;
+        } bigger;
+        size_t size;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        assert_se(sd_event_add_defer(e, &slow, statistics_handler, &slow_usec) >= 0);
+        assert_se(sd_event_source_set_description(slow, "slow") >= 0);
+        assert_se(sd_event_source_set_priority(slow, SD_EVENT_PRIORITY_IMPORTANT) >= 0);
+        assert_se(sd_event_add_defer(e, &fast, statistics_handler, &fast_usec) >= 0);
+        assert_se(sd_event_source_set_description(fast, "fast") >= 0);
+
+        assert_se(sd_event_source_get_statistics(slow, &st, sizeof(st)) >= 0);
+        assert_se(st.n_dispatched == 0 && st.dispatch_usec == 0 && st.pending_usec == 0);
+
+        /* The slow source is dispatched first, the fast one has to wait for it */
+        assert_se(sd_event_run(e, 0) > 0);
+        assert_se(sd_event_run(e, 0) > 0);
+        assert_se(sd_event_run(e, 0) == 0);
+
+        assert_se(sd_event_source_get_statistics(slow, &st, sizeof(st)) >= 0);
+        assert_se(st.n_dispatched == 1);
+        assert_se(st.dispatch_usec >= slow_usec);
+        assert_se(st.dispatch_max_usec == st.dispatch_usec);
+
+        assert_se(sd_event_source_get_statistics(fast, &st, sizeof(st)) >= 0);
+        assert_se(st.n_dispatched == 1);
+        assert_se(st.dispatch_usec < slow_usec);
+        assert_se(st.pending_usec >= slow_usec);
+        assert_se(st.pending_max_usec == st.pending_usec);
+
+        /* Callers built against a later version of the structure get the fields we don't know about
+         * zeroed, sizes below the first version are refused */
+        bigger.later = UINT64_MAX;
+        assert_se(sd_event_source_get_statistics(fast, &bigger.st, sizeof(bigger)) >= 0);
+        assert_se(bigger.st.n_dispatched == 1 && bigger.later == 0);
+        assert_se(sd_event_source_get_statistics(fast, &st, sizeof(uint64_t)) == -EINVAL);
+
+        /* The dump lists the most expensive source first */
+        assert_se(f = open_memstream_unlocked(&dump, &size));
+        assert_se(event_dump_sources(e, f, NULL) >= 0);
+        assert_se(fflush_and_check(f) >= 0);
+        log_debug("%s", dump);
+        assert_se(strstr(dump, "-> Event Source slow:"));
+        assert_se(strstr(dump, "-> Event Source slow:") < strstr(dump, "-> Event Source fast:"));
+}
 
+#define N_WORK 6
+
+typedef struct WorkTest {
+        pid_t loop_tid;
+        pid_t work_tid[N_WORK];
+        unsigned n_done;
+} WorkTest;
+
+static WorkTest work_test;
+
+static int work_handler(void *userdata) {
+        unsigned i = PTR_TO_UINT(userdata);
+
+        work_test.work_tid[i] = gettid();
+        assert_se(usleep(10 * USEC_PER_MSEC) >= 0);
+
+        return i == 0 ? -EBADMSG : (int) i;
+}
+
+static int work_done_handler(sd_event_source *s, int result, void *userdata) {
+        unsigned i = PTR_TO_UINT(userdata);
+
+        /* Results are delivered on the thread running the loop */
+        assert_se(gettid() == work_test.loop_tid);
+        assert_se(work_test.work_tid[i] > 0);
+        assert_se(work_test.work_tid[i] != work_test.loop_tid);
+        assert_se(result == (i == 0 ? -EBADMSG : (int) i));
+
+        work_test.n_done++;
+        return 0;
+}
+
+static void test_work(void) {
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        sd_event_source *s[N_WORK], *abandoned;
+        unsigned i;
+        pid_t pid;
+        int enabled;
+
+        log_info("/* %s */", __func__);
+
+        work_test = (WorkTest) {
+                .loop_tid = gettid(),
+        };
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        assert_se(sd_event_add_work(e, NULL, NULL, work_done_handler, NULL) == -EINVAL);
+        assert_se(sd_event_add_work(e, NULL, work_handler, NULL, NULL) == -EINVAL);
+
+        for (i = 0; i < N_WORK; i++)
+                assert_se(sd_event_add_work(e, &s[i], work_handler, work_done_handler, UINT_TO_PTR(i)) >= 0);
+
+        /* Nothing is dispatched before the work is done, however long that takes */
+        assert_se(sd_event_source_get_enabled(s[0], &enabled) > 0);
+        assert_se(enabled == SD_EVENT_ONESHOT);
+        assert_se(sd_event_source_set_enabled(s[1], SD_EVENT_OFF) >= 0);
+
+        while (work_test.n_done < N_WORK - 1)
+                assert_se(sd_event_run(e, UINT64_MAX) >= 0);
+
+        /* Disabling the source keeps the result around, until it is enabled again */
+        assert_se(sd_event_run(e, 0) == 0);
+        assert_se(sd_event_source_set_enabled(s[1], SD_EVENT_ONESHOT) >= 0);
+        assert_se(sd_event_run(e, 0) > 0);
+        assert_se(work_test.n_done == N_WORK);
+
+        for (i = 0; i < N_WORK; i++)
+                sd_event_source_unref(s[i]);
+
+        /* Sources may go away while their work is queued or running, the event loop waits for it when
+         * freed */
+        assert_se(sd_event_add_work(e, &abandoned, work_handler, work_done_handler, UINT_TO_PTR(1)) >= 0);
+        abandoned = sd_event_source_unref(abandoned);
+        assert_se(sd_event_add_work(e, NULL, work_handler, work_done_handler, UINT_TO_PTR(2)) >= 0);
+
+        /* A forked off child has none of the worker threads, it must not wait for them */
+        pid = fork();
+        assert_se(pid >= 0);
+        if (pid == 0) {
+                e = sd_event_unref(e);
+                _exit(EXIT_SUCCESS);
+        }
+
+        assert_se(wait_for_terminate_and_check("work-child", pid, WAIT_LOG) == EXIT_SUCCESS);
+}
+
+static int budget_defer_handler(sd_event_source *s, void *userdata) {
+        unsigned *c = userdata;
+
+        (*c)++;
+        return 0;
+}
+
+static void test_dispatch_budget(void) {
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        sd_event_source *s[3], *t;
+        unsigned count, budget, i;
+        size_t n;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        assert_se(sd_event_get_dispatch_budget(e, &budget) >= 0);
+        assert_se(budget == 1);
+        assert_se(sd_event_set_dispatch_budget(e, 0) == -EINVAL);
+
+        /* Defer sources are oneshot by default, hence each of them is dispatched exactly once */
+        for (i = 0; i < ELEMENTSOF(s); i++)
+                assert_se(sd_event_add_defer(e, &s[i], budget_defer_handler, &count) >= 0);
+
+        count = 0;
+        assert_se(sd_event_run(e, 0) > 0);
+        assert_se(count == 1);
+
+        assert_se(sd_event_set_dispatch_budget(e, 10) >= 0);
+        count = 0;
+        assert_se(sd_event_run(e, 0) > 0);
+        assert_se(count == 2);
+        assert_se(sd_event_run(e, 0) == 0);
+
+        /* A source that stays pending ends the iteration when we get to it again, so that it doesn't get
+         * dispatched over and over, nor do sources of lower priority get dispatched before it */
+        assert_se(sd_event_add_defer(e, &t, budget_defer_handler, &count) >= 0);
+        assert_se(sd_event_source_set_enabled(t, SD_EVENT_ON) >= 0);
+        assert_se(sd_event_source_set_priority(t, SD_EVENT_PRIORITY_IMPORTANT) >= 0);
+        assert_se(sd_event_source_set_enabled(s[0], SD_EVENT_ONESHOT) >= 0);
+
+        count = 0;
+        assert_se(sd_event_run(e, 0) > 0);
+        assert_se(count == 1);
+        assert_se(sd_event_source_get_enabled(s[0], NULL) > 0);
+
+        assert_se(sd_event_get_event_queue_max(e, &n) >= 0);
+        assert_se(n == 4);
+        assert_se(sd_event_set_event_queue_max(e, 1) >= 0);
+        assert_se(sd_event_get_event_queue_max(e, &n) >= 0);
+        assert_se(n == 1);
+
+        for (i = 0; i < ELEMENTSOF(s); i++)
+                sd_event_source_unref(s[i]);
+        sd_event_source_unref(t);
+}
+
+static int benchmark_io_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        uint64_t *c = userdata;
+
+        /* Don't read the eventfd, so that it stays ready, like a busy source would */
+        (*c)++;
+        return 0;
+}
+
+static void test_dispatch_benchmark(void) {
+        static const struct {
+                unsigned budget;
+                size_t event_queue_max;
+        } params[] = {
+                { 1,        0    },
+                { 16,       0    },
+                { 256,      0    },
+                { 256,      256  },
+                { 4096,     0    },
+                { UINT_MAX, 0    },
+        };
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        _cleanup_free_ sd_event_source **s = NULL;
+        unsigned n_sources = 10000, i;
+        uint64_t count;
+        usec_t duration;
+        struct rlimit rl;
+
+        log_info("/* %s */", __func__);
+
+        (void) rlimit_nofile_bump(-1);
+        assert_se(getrlimit(RLIMIT_NOFILE, &rl) >= 0);
+        if (rl.rlim_cur < n_sources + 64) {
+                log_notice("RLIMIT_NOFILE too low for %u fds, skipping benchmark.", n_sources);
+                return;
+        }
+
+        duration = slow_tests_enabled() ? 2 * USEC_PER_SEC : USEC_PER_SEC / 10;
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        s = new0(sd_event_source*, n_sources);
+        assert_se(s);
+
+        for (i = 0; i < n_sources; i++) {
+                int fd;
+
+                fd = eventfd(1, EFD_CLOEXEC|EFD_NONBLOCK);
+                assert_se(fd >= 0);
+
+                assert_se(sd_event_add_io(e, &s[i], fd, EPOLLIN, benchmark_io_handler, &count) >= 0);
+                assert_se(sd_event_source_set_io_fd_own(s[i], true) >= 0);
+        }
+
+        for (i = 0; i < ELEMENTSOF(params); i++) {
+                usec_t n, t;
+                uint64_t k;
+
+                assert_se(sd_event_set_dispatch_budget(e, params[i].budget) >= 0);
+                assert_se(sd_event_set_event_queue_max(e, params[i].event_queue_max) >= 0);
+
+                count = 0;
+                n = now(CLOCK_MONOTONIC);
+                for (k = 0, t = n; t < n + duration; k++, t = now(CLOCK_MONOTONIC))
+                        assert_se(sd_event_run(e, 0) > 0);
+
+                log_info("budget %10u, event queue %5zu: %8"PRIu64" iterations, %10.0f dispatches/s",
+                         params[i].budget, params[i].event_queue_max, k,
+                         (double) count / ((double) (t - n) / USEC_PER_SEC));
+        }
+
+        for (i = 0; i < n_sources; i++)
+                sd_event_source_unref(s[i]);
+}
+
+static int timer_wheel_handler(sd_event_source *s, uint64_t usec, void *userdata) {
+        unsigned *c = userdata;
+        usec_t n;
+
+        /* Never early, regardless of where the source is queued */
+        assert_se(sd_event_now(sd_event_source_get_event(s), CLOCK_MONOTONIC, &n) >= 0);
+        assert_se(n >= usec);
+
+        (*c)++;
+        return 0;
+}
+
+static void test_timer_wheel(void) {
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        sd_event_source *s[64] = {};
+        unsigned count = 0, i;
+        usec_t n;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(sd_event_now(e, CLOCK_MONOTONIC, &n) >= 0);
+
+        /* Odd sources are exact and go into the prioqs, even ones have the default accuracy and go into the
+         * timer wheel. Move some of each to the other side. */
+        for (i = 0; i < ELEMENTSOF(s); i++) {
+                assert_se(sd_event_add_time(e, &s[i], CLOCK_MONOTONIC, n + (i * 7 % 64) * 2 * USEC_PER_MSEC,
+                                            i % 2 ? 1 : 0, timer_wheel_handler, &count) >= 0);
+
+                if (i % 4 == 0)
+                        assert_se(sd_event_source_set_time_accuracy(s[i], i % 8 ? 500 * USEC_PER_MSEC : 1) >= 0);
+                else if (i % 4 == 1)
+                        assert_se(sd_event_source_set_time_accuracy(s[i], 300 * USEC_PER_MSEC) >= 0);
+        }
+
+        /* One is elapsed already, one is turned off, one is moved */
+        assert_se(sd_event_source_set_time(s[10], 1) >= 0);
+        assert_se(sd_event_source_set_enabled(s[20], SD_EVENT_OFF) >= 0);
+        assert_se(sd_event_source_set_time(s[30], n + 200 * USEC_PER_MSEC) >= 0);
+
+        while (count < ELEMENTSOF(s) - 1)
+                assert_se(sd_event_run(e, (uint64_t) -1) > 0);
+
+        assert_se(sd_event_run(e, 0) == 0);
+        assert_se(count == ELEMENTSOF(s) - 1);
+
+        for (i = 0; i < ELEMENTSOF(s); i++)
+                sd_event_source_unref(s[i]);
+}
+
+static int timer_benchmark_handler(sd_event_source *s, uint64_t usec, void *userdata) {
+        return 0;
+}
+
+static void test_timer_benchmark(void) {
+        /* Exact timers are kept in the prioqs, ones with the default accuracy in the timer wheel */
+        static const uint64_t accuracies[] = { 1, 0 };
+        _cleanup_free_ sd_event_source **s = NULL;
+        unsigned n_sources = 100000, i, j;
+        usec_t duration;
+
+        log_info("/* %s */", __func__);
+
+        duration = slow_tests_enabled() ? 2 * USEC_PER_SEC : USEC_PER_SEC / 10;
+
+        s = new(sd_event_source*, n_sources);
+        assert_se(s);
+
+        for (i = 0; i < ELEMENTSOF(accuracies); i++) {
+                _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+                usec_t n, t1, t2, t;
+                uint64_t k;
+
+                srand(0);
+
+                assert_se(sd_event_new(&e) >= 0);
+
+                /* Set up a lot of timers somewhere in the next hour */
+                n = now(CLOCK_MONOTONIC);
+                for (j = 0; j < n_sources; j++)
+                        assert_se(sd_event_add_time(e, &s[j], CLOCK_MONOTONIC,
+                                                    n + USEC_PER_MINUTE + (usec_t) rand() * USEC_PER_HOUR / RAND_MAX,
+                                                    accuracies[i], timer_benchmark_handler, NULL) >= 0);
+                t1 = now(CLOCK_MONOTONIC);
+
+                /* Then keep moving them around, with an event loop iteration every now and then */
+                for (k = 0, t = t1; t < t1 + duration; k++) {
+                        assert_se(sd_event_source_set_time(s[rand() % n_sources],
+                                                           t + USEC_PER_MINUTE + (usec_t) rand() * USEC_PER_HOUR / RAND_MAX) >= 0);
+
+                        if (k % 64 == 0) {
+                                assert_se(sd_event_run(e, 0) >= 0);
+                                t = now(CLOCK_MONOTONIC);
+                        }
+                }
+
+                t2 = now(CLOCK_MONOTONIC);
+                for (j = 0; j < n_sources; j++)
+                        sd_event_source_unref(s[j]);
+
+                log_info("%-6s %10.0f adds/s, %10.0f reschedules/s, %10.0f removals/s",
+                         accuracies[i] == 1 ? "prioq" : "wheel",
+                         (double) n_sources / ((double) (t1 - n) / USEC_PER_SEC),
+                         (double) k / ((double) (t - t1) / USEC_PER_SEC),
+                         (double) n_sources / ((double) (now(CLOCK_MONOTONIC) - t2) / USEC_PER_SEC));
+        }
+}
+
+static bool use_io_uring(bool b) {
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        _cleanup_free_ char *p = NULL, *target = NULL;
+
+        assert_se(setenv("SD_EVENT_IO_URING", one_zero(b), 1) >= 0);
+
+        /* Check what we actually got, sd_event_new() falls back to epoll silently */
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(asprintf(&p, "/proc/self/fd/%i", sd_event_get_fd(e)) >= 0);
+        assert_se(readlink_malloc(p, &target) >= 0);
+
+        return streq(target, "anon_inode:[io_uring]");
+}
+
+typedef struct BackendBenchmark {
+        int fds[1000];
+        uint64_t count;
+        bool oneshot;
+} BackendBenchmark;
+
+static int backend_benchmark_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        BackendBenchmark *b = userdata;
+        uint64_t v;
+
+        /* Pass the token on to the next fd */
+        assert_se(read(fd, &v, sizeof(v)) == sizeof(v));
+        b->count++;
+        assert_se(eventfd_write(b->fds[b->count % ELEMENTSOF(b->fds)], 1) >= 0);
+
+        /* Changes the set of watched fds each time */
+        if (b->oneshot)
+                assert_se(sd_event_source_set_enabled(s, SD_EVENT_ONESHOT) >= 0);
+
+        return 0;
+}
+
+static void test_backend_benchmark(void) {
+        BackendBenchmark b;
+        usec_t duration;
+        unsigned i, j, k;
+
+        log_info("/* %s */", __func__);
+
+        duration = slow_tests_enabled() ? 2 * USEC_PER_SEC : USEC_PER_SEC / 10;
+
+        for (i = 0; i < 2; i++)
+                for (j = 0; j < 2; j++) {
+                        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+                        usec_t n, t;
+
+                        if (use_io_uring(i) != i) {
+                                log_notice("io_uring not available, skipping.");
+                                continue;
+                        }
+
+                        assert_se(sd_event_new(&e) >= 0);
+
+                        b = (BackendBenchmark) {
+                                .oneshot = j,
+                        };
+
+                        for (k = 0; k < ELEMENTSOF(b.fds); k++) {
+                                sd_event_source *s;
+
+                                b.fds[k] = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+                                assert_se(b.fds[k] >= 0);
+
+                                assert_se(sd_event_add_io(e, &s, b.fds[k], EPOLLIN, backend_benchmark_handler, &b) >= 0);
+                                assert_se(sd_event_source_set_io_fd_own(s, true) >= 0);
+                                assert_se(sd_event_source_set_enabled(s, b.oneshot ? SD_EVENT_ONESHOT : SD_EVENT_ON) >= 0);
+                                assert_se(sd_event_source_set_floating(s, true) >= 0);
+                                sd_event_source_unref(s);
+                        }
+
+                        assert_se(eventfd_write(b.fds[0], 1) >= 0);
+
+                        n = now(CLOCK_MONOTONIC);
+                        for (t = n; t < n + duration; t = now(CLOCK_MONOTONIC))
+                                assert_se(sd_event_run(e, (uint64_t) -1) > 0);
+
+                        log_info("%-8s %-8s %10.0f dispatches/s",
+                                 i ? "io_uring" : "epoll", b.oneshot ? "oneshot" : "on",
+                                 (double) b.count / ((double) (t - n) / USEC_PER_SEC));
+                }
+}
+
+static void run_tests(void) {
         test_basic(true);   /* test with pidfd */
         test_basic(false);  /* test without pidfd */
 
@@ -604,5 +1229,29 @@ int main(int argc, char *argv[]) {
 
         test_pidfd();
 
+        test_ratelimit();
+        test_timer_wheel();
+        test_statistics();
+        test_work();
+
+        test_dispatch_budget();
+        test_dispatch_benchmark();
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        assert_se(!use_io_uring(false));
+        run_tests();
+
+        if (use_io_uring(true)) {
+                log_info("/* Running again with io_uring */");
+                run_tests();
+        } else
+                log_notice("io_uring not available, not running tests with it.");
+
+        test_backend_benchmark();
+        test_timer_benchmark();
+
         return 0;
 }
@@ -252,49 +252,73 @@ static int parse_line(
                                userdata);
 }
 
-/* Go through the file and parse each line */
-int config_parse(const char *unit,
-                 const char *filename,
-                 FILE *f,
-                 const char *sections,
-                 ConfigItemLookup lookup,
-                 const void *table,
-                 ConfigParseFlags flags,
-                 void *userdata,
-                 usec_t *ret_mtime) {
+ConfigFile *config_file_free(ConfigFile *c) {
+        size_t i;
+
+        if (!c)
+                return NULL;
+
+        for (i = 0; i < c->n_lines; i++)
+                free(c->lines[i].text);
+
+        free(c->lines);
+        free(c->filename);
+        return mfree(c);
+}
+
+static int config_file_add_line(ConfigFile *c, size_t *n_allocated, unsigned line, char *text) {
+        assert(c);
+        assert(n_allocated);
+
+        if (!text)
+                return -ENOMEM;
 
-        _cleanup_free_ char *section = NULL, *continuation = NULL;
+        if (!GREEDY_REALLOC(c->lines, *n_allocated, c->n_lines + 1)) {
+                free(text);
+                return -ENOMEM;
+        }
+
+        c->lines[c->n_lines++] = (ConfigLine) {
+                .line = line,
+                .text = text,
+        };
+
+        return 0;
+}
+
+/* Read the file and split it into logical lines */
+int config_file_read(const char *filename, FILE *f, ConfigFile **ret) {
+        _cleanup_(config_file_freep) ConfigFile *c = NULL;
+        _cleanup_free_ char *continuation = NULL;
         _cleanup_fclose_ FILE *ours = NULL;
-        unsigned line = 0, section_line = 0;
-        bool section_ignored = false, bom_seen = false;
+        size_t n_allocated = 0;
+        unsigned line = 0;
+        bool bom_seen = false;
         int r, fd;
-        usec_t mtime;
 
         assert(filename);
-        assert(lookup);
+        assert(ret);
+
+        c = new0(ConfigFile, 1);
+        if (!c)
+                return -ENOMEM;
+
+        c->filename = strdup(filename);
+        if (!c->filename)
+                return -ENOMEM;
 
         if (!f) {
                 f = ours = fopen(filename, "re");
-                if (!f) {
-                        /* Only log on request, except for ENOENT,
-                         * since we return 0 to the caller. */
-                        if ((flags & CONFIG_PARSE_WARN) || errno == ENOENT)
-                                log_full_errno(errno == ENOENT ? LOG_DEBUG : LOG_ERR, errno,
-                                               "Failed to open configuration file '%s': %m", filename);
-                        return errno == ENOENT ? 0 : -errno;
-                }
+                if (!f)
+                        return -errno;
         }
 
         fd = fileno(f);
         if (fd >= 0) { /* stream might not have an fd, let's be careful hence */
-                struct stat st;
+                if (fstat(fd, &c->st) < 0)
+                        return -errno;
 
-                if (fstat(fd, &st) < 0)
-                        return log_full_errno(FLAGS_SET(flags, CONFIG_PARSE_WARN) ? LOG_ERR : LOG_DEBUG, errno,
-                                              "Failed to fstat(%s): %m", filename);
-
-                (void) stat_warn_permissions(filename, &st);
-                mtime = timespec_load(&st.st_mtim);
+                c->have_stat = true;
         }
 
         for (;;) {
@@ -305,17 +329,10 @@ int config_parse(const char *unit,
                 r = read_line(f, LONG_LINE_MAX, &buf);
                 if (r == 0)
                         break;
-                if (r == -ENOBUFS) {
-                        if (flags & CONFIG_PARSE_WARN)
-                                log_error_errno(r, "%s:%u: Line too long", filename, line);
-
-                        return r;
-                }
                 if (r < 0) {
-                        if (FLAGS_SET(flags, CONFIG_PARSE_WARN))
-                                log_error_errno(r, "%s:%u: Error while reading configuration file: %m", filename, line);
-
-                        return r;
+                        c->read_error = r;
+                        c->read_error_line = line;
+                        goto finish;
                 }
 
                 line++;
@@ -337,16 +354,14 @@ int config_parse(const char *unit,
 
                 if (continuation) {
                         if (strlen(continuation) + strlen(l) > LONG_LINE_MAX) {
-                                if (flags & CONFIG_PARSE_WARN)
-                                        log_error("%s:%u: Continuation line too long", filename, line);
-                                return -ENOBUFS;
+                                c->read_error = -ENOBUFS;
+                                c->read_error_line = line;
+                                c->read_error_continuation = true;
+                                goto finish;
                         }
 
-                        if (!strextend(&continuation, l, NULL)) {
-                                if (flags & CONFIG_PARSE_WARN)
-                                        log_oom();
+                        if (!strextend(&continuation, l, NULL))
                                 return -ENOMEM;
-                        }
 
                         p = continuation;
                 } else
@@ -364,41 +379,69 @@ int config_parse(const char *unit,
 
                         if (!continuation) {
                                 continuation = strdup(l);
-                                if (!continuation) {
-                                        if (flags & CONFIG_PARSE_WARN)
-                                                log_oom();
+                                if (!continuation)
                                         return -ENOMEM;
-                                }
                         }
 
                         continue;
                 }
 
-                r = parse_line(unit,
-                               filename,
-                               line,
-                               sections,
-                               lookup,
-                               table,
-                               flags,
-                               &section,
-                               &section_line,
-                               &section_ignored,
-                               p,
-                               userdata);
-                if (r < 0) {
-                        if (flags & CONFIG_PARSE_WARN)
-                                log_warning_errno(r, "%s:%u: Failed to parse file: %m", filename, line);
+                r = config_file_add_line(c, &n_allocated, line,
+                                         continuation ? TAKE_PTR(continuation) :
+                                         p == buf ? TAKE_PTR(buf) : strdup(p));
+                if (r < 0)
                         return r;
-                }
-
-                continuation = mfree(continuation);
         }
 
         if (continuation) {
+                r = config_file_add_line(c, &n_allocated, ++line, TAKE_PTR(continuation));
+                if (r < 0)
+                        return r;
+        }
+
+finish:
+        *ret = TAKE_PTR(c);
+        return 0;
+}
+
+/* Parse each line of a file read before */
+int config_parse_file(
+                const char *unit,
+                const ConfigFile *c,
+                const char *sections,
+                ConfigItemLookup lookup,
+                const void *table,
+                ConfigParseFlags flags,
+                void *userdata,
+                usec_t *ret_mtime) {
+
+        _cleanup_free_ char *section = NULL, *buf = NULL;
+        unsigned section_line = 0;
+        bool section_ignored = false;
+        size_t i, n_allocated = 0;
+        int r;
+
+        assert(c);
+        assert(lookup);
+
+        if (c->have_stat)
+                (void) stat_warn_permissions(c->filename, &c->st);
+
+        for (i = 0; i < c->n_lines; i++) {
+                size_t n;
+
+                /* parse_line() modifies the line, hence work on a copy and leave the file untouched */
+                n = strlen(c->lines[i].text) + 1;
+                if (!GREEDY_REALLOC(buf, n_allocated, n)) {
+                        if (flags & CONFIG_PARSE_WARN)
+                                log_oom();
+                        return -ENOMEM;
+                }
+                memcpy(buf, c->lines[i].text, n);
+
                 r = parse_line(unit,
-                               filename,
-                               ++line,
+                               c->filename,
+                               c->lines[i].line,
                                sections,
                                lookup,
                                table,
@@ -406,21 +449,78 @@ int config_parse(const char *unit,
                                &section,
                                &section_line,
                                &section_ignored,
-                               continuation,
+                               buf,
                                userdata);
                 if (r < 0) {
                         if (flags & CONFIG_PARSE_WARN)
-                                log_warning_errno(r, "%s:%u: Failed to parse file: %m", filename, line);
+                                log_warning_errno(r, "%s:%u: Failed to parse file: %m", c->filename, c->lines[i].line);
                         return r;
                 }
         }
 
+        if (c->read_error < 0) {
+                if (flags & CONFIG_PARSE_WARN) {
+                        if (c->read_error_continuation)
+                                log_error("%s:%u: Continuation line too long", c->filename, c->read_error_line);
+                        else if (c->read_error == -ENOBUFS)
+                                log_error_errno(c->read_error, "%s:%u: Line too long", c->filename, c->read_error_line);
+                        else
+                                log_error_errno(c->read_error, "%s:%u: Error while reading configuration file: %m",
+                                                c->filename, c->read_error_line);
+                }
+
+                return c->read_error;
+        }
+
         if (ret_mtime)
-                *ret_mtime = mtime;
+                *ret_mtime = c->have_stat ? timespec_load(&c->st.st_mtim) : 0;
 
         return 0;
 }
 
+/* Go through the file and parse each line */
+int config_parse(const char *unit,
+                 const char *filename,
+                 FILE *f,
+                 const char *sections,
+                 ConfigItemLookup lookup,
+                 const void *table,
+                 ConfigParseFlags flags,
+                 void *userdata,
+                 usec_t *ret_mtime) {
+
+        _cleanup_(config_file_freep) ConfigFile *c = NULL;
+        _cleanup_fclose_ FILE *ours = NULL;
+        int r;
+
+        assert(filename);
+        assert(lookup);
+
+        if (!f) {
+                f = ours = fopen(filename, "re");
+                if (!f) {
+                        /* Only log on request, except for ENOENT,
+                         * since we return 0 to the caller. */
+                        if ((flags & CONFIG_PARSE_WARN) || errno == ENOENT)
+                                log_full_errno(errno == ENOENT ? LOG_DEBUG : LOG_ERR, errno,
+                                               "Failed to open configuration file '%s': %m", filename);
+                        return errno == ENOENT ? 0 : -errno;
+                }
+        }
+
+        r = config_file_read(filename, f, &c);
+        if (r == -ENOMEM) {
+                if (flags & CONFIG_PARSE_WARN)
+                        log_oom();
+                return r;
+        }
+        if (r < 0)
+                return log_full_errno(FLAGS_SET(flags, CONFIG_PARSE_WARN) ? LOG_ERR : LOG_DEBUG, r,
+                                      "Failed to fstat(%s): %m", filename);
+
+        return config_parse_file(unit, c, sections, lookup, table, flags, userdata, ret_mtime);
+}
+
 static int config_parse_many_files(
                 const char *conf_file,
                 char **files,
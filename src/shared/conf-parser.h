@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <syslog.h>
 
 #include "alloc-util.h"
@@ -80,6 +81,42 @@ int config_item_table_lookup(const void *table, const char *section, const char
  * ConfigPerfItem tables */
 int config_item_perf_lookup(const void *table, const char *section, const char *lvalue, ConfigParserCallback *func, int *ltype, void **data, void *userdata);
 
+/* A configuration file, split into the logical lines to parse, i.e. with comments dropped and continuation
+ * lines joined. Reading a file doesn't log and doesn't depend on the parser tables, hence it may be done
+ * ahead of time and in a different thread. */
+typedef struct ConfigLine {
+        unsigned line;
+        char *text;
+} ConfigLine;
+
+typedef struct ConfigFile {
+        char *filename;
+        struct stat st;
+        bool have_stat;
+
+        ConfigLine *lines;
+        size_t n_lines;
+
+        /* Reading stops at the first error, which is reported when the file is parsed */
+        int read_error;
+        unsigned read_error_line;
+        bool read_error_continuation;
+} ConfigFile;
+
+int config_file_read(const char *filename, FILE *f, ConfigFile **ret);
+ConfigFile *config_file_free(ConfigFile *c);
+DEFINE_TRIVIAL_CLEANUP_FUNC(ConfigFile*, config_file_free);
+
+int config_parse_file(
+                const char *unit,
+                const ConfigFile *c,
+                const char *sections,       /* nulstr */
+                ConfigItemLookup lookup,
+                const void *table,
+                ConfigParseFlags flags,
+                void *userdata,
+                usec_t *ret_mtime);         /* possibly NULL */
+
 int config_parse(
                 const char *unit,
                 const char *filename,
@@ -1,11 +1,16 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "alloc-util.h"
 #include "env-util.h"
+#include "errno-util.h"
 #include "escape.h"
 #include "fileio.h"
+#include "hashmap.h"
+#include "memory-util.h"
 #include "missing_mman.h"
 #include "missing_syscall.h"
 #include "parse-util.h"
@@ -13,6 +18,7 @@
 #include "serialize.h"
 #include "strv.h"
 #include "tmpfile-util.h"
+#include "unaligned.h"
 
 int serialize_item(FILE *f, const char *key, const char *value) {
         assert(f);
@@ -213,3 +219,500 @@ int open_serialization_fd(const char *ident) {
 
         return fd;
 }
+
+/* The binary format starts with a magic that can't be mistaken for a line of the text format, followed by the
+ * version. Each record then consists of a 32bit header carrying the record type in the lowest 8 bits and the
+ * key index in the upper 24 bits, the 32bit payload size and the payload. Strings in the payload include
+ * their trailing NUL byte, so that they can be used right from the mapped file. All integers are little
+ * endian. Readers skip record types they don't know, new record types hence don't need a version bump. */
+
+static const uint8_t serialize_binary_magic[8] = { 0x7f, 'S', 'D', 'S', 'T', 'A', 'T', 'E' };
+
+#define SERIALIZE_BINARY_VERSION 1U
+#define SERIALIZE_BINARY_HEADER_SIZE (sizeof(serialize_binary_magic) + sizeof(uint32_t))
+#define SERIALIZE_RECORD_HEADER_SIZE (2 * sizeof(uint32_t))
+#define SERIALIZE_KEYS_MAX (UINT32_C(1) << 24)
+
+enum {
+        SERIALIZE_RECORD_KEY = 1,       /* defines the next key index, payload is the key */
+        SERIALIZE_RECORD_ITEM,          /* a key=value pair, payload is the value */
+        SERIALIZE_RECORD_LINE,          /* a line without "=", e.g. a unit name */
+        SERIALIZE_RECORD_END,           /* an empty line, i.e. the end of a section */
+};
+
+typedef struct SerializeKey {
+        char *name;
+        size_t length;
+        uint32_t next;                  /* index + 1 of the key that followed this one the last time */
+} SerializeKey;
+
+typedef struct BinarySerializer {
+        FILE *f;
+        Hashmap *key_index;             /* key → index + 1 */
+        SerializeKey *keys;
+        size_t n_keys, n_allocated_keys;
+        uint32_t last_key;
+
+        /* The line being written, which might be split across multiple writes */
+        char *line;
+        size_t n_line, n_allocated_line;
+
+        uint8_t *records;
+        size_t n_records, n_allocated_records;
+} BinarySerializer;
+
+static BinarySerializer *binary_serializer_free(BinarySerializer *s) {
+        if (!s)
+                return NULL;
+
+        hashmap_free(s->key_index);
+        for (size_t i = 0; i < s->n_keys; i++)
+                free(s->keys[i].name);
+        free(s->keys);
+        free(s->line);
+        free(s->records);
+
+        return mfree(s);
+}
+
+static int binary_serializer_put_record(BinarySerializer *s, uint8_t type, uint32_t key, const char *payload, size_t n) {
+        size_t size;
+        uint8_t *p;
+
+        assert(s);
+        assert(key < SERIALIZE_KEYS_MAX);
+
+        /* Strings are stored with a trailing NUL byte */
+        size = payload ? n + 1 : 0;
+        if (size > UINT32_MAX)
+                return -E2BIG;
+
+        /* Records are collected and written out in one go for each chunk of lines we get */
+        if (!GREEDY_REALLOC(s->records, s->n_allocated_records, s->n_records + SERIALIZE_RECORD_HEADER_SIZE + size))
+                return -ENOMEM;
+
+        p = s->records + s->n_records;
+        unaligned_write_le32(p, type | key << 8);
+        unaligned_write_le32(p + sizeof(uint32_t), size);
+        if (payload) {
+                memcpy_safe(p + SERIALIZE_RECORD_HEADER_SIZE, payload, n);
+                p[SERIALIZE_RECORD_HEADER_SIZE + n] = 0;
+        }
+
+        s->n_records += SERIALIZE_RECORD_HEADER_SIZE + size;
+        return 0;
+}
+
+static int binary_serializer_flush(BinarySerializer *s) {
+        assert(s);
+
+        if (s->n_records == 0)
+                return 0;
+
+        if (fwrite(s->records, s->n_records, 1, s->f) != 1)
+                return errno_or_else(EIO);
+
+        s->n_records = 0;
+        return 0;
+}
+
+static int binary_serializer_find_key(BinarySerializer *s, const char *key, size_t n, uint32_t *ret) {
+        _cleanup_free_ char *copy = NULL;
+        uint32_t next;
+        void *p;
+        int r;
+
+        assert(s);
+        assert(key);
+        assert(ret);
+
+        /* Every unit of a type serializes the same keys in the same order, hence try the key that followed
+         * the previous one the last time before hashing. */
+        next = s->last_key > 0 ? s->keys[s->last_key - 1].next : 0;
+        if (next > 0 && s->keys[next - 1].length == n && memcmp(s->keys[next - 1].name, key, n) == 0) {
+                *ret = s->last_key = next;
+                return 0;
+        }
+
+        copy = strndup(key, n);
+        if (!copy)
+                return -ENOMEM;
+
+        p = hashmap_get(s->key_index, copy);
+        if (p)
+                next = PTR_TO_UINT32(p);
+        else {
+                if (s->n_keys >= SERIALIZE_KEYS_MAX)
+                        return -E2BIG;
+
+                if (!GREEDY_REALLOC(s->keys, s->n_allocated_keys, s->n_keys + 1))
+                        return -ENOMEM;
+
+                r = hashmap_ensure_allocated(&s->key_index, &string_hash_ops);
+                if (r < 0)
+                        return r;
+
+                next = s->n_keys + 1;
+
+                r = hashmap_put(s->key_index, copy, UINT32_TO_PTR(next));
+                if (r < 0)
+                        return r;
+
+                s->keys[s->n_keys++] = (SerializeKey) {
+                        .name = TAKE_PTR(copy),
+                        .length = n,
+                };
+
+                r = binary_serializer_put_record(s, SERIALIZE_RECORD_KEY, 0, key, n);
+                if (r < 0)
+                        return r;
+        }
+
+        if (s->last_key > 0)
+                s->keys[s->last_key - 1].next = next;
+
+        *ret = s->last_key = next;
+        return 0;
+}
+
+static int binary_serializer_put_line(BinarySerializer *s, const char *line, size_t n) {
+        const char *eq;
+        uint32_t key;
+        int r;
+
+        assert(s);
+        assert(line || n == 0);
+
+        /* Strip the line like the text reader does, so that both formats deserialize to the same */
+        while (n > 0 && strchr(WHITESPACE, line[0])) {
+                line++;
+                n--;
+        }
+        while (n > 0 && strchr(WHITESPACE, line[n - 1]))
+                n--;
+
+        if (n == 0)
+                return binary_serializer_put_record(s, SERIALIZE_RECORD_END, 0, NULL, 0);
+
+        eq = memchr(line, '=', n);
+        if (!eq)
+                return binary_serializer_put_record(s, SERIALIZE_RECORD_LINE, 0, line, n);
+
+        r = binary_serializer_find_key(s, line, eq - line, &key);
+        if (r < 0)
+                return r;
+
+        return binary_serializer_put_record(s, SERIALIZE_RECORD_ITEM, key - 1, eq + 1, n - (eq - line) - 1);
+}
+
+static int binary_serializer_append(BinarySerializer *s, const char *buf, size_t size) {
+        assert(s);
+
+        if (size == 0)
+                return 0;
+
+        if (!GREEDY_REALLOC(s->line, s->n_allocated_line, s->n_line + size))
+                return -ENOMEM;
+
+        memcpy_safe(s->line + s->n_line, buf, size);
+        s->n_line += size;
+
+        return 0;
+}
+
+static ssize_t binary_serializer_write(void *cookie, const char *buf, size_t size) {
+        BinarySerializer *s = cookie;
+        const char *p = buf, *e;
+        size_t left = size;
+        int r;
+
+        while ((e = memchr(p, '\n', left))) {
+                if (s->n_line > 0) {
+                        /* Complete the line started by an earlier write */
+                        r = binary_serializer_append(s, p, e - p);
+                        if (r < 0)
+                                goto fail;
+
+                        r = binary_serializer_put_line(s, s->line, s->n_line);
+                        s->n_line = 0;
+                } else
+                        r = binary_serializer_put_line(s, p, e - p);
+                if (r < 0)
+                        goto fail;
+
+                left -= e - p + 1;
+                p = e + 1;
+        }
+
+        r = binary_serializer_append(s, p, left);
+        if (r < 0)
+                goto fail;
+
+        r = binary_serializer_flush(s);
+        if (r < 0)
+                goto fail;
+
+        return size;
+
+fail:
+        /* Cookie streams report errors by writing nothing */
+        errno = -r;
+        return 0;
+}
+
+static int binary_serializer_close(void *cookie) {
+        BinarySerializer *s = cookie;
+        int r = 0;
+
+        /* Terminate an incomplete last line */
+        if (s->n_line > 0)
+                r = binary_serializer_put_line(s, s->line, s->n_line);
+        if (r >= 0)
+                r = binary_serializer_flush(s);
+
+        binary_serializer_free(s);
+
+        if (r < 0) {
+                errno = -r;
+                return EOF;
+        }
+
+        return 0;
+}
+
+int serialize_binary_open(FILE *f, FILE **ret) {
+        BinarySerializer *s;
+        uint8_t header[SERIALIZE_BINARY_HEADER_SIZE];
+        FILE *b;
+
+        assert(f);
+        assert(ret);
+
+        memcpy(header, serialize_binary_magic, sizeof(serialize_binary_magic));
+        unaligned_write_le32(header + sizeof(serialize_binary_magic), SERIALIZE_BINARY_VERSION);
+
+        if (fwrite(header, sizeof(header), 1, f) != 1)
+                return errno_or_else(EIO);
+
+        s = new0(BinarySerializer, 1);
+        if (!s)
+                return -ENOMEM;
+
+        s->f = f;
+
+        b = fopencookie(s, "w", (cookie_io_functions_t) {
+                        .write = binary_serializer_write,
+                        .close = binary_serializer_close,
+                });
+        if (!b) {
+                binary_serializer_free(s);
+                return -errno;
+        }
+
+        *ret = b;
+        return 0;
+}
+
+struct Deserializer {
+        FILE *f;
+
+        /* Text format */
+        char *line;
+        bool eof;
+
+        /* Binary format */
+        void *map;
+        size_t map_size, offset;
+        const char **keys;
+        size_t n_keys, n_allocated_keys;
+};
+
+int deserializer_new(FILE *f, Deserializer **ret) {
+        _cleanup_(deserializer_freep) Deserializer *d = NULL;
+        const uint8_t *p;
+        uint32_t version;
+        struct stat st;
+        off_t offset;
+
+        assert(f);
+        assert(ret);
+
+        d = new0(Deserializer, 1);
+        if (!d)
+                return -ENOMEM;
+
+        d->f = f;
+
+        /* Only map the file if there is a binary serialization to read from it, otherwise go on with the text
+         * format line by line. */
+        offset = ftello(f);
+        if (offset < 0 || fstat(fileno(f), &st) < 0 || !S_ISREG(st.st_mode) ||
+            st.st_size < offset || (uint64_t) (st.st_size - offset) < SERIALIZE_BINARY_HEADER_SIZE ||
+            (uint64_t) st.st_size > SIZE_MAX)
+                goto finish;
+
+        d->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+        if (d->map == MAP_FAILED) {
+                d->map = NULL;
+                goto finish;
+        }
+
+        d->map_size = st.st_size;
+
+        p = (const uint8_t*) d->map + offset;
+        if (memcmp(p, serialize_binary_magic, sizeof(serialize_binary_magic)) != 0) {
+                (void) munmap(d->map, d->map_size);
+                d->map = NULL;
+                goto finish;
+        }
+
+        version = unaligned_read_le32(p + sizeof(serialize_binary_magic));
+        if (version > SERIALIZE_BINARY_VERSION) {
+                (void) munmap(d->map, d->map_size);
+                d->map = NULL;
+                return log_error_errno(SYNTHETIC_ERRNO(EPROTONOSUPPORT),
+                                       "Serialization uses unsupported binary format version %" PRIu32 ".", version);
+        }
+
+        d->offset = offset + SERIALIZE_BINARY_HEADER_SIZE;
+
+finish:
+        *ret = TAKE_PTR(d);
+        return 0;
+}
+
+Deserializer *deserializer_free(Deserializer *d) {
+        if (!d)
+                return NULL;
+
+        if (d->map) {
+                /* Leave the stream after what we consumed, as reading the text format would */
+                if (fseeko(d->f, d->offset, SEEK_SET) < 0)
+                        log_debug_errno(errno, "Failed to seek past binary serialization, ignoring: %m");
+
+                munmap(d->map, d->map_size);
+        }
+
+        free(d->line);
+        free(d->keys);
+
+        return mfree(d);
+}
+
+static int deserializer_read_item_text(Deserializer *d, const char **ret_key, const char **ret_value) {
+        char *l;
+        size_t k;
+        int r;
+
+        d->line = mfree(d->line);
+
+        r = read_line(d->f, LONG_LINE_MAX, &d->line);
+        if (r < 0)
+                return log_error_errno(r, "Failed to read serialization line: %m");
+        if (r == 0) {
+                d->eof = true;
+                return 0;
+        }
+
+        l = strstrip(d->line);
+        if (isempty(l)) /* End marker */
+                return 0;
+
+        k = strcspn(l, "=");
+        if (ret_value)
+                *ret_value = l[k] == '=' ? l + k + 1 : l + k;
+        l[k] = 0;
+
+        *ret_key = l;
+        return 1;
+}
+
+static int deserializer_read_item_binary(Deserializer *d, const char **ret_key, const char **ret_value) {
+        const uint8_t *p;
+        const char *payload;
+        uint32_t header, size;
+
+        for (;;) {
+                if (d->offset >= d->map_size)
+                        return 0;
+
+                if (d->map_size - d->offset < SERIALIZE_RECORD_HEADER_SIZE)
+                        return log_error_errno(SYNTHETIC_ERRNO(EBADMSG), "Truncated serialization record.");
+
+                p = (const uint8_t*) d->map + d->offset;
+                header = unaligned_read_le32(p);
+                size = unaligned_read_le32(p + sizeof(uint32_t));
+
+                if (size > d->map_size - d->offset - SERIALIZE_RECORD_HEADER_SIZE)
+                        return log_error_errno(SYNTHETIC_ERRNO(EBADMSG), "Truncated serialization record.");
+
+                payload = (const char*) p + SERIALIZE_RECORD_HEADER_SIZE;
+                d->offset += SERIALIZE_RECORD_HEADER_SIZE + size;
+
+                switch (header & 0xff) {
+
+                case SERIALIZE_RECORD_KEY:
+                        if (size == 0 || payload[size - 1] != 0)
+                                return log_error_errno(SYNTHETIC_ERRNO(EBADMSG), "Unterminated serialization key.");
+
+                        if (!GREEDY_REALLOC(d->keys, d->n_allocated_keys, d->n_keys + 1))
+                                return log_oom();
+
+                        d->keys[d->n_keys++] = payload;
+                        break;
+
+                case SERIALIZE_RECORD_ITEM:
+                        if (size == 0 || payload[size - 1] != 0)
+                                return log_error_errno(SYNTHETIC_ERRNO(EBADMSG), "Unterminated serialization item.");
+                        if ((header >> 8) >= d->n_keys)
+                                return log_error_errno(SYNTHETIC_ERRNO(EBADMSG), "Serialization item refers to undefined key.");
+
+                        *ret_key = d->keys[header >> 8];
+                        if (ret_value)
+                                *ret_value = payload;
+                        return 1;
+
+                case SERIALIZE_RECORD_LINE:
+                        if (size == 0 || payload[size - 1] != 0)
+                                return log_error_errno(SYNTHETIC_ERRNO(EBADMSG), "Unterminated serialization line.");
+
+                        *ret_key = payload;
+                        if (ret_value)
+                                *ret_value = payload + size - 1;
+                        return 1;
+
+                case SERIALIZE_RECORD_END:
+                        return 0;
+                }
+
+                /* Unknown record types are skipped */
+        }
+}
+
+int deserializer_read_item(Deserializer *d, const char **ret_key, const char **ret_value) {
+        assert(d);
+        assert(ret_key);
+
+        /* Returns > 0 if an item was read, and 0 at the end of a section or of the serialization. Lines without
+         * "=" are returned as key with an empty value. */
+
+        if (d->map)
+                return deserializer_read_item_binary(d, ret_key, ret_value);
+
+        return deserializer_read_item_text(d, ret_key, ret_value);
+}
+
+bool deserializer_eof(Deserializer *d) {
+        assert(d);
+
+        if (d->map)
+                return d->offset >= d->map_size;
+
+        return d->eof;
+}
+
+bool deserializer_is_binary(Deserializer *d) {
+        assert(d);
+
+        return d->map;
+}
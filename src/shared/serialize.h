@@ -25,3 +25,19 @@ int deserialize_dual_timestamp(const char *value, dual_timestamp *t);
 int deserialize_environment(const char *value, char ***environment);
 
 int open_serialization_fd(const char *ident);
+
+/* Returns a stream that turns the key=value lines written to it into length-prefixed binary records appended
+ * to f, with the keys stored only once in a key table. Closing it flushes the records. */
+int serialize_binary_open(FILE *f, FILE **ret);
+
+/* Reads items back from either the text or the binary format, whichever is found at the current position of
+ * f. Returned strings are valid until the next item is read. */
+typedef struct Deserializer Deserializer;
+
+int deserializer_new(FILE *f, Deserializer **ret);
+Deserializer *deserializer_free(Deserializer *d);
+DEFINE_TRIVIAL_CLEANUP_FUNC(Deserializer*, deserializer_free);
+
+int deserializer_read_item(Deserializer *d, const char **ret_key, const char **ret_value);
+bool deserializer_eof(Deserializer *d);
+bool deserializer_is_binary(Deserializer *d);
@@ -175,6 +175,8 @@ int sd_bus_set_exit_on_disconnect(sd_bus *bus, int b);
 int sd_bus_get_exit_on_disconnect(sd_bus *bus);
 int sd_bus_set_close_on_exit(sd_bus *bus, int b);
 int sd_bus_get_close_on_exit(sd_bus *bus);
+int sd_bus_set_batch_send(sd_bus *bus, int b);
+int sd_bus_get_batch_send(sd_bus *bus);
 int sd_bus_set_watch_bind(sd_bus *bus, int b);
 int sd_bus_get_watch_bind(sd_bus *bus);
 int sd_bus_set_connected_signal(sd_bus *bus, int b);
@@ -384,6 +386,7 @@ int sd_bus_emit_signal(sd_bus *bus, const char *path, const char *interface, con
 
 int sd_bus_emit_properties_changed_strv(sd_bus *bus, const char *path, const char *interface, char **names);
 int sd_bus_emit_properties_changed(sd_bus *bus, const char *path, const char *interface, const char *name, ...) _sd_sentinel_;
+int sd_bus_invalidate_properties(sd_bus *bus, const char *path, const char *interface);
 
 int sd_bus_emit_object_added(sd_bus *bus, const char *path);
 int sd_bus_emit_object_removed(sd_bus *bus, const char *path);
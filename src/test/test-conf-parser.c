@@ -385,6 +385,48 @@ static void test_config_parse(unsigned i, const char *s) {
         }
 }
 
+static void test_config_parse_file(void) {
+        _cleanup_(unlink_tempfilep) char name[] = "/tmp/test-conf-parser.XXXXXX";
+        _cleanup_(config_file_freep) ConfigFile *c = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *setting1 = NULL;
+        unsigned i;
+
+        const ConfigTableItem items[] = {
+                { "Section", "setting1",  config_parse_string,   0, &setting1},
+                {}
+        };
+
+        log_info("== %s ==", __func__);
+
+        assert_se(fmkostemp_safe(name, "r+", &f) == 0);
+        fputs("# comment\n"
+              "[Section]\n"
+              "setting1 = 1 \\\n"
+              "; comment\n"
+              "  2\n", f);
+        assert_se(fflush_and_check(f) >= 0);
+
+        assert_se(config_file_read(name, NULL, &c) == 0);
+        assert_se(c->have_stat);
+        assert_se(c->read_error == 0);
+        assert_se(c->n_lines == 2);
+        assert_se(c->lines[0].line == 2);
+        assert_se(streq(c->lines[0].text, "[Section]"));
+        assert_se(c->lines[1].line == 5);
+
+        /* The file may be parsed any number of times */
+        for (i = 0; i < 2; i++) {
+                setting1 = mfree(setting1);
+
+                assert_se(config_parse_file(NULL, c, "Section\0", config_item_table_lookup, items,
+                                            CONFIG_PARSE_WARN, NULL, NULL) == 0);
+                assert_se(streq(setting1, "1    2"));
+        }
+
+        assert_se(config_file_read("/no/such/file", NULL, &c) == -ENOENT);
+}
+
 int main(int argc, char **argv) {
         unsigned i;
 
@@ -407,5 +449,7 @@ int main(int argc, char **argv) {
         for (i = 0; i < ELEMENTSOF(config_file); i++)
                 test_config_parse(i, config_file[i]);
 
+        test_config_parse_file();
+
         return 0;
 }
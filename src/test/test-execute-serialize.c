@@ -0,0 +1,164 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "execute-serialize.h"
+#include "fd-util.h"
+#include "fdset.h"
+#include "fileio.h"
+#include "memory-util.h"
+#include "serialize.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+
+static char *dump_context(const ExecContext *c) {
+        _cleanup_fclose_ FILE *f = NULL;
+        char *buf = NULL;
+        size_t sz = 0;
+
+        assert_se(f = open_memstream_unlocked(&buf, &sz));
+        exec_context_dump(c, f, "\t");
+        assert_se(fflush_and_check(f) >= 0);
+        f = safe_fclose(f);
+
+        return buf;
+}
+
+static void setup_source(ExecInvocation *i, int fd) {
+        ExecContext *c = &i->context;
+        BindMount bm = {
+                .source = (char*) "/srv/with space",
+                .destination = (char*) "/var/lib/foo",
+                .read_only = true,
+                .recursive = true,
+        };
+
+        exec_invocation_init(i);
+
+        assert_se(i->unit.id = strdup("foo.service"));
+        assert_se(sd_id128_randomize(&i->unit.invocation_id) >= 0);
+        sd_id128_to_string(i->unit.invocation_id, i->unit.invocation_id_string);
+
+        assert_se(i->command.path = strdup("/bin/echo"));
+        assert_se(i->command.argv = strv_new("echo", "hello world", "tab\there", "\"quoted\""));
+        i->command.flags = EXEC_COMMAND_IGNORE_FAILURE;
+
+        assert_se(c->environment = strv_new("FOO=bar baz", "EMPTY="));
+        assert_se(c->user = strdup("nobody"));
+        assert_se(c->working_directory = strdup("/tmp/trailing space "));
+        assert_se(c->rlimit[RLIMIT_NOFILE] = new(struct rlimit, 1));
+        *c->rlimit[RLIMIT_NOFILE] = (struct rlimit) { 1024, 4096 };
+        c->cpu_sched_set = true;
+        c->cpu_sched_policy = SCHED_BATCH;
+        c->private_tmp = true;
+        c->protect_system = PROTECT_SYSTEM_STRICT;
+        c->std_output = EXEC_OUTPUT_JOURNAL;
+        c->syslog_priority = LOG_DAEMON|LOG_NOTICE;
+        assert_se(c->read_only_paths = strv_new("/etc", "-/opt"));
+        assert_se(strv_extend(&c->directories[EXEC_DIRECTORY_STATE].paths, "foo") >= 0);
+        c->directories[EXEC_DIRECTORY_STATE].mode = 0700;
+        assert_se(bind_mount_add(&c->bind_mounts, &c->n_bind_mounts, &bm) >= 0);
+        assert_se(temporary_filesystem_add(&c->temporary_filesystems, &c->n_temporary_filesystems, "/run/foo", "mode=0755") >= 0);
+        assert_se(c->stdin_data = strdup("some\ndata"));
+        c->stdin_data_size = strlen(c->stdin_data);
+
+        assert_se(i->params.fds = new(int, 1));
+        i->params.fds[0] = fd;
+        i->params.n_storage_fds = 1;
+        assert_se(i->params.fd_names = strv_new("stored"));
+        assert_se(i->params.environment = strv_new("INVOCATION_ID=foo"));
+        i->params.flags = EXEC_APPLY_SANDBOXING|EXEC_PASS_FDS;
+        i->params.watchdog_usec = 5 * USEC_PER_SEC;
+        assert_se(i->prefix[EXEC_DIRECTORY_STATE] = strdup("/var/lib"));
+        i->params.prefix = i->prefix;
+
+        assert_se(i->files_env = strv_new("FILE=env"));
+}
+
+static void test_exec_invocation_serialize(void) {
+        _cleanup_(exec_invocation_done) ExecInvocation a, b;
+        _cleanup_free_ char *dump_a = NULL, *dump_b = NULL;
+        _cleanup_fdset_free_ FDSet *fds = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        int fd;
+
+        log_info("/* %s */", __func__);
+
+        assert_se((fd = open("/dev/null", O_RDONLY|O_CLOEXEC)) >= 0);
+        setup_source(&a, fd);
+        exec_invocation_init(&b);
+
+        assert_se(fds = fdset_new());
+        assert_se((fd = open_serialization_fd("test-execute-serialize")) >= 0);
+        assert_se(f = fdopen(fd, "w+"));
+
+        assert_se(exec_invocation_serialize(f, fds, &a.unit, &a.command, &a.context, &a.params,
+                                            NULL, NULL, a.files_env, -1) >= 0);
+        assert_se(fdset_size(fds) == 1);
+
+        rewind(f);
+        assert_se(exec_invocation_deserialize(&b, f, fds) >= 0);
+        assert_se(fdset_isempty(fds));
+
+        assert_se(streq(b.unit.id, "foo.service"));
+        assert_se(sd_id128_equal(a.unit.invocation_id, b.unit.invocation_id));
+        assert_se(streq(b.command.path, a.command.path));
+        assert_se(strv_equal(b.command.argv, a.command.argv));
+        assert_se(b.command.flags == a.command.flags);
+
+        assert_se(b.params.n_socket_fds == 0);
+        assert_se(b.params.n_storage_fds == 1);
+        assert_se(b.params.fds[0] >= 0 && b.params.fds[0] != a.params.fds[0]);
+        assert_se(strv_equal(b.params.fd_names, a.params.fd_names));
+        assert_se(strv_equal(b.params.environment, a.params.environment));
+        assert_se(b.params.flags == a.params.flags);
+        assert_se(b.params.watchdog_usec == a.params.watchdog_usec);
+        assert_se(streq(b.params.prefix[EXEC_DIRECTORY_STATE], "/var/lib"));
+        assert_se(!b.params.prefix[EXEC_DIRECTORY_RUNTIME]);
+        assert_se(strv_equal(b.files_env, a.files_env));
+        assert_se(b.user_lookup_fd < 0);
+        assert_se(!b.has_runtime);
+
+        assert_se(memcmp_nn(a.context.stdin_data, a.context.stdin_data_size,
+                            b.context.stdin_data, b.context.stdin_data_size) == 0);
+
+        assert_se(dump_a = dump_context(&a.context));
+        assert_se(dump_b = dump_context(&b.context));
+        puts(dump_b);
+        assert_se(streq(dump_a, dump_b));
+}
+
+static void test_exec_invocation_deserialize_invalid(void) {
+        _cleanup_(exec_invocation_done) ExecInvocation i;
+        _cleanup_fdset_free_ FDSet *fds = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        int fd;
+
+        log_info("/* %s */", __func__);
+
+        exec_invocation_init(&i);
+        assert_se(fds = fdset_new());
+        assert_se((fd = open_serialization_fd("test-execute-serialize")) >= 0);
+        assert_se(f = fdopen(fd, "w+"));
+
+        assert_se(serialize_item(f, "unit-id", "foo.service") > 0);
+        assert_se(serialize_item(f, "exec-command-path", "/bin/true") > 0);
+        assert_se(serialize_item(f, "exec-context-no-such-thing", "yes") > 0);
+        assert_se(fflush_and_check(f) >= 0);
+
+        rewind(f);
+        assert_se(exec_invocation_deserialize(&i, f, fds) == -EBADMSG);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_DEBUG);
+
+        test_exec_invocation_serialize();
+        test_exec_invocation_deserialize_invalid();
+
+        return 0;
+}
@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "fd-util.h"
+#include "fileio.h"
+#include "fs-util.h"
+#include "manager.h"
+#include "mkdir.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+#include "unit.h"
+
+static void write_unit(const char *dir, const char *name, const char *contents) {
+        _cleanup_free_ char *p = NULL;
+        struct timespec ts[2];
+        usec_t t;
+
+        assert_se(p = path_join(dir, name));
+        assert_se(mkdir_parents(p, 0755) >= 0);
+        assert_se(write_string_file(p, contents, WRITE_STRING_FILE_CREATE) >= 0);
+
+        /* Make sure the change is noticed even if the file system timestamps are coarse */
+        t = now(CLOCK_REALTIME) + USEC_PER_SEC;
+        timespec_store(ts + 0, t);
+        timespec_store(ts + 1, t);
+        assert_se(utimensat(AT_FDCWD, p, ts, 0) >= 0);
+}
+
+static bool has_dependency(Unit *u, UnitDependency d, Unit *other) {
+        return unit_dependency_array_contains(u->dependencies[d], other);
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL, *unit_dir = NULL;
+        _cleanup_(manager_freep) Manager *m = NULL;
+        _cleanup_free_ char *link = NULL;
+        Unit *a, *b, *c, *a2, *b2, *b3;
+        Job *j;
+        int r;
+
+        test_setup_logging(LOG_DEBUG);
+
+        r = enter_cgroup_subroot(NULL);
+        if (r == -ENOMEDIUM)
+                return log_tests_skipped("cgroupfs not available");
+
+        assert_se(mkdtemp_malloc("/tmp/test-reload-incremental.XXXXXX", &unit_dir) >= 0);
+        write_unit(unit_dir, "a.service",
+                   "[Unit]\n"
+                   "Description=A1\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        write_unit(unit_dir, "b.service",
+                   "[Unit]\n"
+                   "Wants=a.service\n"
+                   "After=a.service\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        write_unit(unit_dir, "c.service",
+                   "[Unit]\n"
+                   "DefaultDependencies=no\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+
+        assert_se(set_unit_path(unit_dir) >= 0);
+        assert_se(runtime_dir = setup_fake_runtime_dir());
+
+        r = manager_new(UNIT_FILE_USER, MANAGER_TEST_RUN_BASIC, &m);
+        if (manager_errno_skip_test(r))
+                return log_tests_skipped_errno(r, "manager_new");
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        assert_se(manager_load_startable_unit_or_warn(m, "b.service", NULL, &b) >= 0);
+        assert_se(manager_load_startable_unit_or_warn(m, "c.service", NULL, &c) >= 0);
+        assert_se(a = manager_get_unit(m, "a.service"));
+        assert_se(streq(a->description, "A1"));
+
+        /* Nothing changed */
+        assert_se(manager_reload_incremental(m) >= 0);
+        assert_se(manager_get_unit(m, "a.service") == a);
+        assert_se(dual_timestamp_is_set(m->timestamps + MANAGER_TIMESTAMP_RELOAD_FINISH));
+
+        /* Only the changed unit is reloaded, and keeps the dependencies the other unit has on it */
+        write_unit(unit_dir, "a.service",
+                   "[Unit]\n"
+                   "Description=A2\n"
+                   "Requires=c.service\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        assert_se(manager_reload_incremental(m) >= 0);
+
+        assert_se(manager_get_unit(m, "b.service") == b);
+        assert_se(manager_get_unit(m, "c.service") == c);
+        assert_se(a2 = manager_get_unit(m, "a.service"));
+        assert_se(streq(a2->description, "A2"));
+        assert_se(has_dependency(b, UNIT_WANTS, a2));
+        assert_se(has_dependency(b, UNIT_AFTER, a2));
+        assert_se(has_dependency(a2, UNIT_WANTED_BY, b));
+        assert_se(has_dependency(a2, UNIT_BEFORE, b));
+        assert_se(has_dependency(a2, UNIT_REQUIRES, c));
+        assert_se(has_dependency(c, UNIT_REQUIRED_BY, a2));
+
+        /* Drop-ins are picked up too, and dependencies from the changed unit are rebuilt */
+        write_unit(unit_dir, "b.service.d/override.conf",
+                   "[Unit]\n"
+                   "Description=B2\n");
+        assert_se(manager_reload_incremental(m) >= 0);
+
+        assert_se(manager_get_unit(m, "a.service") == a2);
+        assert_se(b2 = manager_get_unit(m, "b.service"));
+        assert_se(streq(b2->description, "B2"));
+        assert_se(has_dependency(b2, UNIT_WANTS, a2));
+        assert_se(has_dependency(a2, UNIT_WANTED_BY, b2));
+        assert_se(has_dependency(a2, UNIT_BEFORE, b2));
+
+        /* So are symlinks added to and removed from .wants/ and .requires/ */
+        assert_se(link = path_join(unit_dir, "b.service.requires/c.service"));
+        assert_se(mkdir_parents(link, 0755) >= 0);
+        assert_se(symlink("../c.service", link) >= 0);
+        assert_se(manager_reload_incremental(m) >= 0);
+
+        assert_se(b3 = manager_get_unit(m, "b.service"));
+        assert_se(has_dependency(b3, UNIT_REQUIRES, c));
+        assert_se(has_dependency(c, UNIT_REQUIRED_BY, b3));
+        assert_se(has_dependency(b3, UNIT_WANTS, a2));
+
+        assert_se(unlink(link) >= 0);
+        assert_se(manager_reload_incremental(m) >= 0);
+
+        assert_se(b2 = manager_get_unit(m, "b.service"));
+        assert_se(!has_dependency(b2, UNIT_REQUIRES, c));
+        assert_se(!has_dependency(c, UNIT_REQUIRED_BY, b2));
+        assert_se(has_dependency(b2, UNIT_WANTS, a2));
+
+        /* Units with jobs can't be replaced, a full reload is needed */
+        assert_se(manager_add_job(m, JOB_START, c, JOB_REPLACE, NULL, NULL, &j) == 0);
+        write_unit(unit_dir, "c.service",
+                   "[Unit]\n"
+                   "Description=C2\n"
+                   "DefaultDependencies=no\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        assert_se(manager_reload_incremental(m) == -ESTALE);
+        assert_se(manager_get_unit(m, "c.service") == c);
+
+        manager_clear_jobs(m);
+        assert_se(manager_reload_incremental(m) >= 0);
+        assert_se(streq(manager_get_unit(m, "c.service")->description, "C2"));
+        assert_se(has_dependency(a2, UNIT_REQUIRES, manager_get_unit(m, "c.service")));
+
+        return 0;
+}
@@ -191,6 +191,104 @@ static void test_serialize_environment(void) {
         assert_se(strv_equal(env, env2));
 }
 
+static void write_items(FILE *f) {
+        (void) serialize_item(f, "a", "1");
+        (void) serialize_item(f, "b", " two ");
+        (void) serialize_item(f, "a", "3");
+        (void) serialize_item(f, "c", "");
+        (void) serialize_item(f, "long", long_string + LONG_LINE_MAX - 20000);
+        fputs("section\n", f);
+        fputs("\n", f);
+        fputs("b=last", f);
+}
+
+static void check_items(Deserializer *d) {
+        const char *k, *v;
+
+        assert_se(deserializer_read_item(d, &k, &v) > 0);
+        assert_se(streq(k, "a") && streq(v, "1"));
+        assert_se(deserializer_read_item(d, &k, &v) > 0);
+        assert_se(streq(k, "b") && streq(v, " two"));
+        assert_se(deserializer_read_item(d, &k, &v) > 0);
+        assert_se(streq(k, "a") && streq(v, "3"));
+        assert_se(deserializer_read_item(d, &k, &v) > 0);
+        assert_se(streq(k, "c") && streq(v, ""));
+        assert_se(deserializer_read_item(d, &k, &v) > 0);
+        assert_se(streq(k, "long") && streq(v, long_string + LONG_LINE_MAX - 20000));
+        assert_se(deserializer_read_item(d, &k, &v) > 0);
+        assert_se(streq(k, "section") && streq(v, ""));
+        assert_se(deserializer_read_item(d, &k, &v) == 0);
+        assert_se(!deserializer_eof(d));
+        assert_se(deserializer_read_item(d, &k, &v) > 0);
+        assert_se(streq(k, "b") && streq(v, "last"));
+        assert_se(deserializer_read_item(d, &k, &v) == 0);
+        assert_se(deserializer_eof(d));
+}
+
+static void test_deserializer(bool binary) {
+        _cleanup_(unlink_tempfilep) char fn[] = "/tmp/test-serialize.XXXXXX";
+        _cleanup_(deserializer_freep) Deserializer *d = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *line = NULL;
+
+        assert_se(fmkostemp_safe(fn, "r+", &f) == 0);
+        log_info("/* %s(%s) (%s) */", __func__, yes_no(binary), fn);
+
+        /* Some text first, as the manager writes its own state before the units */
+        assert_se(serialize_item(f, "x", "y") == 1);
+        fputc('\n', f);
+
+        if (binary) {
+                _cleanup_fclose_ FILE *b = NULL;
+
+                assert_se(serialize_binary_open(f, &b) >= 0);
+                write_items(b);
+                assert_se(fflush_and_check(b) >= 0);
+        } else
+                write_items(f);
+
+        assert_se(fflush_and_check(f) >= 0);
+        rewind(f);
+
+        assert_se(read_line(f, LONG_LINE_MAX, &line) > 0);
+        assert_se(streq(line, "x=y"));
+        line = mfree(line);
+        assert_se(read_line(f, LONG_LINE_MAX, &line) > 0);
+        assert_se(streq(line, ""));
+
+        assert_se(deserializer_new(f, &d) >= 0);
+        assert_se(deserializer_is_binary(d) == binary);
+        check_items(d);
+
+        d = deserializer_free(d);
+        assert_se(fgetc(f) == EOF);
+}
+
+static void test_deserializer_truncated(void) {
+        _cleanup_(unlink_tempfilep) char fn[] = "/tmp/test-serialize.XXXXXX";
+        _cleanup_(deserializer_freep) Deserializer *d = NULL;
+        _cleanup_fclose_ FILE *f = NULL, *b = NULL;
+        const char *k, *v;
+        off_t size;
+
+        assert_se(fmkostemp_safe(fn, "r+", &f) == 0);
+        log_info("/* %s (%s) */", __func__, fn);
+
+        assert_se(serialize_binary_open(f, &b) >= 0);
+        assert_se(serialize_item(b, "a", "bbb") == 1);
+        b = safe_fclose(b);
+        assert_se(fflush_and_check(f) >= 0);
+
+        size = ftello(f);
+        assert_se(size > 0);
+        assert_se(ftruncate(fileno(f), size - 1) >= 0);
+        rewind(f);
+
+        assert_se(deserializer_new(f, &d) >= 0);
+        assert_se(deserializer_is_binary(d));
+        assert_se(deserializer_read_item(d, &k, &v) == -EBADMSG);
+}
+
 int main(int argc, char *argv[]) {
         test_setup_logging(LOG_INFO);
 
@@ -203,6 +301,9 @@ int main(int argc, char *argv[]) {
         test_serialize_strv();
         test_deserialize_environment();
         test_serialize_environment();
+        test_deserializer(false);
+        test_deserializer(true);
+        test_deserializer_truncated();
 
         return EXIT_SUCCESS;
 }
@@ -0,0 +1,187 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stdlib.h>
+
+#include "alloc-util.h"
+#include "random-util.h"
+#include "sort-util.h"
+#include "tests.h"
+#include "timer-wheel.h"
+
+#define N_ENTRIES 4096
+#define ACCURACY (250 * USEC_PER_MSEC)
+
+static int entry_compare(TimerWheelEntry * const *a, TimerWheelEntry * const *b) {
+        return CMP((*a)->time, (*b)->time);
+}
+
+static void test_basic(void) {
+        _cleanup_(timer_wheel_freep) TimerWheel *w = NULL;
+        TimerWheelEntry a = {}, b = {}, c = {};
+        usec_t earliest, latest;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(w = timer_wheel_new(ACCURACY));
+        assert_se(timer_wheel_isempty(w));
+        assert_se(!timer_wheel_peek(w, NULL, NULL));
+        assert_se(!timer_wheel_pop(w, 0));
+
+        timer_wheel_add(w, &a, 10 * USEC_PER_SEC, 11 * USEC_PER_SEC);
+        timer_wheel_add(w, &b, 5 * USEC_PER_SEC, 20 * USEC_PER_SEC);
+        timer_wheel_add(w, &c, 100 * USEC_PER_DAY, USEC_INFINITY);
+        assert_se(timer_wheel_size(w) == 3);
+
+        /* Only b is in the first slot, the bound covers a, which is in a later one */
+        assert_se(timer_wheel_peek(w, &earliest, &latest));
+        assert_se(earliest == 5 * USEC_PER_SEC);
+        assert_se(latest >= earliest && latest <= 11 * USEC_PER_SEC);
+
+        assert_se(!timer_wheel_pop(w, 5 * USEC_PER_SEC - 1));
+        assert_se(timer_wheel_pop(w, 5 * USEC_PER_SEC) == &b);
+        assert_se(!b.linked);
+        assert_se(!timer_wheel_pop(w, 5 * USEC_PER_SEC));
+
+        assert_se(timer_wheel_peek(w, &earliest, &latest));
+        assert_se(earliest == 10 * USEC_PER_SEC);
+        assert_se(latest == 11 * USEC_PER_SEC);
+
+        timer_wheel_remove(w, &a);
+        assert_se(!a.linked);
+        assert_se(timer_wheel_peek(w, &earliest, NULL));
+        assert_se(earliest == 100 * USEC_PER_DAY);
+
+        /* Entries that elapsed already are returned right away */
+        timer_wheel_add(w, &a, 1, 1 + ACCURACY);
+        assert_se(timer_wheel_peek(w, &earliest, NULL));
+        assert_se(earliest == 1);
+        assert_se(timer_wheel_pop(w, 6 * USEC_PER_SEC) == &a);
+
+        assert_se(timer_wheel_pop(w, 200 * USEC_PER_DAY) == &c);
+        assert_se(timer_wheel_isempty(w));
+}
+
+static void test_random(void) {
+        _cleanup_(timer_wheel_freep) TimerWheel *w = NULL;
+        _cleanup_free_ TimerWheelEntry *entries = NULL, **sorted = NULL;
+        usec_t n = 0;
+        unsigned i, k;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(w = timer_wheel_new(ACCURACY));
+        assert_se(entries = new0(TimerWheelEntry, N_ENTRIES));
+        assert_se(sorted = new(TimerWheelEntry*, N_ENTRIES));
+
+        /* Spread the entries over a range of magnitudes, so that all levels are used */
+        for (i = 0; i < N_ENTRIES; i++) {
+                usec_t t, accuracy;
+
+                t = random_u64() % (USEC_PER_SEC << (random_u64() % 28));
+                accuracy = ACCURACY + random_u64() % USEC_PER_MINUTE;
+
+                timer_wheel_add(w, entries + i, t, t + accuracy);
+                sorted[i] = entries + i;
+        }
+
+        /* Remove every fourth, and add it back */
+        for (i = 0; i < N_ENTRIES; i += 4) {
+                timer_wheel_remove(w, entries + i);
+                timer_wheel_add(w, entries + i, entries[i].time, entries[i].latest);
+        }
+
+        assert_se(timer_wheel_size(w) == N_ENTRIES);
+        typesafe_qsort(sorted, N_ENTRIES, entry_compare);
+
+        /* Walk through time in steps of increasing size, and check that exactly the elapsed entries are
+         * returned, and that the bounds are right */
+        for (i = 0, k = 0; k < N_ENTRIES; n += 1 + (random_u64() % (n / 4 + USEC_PER_SEC))) {
+                usec_t earliest, latest, l = USEC_INFINITY;
+                TimerWheelEntry *e;
+                unsigned j;
+
+                assert_se(timer_wheel_peek(w, &earliest, &latest));
+                assert_se(earliest == sorted[k]->time);
+
+                for (j = k; j < N_ENTRIES; j++)
+                        l = MIN(l, sorted[j]->latest);
+                assert_se(latest >= earliest);
+                assert_se(latest <= l);
+
+                while ((e = timer_wheel_pop(w, n))) {
+                        assert_se(e->time <= n);
+                        assert_se(!e->linked);
+                        i++;
+                }
+
+                while (k < N_ENTRIES && sorted[k]->time <= n) {
+                        assert_se(!sorted[k]->linked);
+                        k++;
+                }
+
+                assert_se(i == k);
+                assert_se(timer_wheel_size(w) == N_ENTRIES - k);
+        }
+
+        assert_se(timer_wheel_isempty(w));
+        assert_se(!timer_wheel_peek(w, NULL, NULL));
+}
+
+static void test_remove(void) {
+        _cleanup_(timer_wheel_freep) TimerWheel *w = NULL;
+        _cleanup_free_ TimerWheelEntry *entries = NULL;
+        unsigned i, j;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(w = timer_wheel_new(ACCURACY));
+        assert_se(entries = new0(TimerWheelEntry, N_ENTRIES));
+
+        /* Close together, so that many share the first slot */
+        for (i = 0; i < N_ENTRIES; i++) {
+                usec_t t;
+
+                t = random_u64() % (10 * USEC_PER_SEC);
+                timer_wheel_add(w, entries + i, t, t + ACCURACY + random_u64() % USEC_PER_SEC);
+        }
+
+        /* Remove the entries in random order, and check that the bounds are still right each time, while
+         * the cached ones are kept */
+        for (i = N_ENTRIES; i > 0; i--) {
+                usec_t earliest, latest, e = USEC_INFINITY, l = USEC_INFINITY;
+                TimerWheelEntry *x;
+
+                x = entries + random_u64() % N_ENTRIES;
+                while (!x->linked)
+                        x = x == entries + N_ENTRIES - 1 ? entries : x + 1;
+
+                timer_wheel_remove(w, x);
+                assert_se(timer_wheel_size(w) == i - 1);
+
+                for (j = 0; j < N_ENTRIES; j++)
+                        if (entries[j].linked) {
+                                e = MIN(e, entries[j].time);
+                                l = MIN(l, entries[j].latest);
+                        }
+
+                if (i == 1) {
+                        assert_se(!timer_wheel_peek(w, NULL, NULL));
+                        break;
+                }
+
+                assert_se(timer_wheel_peek(w, &earliest, &latest));
+                assert_se(earliest == e);
+                assert_se(latest >= earliest);
+                assert_se(latest <= l);
+        }
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        test_basic();
+        test_random();
+        test_remove();
+
+        return 0;
+}
@@ -0,0 +1,221 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stdlib.h>
+
+#include "alloc-util.h"
+#include "random-util.h"
+#include "tests.h"
+#include "unit-dependency.h"
+
+/* The array never dereferences the units, any distinct addresses will do */
+#define N_UNITS 2000
+static char units[N_UNITS];
+
+#define UNIT_AT(k) ((Unit*) (units + (k)))
+
+static unsigned info_to_model(UnitDependencyInfo info) {
+        return info.data ? info.origin_mask | info.destination_mask << 16 : 0;
+}
+
+static void check(const UnitDependencyArray *a, const unsigned *model) {
+        _cleanup_free_ bool *seen = NULL;
+        unsigned i = 0, n = 0, n_seen = 0;
+        UnitDependencyInfo info;
+        Unit *u;
+
+        assert_se(seen = new0(bool, N_UNITS));
+
+        for (unsigned k = 0; k < N_UNITS; k++) {
+                assert_se(info_to_model(unit_dependency_array_get(a, UNIT_AT(k))) == model[k]);
+                assert_se(unit_dependency_array_contains(a, UNIT_AT(k)) == !!model[k]);
+                if (model[k])
+                        n++;
+        }
+
+        assert_se(unit_dependency_array_size(a) == n);
+        assert_se(unit_dependency_array_isempty(a) == (n == 0));
+
+        while (unit_dependency_array_next(a, &i, &u, &info)) {
+                ptrdiff_t k = (char*) u - units;
+
+                assert_se(k >= 0 && k < N_UNITS);
+                assert_se(!seen[k]);
+                assert_se(info_to_model(info) == model[k]);
+                seen[k] = true;
+                n_seen++;
+        }
+
+        assert_se(n_seen == n);
+
+        for (unsigned k = 1; a && k < a->n_sorted; k++)
+                assert_se((uintptr_t) a->entries[k-1].unit < (uintptr_t) a->entries[k].unit);
+}
+
+static void test_unit_dependency_array_random(void) {
+        _cleanup_free_ unsigned *model = NULL;
+        UnitDependencyArray *a = NULL;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(model = new0(unsigned, N_UNITS));
+
+        for (unsigned n = 0; n < 100000; n++) {
+                unsigned k = random_u32() % N_UNITS, op = random_u32() % 10;
+                UnitDependencyInfo info = {
+                        .origin_mask = random_u32() & _UNIT_DEPENDENCY_MASK_FULL,
+                        .destination_mask = random_u32() & _UNIT_DEPENDENCY_MASK_FULL,
+                };
+
+                if (op < 5) {
+                        unsigned m;
+
+                        if (!info.origin_mask && !info.destination_mask)
+                                info.origin_mask = UNIT_DEPENDENCY_FILE;
+
+                        m = model[k] | info_to_model(info);
+                        assert_se(unit_dependency_array_add(&a, UNIT_AT(k), info) == (m != model[k]));
+                        model[k] = m;
+
+                } else if (op < 8) {
+                        assert_se(unit_dependency_array_remove(a, UNIT_AT(k)) == !!model[k]);
+                        model[k] = 0;
+
+                } else if (model[k]) {
+                        info.origin_mask &= model[k];
+                        info.destination_mask &= model[k] >> 16;
+
+                        unit_dependency_array_update(a, UNIT_AT(k), info);
+                        model[k] = info.origin_mask | info.destination_mask << 16;
+                }
+
+                if (n % 1000 == 0)
+                        check(a, model);
+        }
+
+        check(a, model);
+        unit_dependency_array_free(a);
+}
+
+static void test_unit_dependency_array_remove_while_iterating(void) {
+        _cleanup_free_ unsigned *model = NULL;
+        UnitDependencyArray *a = NULL;
+        unsigned i = 0;
+        Unit *u;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(model = new0(unsigned, N_UNITS));
+
+        for (unsigned k = 0; k < N_UNITS; k++) {
+                assert_se(unit_dependency_array_add(&a, UNIT_AT(k), (UnitDependencyInfo) { .destination_mask = UNIT_DEPENDENCY_FILE }) == 1);
+                model[k] = UNIT_DEPENDENCY_FILE << 16;
+        }
+
+        check(a, model);
+
+        while (unit_dependency_array_next(a, &i, &u, NULL)) {
+                ptrdiff_t k = (char*) u - units;
+
+                if (k % 3 == 0) {
+                        assert_se(unit_dependency_array_remove(a, u));
+                        model[k] = 0;
+                }
+        }
+
+        check(a, model);
+        unit_dependency_array_free(a);
+}
+
+static void test_unit_dependency_array_move(void) {
+        _cleanup_free_ unsigned *model = NULL;
+        UnitDependencyArray *a = NULL, *b = NULL, *c = NULL;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(model = new0(unsigned, N_UNITS));
+
+        for (unsigned k = 0; k < 100; k++) {
+                assert_se(unit_dependency_array_add(&a, UNIT_AT(k), (UnitDependencyInfo) { .origin_mask = UNIT_DEPENDENCY_FILE }) == 1);
+                model[k] |= UNIT_DEPENDENCY_FILE;
+        }
+
+        for (unsigned k = 50; k < 300; k++) {
+                assert_se(unit_dependency_array_add(&b, UNIT_AT(k), (UnitDependencyInfo) { .origin_mask = UNIT_DEPENDENCY_UDEV }) == 1);
+                model[k] |= UNIT_DEPENDENCY_UDEV;
+        }
+
+        assert_se(unit_dependency_array_reserve(&a, unit_dependency_array_size(b)) >= 0);
+        assert_se(unit_dependency_array_move(&a, &b) == 0);
+        assert_se(!b);
+        check(a, model);
+
+        /* Moving into an unallocated array just passes the allocation on */
+        assert_se(unit_dependency_array_move(&c, &a) == 0);
+        assert_se(!a);
+        check(c, model);
+
+        unit_dependency_array_free(c);
+}
+
+static void test_unit_dependency_array_replace(void) {
+        _cleanup_free_ unsigned *model = NULL;
+        UnitDependencyArray *a = NULL, *saved;
+        unsigned n_allocated;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(model = new0(unsigned, N_UNITS));
+
+        /* Enough entries for most of them to be in the sorted part, and some in the tail */
+        for (unsigned k = 0; k < 200; k += 2) {
+                assert_se(unit_dependency_array_add(&a, UNIT_AT(k), (UnitDependencyInfo) { .origin_mask = UNIT_DEPENDENCY_FILE }) == 1);
+                model[k] = UNIT_DEPENDENCY_FILE;
+        }
+        assert_se(a->n_sorted > 0 && a->n_sorted < a->n_entries);
+
+        assert_se(unit_dependency_array_remove(a, UNIT_AT(100)));
+        model[100] = 0;
+
+        saved = a;
+        n_allocated = a->n_allocated;
+
+        for (unsigned n = 0; n < 10000; n++) {
+                unsigned old = random_u32() % N_UNITS, k = random_u32() % N_UNITS;
+
+                if (!model[old] || old == k)
+                        continue;
+
+                /* Onto units the array has no entry for, a removed one, or an existing one to merge with */
+                unit_dependency_array_replace(a, UNIT_AT(old), UNIT_AT(k));
+                model[k] |= model[old];
+                model[old] = 0;
+
+                if (n % 100 == 0)
+                        check(a, model);
+
+                /* Keep some around */
+                if (unit_dependency_array_size(a) < 10) {
+                        assert_se(unit_dependency_array_add(&a, UNIT_AT(old), (UnitDependencyInfo) { .destination_mask = UNIT_DEPENDENCY_UDEV }) == 1);
+                        model[old] = UNIT_DEPENDENCY_UDEV << 16;
+                        saved = a;
+                        n_allocated = a->n_allocated;
+                }
+        }
+
+        /* Never allocates */
+        assert_se(a == saved && a->n_allocated == n_allocated);
+
+        check(a, model);
+        unit_dependency_array_free(a);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        test_unit_dependency_array_random();
+        test_unit_dependency_array_remove_while_iterating();
+        test_unit_dependency_array_move();
+        test_unit_dependency_array_replace();
+
+        return EXIT_SUCCESS;
+}